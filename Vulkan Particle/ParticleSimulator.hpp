@@ -0,0 +1,584 @@
+#pragma once
+
+/*
+* Host side particle simulator class
+*
+* Same simulation as particle_simulate.comp, with the particle state kept in SoA layout and integrated in batches
+* of 8 (AVX2) or 4 (NEON) particles. The results are bit identical to the scalar reference and the compute kernel,
+* so the simulator doubles as fallback for devices without a usable compute path and as reference for validation.
+* Each step streams position + packed color of all particles into a persistently mapped vertex buffer region.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+
+#include "vksSimd.h"
+#include "vksJobSystem.h"
+#include "VulkanParticleSystem.hpp"
+
+namespace vks
+{
+	/**
+	* @brief Vertex layout written by the host simulator
+	*
+	* Matches the following shader layout (see particle_color.vert):
+	*	layout (location = 0) in vec3 inPos;
+	*	layout (location = 1) in vec4 inColor;	(R8G8B8A8_UNORM)
+	*/
+	struct ParticleVertex
+	{
+		float position[3];
+		uint32_t color;
+	};
+
+	/**
+	* @brief Persistently mapped vertex buffer for host simulated particles
+	*
+	* @note One region per frame in flight, the host only writes the region of the current frame after its fence wait
+	*/
+	struct ParticleVertexBuffer
+	{
+		vks::Buffer buffer;
+		/** @brief Max. number of vertices per region */
+		uint32_t capacity = 0;
+		/** @brief Number of regions (frames in flight) */
+		uint32_t regionCount = 0;
+
+		/**
+		* Create the buffer and keep it mapped for the lifetime of the object
+		*
+		* @param device Device to create the buffer on
+		* @param capacity Max. number of vertices per region (use the padded particle count of the simulator)
+		* @param regionCount Number of regions (frames in flight)
+		*/
+		void create(vks::VulkanDevice *device, uint32_t capacity, uint32_t regionCount)
+		{
+			this->capacity = capacity;
+			this->regionCount = regionCount;
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+				&buffer, regionSize() * regionCount));
+			VK_CHECK_RESULT(buffer.map());
+		}
+
+		void destroy()
+		{
+			buffer.unmap();
+			buffer.destroy();
+		}
+
+		/** @brief Size of a single region in bytes */
+		VkDeviceSize regionSize() const { return (VkDeviceSize)capacity * sizeof(ParticleVertex); }
+
+		/** @brief Byte offset of a region, to be passed to vkCmdBindVertexBuffers */
+		VkDeviceSize regionOffset(uint32_t region) const { return regionSize() * region; }
+
+		/** @brief Host pointer to the vertices of a region */
+		ParticleVertex* region(uint32_t region)
+		{
+			assert(buffer.mapped && region < regionCount);
+			return reinterpret_cast<ParticleVertex*>(static_cast<uint8_t*>(buffer.mapped) + regionOffset(region));
+		}
+
+		static vk::VertexInputBindingDescription bindingDescription(uint32_t binding)
+		{
+			vk::VertexInputBindingDescription desc;
+			desc.setBinding (binding)
+				.setStride (sizeof(ParticleVertex))
+				.setInputRate (vk::VertexInputRate::eVertex);
+			return desc;
+		}
+
+		static std::array<vk::VertexInputAttributeDescription, 2> attributeDescriptions(uint32_t binding)
+		{
+			std::array<vk::VertexInputAttributeDescription, 2> attributes;
+			attributes[0].setBinding (binding)
+				.setLocation (0)
+				.setFormat (vk::Format::eR32G32B32Sfloat)
+				.setOffset (offsetof(ParticleVertex, position));
+			attributes[1].setBinding (binding)
+				.setLocation (1)
+				.setFormat (vk::Format::eR8G8B8A8Unorm)
+				.setOffset (offsetof(ParticleVertex, color));
+			return attributes;
+		}
+	};
+
+	/**
+	* @brief SoA particle simulator
+	*
+	* @note Bit identical results require multiplies and adds not to be contracted into fused multiply-adds, so contraction
+	* is disabled for the simulator and the scalar reference on every target (the AVX2 kernel is also compiled without FMA)
+	*/
+	VKS_FP_CONTRACT_OFF_BEGIN
+	struct ParticleSimulator
+	{
+		/** @brief Arrays are padded to the widest batch */
+		static const uint32_t laneCount = 8;
+		/** @brief Min. number of particles per job when stepping in parallel */
+		static const uint32_t jobSize = 16384;
+
+		/** @brief Number of particles */
+		uint32_t count = 0;
+		/** @brief Kernel used by step(), defaults to the widest one supported by the CPU */
+		simd::InstructionSet instructionSet = simd::InstructionSet::Scalar;
+		ParticleParams params;
+		/** @brief Number of steps since reset() */
+		uint64_t stepCount = 0;
+
+		simd::AlignedVector<float> positionX;
+		simd::AlignedVector<float> positionY;
+		simd::AlignedVector<float> positionZ;
+		simd::AlignedVector<float> velocityX;
+		simd::AlignedVector<float> velocityY;
+		simd::AlignedVector<float> velocityZ;
+		/** @brief Remaining lifetime in seconds */
+		simd::AlignedVector<float> lifetime;
+		/** @brief Number of respawns, seeds the emitter random numbers */
+		simd::AlignedVector<uint32_t> generation;
+		/** @brief Packed RGBA8 color, derived from speed and remaining lifetime */
+		simd::AlignedVector<uint32_t> colors;
+
+		ParticleSimulator()
+		{
+			if (simd::supported(simd::InstructionSet::AVX2))
+			{
+				instructionSet = simd::InstructionSet::AVX2;
+			}
+			else if (simd::supported(simd::InstructionSet::NEON))
+			{
+				instructionSet = simd::InstructionSet::NEON;
+			}
+		}
+
+		/** @brief Returns true if step() has a kernel for the instruction set on this machine */
+		static bool kernelAvailable(simd::InstructionSet instructionSet)
+		{
+			return (instructionSet != simd::InstructionSet::SSE) && simd::supported(instructionSet);
+		}
+
+		/** @brief Number of particles rounded up to the batch size, vertex outputs must have room for this many */
+		uint32_t paddedCount() const { return simd::padded(count, laneCount); }
+
+		/**
+		* Set all particles to the initial state of the compute particle system
+		*
+		* @param count Number of particles
+		* @param params Simulation parameters (particle count is set by this function)
+		*/
+		void reset(uint32_t count, const ParticleParams &params)
+		{
+			this->count = count;
+			this->params = params;
+			this->params.particleCount = count;
+			stepCount = 0;
+			const uint32_t padded = paddedCount();
+			for (auto array : { &positionX, &positionY, &positionZ, &velocityX, &velocityY, &velocityZ, &lifetime })
+			{
+				array->assign(padded, 0.0f);
+			}
+			generation.assign(padded, 0);
+			colors.assign(padded, 0);
+			for (uint32_t i = 0; i < count; i++)
+			{
+				set(i, particles::initial(i, this->params));
+				colors[i] = color(i);
+			}
+		}
+
+		void set(uint32_t index, const Particle &particle)
+		{
+			assert(index < count);
+			positionX[index] = particle.position.x;
+			positionY[index] = particle.position.y;
+			positionZ[index] = particle.position.z;
+			lifetime[index] = particle.position.w;
+			velocityX[index] = particle.velocity.x;
+			velocityY[index] = particle.velocity.y;
+			velocityZ[index] = particle.velocity.z;
+			generation[index] = particle.generation;
+		}
+
+		/** @brief State of a particle in the layout of the compute particle system */
+		Particle get(uint32_t index) const
+		{
+			assert(index < count);
+			Particle particle;
+			particle.position = glm::vec4(positionX[index], positionY[index], positionZ[index], lifetime[index]);
+			particle.velocity = glm::vec3(velocityX[index], velocityY[index], velocityZ[index]);
+			particle.generation = generation[index];
+			return particle;
+		}
+
+		/**
+		* Advance all particles by one time step (params.gravity.w)
+		*
+		* @param output Optional vertex destination with room for paddedCount() vertices (e.g. a mapped vertex buffer region)
+		* @param jobSystem Optional job system to split the particles across threads
+		*/
+		void step(ParticleVertex *output = nullptr, JobSystem *jobSystem = nullptr)
+		{
+			if (jobSystem)
+			{
+				// Chunks are whole batches, particles are independent so no synchronization is needed
+				jobSystem->parallelFor(0, paddedCount() / laneCount, jobSize / laneCount, [this, output](uint32_t first, uint32_t last)
+				{
+					stepRange(first * laneCount, std::min(last * laneCount, count), output);
+				});
+			}
+			else
+			{
+				stepRange(0, count, output);
+			}
+			stepCount++;
+		}
+
+		/**
+		* Compare the state with particles simulated elsewhere (e.g. read back from the compute particle system)
+		*
+		* @return Number of particles that are not bit identical
+		*/
+		uint32_t compare(const std::vector<Particle> &reference, float *maxPositionError = nullptr) const
+		{
+			uint32_t mismatches = 0;
+			float maxError = 0.0f;
+			const uint32_t compareCount = std::min(count, static_cast<uint32_t>(reference.size()));
+			for (uint32_t i = 0; i < compareCount; i++)
+			{
+				const Particle particle = get(i);
+				// Positions, velocities and lifetimes are compared as bit patterns, the padding after velocity is the generation
+				if (memcmp(&particle, &reference[i], sizeof(Particle)) != 0)
+				{
+					mismatches++;
+					maxError = std::max(maxError, glm::length(glm::vec3(particle.position) - glm::vec3(reference[i].position)));
+				}
+			}
+			if (maxPositionError)
+			{
+				*maxPositionError = maxError;
+			}
+			return mismatches + (count - compareCount);
+		}
+
+		/** @brief Bytes read and written per particle and step (state, colors and vertex output) */
+		static uint32_t bytesPerStep() { return 2 * 7 * sizeof(float) + sizeof(uint32_t) + sizeof(ParticleVertex); }
+
+	private:
+		// first must be a multiple of laneCount
+		void stepRange(uint32_t first, uint32_t last, ParticleVertex *output)
+		{
+			switch (instructionSet)
+			{
+#if defined(VKS_SIMD_X86)
+			case simd::InstructionSet::AVX2:
+				stepAVX2(first, last, output);
+				break;
+#endif
+#if defined(VKS_SIMD_NEON)
+			case simd::InstructionSet::NEON:
+				stepNEON(first, last, output);
+				break;
+#endif
+			default:
+				stepScalar(first, last, output);
+				break;
+			}
+		}
+
+		static uint32_t packColor(float r, float g, float b)
+		{
+			return (uint32_t)(r * 255.0f + 0.5f) | ((uint32_t)(g * 255.0f + 0.5f) << 8) | ((uint32_t)(b * 255.0f + 0.5f) << 16) | 0xff000000u;
+		}
+
+		// Fast particles are bright, dying ones fade to red (same as particle.vert)
+		uint32_t color(uint32_t i) const
+		{
+			const float speedSquared = velocityX[i] * velocityX[i] + velocityY[i] * velocityY[i] + velocityZ[i] * velocityZ[i];
+			const float speed = std::min(std::sqrt(speedSquared) * 0.25f, 1.0f);
+			const float life = std::min(std::max(lifetime[i] * 0.5f, 0.0f), 1.0f);
+			float rgb[3];
+			const float fast[3] = { 1.0f, 1.0f, 1.0f };
+			const float slow[3] = { 0.2f, 0.5f, 1.0f };
+			const float dying[3] = { 1.0f, 0.2f, 0.05f };
+			for (uint32_t c = 0; c < 3; c++)
+			{
+				const float alive = slow[c] + (fast[c] - slow[c]) * speed;
+				rgb[c] = dying[c] + (alive - dying[c]) * life;
+			}
+			return packColor(rgb[0], rgb[1], rgb[2]);
+		}
+
+		void respawn(uint32_t i)
+		{
+			glm::vec3 position;
+			glm::vec3 velocity;
+			generation[i]++;
+			particles::respawn(i, generation[i], params, position, velocity, lifetime[i]);
+			positionX[i] = position.x;
+			positionY[i] = position.y;
+			positionZ[i] = position.z;
+			velocityX[i] = velocity.x;
+			velocityY[i] = velocity.y;
+			velocityZ[i] = velocity.z;
+		}
+
+		void writeVertex(uint32_t i, ParticleVertex *output) const
+		{
+			output[i].position[0] = positionX[i];
+			output[i].position[1] = positionY[i];
+			output[i].position[2] = positionZ[i];
+			output[i].color = colors[i];
+		}
+
+		// Operation order matches particles::step (and particle_simulate.comp)
+
+		void stepScalar(uint32_t first, uint32_t last, ParticleVertex *output)
+		{
+			const float dt = params.gravity.w;
+			const float gravityX = params.gravity.x * dt;
+			const float gravityY = params.gravity.y * dt;
+			const float gravityZ = params.gravity.z * dt;
+			for (uint32_t i = first; i < last; i++)
+			{
+				const float life = lifetime[i] - dt;
+				if (life <= 0.0f)
+				{
+					respawn(i);
+				}
+				else
+				{
+					lifetime[i] = life;
+					velocityX[i] = (velocityX[i] + gravityX) * params.damping;
+					velocityY[i] = (velocityY[i] + gravityY) * params.damping;
+					velocityZ[i] = (velocityZ[i] + gravityZ) * params.damping;
+					positionX[i] = positionX[i] + velocityX[i] * dt;
+					positionY[i] = positionY[i] + velocityY[i] * dt;
+					positionZ[i] = positionZ[i] + velocityZ[i] * dt;
+					if (positionY[i] > params.floorHeight)
+					{
+						positionY[i] = params.floorHeight;
+						velocityY[i] = -velocityY[i] * params.restitution;
+					}
+				}
+				colors[i] = color(i);
+				if (output)
+				{
+					writeVertex(i, output);
+				}
+			}
+		}
+
+#if defined(VKS_SIMD_X86)
+		VKS_TARGET_AVX2_NOFMA void stepAVX2(uint32_t first, uint32_t last, ParticleVertex *output)
+		{
+			const __m256 zero = _mm256_setzero_ps();
+			const __m256 one = _mm256_set1_ps(1.0f);
+			const __m256 signMask = _mm256_set1_ps(-0.0f);
+			const __m256 dt = _mm256_set1_ps(params.gravity.w);
+			const __m256 gravityX = _mm256_set1_ps(params.gravity.x * params.gravity.w);
+			const __m256 gravityY = _mm256_set1_ps(params.gravity.y * params.gravity.w);
+			const __m256 gravityZ = _mm256_set1_ps(params.gravity.z * params.gravity.w);
+			const __m256 damping = _mm256_set1_ps(params.damping);
+			const __m256 floorHeight = _mm256_set1_ps(params.floorHeight);
+			const __m256 restitution = _mm256_set1_ps(params.restitution);
+			// Color gradients, see color()
+			const __m256 slowR = _mm256_set1_ps(0.2f), slowG = _mm256_set1_ps(0.5f), slowB = _mm256_set1_ps(1.0f);
+			const __m256 dyingR = _mm256_set1_ps(1.0f), dyingG = _mm256_set1_ps(0.2f), dyingB = _mm256_set1_ps(0.05f);
+			const __m256 colorScale = _mm256_set1_ps(255.0f);
+			const __m256 half = _mm256_set1_ps(0.5f);
+			const __m256i alpha = _mm256_set1_epi32((int)0xff000000u);
+			// Write combined host visible memory is best written with non-temporal stores
+			const bool streamOutput = output && ((reinterpret_cast<uintptr_t>(output) & 31) == 0);
+
+			for (uint32_t i = first; i < last; i += 8)
+			{
+				const __m256 life = _mm256_sub_ps(_mm256_load_ps(&lifetime[i]), dt);
+				__m256 vx = _mm256_mul_ps(_mm256_add_ps(_mm256_load_ps(&velocityX[i]), gravityX), damping);
+				__m256 vy = _mm256_mul_ps(_mm256_add_ps(_mm256_load_ps(&velocityY[i]), gravityY), damping);
+				__m256 vz = _mm256_mul_ps(_mm256_add_ps(_mm256_load_ps(&velocityZ[i]), gravityZ), damping);
+				__m256 px = _mm256_add_ps(_mm256_load_ps(&positionX[i]), _mm256_mul_ps(vx, dt));
+				__m256 py = _mm256_add_ps(_mm256_load_ps(&positionY[i]), _mm256_mul_ps(vy, dt));
+				__m256 pz = _mm256_add_ps(_mm256_load_ps(&positionZ[i]), _mm256_mul_ps(vz, dt));
+				const __m256 bounce = _mm256_cmp_ps(py, floorHeight, _CMP_GT_OQ);
+				py = _mm256_blendv_ps(py, floorHeight, bounce);
+				vy = _mm256_blendv_ps(vy, _mm256_mul_ps(_mm256_xor_ps(vy, signMask), restitution), bounce);
+
+				_mm256_store_ps(&lifetime[i], life);
+				_mm256_store_ps(&velocityX[i], vx);
+				_mm256_store_ps(&velocityY[i], vy);
+				_mm256_store_ps(&velocityZ[i], vz);
+				_mm256_store_ps(&positionX[i], px);
+				_mm256_store_ps(&positionY[i], py);
+				_mm256_store_ps(&positionZ[i], pz);
+
+				// Expired particles are rare (about one per lifetime / dt steps), respawn them one by one
+				uint32_t expired = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(life, zero, _CMP_LE_OQ)));
+				if (last - i < 8)
+				{
+					expired &= (1u << (last - i)) - 1;
+				}
+				if (expired)
+				{
+					while (expired)
+					{
+						respawn(i + simd::lowestBit(expired));
+						expired &= expired - 1;
+					}
+					px = _mm256_load_ps(&positionX[i]);
+					py = _mm256_load_ps(&positionY[i]);
+					pz = _mm256_load_ps(&positionZ[i]);
+					vx = _mm256_load_ps(&velocityX[i]);
+					vy = _mm256_load_ps(&velocityY[i]);
+					vz = _mm256_load_ps(&velocityZ[i]);
+				}
+
+				const __m256 speedSquared = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vx, vx), _mm256_mul_ps(vy, vy)), _mm256_mul_ps(vz, vz));
+				const __m256 speed = _mm256_min_ps(_mm256_mul_ps(_mm256_sqrt_ps(speedSquared), _mm256_set1_ps(0.25f)), one);
+				const __m256 fade = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_load_ps(&lifetime[i]), half), zero), one);
+				const __m256 r = _mm256_add_ps(dyingR, _mm256_mul_ps(_mm256_sub_ps(_mm256_add_ps(slowR, _mm256_mul_ps(_mm256_sub_ps(one, slowR), speed)), dyingR), fade));
+				const __m256 g = _mm256_add_ps(dyingG, _mm256_mul_ps(_mm256_sub_ps(_mm256_add_ps(slowG, _mm256_mul_ps(_mm256_sub_ps(one, slowG), speed)), dyingG), fade));
+				const __m256 b = _mm256_add_ps(dyingB, _mm256_mul_ps(_mm256_sub_ps(_mm256_add_ps(slowB, _mm256_mul_ps(_mm256_sub_ps(one, slowB), speed)), dyingB), fade));
+				const __m256i ri = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(r, colorScale), half));
+				const __m256i gi = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(g, colorScale), half));
+				const __m256i bi = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(b, colorScale), half));
+				const __m256i packed = _mm256_or_si256(_mm256_or_si256(ri, _mm256_slli_epi32(gi, 8)), _mm256_or_si256(_mm256_slli_epi32(bi, 16), alpha));
+				_mm256_store_si256(reinterpret_cast<__m256i*>(&colors[i]), packed);
+
+				if (!output)
+				{
+					continue;
+				}
+				// Transpose 8 x (x, y, z, color) into 8 interleaved vertices
+				const __m256 c = _mm256_castsi256_ps(packed);
+				const __m256 xy0 = _mm256_unpacklo_ps(px, py);	// x0 y0 x1 y1 | x4 y4 x5 y5
+				const __m256 xy1 = _mm256_unpackhi_ps(px, py);	// x2 y2 x3 y3 | x6 y6 x7 y7
+				const __m256 zc0 = _mm256_unpacklo_ps(pz, c);
+				const __m256 zc1 = _mm256_unpackhi_ps(pz, c);
+				const __m256 v04 = _mm256_shuffle_ps(xy0, zc0, _MM_SHUFFLE(1, 0, 1, 0));
+				const __m256 v15 = _mm256_shuffle_ps(xy0, zc0, _MM_SHUFFLE(3, 2, 3, 2));
+				const __m256 v26 = _mm256_shuffle_ps(xy1, zc1, _MM_SHUFFLE(1, 0, 1, 0));
+				const __m256 v37 = _mm256_shuffle_ps(xy1, zc1, _MM_SHUFFLE(3, 2, 3, 2));
+				float *dst = reinterpret_cast<float*>(&output[i]);
+				const __m256 vertices[4] = {
+					_mm256_permute2f128_ps(v04, v15, 0x20),
+					_mm256_permute2f128_ps(v26, v37, 0x20),
+					_mm256_permute2f128_ps(v04, v15, 0x31),
+					_mm256_permute2f128_ps(v26, v37, 0x31)
+				};
+				for (uint32_t j = 0; j < 4; j++)
+				{
+					if (streamOutput)
+					{
+						_mm256_stream_ps(dst + j * 8, vertices[j]);
+					}
+					else
+					{
+						_mm256_storeu_ps(dst + j * 8, vertices[j]);
+					}
+				}
+			}
+			if (streamOutput)
+			{
+				// Non-temporal stores are weakly ordered, make them visible before the submission
+				_mm_sfence();
+			}
+		}
+#endif
+
+#if defined(VKS_SIMD_NEON)
+		void stepNEON(uint32_t first, uint32_t last, ParticleVertex *output)
+		{
+			const float32x4_t zero = vdupq_n_f32(0.0f);
+			const float32x4_t one = vdupq_n_f32(1.0f);
+			const float32x4_t dt = vdupq_n_f32(params.gravity.w);
+			const float32x4_t gravityX = vdupq_n_f32(params.gravity.x * params.gravity.w);
+			const float32x4_t gravityY = vdupq_n_f32(params.gravity.y * params.gravity.w);
+			const float32x4_t gravityZ = vdupq_n_f32(params.gravity.z * params.gravity.w);
+			const float32x4_t damping = vdupq_n_f32(params.damping);
+			const float32x4_t floorHeight = vdupq_n_f32(params.floorHeight);
+			const float32x4_t restitution = vdupq_n_f32(params.restitution);
+			const float32x4_t slowR = vdupq_n_f32(0.2f), slowG = vdupq_n_f32(0.5f), slowB = vdupq_n_f32(1.0f);
+			const float32x4_t dyingR = vdupq_n_f32(1.0f), dyingG = vdupq_n_f32(0.2f), dyingB = vdupq_n_f32(0.05f);
+			const float32x4_t colorScale = vdupq_n_f32(255.0f);
+			const float32x4_t half = vdupq_n_f32(0.5f);
+			const uint32x4_t alpha = vdupq_n_u32(0xff000000u);
+
+			for (uint32_t i = first; i < last; i += 4)
+			{
+				// Separate multiplies and adds (vmlaq would be fused on AArch64 and break bit equality)
+				const float32x4_t life = vsubq_f32(vld1q_f32(&lifetime[i]), dt);
+				float32x4_t vx = vmulq_f32(vaddq_f32(vld1q_f32(&velocityX[i]), gravityX), damping);
+				float32x4_t vy = vmulq_f32(vaddq_f32(vld1q_f32(&velocityY[i]), gravityY), damping);
+				float32x4_t vz = vmulq_f32(vaddq_f32(vld1q_f32(&velocityZ[i]), gravityZ), damping);
+				float32x4_t px = vaddq_f32(vld1q_f32(&positionX[i]), vmulq_f32(vx, dt));
+				float32x4_t py = vaddq_f32(vld1q_f32(&positionY[i]), vmulq_f32(vy, dt));
+				float32x4_t pz = vaddq_f32(vld1q_f32(&positionZ[i]), vmulq_f32(vz, dt));
+				const uint32x4_t bounce = vcgtq_f32(py, floorHeight);
+				py = vbslq_f32(bounce, floorHeight, py);
+				vy = vbslq_f32(bounce, vmulq_f32(vnegq_f32(vy), restitution), vy);
+
+				vst1q_f32(&lifetime[i], life);
+				vst1q_f32(&velocityX[i], vx);
+				vst1q_f32(&velocityY[i], vy);
+				vst1q_f32(&velocityZ[i], vz);
+				vst1q_f32(&positionX[i], px);
+				vst1q_f32(&positionY[i], py);
+				vst1q_f32(&positionZ[i], pz);
+
+				uint32_t lanes[4];
+				vst1q_u32(lanes, vcleq_f32(life, zero));
+				bool respawned = false;
+				for (uint32_t lane = 0; (lane < 4) && (i + lane < last); lane++)
+				{
+					if (lanes[lane])
+					{
+						respawn(i + lane);
+						respawned = true;
+					}
+				}
+				if (respawned)
+				{
+					px = vld1q_f32(&positionX[i]);
+					py = vld1q_f32(&positionY[i]);
+					pz = vld1q_f32(&positionZ[i]);
+					vx = vld1q_f32(&velocityX[i]);
+					vy = vld1q_f32(&velocityY[i]);
+					vz = vld1q_f32(&velocityZ[i]);
+				}
+
+				const float32x4_t speedSquared = vaddq_f32(vaddq_f32(vmulq_f32(vx, vx), vmulq_f32(vy, vy)), vmulq_f32(vz, vz));
+				const float32x4_t speed = vminq_f32(vmulq_f32(vsqrtq_f32(speedSquared), vdupq_n_f32(0.25f)), one);
+				const float32x4_t fade = vminq_f32(vmaxq_f32(vmulq_f32(vld1q_f32(&lifetime[i]), half), zero), one);
+				const float32x4_t r = vaddq_f32(dyingR, vmulq_f32(vsubq_f32(vaddq_f32(slowR, vmulq_f32(vsubq_f32(one, slowR), speed)), dyingR), fade));
+				const float32x4_t g = vaddq_f32(dyingG, vmulq_f32(vsubq_f32(vaddq_f32(slowG, vmulq_f32(vsubq_f32(one, slowG), speed)), dyingG), fade));
+				const float32x4_t b = vaddq_f32(dyingB, vmulq_f32(vsubq_f32(vaddq_f32(slowB, vmulq_f32(vsubq_f32(one, slowB), speed)), dyingB), fade));
+				const uint32x4_t ri = vcvtq_u32_f32(vaddq_f32(vmulq_f32(r, colorScale), half));
+				const uint32x4_t gi = vcvtq_u32_f32(vaddq_f32(vmulq_f32(g, colorScale), half));
+				const uint32x4_t bi = vcvtq_u32_f32(vaddq_f32(vmulq_f32(b, colorScale), half));
+				const uint32x4_t packed = vorrq_u32(vorrq_u32(ri, vshlq_n_u32(gi, 8)), vorrq_u32(vshlq_n_u32(bi, 16), alpha));
+				vst1q_u32(&colors[i], packed);
+
+				if (output)
+				{
+					// Interleaving store of x, y, z, color
+					float32x4x4_t vertices;
+					vertices.val[0] = px;
+					vertices.val[1] = py;
+					vertices.val[2] = pz;
+					vertices.val[3] = vreinterpretq_f32_u32(packed);
+					vst4q_f32(reinterpret_cast<float*>(&output[i]), vertices);
+				}
+			}
+		}
+#endif
+	};
+	VKS_FP_CONTRACT_OFF_END
+}
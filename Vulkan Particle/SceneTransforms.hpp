@@ -0,0 +1,379 @@
+#pragma once
+
+/*
+* Host side scene transform class
+*
+* Keeps the transforms of many objects in SoA layout and processes them in batches of 4 (SSE) or 8 (AVX2) objects:
+* - Rotate (about y), scale and translate into world matrices
+* - Test the world space bounding spheres against the view frustum
+* - Write projection * view * world of the visible objects (compacted) to an instance buffer region,
+*   so the vertex shader only needs one matrix multiply per vertex
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cmath>
+#include <cassert>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include "vksSimd.h"
+#include "VulkanInstanceBuffer.hpp"
+
+namespace vks
+{
+	struct SceneTransforms
+	{
+		/** @brief Arrays are padded to the widest batch */
+		static const uint32_t laneCount = 8;
+
+		/** @brief Number of objects */
+		uint32_t count = 0;
+		/** @brief Kernel used by update(), defaults to the widest one supported by the CPU */
+		simd::InstructionSet instructionSet = simd::InstructionSet::Scalar;
+
+		// Inputs
+		simd::AlignedVector<float> positionX;
+		simd::AlignedVector<float> positionY;
+		simd::AlignedVector<float> positionZ;
+		/** @brief Uniform scale */
+		simd::AlignedVector<float> scale;
+		/** @brief Rotation about the y axis as cosine and sine, the per-frame angle is added on top */
+		simd::AlignedVector<float> rotationCos;
+		simd::AlignedVector<float> rotationSin;
+		/** @brief Bounding sphere radius of the unscaled mesh (around the object origin) */
+		simd::AlignedVector<float> radius;
+		std::vector<glm::vec4> colors;
+
+		/**
+		* @brief World matrices, 12 arrays holding the upper 3x4 part in column major order
+		*
+		* world[column * 3 + row][object], the last row is always (0, 0, 0, 1)
+		*/
+		std::array<simd::AlignedVector<float>, 12> world;
+
+		SceneTransforms()
+		{
+			// No NEON kernel, ARM uses the scalar path
+			if (simd::supported(simd::InstructionSet::AVX2))
+			{
+				instructionSet = simd::InstructionSet::AVX2;
+			}
+			else if (simd::supported(simd::InstructionSet::SSE))
+			{
+				instructionSet = simd::InstructionSet::SSE;
+			}
+		}
+
+		/** @brief Returns true if update() has a kernel for the instruction set on this machine */
+		static bool kernelAvailable(simd::InstructionSet instructionSet)
+		{
+			return (instructionSet != simd::InstructionSet::NEON) && simd::supported(instructionSet);
+		}
+
+		/** @brief Resize all arrays, new objects are zero initialized */
+		void resize(uint32_t count)
+		{
+			this->count = count;
+			const uint32_t paddedCount = simd::padded(count, laneCount);
+			for (auto array : { &positionX, &positionY, &positionZ, &scale, &rotationCos, &rotationSin, &radius })
+			{
+				array->resize(paddedCount, 0.0f);
+			}
+			for (auto& column : world)
+			{
+				column.resize(paddedCount, 0.0f);
+			}
+			colors.resize(paddedCount);
+		}
+
+		/**
+		* Set the transform and bounds of an object
+		*
+		* @param index Index of the object
+		* @param position World space position
+		* @param objectScale Uniform scale
+		* @param angle Rotation about the y axis (radians)
+		* @param meshRadius Bounding sphere radius of the unscaled mesh
+		* @param color Per-instance color
+		*/
+		void set(uint32_t index, const glm::vec3 &position, float objectScale, float angle, float meshRadius, const glm::vec4 &color)
+		{
+			assert(index < count);
+			positionX[index] = position.x;
+			positionY[index] = position.y;
+			positionZ[index] = position.z;
+			scale[index] = objectScale;
+			rotationCos[index] = std::cos(angle);
+			rotationSin[index] = std::sin(angle);
+			radius[index] = meshRadius;
+			colors[index] = color;
+		}
+
+		/**
+		* Update the world matrices of all objects and write the MVPs of the visible ones
+		*
+		* @param viewProjection Projection * view matrix
+		* @param planes Frustum planes of the view projection matrix (see vks::Frustum)
+		* @param angle Rotation about the y axis added to all objects (radians)
+		* @param output Destination for the visible instances (room for count instances), the mat4 holds the MVP
+		*
+		* @return Number of visible instances written to output
+		*/
+		uint32_t update(const glm::mat4 &viewProjection, const std::array<glm::vec4, 6> &planes, float angle, InstanceData *output)
+		{
+			FrameConstants constants;
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				constants.viewProjection[i] = viewProjection[i / 4][i % 4];
+			}
+			for (uint32_t i = 0; i < 6; i++)
+			{
+				for (uint32_t j = 0; j < 4; j++)
+				{
+					constants.planes[i * 4 + j] = planes[i][j];
+				}
+			}
+			constants.angleCos = std::cos(angle);
+			constants.angleSin = std::sin(angle);
+
+			switch (instructionSet)
+			{
+#if defined(VKS_SIMD_X86)
+			case simd::InstructionSet::AVX2:
+				return updateAVX2(constants, output);
+			case simd::InstructionSet::SSE:
+				return updateSSE(constants, output);
+#endif
+			default:
+				return updateScalar(constants, output);
+			}
+		}
+
+	private:
+		struct FrameConstants
+		{
+			/** @brief Column major */
+			float viewProjection[16];
+			/** @brief Six planes, xyz = normal, w = distance */
+			float planes[24];
+			float angleCos;
+			float angleSin;
+		};
+
+		// Model matrix = translate * rotate(y) * scale, so:
+		//	world column 0 = ( c * s, 0, -sn * s), column 1 = (0, s, 0), column 2 = (sn * s, 0, c * s), column 3 = position
+		// and MVP = viewProjection * world only needs the non-zero terms
+
+		uint32_t updateScalar(const FrameConstants &constants, InstanceData *output)
+		{
+			const float *vp = constants.viewProjection;
+			uint32_t visibleCount = 0;
+			for (uint32_t i = 0; i < count; i++)
+			{
+				const float c = rotationCos[i] * constants.angleCos - rotationSin[i] * constants.angleSin;
+				const float sn = rotationSin[i] * constants.angleCos + rotationCos[i] * constants.angleSin;
+				const float s = scale[i];
+				const float cs = c * s;
+				const float ss = sn * s;
+				const float px = positionX[i];
+				const float py = positionY[i];
+				const float pz = positionZ[i];
+
+				world[0][i] = cs;	world[1][i] = 0.0f;	world[2][i] = -ss;
+				world[3][i] = 0.0f;	world[4][i] = s;	world[5][i] = 0.0f;
+				world[6][i] = ss;	world[7][i] = 0.0f;	world[8][i] = cs;
+				world[9][i] = px;	world[10][i] = py;	world[11][i] = pz;
+
+				const float r = radius[i] * s;
+				bool visible = true;
+				for (uint32_t p = 0; p < 6; p++)
+				{
+					const float *plane = &constants.planes[p * 4];
+					if (plane[0] * px + plane[1] * py + plane[2] * pz + plane[3] + r < 0.0f)
+					{
+						visible = false;
+						break;
+					}
+				}
+				if (!visible)
+				{
+					continue;
+				}
+
+				float *mvp = &output[visibleCount].model[0][0];
+				for (uint32_t k = 0; k < 4; k++)
+				{
+					mvp[k] = vp[k] * cs - vp[8 + k] * ss;
+					mvp[4 + k] = vp[4 + k] * s;
+					mvp[8 + k] = vp[k] * ss + vp[8 + k] * cs;
+					mvp[12 + k] = vp[k] * px + vp[4 + k] * py + vp[8 + k] * pz + vp[12 + k];
+				}
+				output[visibleCount].color = colors[i];
+				visibleCount++;
+			}
+			return visibleCount;
+		}
+
+#if defined(VKS_SIMD_X86)
+		uint32_t updateSSE(const FrameConstants &constants, InstanceData *output)
+		{
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 angleCos = _mm_set1_ps(constants.angleCos);
+			const __m128 angleSin = _mm_set1_ps(constants.angleSin);
+			__m128 vp[16];
+			for (uint32_t j = 0; j < 16; j++)
+			{
+				vp[j] = _mm_set1_ps(constants.viewProjection[j]);
+			}
+			__m128 planes[24];
+			for (uint32_t j = 0; j < 24; j++)
+			{
+				planes[j] = _mm_set1_ps(constants.planes[j]);
+			}
+
+			alignas(16) float mvp[16][4];
+			uint32_t visibleCount = 0;
+			for (uint32_t i = 0; i < count; i += 4)
+			{
+				const __m128 rc = _mm_load_ps(&rotationCos[i]);
+				const __m128 rs = _mm_load_ps(&rotationSin[i]);
+				const __m128 c = _mm_sub_ps(_mm_mul_ps(rc, angleCos), _mm_mul_ps(rs, angleSin));
+				const __m128 sn = _mm_add_ps(_mm_mul_ps(rs, angleCos), _mm_mul_ps(rc, angleSin));
+				const __m128 s = _mm_load_ps(&scale[i]);
+				const __m128 cs = _mm_mul_ps(c, s);
+				const __m128 ss = _mm_mul_ps(sn, s);
+				const __m128 px = _mm_load_ps(&positionX[i]);
+				const __m128 py = _mm_load_ps(&positionY[i]);
+				const __m128 pz = _mm_load_ps(&positionZ[i]);
+
+				_mm_store_ps(&world[0][i], cs);		_mm_store_ps(&world[1][i], zero);	_mm_store_ps(&world[2][i], _mm_sub_ps(zero, ss));
+				_mm_store_ps(&world[3][i], zero);	_mm_store_ps(&world[4][i], s);		_mm_store_ps(&world[5][i], zero);
+				_mm_store_ps(&world[6][i], ss);		_mm_store_ps(&world[7][i], zero);	_mm_store_ps(&world[8][i], cs);
+				_mm_store_ps(&world[9][i], px);		_mm_store_ps(&world[10][i], py);	_mm_store_ps(&world[11][i], pz);
+
+				const __m128 r = _mm_mul_ps(_mm_load_ps(&radius[i]), s);
+				__m128 inside = _mm_cmpeq_ps(zero, zero);
+				for (uint32_t p = 0; p < 6; p++)
+				{
+					__m128 distance = _mm_add_ps(_mm_mul_ps(planes[p * 4], px), _mm_mul_ps(planes[p * 4 + 1], py));
+					distance = _mm_add_ps(distance, _mm_mul_ps(planes[p * 4 + 2], pz));
+					distance = _mm_add_ps(distance, _mm_add_ps(planes[p * 4 + 3], r));
+					inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, zero));
+				}
+				uint32_t mask = static_cast<uint32_t>(_mm_movemask_ps(inside));
+				if (count - i < 4)
+				{
+					mask &= (1u << (count - i)) - 1;
+				}
+				if (!mask)
+				{
+					continue;
+				}
+
+				for (uint32_t k = 0; k < 4; k++)
+				{
+					_mm_store_ps(mvp[k], _mm_sub_ps(_mm_mul_ps(vp[k], cs), _mm_mul_ps(vp[8 + k], ss)));
+					_mm_store_ps(mvp[4 + k], _mm_mul_ps(vp[4 + k], s));
+					_mm_store_ps(mvp[8 + k], _mm_add_ps(_mm_mul_ps(vp[k], ss), _mm_mul_ps(vp[8 + k], cs)));
+					__m128 translation = _mm_add_ps(_mm_mul_ps(vp[k], px), _mm_mul_ps(vp[4 + k], py));
+					translation = _mm_add_ps(translation, _mm_add_ps(_mm_mul_ps(vp[8 + k], pz), vp[12 + k]));
+					_mm_store_ps(mvp[12 + k], translation);
+				}
+				writeVisible(&mvp[0][0], 4, mask, i, output, visibleCount);
+			}
+			return visibleCount;
+		}
+
+		VKS_TARGET_AVX2 uint32_t updateAVX2(const FrameConstants &constants, InstanceData *output)
+		{
+			const __m256 zero = _mm256_setzero_ps();
+			const __m256 angleCos = _mm256_set1_ps(constants.angleCos);
+			const __m256 angleSin = _mm256_set1_ps(constants.angleSin);
+			__m256 vp[16];
+			for (uint32_t j = 0; j < 16; j++)
+			{
+				vp[j] = _mm256_set1_ps(constants.viewProjection[j]);
+			}
+			__m256 planes[24];
+			for (uint32_t j = 0; j < 24; j++)
+			{
+				planes[j] = _mm256_set1_ps(constants.planes[j]);
+			}
+
+			alignas(32) float mvp[16][8];
+			uint32_t visibleCount = 0;
+			for (uint32_t i = 0; i < count; i += 8)
+			{
+				const __m256 rc = _mm256_load_ps(&rotationCos[i]);
+				const __m256 rs = _mm256_load_ps(&rotationSin[i]);
+				const __m256 c = _mm256_fmsub_ps(rc, angleCos, _mm256_mul_ps(rs, angleSin));
+				const __m256 sn = _mm256_fmadd_ps(rs, angleCos, _mm256_mul_ps(rc, angleSin));
+				const __m256 s = _mm256_load_ps(&scale[i]);
+				const __m256 cs = _mm256_mul_ps(c, s);
+				const __m256 ss = _mm256_mul_ps(sn, s);
+				const __m256 px = _mm256_load_ps(&positionX[i]);
+				const __m256 py = _mm256_load_ps(&positionY[i]);
+				const __m256 pz = _mm256_load_ps(&positionZ[i]);
+
+				_mm256_store_ps(&world[0][i], cs);		_mm256_store_ps(&world[1][i], zero);	_mm256_store_ps(&world[2][i], _mm256_sub_ps(zero, ss));
+				_mm256_store_ps(&world[3][i], zero);	_mm256_store_ps(&world[4][i], s);		_mm256_store_ps(&world[5][i], zero);
+				_mm256_store_ps(&world[6][i], ss);		_mm256_store_ps(&world[7][i], zero);	_mm256_store_ps(&world[8][i], cs);
+				_mm256_store_ps(&world[9][i], px);		_mm256_store_ps(&world[10][i], py);	_mm256_store_ps(&world[11][i], pz);
+
+				const __m256 r = _mm256_mul_ps(_mm256_load_ps(&radius[i]), s);
+				__m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+				for (uint32_t p = 0; p < 6; p++)
+				{
+					__m256 distance = _mm256_fmadd_ps(planes[p * 4 + 2], pz, _mm256_add_ps(planes[p * 4 + 3], r));
+					distance = _mm256_fmadd_ps(planes[p * 4 + 1], py, distance);
+					distance = _mm256_fmadd_ps(planes[p * 4], px, distance);
+					inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, zero, _CMP_GE_OQ));
+				}
+				uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(inside));
+				if (count - i < 8)
+				{
+					mask &= (1u << (count - i)) - 1;
+				}
+				if (!mask)
+				{
+					continue;
+				}
+
+				for (uint32_t k = 0; k < 4; k++)
+				{
+					_mm256_store_ps(mvp[k], _mm256_fmsub_ps(vp[k], cs, _mm256_mul_ps(vp[8 + k], ss)));
+					_mm256_store_ps(mvp[4 + k], _mm256_mul_ps(vp[4 + k], s));
+					_mm256_store_ps(mvp[8 + k], _mm256_fmadd_ps(vp[k], ss, _mm256_mul_ps(vp[8 + k], cs)));
+					_mm256_store_ps(mvp[12 + k], _mm256_fmadd_ps(vp[k], px, _mm256_fmadd_ps(vp[4 + k], py, _mm256_fmadd_ps(vp[8 + k], pz, vp[12 + k]))));
+				}
+				writeVisible(&mvp[0][0], 8, mask, i, output, visibleCount);
+			}
+			return visibleCount;
+		}
+#endif
+
+		/** @brief Copy the MVPs of the visible lanes of a batch (stored as mvp[element][lane]) to the output */
+		void writeVisible(const float *mvp, uint32_t lanes, uint32_t mask, uint32_t first, InstanceData *output, uint32_t &visibleCount)
+		{
+			while (mask)
+			{
+				const uint32_t lane = simd::lowestBit(mask);
+				mask &= mask - 1;
+				float *dst = &output[visibleCount].model[0][0];
+				for (uint32_t j = 0; j < 16; j++)
+				{
+					dst[j] = mvp[j * lanes + lane];
+				}
+				output[visibleCount].color = colors[first + lane];
+				visibleCount++;
+			}
+		}
+	};
+}
@@ -9,6 +9,10 @@
 #include "VulkanBase.h"
 #include "VulkanInitializers.h"
 
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#pragma comment(lib, "winmm.lib")
+
 std::vector<const char*> VulkanExampleBase::args;
 
 void VulkanExampleBase::createInstance(bool enableValidation)
@@ -25,19 +29,37 @@ void VulkanExampleBase::createInstance(bool enableValidation)
 		.setPEngineName (name.c_str())
 		.setApiVersion (VK_API_VERSION_1_0);
 
-	std::vector<const char*> instanceExtensions = { VK_KHR_SURFACE_EXTENSION_NAME };
+	std::vector<const char*> instanceExtensions;
 
-	// Enable surface extensions depending on os
-	instanceExtensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
+	// Enable surface extensions depending on os (headless rendering has no surface)
+	if (!settings.headless)
+	{
+		instanceExtensions.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
+	}
+
+	if (settings.validation)
+	{
+		instanceExtensions.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
+	}
+
+#if defined(VK_EXT_debug_utils)
+	// Object names and command buffer labels for capture tools and validation messages (see VulkanDebugMarker.hpp)
+	std::vector<vk::ExtensionProperties> availableExtensions = CHECK(vk::enumerateInstanceExtensionProperties ());
+	for (auto& extension : availableExtensions)
+	{
+		if (std::string(extension.extensionName) == VK_EXT_DEBUG_UTILS_EXTENSION_NAME)
+		{
+			instanceExtensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+			debugUtils = true;
+		}
+	}
+#endif
 
 	vk::InstanceCreateInfo instanceCreateInfo {};
 	instanceCreateInfo.pApplicationInfo = &appInfo;
 	if (instanceExtensions.size() > 0)
 	{
-		if (settings.validation)
-		{
-			instanceExtensions.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
-		}
 		instanceCreateInfo.enabledExtensionCount = (uint32_t)instanceExtensions.size();
 		instanceCreateInfo.setPpEnabledExtensionNames(instanceExtensions.data());
 	}
@@ -92,6 +114,10 @@ void VulkanExampleBase::createCommandBuffers()
 		.setCommandBufferCount (swapChain.imageCount);
 
 	drawCmdBuffers = CHECK(vulkanDevice->D().allocateCommandBuffers (cmdBufAllocateInfo));
+	for (size_t i = 0; i < drawCmdBuffers.size(); i++)
+	{
+		vulkanDevice->setCommandBufferName(drawCmdBuffers[i], "draw command buffer " + std::to_string(i));
+	}
 }
 
 void VulkanExampleBase::destroyCommandBuffers()
@@ -112,11 +138,11 @@ void VulkanExampleBase::createPipelineCache()
 
 void VulkanExampleBase::prepare()
 {
-	///TODO
-	//if (vulkanDevice->enableDebugMarkers)
-	//{
-	//	vks::debugmarker::setup(device);
-	//}
+	vks::debugmarker::setup(static_cast<VkInstance>(instance), device, debugUtils, vulkanDevice->enableDebugMarkers);
+	if (vks::debugmarker::active())
+	{
+		std::cout << "Debug names and labels enabled (" << (vks::debugmarker::functions().debugUtils ? "VK_EXT_debug_utils" : VK_EXT_DEBUG_MARKER_EXTENSION_NAME) << ")" << std::endl;
+	}
 	//createCommandPool(); //vulkanDevice has a command pool
 	setupSwapChain();
 	createCommandBuffers();
@@ -124,7 +150,45 @@ void VulkanExampleBase::prepare()
 	setupRenderPass();
 	createPipelineCache();
 	setupFrameBuffer();
-
+	if ((settings.profile) || (settings.benchmark) || (!settings.traceOutput.empty()) || (settings.overlay) || (settings.lowLatency))
+	{
+		gpuProfiler.prepare(vulkanDevice, vulkanDevice->queueFamilyIndices.graphics, static_cast<uint32_t>(drawCmdBuffers.size()), 32, settings.pipelineStatistics);
+		gpuProfiler.collectSamples = settings.benchmark;
+		gpuProfiler.skipFrames = settings.benchmarkWarmup;
+	}
+	if ((!settings.traceOutput.empty()) || (settings.lowLatency))
+	{
+		// The queue is still idle, so the fallback calibration is as accurate as it gets
+		gpuProfiler.enableCalibratedTimestamps(instance);
+		gpuProfiler.calibrate(queue);
+	}
+	if (!settings.traceOutput.empty())
+	{
+		vks::trace::setGpuName(vulkanDevice->properties.deviceName);
+		vks::trace::setEnabled(true);
+	}
+	if (settings.lowLatency)
+	{
+		prepareLatency();
+	}
+	if (settings.benchmark)
+	{
+		prepareBenchmark();
+	}
+	if (settings.targetFrameRate > 0.0)
+	{
+		framePacer.setTargetFps(settings.targetFrameRate);
+		framePacer.collectSamples = settings.benchmark;
+		framePacer.skipFrames = settings.benchmarkWarmup;
+		// Sleeps wake up on the scheduler tick, 1 ms instead of the default 15.6 ms keeps the spin part short
+		timeBeginPeriod(1);
+		std::cout << "Frame pacing: " << settings.targetFrameRate << " fps (" << 1000.0 / settings.targetFrameRate << " ms per frame)" << std::endl;
+	}
+	if (settings.overlay)
+	{
+		textOverlay.prepare(vulkanDevice, queue, pipelineCache, static_cast<uint32_t>(drawCmdBuffers.size()));
+		updateTextOverlay();
+	}
 }
 
 VkPipelineShaderStageCreateInfo VulkanExampleBase::loadShader(std::string fileName, VkShaderStageFlagBits stage)
@@ -153,9 +217,20 @@ void VulkanExampleBase::renderLoop()
 
 	MSG msg;
 	bool quitMessageReceived = false;
+	uint32_t framesRendered = 0;
+	auto tLastStart = std::chrono::high_resolution_clock::now();
 	while (!quitMessageReceived)
 	{
+		if (framePacer.enabled())
+		{
+			VKS_TRACE_SCOPE("pace");
+			framePacer.waitForFrameStart();
+		}
+		VKS_TRACE_SCOPE("frame");
 		auto tStart = std::chrono::high_resolution_clock::now();
+		// Start to start, so the time spent waiting for the frame pacer advances animations too
+		auto tInterval = std::chrono::duration<double, std::milli>(tStart - tLastStart).count();
+		tLastStart = tStart;
 		if (viewUpdated)
 		{
 			viewUpdated = false;
@@ -176,9 +251,27 @@ void VulkanExampleBase::renderLoop()
 
 		render();
 		frameCounter++;
+		framesRendered++;
+		// Benchmark runs measure frameLimit frames after the warm up
+		const uint32_t frameCount = settings.frameLimit + (settings.benchmark ? settings.benchmarkWarmup : 0);
+		if ((settings.frameLimit > 0) && (framesRendered >= frameCount))
+		{
+			quitMessageReceived = true;
+		}
 		auto tEnd = std::chrono::high_resolution_clock::now();
 		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
-		frameTimer = (float)tDiff / 1000.0f;
+		frameTimer = (float)(framePacer.enabled() ? tInterval : tDiff) / 1000.0f;
+		overlayStats.frameMs[overlayStats.frameIndex] = (float)tDiff;
+		overlayStats.frameIndex = (overlayStats.frameIndex + 1) % static_cast<uint32_t>(overlayStats.frameMs.size());
+		if (settings.benchmark)
+		{
+			if (framesRendered > settings.benchmarkWarmup)
+			{
+				benchmark.cpuMs.push_back(tDiff);
+			}
+			// Animations advance by a fixed step, so every run renders the same frames
+			frameTimer = 1.0f / 60.0f;
+		}
 		///TODO Add cam
 		///camera.update(frameTimer);
 		//if (camera.moving())
@@ -194,12 +287,12 @@ void VulkanExampleBase::renderLoop()
 				timer -= 1.0f;
 			}
 		}
-		fpsTimer += (float)tDiff;
+		fpsTimer += (float)(framePacer.enabled() ? tInterval : tDiff);
 		if (fpsTimer > 1000.0f)
 		{
-
-			lastFPS = static_cast<uint32_t>(1.0f / frameTimer);
+			lastFPS = static_cast<uint32_t>(frameCounter * 1000.0f / fpsTimer + 0.5f);
 			updateTextOverlay();
+			framePacer.resetMaxJitter();
 			fpsTimer = 0.0f;
 			frameCounter = 0;
 		}
@@ -207,36 +300,544 @@ void VulkanExampleBase::renderLoop()
 
 	// Flush device to make sure all resources can be freed 
 	vkDeviceWaitIdle(vulkanDevice->GetDevice());
+
+	if (settings.benchmark)
+	{
+		writeBenchmarkReport();
+	}
+
+	if (!settings.traceOutput.empty())
+	{
+		vks::trace::setEnabled(false);
+		if (vks::trace::write(settings.traceOutput))
+		{
+			std::cout << "Trace written to " << settings.traceOutput << std::endl;
+		}
+		else
+		{
+			std::cerr << "Could not write trace to " << settings.traceOutput << std::endl;
+		}
+	}
 }
 
 void VulkanExampleBase::updateTextOverlay()
 {
-	
+	if (!textOverlay.prepared)
+	{
+		return;
+	}
+	auto tStart = std::chrono::high_resolution_clock::now();
+
+	const uint32_t white = vks::TextOverlay::color(1.0f, 1.0f, 1.0f);
+	const uint32_t gray = vks::TextOverlay::color(0.7f, 0.7f, 0.7f);
+	const uint32_t background = vks::TextOverlay::color(0.0f, 0.0f, 0.0f, 0.6f);
+	const float lineHeight = textOverlay.lineHeight();
+	const float x = 8.0f;
+	float y = 8.0f;
+	char text[256];
+
+	textOverlay.beginTextUpdate();
+	textOverlay.addText(title + " - " + vulkanDevice->properties.deviceName, x, y, vks::TextOverlay::Align::Left, white, background);
+	y += lineHeight;
+
+	// Over the frames of the graph
+	float averageMs = 0.0f;
+	float worstMs = 0.0f;
+	for (float frameMs : overlayStats.frameMs)
+	{
+		averageMs += frameMs;
+		worstMs = std::max(worstMs, frameMs);
+	}
+	averageMs /= (float)overlayStats.frameMs.size();
+	snprintf(text, sizeof(text), "%u fps, CPU frame %.2f ms (worst %.2f ms)", lastFPS, averageMs, worstMs);
+	textOverlay.addText(text, x, y, vks::TextOverlay::Align::Left, white, background);
+	y += lineHeight;
+
+	if (settings.lowLatency)
+	{
+		snprintf(text, sizeof(text), "Input to GPU end %.2f ms (last %.2f ms), %u frame(s) queued at most",
+			inputLatency.averageMs, inputLatency.lastMs, latency.maxFrames);
+		textOverlay.addText(text, x, y, vks::TextOverlay::Align::Left, white, background);
+		y += lineHeight;
+	}
+
+	if (framePacer.enabled())
+	{
+		snprintf(text, sizeof(text), "Paced to %.1f fps, jitter %.3f ms avg %.3f ms max, waiting %.2f ms/frame",
+			framePacer.targetFps(), framePacer.averageJitterMs, framePacer.maxJitterMs, framePacer.averageWaitMs);
+		textOverlay.addText(text, x, y, vks::TextOverlay::Align::Left, white, background);
+		y += lineHeight;
+	}
+
+	if (gpuProfiler.enabled)
+	{
+		for (auto& timings : gpuProfiler.timings())
+		{
+			snprintf(text, sizeof(text), "GPU %-16s %7.3f ms", timings.name, timings.averageMs);
+			textOverlay.addText(text, x, y, vks::TextOverlay::Align::Left, gray, background);
+			y += lineHeight;
+		}
+	}
+	else
+	{
+		textOverlay.addText("GPU timings not available on this queue", x, y, vks::TextOverlay::Align::Left, gray, background);
+		y += lineHeight;
+	}
+
+	PROCESS_MEMORY_COUNTERS memoryCounters = {};
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &memoryCounters, sizeof(memoryCounters)))
+	{
+		snprintf(text, sizeof(text), "Host memory %.1f MB working set, %.1f MB committed",
+			memoryCounters.WorkingSetSize / (1024.0 * 1024.0), memoryCounters.PagefileUsage / (1024.0 * 1024.0));
+		textOverlay.addText(text, x, y, vks::TextOverlay::Align::Left, gray, background);
+		y += lineHeight;
+	}
+
+	getOverlayText(&textOverlay, x, y);
+
+	snprintf(text, sizeof(text), "Overlay update %.3f ms", overlayStats.updateMs);
+	textOverlay.addText(text, x, y, vks::TextOverlay::Align::Left, gray, background);
+
+	// Frame time graph in the lower left corner, oldest frame first, the line marks 16.7 ms (60 fps)
+	const float barWidth = 2.0f;
+	const float graphHeight = 64.0f;
+	const float graphMs = 33.3f;
+	const float graphWidth = barWidth * overlayStats.frameMs.size();
+	const float graphBottom = (float)height - 8.0f;
+	textOverlay.addRect(x, graphBottom - graphHeight, graphWidth, graphHeight, background);
+	for (uint32_t i = 0; i < overlayStats.frameMs.size(); i++)
+	{
+		const float frameMs = overlayStats.frameMs[(overlayStats.frameIndex + i) % overlayStats.frameMs.size()];
+		const float barHeight = std::min(frameMs / graphMs, 1.0f) * graphHeight;
+		const uint32_t barColor = (frameMs <= 16.7f) ? vks::TextOverlay::color(0.2f, 0.9f, 0.2f) :
+			((frameMs <= 33.3f) ? vks::TextOverlay::color(0.9f, 0.8f, 0.1f) : vks::TextOverlay::color(0.9f, 0.2f, 0.1f));
+		textOverlay.addRect(x + i * barWidth, graphBottom - barHeight, barWidth, barHeight, barColor);
+	}
+	textOverlay.addRect(x, graphBottom - graphHeight * (16.7f / graphMs), graphWidth, 1.0f, vks::TextOverlay::color(1.0f, 1.0f, 1.0f, 0.5f));
+	textOverlay.addText("16.7 ms", x + graphWidth + 4.0f, graphBottom - graphHeight * (16.7f / graphMs) - lineHeight * 0.5f,
+		vks::TextOverlay::Align::Left, gray, background);
+
+	textOverlay.endTextUpdate();
+	overlayStats.updateMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+}
+
+void VulkanExampleBase::getOverlayText(vks::TextOverlay *, float, float &)
+{
+	// Can be overriden in derived class
+}
+
+void VulkanExampleBase::drawTextOverlay(vk::CommandBuffer cmdBuffer, uint32_t frame, vk::RenderPass renderPass)
+{
+	if (!textOverlay.prepared)
+	{
+		return;
+	}
+	vks::GpuProfiler::Scope scope(gpuProfiler, cmdBuffer, "overlay");
+	textOverlay.draw(cmdBuffer, frame, renderPass, width, height);
 }
 
 void VulkanExampleBase::prepareFrame()
 {
-	// Acquire the next image from the swap chain
-	VkResult err = swapChain.acquireNextImage(semaphores.presentComplete, &currentBuffer);
-	// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE) or no longer optimal for presentation (SUBOPTIMAL)
-	if ((err == VK_ERROR_OUT_OF_DATE_KHR) || (err == VK_SUBOPTIMAL_KHR)) {
-		windowResize();
+	VKS_TRACE_SCOPE("prepareFrame");
+	if (settings.headless)
+	{
+		// Advance through the image ring, the empty batch stands in for the acquire and signals the semaphore the frame's submission waits on
+		currentBuffer = (currentBuffer + 1) % swapChain.imageCount;
+		vk::SubmitInfo acquireInfo;
+		acquireInfo.setSignalSemaphoreCount (1)
+			.setPSignalSemaphores (&semaphores.presentComplete);
+		VK_CHECK_RESULT(queue.submit (acquireInfo, nullptr));
+	}
+	else
+	{
+		// Acquire the next image from the swap chain
+		VkResult err = swapChain.acquireNextImage(semaphores.presentComplete, &currentBuffer);
+		// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE) or no longer optimal for presentation (SUBOPTIMAL)
+		if ((err == VK_ERROR_OUT_OF_DATE_KHR) || (err == VK_SUBOPTIMAL_KHR)) {
+			windowResize();
+		}
+		else {
+			VK_CHECK_RESULT(err);
+		}
 	}
-	else {
-		VK_CHECK_RESULT(err);
+	if (settings.benchmark)
+	{
+		beginFrameTiming();
 	}
 }
 
 void VulkanExampleBase::submitFrame()
 {
-	// Present the current buffer to the swap chain
-	// Pass the semaphore signaled by the command buffer submission from the submit info as the wait semaphore for swap chain presentation
-	// This ensures that the image is not presented to the windowing system until all commands have been submitted
-	VK_CHECK_RESULT(swapChain.queuePresent(queue, currentBuffer, semaphores.renderComplete));
+	VKS_TRACE_SCOPE("submitFrame");
+	if (settings.benchmark)
+	{
+		endFrameTiming();
+	}
+	if (settings.headless)
+	{
+		// Nothing is presented, consume the render complete signal so the semaphore can be signaled again next frame
+		vk::PipelineStageFlags waitStageMask = vk::PipelineStageFlagBits::eAllCommands;
+		vk::SubmitInfo presentInfo;
+		presentInfo.setWaitSemaphoreCount (1)
+			.setPWaitSemaphores (&semaphores.renderComplete)
+			.setPWaitDstStageMask (&waitStageMask);
+		VK_CHECK_RESULT(queue.submit (presentInfo, nullptr));
+	}
+	else
+	{
+		// Present the current buffer to the swap chain
+		// Pass the semaphore signaled by the command buffer submission from the submit info as the wait semaphore for swap chain presentation
+		// This ensures that the image is not presented to the windowing system until all commands have been submitted
+		VK_CHECK_RESULT(swapChain.queuePresent(queue, currentBuffer, semaphores.renderComplete));
+	}
+	framePacer.framePresented();
+
+	if (settings.benchmark)
+	{
+		auto tPresent = std::chrono::high_resolution_clock::now();
+		if (benchmark.frame > settings.benchmarkWarmup)
+		{
+			benchmark.presentIntervalMs.push_back(std::chrono::duration<double, std::milli>(tPresent - benchmark.lastPresent).count());
+		}
+		benchmark.lastPresent = tPresent;
+	}
 
 	//VK_CHECK_RESULT(queue.waitIdle ()); //is equivalent to submitting a fence to a queue and waiting with an infinite timeout for that fence to signal.
 }
 
+void VulkanExampleBase::prepareLatency()
+{
+	const uint32_t slotCount = static_cast<uint32_t>(drawCmdBuffers.size());
+	latency.inputNs.assign(slotCount, -1);
+	// Each queued frame holds a slot, the slot fences never let more frames than slots be queued
+	latency.maxFrames = std::max(std::min(settings.latencyFrames, slotCount), 1u);
+	if (latency.maxFrames != settings.latencyFrames)
+	{
+		std::cerr << "Low latency mode: " << settings.latencyFrames << " queued frames not possible with " << slotCount << " frame slots, using " << latency.maxFrames << std::endl;
+	}
+	for (uint32_t i = 0; i < latency.maxFrames; i++)
+	{
+		VkFence fence;
+		VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo();
+		VK_CHECK_RESULT(vkCreateFence(vulkanDevice->GetDevice(), &fenceCreateInfo, nullptr, &fence));
+		latency.fences.push_back(fence);
+	}
+	gpuProfiler.keepCalibrated = true;
+
+	const uint32_t validBits = vulkanDevice->queueFamilyProperties[vulkanDevice->queueFamilyIndices.graphics].timestampValidBits;
+	latency.timestamps = (gpuProfiler.enabled) && (gpuProfiler.calibration.valid) && (validBits > 0);
+	if (!latency.timestamps)
+	{
+		std::cerr << "Graphics queue doesn't support timestamps, no latency estimate" << std::endl;
+		return;
+	}
+	latency.timestampMask = (validBits >= 64) ? ~0ull : ((1ull << validBits) - 1);
+
+	vk::QueryPoolCreateInfo queryPoolInfo;
+	queryPoolInfo.setQueryType (vk::QueryType::eTimestamp)
+		.setQueryCount (slotCount);
+	latency.queryPool = CHECK(vulkanDevice->D().createQueryPool (queryPoolInfo));
+
+	vk::CommandBufferAllocateInfo cmdBufAllocateInfo;
+	cmdBufAllocateInfo.setCommandPool (vulkanDevice->commandPool)
+		.setLevel (vk::CommandBufferLevel::ePrimary)
+		.setCommandBufferCount (slotCount);
+	latency.commandBuffers = CHECK(vulkanDevice->D().allocateCommandBuffers (cmdBufAllocateInfo));
+
+	// Recorded once, a slot is only resubmitted after its fence signaled
+	for (uint32_t slot = 0; slot < slotCount; slot++)
+	{
+		vk::CommandBuffer cmdBuffer = latency.commandBuffers[slot];
+		VK_CHECK_RESULT(cmdBuffer.begin (vk::CommandBufferBeginInfo()));
+		cmdBuffer.resetQueryPool (latency.queryPool, slot, 1);
+		cmdBuffer.writeTimestamp (vk::PipelineStageFlagBits::eBottomOfPipe, latency.queryPool, slot);
+		VK_CHECK_RESULT(cmdBuffer.end ());
+	}
+	std::cout << "Low latency mode: " << latency.maxFrames << " frame(s) queued at most, " << (gpuProfiler.hasCalibratedTimestamps() ? "calibrated timestamps" : "startup calibration") << std::endl;
+}
+
+void VulkanExampleBase::destroyLatency()
+{
+	if (!latency.commandBuffers.empty())
+	{
+		vulkanDevice->D().freeCommandBuffers (vulkanDevice->commandPool, latency.commandBuffers);
+		latency.commandBuffers.clear();
+	}
+	if (latency.queryPool != VK_NULL_HANDLE)
+	{
+		vkDestroyQueryPool(vulkanDevice->GetDevice(), latency.queryPool, nullptr);
+		latency.queryPool = VK_NULL_HANDLE;
+	}
+	for (auto& fence : latency.fences)
+	{
+		vkDestroyFence(vulkanDevice->GetDevice(), fence, nullptr);
+	}
+	latency.fences.clear();
+}
+
+void VulkanExampleBase::beginLateUpdate(uint32_t frame)
+{
+	if (!settings.lowLatency)
+	{
+		return;
+	}
+	VKS_TRACE_SCOPE("beginLateUpdate");
+	// The slot's previous frame has completed, its end timestamp closes the latency of the input it was rendered with
+	if ((latency.timestamps) && (latency.inputNs[frame] >= 0))
+	{
+		uint64_t ticks = 0;
+		if (vkGetQueryPoolResults(vulkanDevice->GetDevice(), latency.queryPool, frame, 1, sizeof(ticks), &ticks, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+		{
+			const double latencyMs = (gpuProfiler.traceTime(ticks & latency.timestampMask) - latency.inputNs[frame]) / 1000000.0;
+			inputLatency.lastMs = latencyMs;
+			inputLatency.averageMs = (inputLatency.averageMs == 0.0) ? latencyMs : inputLatency.averageMs * 0.95 + latencyMs * 0.05;
+			if ((settings.benchmark) && (benchmark.frame > settings.benchmarkWarmup))
+			{
+				latency.samples.push_back(latencyMs);
+			}
+		}
+	}
+	latency.inputNs[frame] = -1;
+
+	// Frame N is submitted once frame N - maxFrames has completed, its fence is the one frame N reuses
+	if (latency.submittedFrames >= latency.maxFrames)
+	{
+		VkFence &fence = latency.fences[latency.submittedFrames % latency.maxFrames];
+		VK_CHECK_RESULT(vkWaitForFences(vulkanDevice->GetDevice(), 1, &fence, VK_TRUE, UINT64_MAX));
+		VK_CHECK_RESULT(vkResetFences(vulkanDevice->GetDevice(), 1, &fence));
+	}
+
+	// Only mouse messages, they change the view and nothing else (resizes and key handlers are left to the render loop)
+	MSG msg;
+	while (PeekMessage(&msg, NULL, WM_MOUSEFIRST, WM_MOUSELAST, PM_REMOVE))
+	{
+		TranslateMessage(&msg);
+		DispatchMessage(&msg);
+	}
+	latency.inputNs[frame] = vks::trace::now();
+}
+
+vk::CommandBuffer VulkanExampleBase::latencyCommandBuffer(uint32_t frame)
+{
+	return ((settings.lowLatency) && (latency.timestamps)) ? latency.commandBuffers[frame] : vk::CommandBuffer();
+}
+
+void VulkanExampleBase::endLateUpdate()
+{
+	if (!settings.lowLatency)
+	{
+		return;
+	}
+	// A submission without batches signals the fence once all work submitted to the queue before it has completed
+	VK_CHECK_RESULT(queue.submit (nullptr, vk::Fence(latency.fences[latency.submittedFrames % latency.maxFrames])));
+	latency.submittedFrames++;
+}
+
+void VulkanExampleBase::prepareBenchmark()
+{
+	const uint32_t slotCount = swapChain.imageCount;
+	benchmark.pendingFrames.assign(slotCount, -1);
+
+	const uint32_t validBits = vulkanDevice->queueFamilyProperties[vulkanDevice->queueFamilyIndices.graphics].timestampValidBits;
+	benchmark.timestamps = (validBits > 0) && (vulkanDevice->properties.limits.timestampPeriod > 0.0f);
+	if (!benchmark.timestamps)
+	{
+		std::cerr << "Graphics queue doesn't support timestamps, the benchmark has no GPU times" << std::endl;
+		return;
+	}
+	benchmark.timestampMask = (validBits >= 64) ? ~0ull : ((1ull << validBits) - 1);
+
+	vk::QueryPoolCreateInfo queryPoolInfo;
+	queryPoolInfo.setQueryType (vk::QueryType::eTimestamp)
+		.setQueryCount (2 * slotCount);
+	benchmark.queryPool = CHECK(vulkanDevice->D().createQueryPool (queryPoolInfo));
+
+	vk::CommandBufferAllocateInfo cmdBufAllocateInfo;
+	cmdBufAllocateInfo.setCommandPool (vulkanDevice->commandPool)
+		.setLevel (vk::CommandBufferLevel::ePrimary)
+		.setCommandBufferCount (2 * slotCount);
+	benchmark.commandBuffers = CHECK(vulkanDevice->D().allocateCommandBuffers (cmdBufAllocateInfo));
+
+	// The timestamp submissions are recorded once, a slot is only resubmitted after its fence signaled
+	for (uint32_t slot = 0; slot < slotCount; slot++)
+	{
+		vk::CommandBuffer beginCmd = benchmark.commandBuffers[2 * slot];
+		VK_CHECK_RESULT(beginCmd.begin (vk::CommandBufferBeginInfo()));
+		beginCmd.resetQueryPool (benchmark.queryPool, 2 * slot, 2);
+		beginCmd.writeTimestamp (vk::PipelineStageFlagBits::eTopOfPipe, benchmark.queryPool, 2 * slot);
+		VK_CHECK_RESULT(beginCmd.end ());
+
+		// Bottom of pipe waits for all work submitted before it
+		vk::CommandBuffer endCmd = benchmark.commandBuffers[2 * slot + 1];
+		VK_CHECK_RESULT(endCmd.begin (vk::CommandBufferBeginInfo()));
+		endCmd.writeTimestamp (vk::PipelineStageFlagBits::eBottomOfPipe, benchmark.queryPool, 2 * slot + 1);
+		VK_CHECK_RESULT(endCmd.end ());
+
+		VkFence fence;
+		VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo();
+		VK_CHECK_RESULT(vkCreateFence(vulkanDevice->GetDevice(), &fenceCreateInfo, nullptr, &fence));
+		benchmark.fences.push_back(fence);
+	}
+}
+
+void VulkanExampleBase::destroyBenchmark()
+{
+	for (auto& fence : benchmark.fences)
+	{
+		vkDestroyFence(vulkanDevice->GetDevice(), fence, nullptr);
+	}
+	benchmark.fences.clear();
+	if (!benchmark.commandBuffers.empty())
+	{
+		vulkanDevice->D().freeCommandBuffers (vulkanDevice->commandPool, benchmark.commandBuffers);
+		benchmark.commandBuffers.clear();
+	}
+	if (benchmark.queryPool != VK_NULL_HANDLE)
+	{
+		vkDestroyQueryPool(vulkanDevice->GetDevice(), benchmark.queryPool, nullptr);
+		benchmark.queryPool = VK_NULL_HANDLE;
+	}
+}
+
+void VulkanExampleBase::beginFrameTiming()
+{
+	if (!benchmark.timestamps)
+	{
+		return;
+	}
+	const uint32_t slot = static_cast<uint32_t>(benchmark.frame % benchmark.fences.size());
+	if (benchmark.pendingFrames[slot] >= 0)
+	{
+		// Submitted a full ring of frames ago, the frame's own fence wait would block for the same work
+		VK_CHECK_RESULT(vkWaitForFences(vulkanDevice->GetDevice(), 1, &benchmark.fences[slot], VK_TRUE, UINT64_MAX));
+		VK_CHECK_RESULT(vkResetFences(vulkanDevice->GetDevice(), 1, &benchmark.fences[slot]));
+		readFrameTiming(slot);
+	}
+	vk::SubmitInfo timestampInfo;
+	timestampInfo.setCommandBufferCount (1)
+		.setPCommandBuffers (&benchmark.commandBuffers[2 * slot]);
+	VK_CHECK_RESULT(queue.submit (timestampInfo, nullptr));
+}
+
+void VulkanExampleBase::endFrameTiming()
+{
+	if (benchmark.timestamps)
+	{
+		const uint32_t slot = static_cast<uint32_t>(benchmark.frame % benchmark.fences.size());
+		vk::SubmitInfo timestampInfo;
+		timestampInfo.setCommandBufferCount (1)
+			.setPCommandBuffers (&benchmark.commandBuffers[2 * slot + 1]);
+		VK_CHECK_RESULT(queue.submit (timestampInfo, benchmark.fences[slot]));
+		benchmark.pendingFrames[slot] = benchmark.frame;
+	}
+	benchmark.frame++;
+}
+
+void VulkanExampleBase::readFrameTiming(uint32_t slot)
+{
+	uint64_t timestamps[2];
+	VK_CHECK_RESULT(vkGetQueryPoolResults(vulkanDevice->GetDevice(), benchmark.queryPool, 2 * slot, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT));
+	// The frame starts when the previous one ended if the GPU was still busy with it when the begin timestamp was written
+	uint64_t begin = timestamps[0];
+	if ((benchmark.lastEnd != 0) && (((timestamps[0] - benchmark.lastEnd) & benchmark.timestampMask) > (benchmark.timestampMask >> 1)))
+	{
+		begin = benchmark.lastEnd;
+	}
+	benchmark.lastEnd = timestamps[1];
+	if (benchmark.pendingFrames[slot] >= settings.benchmarkWarmup)
+	{
+		const uint64_t ticks = (timestamps[1] - begin) & benchmark.timestampMask;
+		benchmark.gpuMs.push_back((double)ticks * vulkanDevice->properties.limits.timestampPeriod / 1000000.0);
+	}
+	benchmark.pendingFrames[slot] = -1;
+}
+
+void VulkanExampleBase::writeBenchmarkReport()
+{
+	// The device is idle, resolve the frames still pending in frame order
+	const int64_t slotCount = static_cast<int64_t>(benchmark.pendingFrames.size());
+	for (int64_t frame = std::max(benchmark.frame - slotCount, (int64_t)0); frame < benchmark.frame; frame++)
+	{
+		const uint32_t slot = static_cast<uint32_t>(frame % slotCount);
+		if (benchmark.pendingFrames[slot] == frame)
+		{
+			readFrameTiming(slot);
+		}
+	}
+
+	const VkPhysicalDeviceProperties &properties = vulkanDevice->properties;
+	vks::BenchmarkReport report;
+	report.addMetadata("example", title);
+	report.addMetadata("device", properties.deviceName);
+	report.addMetadata("deviceType", vks::tools::physicalDeviceTypeString(properties.deviceType));
+	report.addMetadataNumber("vendorID", properties.vendorID);
+	report.addMetadataNumber("deviceID", properties.deviceID);
+	report.addMetadataNumber("driverVersion", properties.driverVersion);
+	report.addMetadata("apiVersion", std::to_string(properties.apiVersion >> 22) + "." + std::to_string((properties.apiVersion >> 12) & 0x3ff) + "." + std::to_string(properties.apiVersion & 0xfff));
+	report.addMetadataNumber("width", width);
+	report.addMetadataNumber("height", height);
+	report.addMetadataFlag("headless", settings.headless);
+	report.addMetadataFlag("vsync", settings.vsync);
+	report.addMetadataFlag("validation", settings.validation);
+	report.addMetadataNumber("swapChainImages", swapChain.imageCount);
+	report.addMetadataNumber("jobThreads", jobSystem->threadCount());
+	report.addMetadataNumber("warmupFrames", settings.benchmarkWarmup);
+	report.addMetadataNumber("frames", settings.frameLimit);
+	report.addMetadataFlag("gpuTimestamps", benchmark.timestamps);
+	report.addMetadataNumber("targetFrameRate", settings.targetFrameRate);
+	report.addMetadataFlag("lowLatency", settings.lowLatency);
+	if (settings.lowLatency)
+	{
+		report.addMetadataNumber("latencyFrames", latency.maxFrames);
+	}
+	getBenchmarkMetadata(report);
+	report.addSeries("cpuMs", benchmark.cpuMs);
+	report.addSeries("gpuMs", benchmark.gpuMs);
+	report.addSeries("presentIntervalMs", benchmark.presentIntervalMs);
+	if (latency.timestamps)
+	{
+		// From sampling the input to the end of the frame's batch on the device
+		report.addSeries("inputLatencyMs", latency.samples);
+	}
+	if (framePacer.enabled())
+	{
+		// Deviation of each present interval from the target period
+		report.addSeries("pacingJitterMs", framePacer.jitterSamples);
+	}
+	gpuProfiler.addToReport(report);
+
+	const vks::SampleStatistics cpu = report.statistics("cpuMs");
+	const vks::SampleStatistics gpu = report.statistics("gpuMs");
+	const vks::SampleStatistics present = report.statistics("presentIntervalMs");
+	std::cout << "Benchmark (" << benchmark.cpuMs.size() << " frames after " << settings.benchmarkWarmup << " warm up frames)" << std::endl;
+	std::cout << " CPU           : " << cpu.avg << " ms avg, " << cpu.median << " median, " << cpu.p99 << " p99" << std::endl;
+	std::cout << " GPU           : " << gpu.avg << " ms avg, " << gpu.median << " median, " << gpu.p99 << " p99" << std::endl;
+	std::cout << " Present       : " << present.avg << " ms avg, " << present.median << " median, " << present.p99 << " p99" << std::endl;
+	if (latency.timestamps)
+	{
+		const vks::SampleStatistics inputToGpu = report.statistics("inputLatencyMs");
+		std::cout << " Input latency : " << inputToGpu.avg << " ms avg, " << inputToGpu.median << " median, " << inputToGpu.p99 << " p99" << std::endl;
+	}
+	if (framePacer.enabled())
+	{
+		const vks::SampleStatistics jitter = report.statistics("pacingJitterMs");
+		std::cout << " Pacing jitter : " << jitter.avg << " ms avg, " << jitter.median << " median, " << jitter.p99 << " p99" << std::endl;
+	}
+	if (report.write(settings.benchmarkOutput))
+	{
+		std::cout << "Benchmark report written to " << settings.benchmarkOutput << std::endl;
+	}
+	else
+	{
+		std::cerr << "Could not write benchmark report to " << settings.benchmarkOutput << std::endl;
+	}
+}
+
+void VulkanExampleBase::getBenchmarkMetadata(vks::BenchmarkReport &)
+{
+	// Can be overriden in derived class
+}
+
 VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 {
 
@@ -268,6 +869,69 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 		{
 			settings.fullscreen = true;
 		}
+		if (args[i] == std::string("-headless"))
+		{
+			settings.headless = true;
+		}
+		if ((args[i] == std::string("-frames")) && (i + 1 < args.size()))
+		{
+			char* endptr;
+			uint32_t count = strtol(args[i + 1], &endptr, 10);
+			if (endptr != args[i + 1]) { settings.frameLimit = count; };
+		}
+		if (args[i] == std::string("-benchmark"))
+		{
+			settings.benchmark = true;
+		}
+		if (args[i] == std::string("-profile"))
+		{
+			settings.profile = true;
+		}
+		if (args[i] == std::string("-pipelinestats"))
+		{
+			settings.profile = true;
+			settings.pipelineStatistics = true;
+		}
+		if ((args[i] == std::string("-warmup")) && (i + 1 < args.size()))
+		{
+			char* endptr;
+			uint32_t count = strtol(args[i + 1], &endptr, 10);
+			if (endptr != args[i + 1]) { settings.benchmarkWarmup = count; };
+		}
+		if ((args[i] == std::string("-output")) && (i + 1 < args.size()))
+		{
+			settings.benchmarkOutput = args[i + 1];
+		}
+		if ((args[i] == std::string("-trace")) && (i + 1 < args.size()))
+		{
+			settings.traceOutput = args[i + 1];
+		}
+		if (args[i] == std::string("-overlay"))
+		{
+			settings.overlay = true;
+		}
+		if ((args[i] == std::string("-targetfps")) && (i + 1 < args.size()))
+		{
+			char* endptr;
+			double fps = strtod(args[i + 1], &endptr);
+			if ((endptr != args[i + 1]) && (fps > 0.0)) { settings.targetFrameRate = fps; };
+		}
+		if (args[i] == std::string("-lowlatency"))
+		{
+			settings.lowLatency = true;
+		}
+		if ((args[i] == std::string("-latencyframes")) && (i + 1 < args.size()))
+		{
+			char* endptr;
+			uint32_t count = strtol(args[i + 1], &endptr, 10);
+			if ((endptr != args[i + 1]) && (count > 0)) { settings.latencyFrames = count; settings.lowLatency = true; };
+		}
+		if ((args[i] == std::string("-framebudget")) && (i + 1 < args.size()))
+		{
+			char* endptr;
+			double ms = strtod(args[i + 1], &endptr);
+			if ((endptr != args[i + 1]) && (ms > 0.0)) { settings.targetFrameRate = 1000.0 / ms; };
+		}
 		if ((args[i] == std::string("-w")) || (args[i] == std::string("-width")))
 		{
 			char* endptr;
@@ -280,7 +944,41 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 			uint32_t h = strtol(args[i + 1], &endptr, 10);
 			if (endptr != args[i + 1]) { height = h; };
 		}
+		if ((args[i] == std::string("-workers")) && (i + 1 < args.size()))
+		{
+			char* endptr;
+			long count = strtol(args[i + 1], &endptr, 10);
+			// 0 keeps the default (one less than the hardware threads), a mistyped count must not spawn thousands of threads
+			const long maxCount = 4 * (long)std::max(std::thread::hardware_concurrency(), 1u);
+			if ((endptr != args[i + 1]) && (count > 0)) { settings.workerCount = static_cast<uint32_t>(std::min(count, maxCount)); };
+			if ((endptr == args[i + 1]) || (count < 0) || (count > maxCount))
+			{
+				std::cerr << "-workers expects 0 (automatic) to " << maxCount << ", using " << settings.workerCount << " (0 = automatic)" << std::endl;
+			}
+		}
+	}
+
+	if ((settings.benchmark) && (settings.frameLimit == 0))
+	{
+		settings.frameLimit = 1000;
+	}
+	if ((settings.headless) && (settings.frameLimit == 0))
+	{
+		// No window, so no WM_QUIT ends the render loop
+		settings.frameLimit = 1000;
+		std::cout << "Headless without -frames, rendering " << settings.frameLimit << " frames" << std::endl;
+	}
+
+#if !defined(VKS_TRACING)
+	if (!settings.traceOutput.empty())
+	{
+		std::cerr << "Built without VKS_TRACING, -trace is ignored" << std::endl;
+		settings.traceOutput.clear();
 	}
+#endif
+
+	vks::trace::setThreadName("main");
+	jobSystem.reset(new vks::JobSystem(settings.workerCount));
 
 
 
@@ -299,6 +997,15 @@ VulkanExampleBase::~VulkanExampleBase()
 {
 	// Clean up Vulkan resources
 	swapChain.cleanup();
+	destroyHeadlessTargets();
+	destroyBenchmark();
+	destroyLatency();
+	gpuProfiler.destroy();
+	textOverlay.destroy();
+	if (framePacer.enabled())
+	{
+		timeEndPeriod(1);
+	}
 	if (descriptorPool)
 	{
 		vkDestroyDescriptorPool(vulkanDevice->GetDevice(), descriptorPool, nullptr);
@@ -413,7 +1120,14 @@ void VulkanExampleBase::initVulkan()
 	// This is handled by a separate class that gets a logical device representation
 	// and encapsulates functions related to a device
 	vulkanDevice = new vks::VulkanDevice(physicalDevice);
-	vulkanDevice->createLogicalDevice(enabledFeatures, enabledExtensions);
+#if defined(VK_EXT_calibrated_timestamps)
+	// Places the GPU scopes of a trace (and the frame ends of the latency estimate) on the CPU timeline without a round trip through the queue
+	if (((!settings.traceOutput.empty()) || (settings.lowLatency)) && (vulkanDevice->extensionSupported(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME)))
+	{
+		enabledExtensions.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+	}
+#endif
+	vulkanDevice->createLogicalDevice(enabledFeatures, enabledExtensions, !settings.headless);
 	device = vulkanDevice->GetDevice();
 	
 
@@ -423,7 +1137,11 @@ void VulkanExampleBase::initVulkan()
 	VkBool32 validDepthFormat = vks::tools::getSupportedDepthFormat(physicalDevice, &depthFormat);
 	assert(validDepthFormat);
 
-	swapChain.connect(instance, physicalDevice, vulkanDevice->GetDevice ());
+	// The swap chain functions are not loaded without the swap chain extensions
+	if (!settings.headless)
+	{
+		swapChain.connect(instance, physicalDevice, vulkanDevice->GetDevice ());
+	}
 
 	// Create synchronization objects
 	vk::SemaphoreCreateInfo semaphoreCreateInfo; //Arguments reserved for future use
@@ -571,6 +1289,11 @@ HWND VulkanExampleBase::setupWindow(HINSTANCE hinstance, WNDPROC wndproc)
 
 void VulkanExampleBase::handleMessages(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 {
+	// Benchmark runs ignore input, closing the window still ends them
+	if ((settings.benchmark) && (uMsg != WM_CLOSE) && (uMsg != WM_PAINT))
+	{
+		return;
+	}
 	switch (uMsg)
 	{
 	case WM_CLOSE:
@@ -718,7 +1441,8 @@ void VulkanExampleBase::setupDepthStencil()
 	image.arrayLayers = 1;
 	image.samples = VK_SAMPLE_COUNT_1_BIT;
 	image.tiling = VK_IMAGE_TILING_OPTIMAL;
-	image.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	// Sampled for depth pyramid generation (occlusion culling)
+	image.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 	image.flags = 0;
 
 	VkMemoryAllocateInfo mem_alloc = {};
@@ -742,7 +1466,7 @@ void VulkanExampleBase::setupDepthStencil()
 
 	VkMemoryRequirements memReqs;
 
-	VK_CHECK_RESULT(vkCreateImage(vulkanDevice->GetDevice (), &image, nullptr, &depthStencil.image));
+	VK_CHECK_RESULT(vulkanDevice->createImage(&image, &depthStencil.image, "depth stencil"));
 	vkGetImageMemoryRequirements(vulkanDevice->GetDevice(), depthStencil.image, &memReqs);
 	mem_alloc.allocationSize = memReqs.size;
 	mem_alloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal);
@@ -790,7 +1514,7 @@ void VulkanExampleBase::setupRenderPass()
 		.setStencilLoadOp	(vk::AttachmentLoadOp::eDontCare)
 		.setStencilStoreOp	(vk::AttachmentStoreOp::eDontCare)
 		.setInitialLayout	(vk::ImageLayout::eUndefined)
-		.setFinalLayout		(vk::ImageLayout::ePresentSrcKHR);
+		.setFinalLayout		(presentLayout());
 
 	// Depth attachment
 	attachments[1].setFormat ((vk::Format)depthFormat)
@@ -822,7 +1546,7 @@ void VulkanExampleBase::setupRenderPass()
 		.setPResolveAttachments (nullptr);
 
 	// Subpass dependencies for layout transitions
-	std::array<vk::SubpassDependency, 2> dependencies;
+	std::array<vk::SubpassDependency, 3> dependencies;
 
 	dependencies[0].setSrcSubpass (VK_SUBPASS_EXTERNAL)
 		.setDstSubpass		(0)
@@ -840,7 +1564,14 @@ void VulkanExampleBase::setupRenderPass()
 		.setDstAccessMask	(vk::AccessFlagBits::eMemoryRead)
 		.setDependencyFlags	(vk::DependencyFlagBits::eByRegion);
 
-	
+	// All frames in flight share the depth attachment (also the headless image ring), its clear waits for the depth tests of the previous frame
+	dependencies[2].setSrcSubpass (VK_SUBPASS_EXTERNAL)
+		.setDstSubpass		(0)
+		.setSrcStageMask	(vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests)
+		.setDstStageMask	(vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests)
+		.setSrcAccessMask	(vk::AccessFlagBits::eDepthStencilAttachmentWrite)
+		.setDstAccessMask	(vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite)
+		.setDependencyFlags (vk::DependencyFlagBits::eByRegion);
 
 	vk::RenderPassCreateInfo renderPassInfo = {};
 	renderPassInfo.setAttachmentCount ((uint32_t)attachments.size())
@@ -917,5 +1648,79 @@ void VulkanExampleBase::initSwapchain()
 
 void VulkanExampleBase::setupSwapChain()
 {
+	if (settings.headless)
+	{
+		setupHeadlessTargets();
+		return;
+	}
 	swapChain.create(&width, &height, settings.vsync);
 }
+
+void VulkanExampleBase::setupHeadlessTargets()
+{
+	destroyHeadlessTargets();
+
+	// Same format and image count a typical swap chain would offer, so derived passes and frame counts don't change
+	const uint32_t imageCount = 3;
+	swapChain.colorFormat = VK_FORMAT_B8G8R8A8_UNORM;
+	VkFormatProperties formatProps;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, swapChain.colorFormat, &formatProps);
+	if (!(formatProps.optimalTilingFeatures & VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT))
+	{
+		swapChain.colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+	}
+	swapChain.imageCount = imageCount;
+	swapChain.buffers.resize(imageCount);
+	headlessTargets.images.resize(imageCount);
+	headlessTargets.memory.resize(imageCount);
+
+	VkImageCreateInfo image = vks::initializers::imageCreateInfo();
+	image.imageType = VK_IMAGE_TYPE_2D;
+	image.format = swapChain.colorFormat;
+	image.extent = { width, height, 1 };
+	image.mipLevels = 1;
+	image.arrayLayers = 1;
+	image.samples = VK_SAMPLE_COUNT_1_BIT;
+	image.tiling = VK_IMAGE_TILING_OPTIMAL;
+	// Transfer source for reading frames back
+	image.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
+	VkImageViewCreateInfo colorAttachmentView = vks::initializers::imageViewCreateInfo();
+	colorAttachmentView.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	colorAttachmentView.format = swapChain.colorFormat;
+	colorAttachmentView.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+	for (uint32_t i = 0; i < imageCount; i++)
+	{
+		VkMemoryRequirements memReqs;
+		VK_CHECK_RESULT(vulkanDevice->createImage(&image, &headlessTargets.images[i], "headless target " + std::to_string(i)));
+		vkGetImageMemoryRequirements(vulkanDevice->GetDevice(), headlessTargets.images[i], &memReqs);
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal);
+		VK_CHECK_RESULT(vkAllocateMemory(vulkanDevice->GetDevice(), &memAlloc, nullptr, &headlessTargets.memory[i]));
+		VK_CHECK_RESULT(vkBindImageMemory(vulkanDevice->GetDevice(), headlessTargets.images[i], headlessTargets.memory[i], 0));
+
+		swapChain.buffers[i].image = headlessTargets.images[i];
+		colorAttachmentView.image = headlessTargets.images[i];
+		VK_CHECK_RESULT(vkCreateImageView(vulkanDevice->GetDevice(), &colorAttachmentView, nullptr, &swapChain.buffers[i].view));
+	}
+}
+
+void VulkanExampleBase::destroyHeadlessTargets()
+{
+	for (size_t i = 0; i < headlessTargets.images.size(); i++)
+	{
+		vkDestroyImageView(vulkanDevice->GetDevice(), swapChain.buffers[i].view, nullptr);
+		vkDestroyImage(vulkanDevice->GetDevice(), headlessTargets.images[i], nullptr);
+		vkFreeMemory(vulkanDevice->GetDevice(), headlessTargets.memory[i], nullptr);
+	}
+	headlessTargets.images.clear();
+	headlessTargets.memory.clear();
+}
+
+vk::ImageLayout VulkanExampleBase::presentLayout() const
+{
+	// The present layout needs VK_KHR_swapchain, which a headless device doesn't enable
+	return settings.headless ? vk::ImageLayout::eTransferSrcOptimal : vk::ImageLayout::ePresentSrcKHR;
+}
@@ -36,6 +36,12 @@
 
 #include "VulkanDevice.hpp"
 #include "VulkanSwapChain.hpp"
+#include "vksJobSystem.h"
+#include "vksBenchmark.h"
+#include "VulkanGpuProfiler.hpp"
+#include "vksTrace.h"
+#include "VulkanTextOverlay.hpp"
+#include "vksFramePacer.h"
 
 
 
@@ -54,6 +60,59 @@ private:
 	bool resizing = false;
 	// Called if the window is resized and some resources have to be recreatesd
 	void windowResize();
+	/** @brief Per-frame timings of a benchmark run (-benchmark) */
+	struct {
+		// Two timestamps per slot, written by separate submissions before and after the frame's work
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+		bool timestamps = false;
+		uint64_t timestampMask = 0;
+		// Per slot: begin and end timestamp command buffers, fence of the end submission
+		std::vector<vk::CommandBuffer> commandBuffers;
+		std::vector<VkFence> fences;
+		// Frame whose timestamps are pending in a slot (-1 = none), slots are used in frame order
+		std::vector<int64_t> pendingFrames;
+		int64_t frame = 0;
+		// End of the last resolved frame, the begin timestamp may be written while the previous frame still runs
+		uint64_t lastEnd = 0;
+		std::chrono::high_resolution_clock::time_point lastPresent;
+		std::vector<double> cpuMs;
+		std::vector<double> gpuMs;
+		std::vector<double> presentIntervalMs;
+	} benchmark;
+	void prepareBenchmark();
+	void destroyBenchmark();
+	void beginFrameTiming();
+	void endFrameTiming();
+	void readFrameTiming(uint32_t slot);
+	void writeBenchmarkReport();
+	// VK_EXT_debug_utils has been enabled on the instance
+	bool debugUtils = false;
+	/** @brief Queue depth limit and latency estimate of the low latency mode (-lowlatency) */
+	struct {
+		// Per slot: command buffer writing the timestamp at the end of the frame's batch
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+		bool timestamps = false;
+		uint64_t timestampMask = 0;
+		std::vector<vk::CommandBuffer> commandBuffers;
+		// Per slot: trace clock time the submitted frame's input was sampled at (-1 = none pending)
+		std::vector<int64_t> inputNs;
+		// Ring of maxFrames fences, frame N signals fences[N % maxFrames] with a fence only submission after its batch
+		// Owned by the latency code, so swapchain images acquired out of order don't affect the queue depth limit
+		std::vector<VkFence> fences;
+		uint64_t submittedFrames = 0;
+		// Frames that may be queued on the device (settings.latencyFrames clamped to the slot count)
+		uint32_t maxFrames = 1;
+		std::vector<double> samples;
+	} latency;
+	void prepareLatency();
+	void destroyLatency();
+	/** @brief Recent CPU frame times shown as graph by the text overlay (-overlay) */
+	struct {
+		std::array<float, 128> frameMs = {};
+		uint32_t frameIndex = 0;
+		// CPU time of the last content update
+		double updateMs = 0.0;
+	} overlayStats;
 protected:
 	// Frame counter to display fps
 	uint32_t frameCounter = 0;
@@ -93,6 +152,11 @@ protected:
 	vk::PipelineCache pipelineCache;
 	// Wraps the swap chain to present images (framebuffers) to the windowing system
 	VulkanSwapChain swapChain;
+	/** @brief Images behind swapChain.buffers in headless mode (the views are created like swap chain views) */
+	struct {
+		std::vector<VkImage> images;
+		std::vector<VkDeviceMemory> memory;
+	} headlessTargets;
 
 	vk::SubmitInfo submitInfo;
 	// Synchronization semaphores
@@ -123,8 +187,51 @@ public:
 		bool fullscreen = false;
 		/** @brief Set to true if v-sync will be forced for the swapchain */
 		bool vsync = false;
+		/** @brief Number of job system worker threads (0 = one per hardware thread, minus the main thread) */
+		uint32_t workerCount = 0;
+		/** @brief Render into a ring of offscreen images instead of a window (no surface, swap chain or presentation) */
+		bool headless = false;
+		/** @brief Number of frames rendered before the render loop returns (0 = until the window is closed), measured frames of a benchmark run */
+		uint32_t frameLimit = 0;
+		/** @brief Run a fixed number of frames without input and write their timings to benchmarkOutput */
+		bool benchmark = false;
+		/** @brief Frames rendered before the benchmark starts measuring */
+		uint32_t benchmarkWarmup = 60;
+		std::string benchmarkOutput = "benchmark.json";
+		/** @brief Time the GPU scopes of the frame command buffers (always on for benchmark and trace runs) */
+		bool profile = false;
+		/** @brief Also count vertex/fragment shader invocations and clipping primitives of the outermost GPU scopes (enables the pipelineStatisticsQuery feature) */
+		bool pipelineStatistics = false;
+		/** @brief Record CPU and GPU scopes and write them as Chrome trace JSON to this file when the render loop ends (empty = off, needs VKS_TRACING) */
+		std::string traceOutput;
+		/** @brief Draw frame statistics (fps, CPU / GPU times, frame time graph, memory) over the frame */
+		bool overlay = false;
+		/** @brief Frame rate the render loop is paced to (0 = as fast as the present mode allows), see -targetfps and -framebudget */
+		double targetFrameRate = 0.0;
+		/** @brief Sample mouse input and write the camera matrices right before each frame's submission, with a bounded queue depth */
+		bool lowLatency = false;
+		/** @brief Frames that may be queued on the device in low latency mode, frame N is submitted after frame N - latencyFrames completed */
+		uint32_t latencyFrames = 1;
 	} settings;
 
+	/** @brief Estimated latency from sampling the input to the device completing the frame (low latency mode, 0 = no estimate yet) */
+	struct {
+		double lastMs = 0.0;
+		double averageMs = 0.0;
+	} inputLatency;
+
+	/** @brief Work stealing job system for fanning out per-frame work (created in the constructor, see -workers) */
+	std::unique_ptr<vks::JobSystem> jobSystem;
+
+	/** @brief Named GPU timestamp scopes, one query range per draw command buffer (enabled by -profile or -benchmark) */
+	vks::GpuProfiler gpuProfiler;
+
+	/** @brief Limits the render loop to settings.targetFrameRate (sleep and spin before each frame) and measures the pacing jitter */
+	vks::FramePacer framePacer;
+
+	/** @brief Frame statistics drawn at the end of the last render pass (enabled by -overlay, see drawTextOverlay()) */
+	vks::TextOverlay textOverlay;
+
 	VkClearColorValue defaultClearColor = { { 0.025f, 0.025f, 0.025f, 1.0f } };
 
 	float zoom = 0;
@@ -220,10 +327,19 @@ public:
 	/** @brief (Virtual) Called after the physical device features have been read, can be used to set features to enable on the device */
 	virtual void getEnabledFeatures();
 
+	/** @brief (Virtual) Called when the benchmark report is written, can be used to add the example's settings */
+	virtual void getBenchmarkMetadata(vks::BenchmarkReport &report);
+
 	// Connect and prepare the swap chain
 	void initSwapchain();
 	// Create swap chain images
 	void setupSwapChain();
+	// Create the offscreen image ring used instead of the swap chain in headless mode
+	void setupHeadlessTargets();
+	// Destroy the offscreen image ring and its views
+	void destroyHeadlessTargets();
+	/** @brief Layout the color attachment is left in at the end of a frame (present source, transfer source when headless) */
+	vk::ImageLayout presentLayout() const;
 
 	// Check if command buffers are valid (!= VK_NULL_HANDLE)
 	bool checkCommandBuffers();
@@ -252,10 +368,29 @@ public:
 	// Render one frame of a render loop on platforms that sync rendering
 	void renderFrame();
 
+	// Rebuild the text overlay content (once per second)
 	void updateTextOverlay();
 
 	/** @brief (Virtual) Called when the text overlay is updating, can be used to add custom text to the overlay */
-	//virtual void getOverlayText(VulkanTextOverlay*);
+	virtual void getOverlayText(vks::TextOverlay *textOverlay, float x, float &y);
+
+	/**
+	* Record the text overlay draw of a frame (does nothing if the overlay is disabled)
+	*
+	* @note Record last in the last subpass of the frame's final render pass, its frame's slice is updated after the frame's fence wait (textOverlay.update())
+	*/
+	void drawTextOverlay(vk::CommandBuffer cmdBuffer, uint32_t frame, vk::RenderPass renderPass);
+
+	/**
+	* Low latency mode: wait until the queue depth allows the current frame's submission, then sample the mouse input
+	*
+	* @note Call right before the frame's matrices are written and submitted, after its slot's fence has been waited on
+	*/
+	void beginLateUpdate(uint32_t frame);
+	/** @brief Low latency mode: command buffer to submit after the frame's command buffers in the same batch (may be null) */
+	vk::CommandBuffer latencyCommandBuffer(uint32_t frame);
+	/** @brief Low latency mode: the frame's batch has been submitted to the queue */
+	void endLateUpdate();
 
 	// Prepare the frame for workload submission
 	// - Acquires the next image from the swap chain 
@@ -263,7 +398,6 @@ public:
 	void prepareFrame();
 
 	// Submit the frames' workload 
-	// - Submits the text overlay (if enabled)
 	void submitFrame();
 
 };
@@ -284,8 +418,11 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int)									\
 	for (int32_t i = 0; i < __argc; i++) { VulkanExample::args.push_back(__argv[i]); };  			\
 	vulkanExample = new VulkanExample();															\
 	vulkanExample->initVulkan();																	\
-	vulkanExample->setupWindow(hInstance, WndProc);													\
-	vulkanExample->initSwapchain();																	\
+	if (!vulkanExample->settings.headless)															\
+	{																								\
+		vulkanExample->setupWindow(hInstance, WndProc);												\
+		vulkanExample->initSwapchain();																\
+	}																								\
 	vulkanExample->prepare();																		\
 	vulkanExample->renderLoop();																	\
 	delete(vulkanExample);																			\
@@ -0,0 +1,198 @@
+#pragma once
+
+/*
+* Vulkan debug markers
+*
+* Object names and command buffer labels for capture tools (RenderDoc, Nsight, ...) and validation messages.
+* Uses VK_EXT_debug_utils if it has been enabled on the instance (and the headers know it), else VK_EXT_debug_marker
+* if it has been enabled on the device (which is usually only exposed while a capture tool is attached).
+* Without either every function returns after checking a flag.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+	namespace debugmarker
+	{
+		struct Functions
+		{
+			/** @brief Names and labels are passed to one of the extensions */
+			bool active = false;
+			/** @brief VK_EXT_debug_utils is used (else VK_EXT_debug_marker) */
+			bool debugUtils = false;
+			PFN_vkDebugMarkerSetObjectNameEXT setObjectName = nullptr;
+			PFN_vkCmdDebugMarkerBeginEXT cmdBegin = nullptr;
+			PFN_vkCmdDebugMarkerEndEXT cmdEnd = nullptr;
+			PFN_vkCmdDebugMarkerInsertEXT cmdInsert = nullptr;
+#if defined(VK_EXT_debug_utils)
+			PFN_vkSetDebugUtilsObjectNameEXT setUtilsObjectName = nullptr;
+			PFN_vkCmdBeginDebugUtilsLabelEXT cmdBeginLabel = nullptr;
+			PFN_vkCmdEndDebugUtilsLabelEXT cmdEndLabel = nullptr;
+			PFN_vkCmdInsertDebugUtilsLabelEXT cmdInsertLabel = nullptr;
+#endif
+		};
+
+		inline Functions& functions()
+		{
+			static Functions instance;
+			return instance;
+		}
+
+		inline bool active()
+		{
+			return functions().active;
+		}
+
+		/**
+		* Load the function pointers of the extension that is used
+		*
+		* @param instance Instance, VK_EXT_debug_utils is used if debugUtils is set
+		* @param device Logical device, VK_EXT_debug_marker is used if debugMarker is set (and debug utils isn't)
+		* @param debugUtils VK_EXT_debug_utils has been enabled on the instance
+		* @param debugMarker VK_EXT_debug_marker has been enabled on the device
+		*/
+		inline void setup(VkInstance instance, VkDevice device, bool debugUtils, bool debugMarker)
+		{
+			Functions &f = functions();
+			f = Functions();
+#if defined(VK_EXT_debug_utils)
+			if (debugUtils)
+			{
+				f.setUtilsObjectName = reinterpret_cast<PFN_vkSetDebugUtilsObjectNameEXT>(vkGetInstanceProcAddr(instance, "vkSetDebugUtilsObjectNameEXT"));
+				f.cmdBeginLabel = reinterpret_cast<PFN_vkCmdBeginDebugUtilsLabelEXT>(vkGetInstanceProcAddr(instance, "vkCmdBeginDebugUtilsLabelEXT"));
+				f.cmdEndLabel = reinterpret_cast<PFN_vkCmdEndDebugUtilsLabelEXT>(vkGetInstanceProcAddr(instance, "vkCmdEndDebugUtilsLabelEXT"));
+				f.cmdInsertLabel = reinterpret_cast<PFN_vkCmdInsertDebugUtilsLabelEXT>(vkGetInstanceProcAddr(instance, "vkCmdInsertDebugUtilsLabelEXT"));
+				f.debugUtils = (f.setUtilsObjectName != nullptr) && (f.cmdBeginLabel != nullptr) && (f.cmdEndLabel != nullptr) && (f.cmdInsertLabel != nullptr);
+				f.active = f.debugUtils;
+			}
+#endif
+			if ((!f.active) && (debugMarker))
+			{
+				f.setObjectName = reinterpret_cast<PFN_vkDebugMarkerSetObjectNameEXT>(vkGetDeviceProcAddr(device, "vkDebugMarkerSetObjectNameEXT"));
+				f.cmdBegin = reinterpret_cast<PFN_vkCmdDebugMarkerBeginEXT>(vkGetDeviceProcAddr(device, "vkCmdDebugMarkerBeginEXT"));
+				f.cmdEnd = reinterpret_cast<PFN_vkCmdDebugMarkerEndEXT>(vkGetDeviceProcAddr(device, "vkCmdDebugMarkerEndEXT"));
+				f.cmdInsert = reinterpret_cast<PFN_vkCmdDebugMarkerInsertEXT>(vkGetDeviceProcAddr(device, "vkCmdDebugMarkerInsertEXT"));
+				f.active = (f.setObjectName != nullptr) && (f.cmdBegin != nullptr) && (f.cmdEnd != nullptr) && (f.cmdInsert != nullptr);
+			}
+		}
+
+		/**
+		* Name an object
+		*
+		* @param object Handle of the object (cast to uint64_t)
+		* @param objectType Type of the object, the core values are the same for VkObjectType of debug utils
+		*/
+		inline void setObjectName(VkDevice device, uint64_t object, VkDebugReportObjectTypeEXT objectType, const char* name)
+		{
+			const Functions &f = functions();
+			if (!f.active)
+			{
+				return;
+			}
+#if defined(VK_EXT_debug_utils)
+			if (f.debugUtils)
+			{
+				VkDebugUtilsObjectNameInfoEXT nameInfo = {};
+				nameInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT;
+				nameInfo.objectType = static_cast<VkObjectType>(objectType);
+				nameInfo.objectHandle = object;
+				nameInfo.pObjectName = name;
+				f.setUtilsObjectName(device, &nameInfo);
+				return;
+			}
+#endif
+			VkDebugMarkerObjectNameInfoEXT nameInfo = {};
+			nameInfo.sType = VK_STRUCTURE_TYPE_DEBUG_MARKER_OBJECT_NAME_INFO_EXT;
+			nameInfo.objectType = objectType;
+			nameInfo.object = object;
+			nameInfo.pObjectName = name;
+			f.setObjectName(device, &nameInfo);
+		}
+
+		/** @brief Open a label region, regions nest and must be closed in the same command buffer */
+		inline void beginRegion(VkCommandBuffer cmdBuffer, const char* name)
+		{
+			const Functions &f = functions();
+			if (!f.active)
+			{
+				return;
+			}
+#if defined(VK_EXT_debug_utils)
+			if (f.debugUtils)
+			{
+				VkDebugUtilsLabelEXT label = {};
+				label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+				label.pLabelName = name;
+				f.cmdBeginLabel(cmdBuffer, &label);
+				return;
+			}
+#endif
+			VkDebugMarkerMarkerInfoEXT markerInfo = {};
+			markerInfo.sType = VK_STRUCTURE_TYPE_DEBUG_MARKER_MARKER_INFO_EXT;
+			markerInfo.pMarkerName = name;
+			f.cmdBegin(cmdBuffer, &markerInfo);
+		}
+
+		inline void endRegion(VkCommandBuffer cmdBuffer)
+		{
+			const Functions &f = functions();
+			if (!f.active)
+			{
+				return;
+			}
+#if defined(VK_EXT_debug_utils)
+			if (f.debugUtils)
+			{
+				f.cmdEndLabel(cmdBuffer);
+				return;
+			}
+#endif
+			f.cmdEnd(cmdBuffer);
+		}
+
+		/** @brief Single label at the current position of the command buffer */
+		inline void insert(VkCommandBuffer cmdBuffer, const char* name)
+		{
+			const Functions &f = functions();
+			if (!f.active)
+			{
+				return;
+			}
+#if defined(VK_EXT_debug_utils)
+			if (f.debugUtils)
+			{
+				VkDebugUtilsLabelEXT label = {};
+				label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+				label.pLabelName = name;
+				f.cmdInsertLabel(cmdBuffer, &label);
+				return;
+			}
+#endif
+			VkDebugMarkerMarkerInfoEXT markerInfo = {};
+			markerInfo.sType = VK_STRUCTURE_TYPE_DEBUG_MARKER_MARKER_INFO_EXT;
+			markerInfo.pMarkerName = name;
+			f.cmdInsert(cmdBuffer, &markerInfo);
+		}
+
+		/** @brief Label region for the lifetime of the object */
+		class Region
+		{
+		public:
+			Region(VkCommandBuffer cmdBuffer, const char* name) : cmdBuffer(cmdBuffer)
+			{
+				beginRegion(cmdBuffer, name);
+			}
+			~Region()
+			{
+				endRegion(cmdBuffer);
+			}
+		private:
+			VkCommandBuffer cmdBuffer;
+		};
+	}
+}
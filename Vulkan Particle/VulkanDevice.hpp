@@ -15,11 +15,13 @@
 #include <exception>
 #include <assert.h>
 #include <algorithm>
+#include <string>
 #include "vulkan/vulkan.h"
 #include <vulkan/vulkan.hpp>
 #include "vksTools.h"
 #include "VulkanBuffer.hpp"
 #include "VulkanInitializers.h"
+#include "VulkanDebugMarker.hpp"
 
 namespace vks
 {
@@ -42,12 +44,16 @@ namespace vks
 		std::vector<vk::QueueFamilyProperties> queueFamilyProperties;
 		/** @brief List of extensions supported by the device */
 		std::vector<std::string> supportedExtensions;
+		/** @brief List of extensions enabled at logical device creation */
+		std::vector<std::string> enabledExtensions;
 
 		/** @brief Default command pool for the graphics queue family index */
 		VkCommandPool commandPool = VK_NULL_HANDLE;
 
 		/** @brief Set to true when the debug marker extension is detected */
 		bool enableDebugMarkers = false;
+		/** @brief Objects named automatically so far, numbers the generated names */
+		uint32_t debugNameCount = 0;
 
 		/** @brief Contains queue family indices */
 		struct
@@ -160,7 +166,7 @@ namespace vks
 			{
 				for (uint32_t i = 0; i < static_cast<uint32_t>(queueFamilyProperties.size()); i++)
 				{
-					if ((queueFamilyProperties[i].queueFlags & queueFlags) && ((queueFamilyProperties[i].queueFlags & vk::QueueFlagBits::eGraphics) /*== 0*/))
+					if ((queueFamilyProperties[i].queueFlags & queueFlags) && !(queueFamilyProperties[i].queueFlags & vk::QueueFlagBits::eGraphics))
 					{ 
 						return i;
 						break;
@@ -175,8 +181,8 @@ namespace vks
 				for (uint32_t i = 0; i < static_cast<uint32_t>(queueFamilyProperties.size()); i++)
 				{
 					if ((queueFamilyProperties[i].queueFlags & queueFlags) && 
-						((queueFamilyProperties[i].queueFlags & vk::QueueFlagBits::eGraphics) /*== 0*/) && 
-						((queueFamilyProperties[i].queueFlags & vk::QueueFlagBits::eCompute) /*== 0*/))
+						!(queueFamilyProperties[i].queueFlags & vk::QueueFlagBits::eGraphics) && 
+						!(queueFamilyProperties[i].queueFlags & vk::QueueFlagBits::eCompute))
 					{
 						return i;
 						break;
@@ -287,6 +293,7 @@ namespace vks
 			}
 
 			ownDevice = CHECK(physicalDevice.createDevice (deviceCreateInfo, nullptr));
+			this->enabledExtensions.assign(deviceExtensions.begin(), deviceExtensions.end());
 
 			// Create a default command pool for graphics command buffers
 			commandPool = createCommandPool(queueFamilyIndices.graphics);
@@ -349,6 +356,11 @@ namespace vks
 
 			VK_CHECK_RESULT(ownDevice.bindBufferMemory (buffer, memory, 0));
 			// Attach the memory to the buffer object
+			// Naming returns early without a debug extension, the check only skips building the name
+			if (vks::debugmarker::active())
+			{
+				setBufferName(buffer, bufferName((VkBufferUsageFlags)usageFlags, size));
+			}
 
 			return BuffMem{ buffer, memory };
 		}
@@ -396,11 +408,46 @@ namespace vks
 
 			// Initialize a default descriptor that covers the whole buffer size
 			buffer->setupDescriptor();
+			if (vks::debugmarker::active())
+			{
+				setBufferName(buffer->buffer, bufferName(usageFlags, size));
+			}
 
 			// Attach the memory to the buffer object
 			return buffer->bind();
 		}
 
+		/**
+		* Create a device local buffer and fill it with data through a temporary staging buffer
+		*
+		* @param usageFlags Usage flag bitmask for the buffer (transfer destination is added)
+		* @param buffer Pointer to a vk::Vulkan buffer object
+		* @param size Size of the buffer in byes
+		* @param data Pointer to the data that should be copied to the buffer
+		* @param queue Queue used for the copy (waits for completion)
+		*
+		* @return VK_SUCCESS if buffer handle and memory have been created and the data has been copied
+		*/
+		VkResult createDeviceLocalBuffer(VkBufferUsageFlags usageFlags, vks::Buffer *buffer, VkDeviceSize size, void *data, VkQueue queue)
+		{
+			vks::Buffer staging;
+			VK_CHECK_RESULT(createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, &staging, size, data));
+			VkResult result = createBuffer(usageFlags | VK_BUFFER_USAGE_TRANSFER_DST_BIT, vk::MemoryPropertyFlagBits::eDeviceLocal, buffer, size);
+			if (result != VK_SUCCESS)
+			{
+				// Nothing to copy to, the caller gets the error
+				staging.destroy();
+				return result;
+			}
+			// Only copy the data size, allocation sizes of the two buffers may differ
+			VkBufferCopy copyRegion = {};
+			copyRegion.size = size;
+			copyBuffer(&staging, buffer, queue, &copyRegion);
+			staging.destroy();
+			return result;
+		}
+
 		/**
 		* Copy buffer data from src to dst using VkCmdCopyBuffer
 		*
@@ -469,6 +516,10 @@ namespace vks
 
 			vk::CommandBuffer cmdBuffer;
 			VK_CHECK_RESULT(ownDevice.allocateCommandBuffers (&cmdBufAllocateInfo, &cmdBuffer));
+			if (vks::debugmarker::active())
+			{
+				setCommandBufferName(cmdBuffer, "command buffer #" + std::to_string(debugNameCount++));
+			}
 
 			// If requested, also start recording for the new command buffer
 			if (begin)
@@ -521,6 +572,63 @@ namespace vks
 			}
 		}
 
+		/**
+		* Create an image
+		*
+		* @param imageCreateInfo Creation parameters
+		* @param image Pointer to the image handle acquired by the function
+		* @param name Name shown by debugging tools
+		*
+		* @return VkResult of the image creation call
+		*/
+		VkResult createImage(const VkImageCreateInfo *imageCreateInfo, VkImage *image, const std::string &name)
+		{
+			VkResult result = vkCreateImage(logicalDevice, imageCreateInfo, nullptr, image);
+			if (result == VK_SUCCESS)
+			{
+				setImageName(*image, name);
+			}
+			return result;
+		}
+
+		/**
+		* Create a graphics pipeline
+		*
+		* @param pipelineCache Pipeline cache to use
+		* @param pipelineCreateInfo Creation parameters
+		* @param name Name shown by debugging tools
+		*/
+		vk::Pipeline createGraphicsPipeline(vk::PipelineCache pipelineCache, const vk::GraphicsPipelineCreateInfo &pipelineCreateInfo, const std::string &name)
+		{
+			vk::Pipeline pipeline = CHECK(ownDevice.createGraphicsPipeline (pipelineCache, pipelineCreateInfo));
+			setPipelineName(pipeline, name);
+			return pipeline;
+		}
+
+		/** @brief Name a buffer for debugging tools (no-op without an active debug marker extension, see VulkanDebugMarker.hpp) */
+		void setBufferName(vk::Buffer buffer, const std::string &name)
+		{
+			vks::debugmarker::setObjectName(logicalDevice, (uint64_t)static_cast<VkBuffer>(buffer), VK_DEBUG_REPORT_OBJECT_TYPE_BUFFER_EXT, name.c_str());
+		}
+
+		/** @brief Name an image for debugging tools */
+		void setImageName(vk::Image image, const std::string &name)
+		{
+			vks::debugmarker::setObjectName(logicalDevice, (uint64_t)static_cast<VkImage>(image), VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT, name.c_str());
+		}
+
+		/** @brief Name a pipeline for debugging tools */
+		void setPipelineName(vk::Pipeline pipeline, const std::string &name)
+		{
+			vks::debugmarker::setObjectName(logicalDevice, (uint64_t)static_cast<VkPipeline>(pipeline), VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT, name.c_str());
+		}
+
+		/** @brief Name a command buffer for debugging tools */
+		void setCommandBufferName(vk::CommandBuffer cmdBuffer, const std::string &name)
+		{
+			vks::debugmarker::setObjectName(logicalDevice, (uint64_t)static_cast<VkCommandBuffer>(cmdBuffer), VK_DEBUG_REPORT_OBJECT_TYPE_COMMAND_BUFFER_EXT, name.c_str());
+		}
+
 		/**
 		* Check if an extension is supported by the (physical device)
 		*
@@ -533,5 +641,43 @@ namespace vks
 			return (std::find(supportedExtensions.begin(), supportedExtensions.end(), extension) != supportedExtensions.end());
 		}
 
+		/**
+		* Check if an extension has been enabled on the logical device
+		*
+		* @param extension Name of the extension to check
+		*
+		* @return True if the extension was passed to the logical device creation
+		*/
+		bool extensionEnabled(std::string extension)
+		{
+			return (std::find(enabledExtensions.begin(), enabledExtensions.end(), extension) != enabledExtensions.end());
+		}
+
+	private:
+		// Generated buffer name, e.g. "vertex storage buffer #3 (65536 bytes)"
+		std::string bufferName(VkBufferUsageFlags usageFlags, VkDeviceSize size)
+		{
+			const std::pair<VkBufferUsageFlagBits, const char*> usages[] = {
+				{ VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, "vertex" },
+				{ VK_BUFFER_USAGE_INDEX_BUFFER_BIT, "index" },
+				{ VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, "indirect" },
+				{ VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, "uniform" },
+				{ VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, "storage" },
+			};
+			std::string name;
+			for (auto& usage : usages)
+			{
+				if (usageFlags & usage.first)
+				{
+					name += std::string(usage.second) + " ";
+				}
+			}
+			if (name.empty())
+			{
+				name = (usageFlags & VK_BUFFER_USAGE_TRANSFER_SRC_BIT) ? "staging " : "";
+			}
+			return name + "buffer #" + std::to_string(debugNameCount++) + " (" + std::to_string(size) + " bytes)";
+		}
+
 	};
 }
@@ -0,0 +1,389 @@
+#pragma once
+
+/*
+* Vulkan frustum culling class
+*
+* Compute pass that tests per-object bounding spheres against the view frustum and compacts
+* the visible objects into indirect draw records and a draw count (no host read back)
+* A host reference implementation can be used to validate the device results
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <cfloat>
+
+#include "vulkan/vulkan.h"
+#include <vulkan/vulkan.hpp>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include "vksTools.h"
+#include "VulkanBuffer.hpp"
+#include "VulkanDevice.hpp"
+#include "VulkanInitializers.h"
+#include "VulkanIndirectDraw.hpp"
+
+namespace vks
+{
+	/** @brief View frustum as six normalized planes (xyz = normal pointing inwards, w = distance) */
+	struct Frustum
+	{
+		enum side { LEFT = 0, RIGHT = 1, BOTTOM = 2, TOP = 3, FRONT = 4, BACK = 5 };
+		std::array<glm::vec4, 6> planes;
+
+		/**
+		* Extract the planes from a (model) view projection matrix
+		*
+		* @note Assumes a [0..1] clip space depth range (GLM_FORCE_DEPTH_ZERO_TO_ONE), planes are in the space the matrix transforms from
+		*/
+		void update(const glm::mat4 &matrix)
+		{
+			const glm::vec4 row0(matrix[0].x, matrix[1].x, matrix[2].x, matrix[3].x);
+			const glm::vec4 row1(matrix[0].y, matrix[1].y, matrix[2].y, matrix[3].y);
+			const glm::vec4 row2(matrix[0].z, matrix[1].z, matrix[2].z, matrix[3].z);
+			const glm::vec4 row3(matrix[0].w, matrix[1].w, matrix[2].w, matrix[3].w);
+
+			planes[LEFT] = row3 + row0;
+			planes[RIGHT] = row3 - row0;
+			planes[BOTTOM] = row3 + row1;
+			planes[TOP] = row3 - row1;
+			planes[FRONT] = row2;
+			planes[BACK] = row3 - row2;
+
+			for (auto& plane : planes)
+			{
+				plane /= glm::length(glm::vec3(plane));
+			}
+		}
+
+		/**
+		* Distance of a sphere to the frustum (negative if the sphere is fully outside of at least one plane)
+		*
+		* @param sphere xyz = center, w = radius
+		*/
+		float sphereDistance(const glm::vec4 &sphere) const
+		{
+			float minDistance = FLT_MAX;
+			for (auto& plane : planes)
+			{
+				minDistance = std::min(minDistance, glm::dot(glm::vec3(plane), glm::vec3(sphere)) + plane.w + sphere.w);
+			}
+			return minDistance;
+		}
+
+		bool sphereVisible(const glm::vec4 &sphere) const
+		{
+			return sphereDistance(sphere) >= 0.0f;
+		}
+	};
+
+	/** @brief Per-object culling data, layout matches the std430 ObjectData struct of the culling shader */
+	struct CullObject
+	{
+		/** @brief xyz = center, w = radius, in the same space as the frustum */
+		glm::vec4 sphere;
+		/** @brief Index of the mesh in the mesh arena */
+		uint32_t mesh;
+		uint32_t pad[3];
+	};
+
+	/**
+	* @brief Compute shader frustum culling writing compacted indirect draw records
+	*
+	* Records a reset of the draw count, the culling dispatch and the barrier to the indirect draw into a command buffer.
+	* Each visible object gets one draw record with firstInstance set to the object index.
+	*/
+	struct FrustumCulling
+	{
+		/** @brief Must match local_size_x of cull_frustum.comp */
+		static const uint32_t workgroupSize = 64;
+
+		vks::VulkanDevice *device = nullptr;
+		/** @brief Output draw records and count (device local, one region per command buffer) */
+		vks::IndirectDrawBuffer *output = nullptr;
+
+		vks::Buffer objectBuffer;
+		vks::Buffer meshBuffer;
+		vks::Buffer paramsBuffer;
+
+		/** @brief Layout matches the culling shader's uniform block (std140) */
+		struct Params
+		{
+			glm::vec4 planes[6];
+			uint32_t objectCount;
+			uint32_t pad[3];
+		};
+
+		vk::DescriptorSetLayout descriptorSetLayout;
+		vk::PipelineLayout pipelineLayout;
+		vk::Pipeline pipeline;
+		vk::DescriptorPool descriptorPool;
+		/** @brief One descriptor set per output region */
+		std::vector<vk::DescriptorSet> descriptorSets;
+
+		/** @brief Host copies for the reference implementation */
+		std::vector<CullObject> objects;
+		std::vector<MeshRange> meshes;
+		Frustum frustum;
+
+		/**
+		* Create buffers, descriptors and the compute pipeline
+		*
+		* @param device Device to create the resources on
+		* @param queue Queue used for the initial uploads
+		* @param pipelineCache Pipeline cache to use
+		* @param meshArena Meshes referenced by the objects
+		* @param objects Bounding spheres and meshes of all objects
+		* @param output Device local indirect draw buffer receiving the visible objects, one region per command buffer
+		*/
+		void prepare(vks::VulkanDevice *device, VkQueue queue, vk::PipelineCache pipelineCache, const vks::MeshArena &meshArena,
+			const std::vector<CullObject> &objects, vks::IndirectDrawBuffer *output)
+		{
+			this->device = device;
+			this->output = output;
+			this->objects = objects;
+			this->meshes = meshArena.meshes;
+			assert(!output->hostAccess && output->maxDrawCount >= objects.size());
+
+			// Static object and mesh data
+			VK_CHECK_RESULT(device->createDeviceLocalBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &objectBuffer,
+				objects.size() * sizeof(CullObject), (void*)objects.data(), queue));
+			// Draw record templates, matches the std430 MeshData struct of the culling shader
+			std::vector<uint32_t> meshData;
+			for (auto& mesh : meshes)
+			{
+				meshData.insert(meshData.end(), { mesh.indexCount, mesh.firstIndex, static_cast<uint32_t>(mesh.vertexOffset), 0 });
+			}
+			VK_CHECK_RESULT(device->createDeviceLocalBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &meshBuffer,
+				meshData.size() * sizeof(uint32_t), meshData.data(), queue));
+
+			// Frustum planes are updated by the host whenever the view changes
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, &paramsBuffer, sizeof(Params)));
+			VK_CHECK_RESULT(paramsBuffer.map());
+
+			// Binding 0 : Frustum planes and object count
+			// Binding 1 : Objects (bounding sphere, mesh)
+			// Binding 2 : Meshes (draw record templates)
+			// Binding 3 : Output draw records
+			// Binding 4 : Output draw count
+			std::array<vk::DescriptorSetLayoutBinding, 5> setLayoutBindings;
+			for (uint32_t i = 0; i < setLayoutBindings.size(); i++)
+			{
+				setLayoutBindings[i].setBinding (i)
+					.setDescriptorType ((i == 0) ? vk::DescriptorType::eUniformBuffer : vk::DescriptorType::eStorageBuffer)
+					.setDescriptorCount (1)
+					.setStageFlags (vk::ShaderStageFlagBits::eCompute);
+			}
+			vk::DescriptorSetLayoutCreateInfo descriptorLayout;
+			descriptorLayout.setBindingCount (static_cast<uint32_t>(setLayoutBindings.size()))
+				.setPBindings (setLayoutBindings.data());
+			descriptorSetLayout = CHECK(device->D().createDescriptorSetLayout (descriptorLayout));
+
+			vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo;
+			pipelineLayoutCreateInfo.setSetLayoutCount (1)
+				.setPSetLayouts (&descriptorSetLayout);
+			pipelineLayout = CHECK(device->D().createPipelineLayout (pipelineLayoutCreateInfo));
+
+			pipeline = vks::tools::createComputePipeline(device->D(), pipelineCache, pipelineLayout, "shaders/cull_frustum.comp.spv");
+
+			const uint32_t regionCount = output->regionCount;
+			std::array<vk::DescriptorPoolSize, 2> poolSizes;
+			poolSizes[0].setType (vk::DescriptorType::eUniformBuffer).setDescriptorCount (regionCount);
+			poolSizes[1].setType (vk::DescriptorType::eStorageBuffer).setDescriptorCount (4 * regionCount);
+			vk::DescriptorPoolCreateInfo descriptorPoolInfo;
+			descriptorPoolInfo.setPoolSizeCount (static_cast<uint32_t>(poolSizes.size()))
+				.setPPoolSizes (poolSizes.data())
+				.setMaxSets (regionCount);
+			descriptorPool = CHECK(device->D().createDescriptorPool (descriptorPoolInfo));
+
+			std::vector<vk::DescriptorSetLayout> setLayouts(regionCount, descriptorSetLayout);
+			vk::DescriptorSetAllocateInfo allocInfo;
+			allocInfo.setDescriptorPool (descriptorPool)
+				.setDescriptorSetCount (regionCount)
+				.setPSetLayouts (setLayouts.data());
+			descriptorSets = CHECK(device->D().allocateDescriptorSets (allocInfo));
+
+			for (uint32_t region = 0; region < regionCount; region++)
+			{
+				std::array<vk::DescriptorBufferInfo, 5> bufferInfos = {
+					vk::DescriptorBufferInfo(paramsBuffer.buffer, 0, sizeof(Params)),
+					vk::DescriptorBufferInfo(objectBuffer.buffer, 0, VK_WHOLE_SIZE),
+					vk::DescriptorBufferInfo(meshBuffer.buffer, 0, VK_WHOLE_SIZE),
+					vk::DescriptorBufferInfo(output->commands.buffer, output->regionOffset(region), output->regionSize()),
+					vk::DescriptorBufferInfo(output->count.buffer, output->countOffset(region), sizeof(uint32_t))
+				};
+				std::array<vk::WriteDescriptorSet, 5> writeDescriptorSets;
+				for (uint32_t i = 0; i < writeDescriptorSets.size(); i++)
+				{
+					writeDescriptorSets[i].setDstSet (descriptorSets[region])
+						.setDstBinding (i)
+						.setDescriptorCount (1)
+						.setDescriptorType (setLayoutBindings[i].descriptorType)
+						.setPBufferInfo (&bufferInfos[i]);
+				}
+				device->D().updateDescriptorSets (writeDescriptorSets, {});
+			}
+		}
+
+		void destroy()
+		{
+			if (!device)
+			{
+				return;
+			}
+			device->D().destroyPipeline (pipeline);
+			device->D().destroyPipelineLayout (pipelineLayout);
+			device->D().destroyDescriptorSetLayout (descriptorSetLayout);
+			device->D().destroyDescriptorPool (descriptorPool);
+			paramsBuffer.unmap();
+			paramsBuffer.destroy();
+			objectBuffer.destroy();
+			meshBuffer.destroy();
+		}
+
+		/**
+		* Update the frustum used by the next culling passes
+		*
+		* @param matrix Matrix transforming the object bounding spheres to clip space (e.g. projection * view * model)
+		*/
+		void updateFrustum(const glm::mat4 &matrix)
+		{
+			frustum.update(matrix);
+			Params *params = static_cast<Params*>(paramsBuffer.mapped);
+			std::copy(frustum.planes.begin(), frustum.planes.end(), params->planes);
+			params->objectCount = static_cast<uint32_t>(objects.size());
+		}
+
+		/**
+		* Record the culling pass for one output region
+		*
+		* @note Must be recorded outside of a render pass, the output can be consumed by indirect draws afterwards
+		*/
+		void buildCommandBuffer(vk::CommandBuffer cmdBuffer, uint32_t region)
+		{
+			// Reset the draw count
+			// Without the draw count extension all records are submitted, so all of them need to be reset (instance count of zero)
+			if (!output->drawIndexedIndirectCount)
+			{
+				cmdBuffer.fillBuffer (output->commands.buffer, output->regionOffset(region), output->regionSize(), 0);
+			}
+			cmdBuffer.fillBuffer (output->count.buffer, output->countOffset(region), output->countRegionSize(), 0);
+
+			std::array<vk::BufferMemoryBarrier, 2> resetBarriers = {
+				vks::initializers::bufferBarrier(output->commands.buffer, vk::AccessFlagBits::eTransferWrite,
+					vk::AccessFlagBits::eShaderWrite, output->regionOffset(region), output->regionSize()),
+				vks::initializers::bufferBarrier(output->count.buffer, vk::AccessFlagBits::eTransferWrite,
+					vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite, output->countOffset(region), output->countRegionSize())
+			};
+			cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eDrawIndirect, vk::PipelineStageFlagBits::eComputeShader,
+				vk::DependencyFlags(), nullptr, resetBarriers, nullptr);
+
+			cmdBuffer.bindPipeline (vk::PipelineBindPoint::eCompute, pipeline);
+			cmdBuffer.bindDescriptorSets (vk::PipelineBindPoint::eCompute, pipelineLayout, 0, descriptorSets[region], {});
+			cmdBuffer.dispatch ((static_cast<uint32_t>(objects.size()) + workgroupSize - 1) / workgroupSize, 1, 1);
+
+			// Make the compacted draw records and the count visible to the indirect draw
+			std::array<vk::BufferMemoryBarrier, 2> drawBarriers = {
+				vks::initializers::bufferBarrier(output->commands.buffer, vk::AccessFlagBits::eShaderWrite,
+					vk::AccessFlagBits::eIndirectCommandRead, output->regionOffset(region), output->regionSize()),
+				vks::initializers::bufferBarrier(output->count.buffer, vk::AccessFlagBits::eShaderWrite,
+					vk::AccessFlagBits::eIndirectCommandRead, output->countOffset(region), output->countRegionSize())
+			};
+			cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eDrawIndirect,
+				vk::DependencyFlags(), nullptr, drawBarriers, nullptr);
+		}
+
+		/**
+		* Host reference implementation of the culling pass
+		*
+		* @param visible Receives the indices of all visible objects (sorted)
+		* @param borderline (Optional) Receives the indices of objects that touch a frustum plane within epsilon, these may legitimately differ between host and device
+		*/
+		void cullReference(std::vector<uint32_t> &visible, std::vector<uint32_t> *borderline = nullptr, float epsilon = 1.0e-4f) const
+		{
+			visible.clear();
+			for (uint32_t i = 0; i < static_cast<uint32_t>(objects.size()); i++)
+			{
+				float distance = frustum.sphereDistance(objects[i].sphere);
+				if (distance >= 0.0f)
+				{
+					visible.push_back(i);
+				}
+				if ((borderline) && (std::abs(distance) < epsilon))
+				{
+					borderline->push_back(i);
+				}
+			}
+		}
+
+		/**
+		* Run the culling pass for a region, read back its result and compare it with the host reference
+		*
+		* @note Stalls the queue, for debugging and testing only
+		*
+		* @return True if host and device agree on all objects not touching a frustum plane
+		*/
+		bool validate(VkQueue queue, uint32_t region)
+		{
+			VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+
+			const VkDeviceSize countSize = 16;
+			vks::Buffer readback;
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, &readback, countSize + output->regionSize()));
+
+			vk::CommandBuffer cmdBuffer = device->createCommandBuffer(vk::CommandBufferLevel::ePrimary, true);
+			buildCommandBuffer(cmdBuffer, region);
+			std::array<vk::BufferMemoryBarrier, 2> copyBarriers = {
+				vks::initializers::bufferBarrier(output->commands.buffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eTransferRead),
+				vks::initializers::bufferBarrier(output->count.buffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eTransferRead)
+			};
+			cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eDrawIndirect, vk::PipelineStageFlagBits::eTransfer,
+				vk::DependencyFlags(), nullptr, copyBarriers, nullptr);
+			cmdBuffer.copyBuffer (output->count.buffer, readback.buffer, vk::BufferCopy(output->countOffset(region), 0, sizeof(uint32_t)));
+			cmdBuffer.copyBuffer (output->commands.buffer, readback.buffer, vk::BufferCopy(output->regionOffset(region), countSize, output->regionSize()));
+			device->flushCommandBuffer(cmdBuffer, queue);
+
+			VK_CHECK_RESULT(readback.map());
+			const uint32_t drawCount = *static_cast<uint32_t*>(readback.mapped);
+			const VkDrawIndexedIndirectCommand *records = reinterpret_cast<const VkDrawIndexedIndirectCommand*>(static_cast<uint8_t*>(readback.mapped) + countSize);
+			std::vector<uint32_t> deviceVisible;
+			for (uint32_t i = 0; i < std::min(drawCount, output->maxDrawCount); i++)
+			{
+				deviceVisible.push_back(records[i].firstInstance);
+			}
+			readback.unmap();
+			readback.destroy();
+			std::sort(deviceVisible.begin(), deviceVisible.end());
+
+			std::vector<uint32_t> hostVisible, borderline;
+			cullReference(hostVisible, &borderline);
+
+			// Objects classified differently by host and device
+			std::vector<uint32_t> mismatches;
+			std::set_symmetric_difference(hostVisible.begin(), hostVisible.end(), deviceVisible.begin(), deviceVisible.end(), std::back_inserter(mismatches));
+			uint32_t errors = 0;
+			for (auto index : mismatches)
+			{
+				if (std::find(borderline.begin(), borderline.end(), index) == borderline.end())
+				{
+					errors++;
+				}
+			}
+
+			std::cout << "Frustum culling validation: device " << deviceVisible.size() << " visible, host " << hostVisible.size()
+				<< " visible, " << errors << " mismatches (" << (mismatches.size() - errors) << " borderline) of " << objects.size() << " objects" << std::endl;
+			return errors == 0;
+		}
+	};
+}
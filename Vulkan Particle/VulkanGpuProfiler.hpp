@@ -0,0 +1,570 @@
+#pragma once
+
+/*
+* Vulkan GPU profiler
+*
+* Named scopes write a pair of timestamps into the query range of the frame (command buffer) they are recorded in.
+* A frame's results are read once its fence has been waited on before the command buffer is used again, so
+* resolving never stalls and lags the recording by the number of frames in flight.
+*
+* Optionally, outermost scopes also count vertex shader invocations, primitives output by clipping and fragment shader
+* invocations with a pipeline statistics query (needs the pipelineStatisticsQuery feature).
+*
+* Every scope is also a command buffer label region, so capture tools show the same structure (see VulkanDebugMarker.hpp).
+*
+* While a trace is recorded (vksTrace.h), resolved scopes are also added as GPU trace events. Their timestamps are moved
+* to the CPU time base with a calibration taken by calibrate(): from VK_EXT_calibrated_timestamps if the device has it
+* enabled (renewed every few hundred frames against clock drift), else from a timestamp written by an otherwise idle queue
+* (accurate to about half the submit round trip).
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include <vulkan/vulkan.hpp>
+
+#include "vksTools.h"
+#include "VulkanDevice.hpp"
+#include "VulkanDebugMarker.hpp"
+#include "vksBenchmark.h"
+#include "vksTrace.h"
+
+namespace vks
+{
+	class GpuProfiler
+	{
+	public:
+		/** @brief Pipeline statistics counters, in the order the query returns them (flag bit order) */
+		struct PipelineStatistics
+		{
+			uint64_t vertexInvocations = 0;
+			uint64_t clippingPrimitives = 0;
+			uint64_t fragmentInvocations = 0;
+		};
+
+		/** @brief A GPU timestamp and the trace time (vks::trace::now()) of the same moment */
+		struct Calibration
+		{
+			uint64_t gpuTicks = 0;
+			int64_t cpuNs = 0;
+			bool valid = false;
+		};
+
+		/** @brief Timings of all scopes with the same name */
+		struct ScopeTimings
+		{
+			const char* name;
+			/** @brief Sum of the scope's instances in the last resolved frame */
+			double lastMs = 0.0;
+			/** @brief Moving average of lastMs */
+			double averageMs = 0.0;
+			/** @brief lastMs of every resolved frame while collecting */
+			std::vector<double> samples;
+			/** @brief Pipeline statistics were recorded for the scope */
+			bool hasStatistics = false;
+			/** @brief Sum of the scope's instances in the last resolved frame */
+			PipelineStatistics lastStatistics;
+			/** @brief lastStatistics of every resolved frame while collecting */
+			std::vector<PipelineStatistics> statisticsSamples;
+		};
+
+		/**
+		* @brief Times the commands recorded during its lifetime, also a label region for debugging tools (see VulkanDebugMarker.hpp)
+		*
+		* @note Scopes may nest and may span render pass boundaries, but must begin and end in the same command buffer
+		* @note The name is stored as pointer, use string literals
+		* @note With pipeline statistics, an outermost scope begun outside of a render pass must also end outside of it
+		*/
+		class Scope
+		{
+		public:
+			Scope(GpuProfiler &profiler, vk::CommandBuffer cmdBuffer, const char* name)
+				: profiler(profiler), cmdBuffer(cmdBuffer)
+			{
+				vks::debugmarker::beginRegion(static_cast<VkCommandBuffer>(cmdBuffer), name);
+				query = profiler.beginScope(cmdBuffer, name);
+			}
+			~Scope()
+			{
+				profiler.endScope(cmdBuffer, query);
+				vks::debugmarker::endRegion(static_cast<VkCommandBuffer>(cmdBuffer));
+			}
+		private:
+			GpuProfiler &profiler;
+			vk::CommandBuffer cmdBuffer;
+			uint32_t query;
+		};
+
+		vks::VulkanDevice *device = nullptr;
+		/** @brief Timestamps are written and resolved (prepared on a queue family with timestamp support) */
+		bool enabled = false;
+		/** @brief Keep per-frame samples of every scope (for benchmark reports) */
+		bool collectSamples = false;
+		/** @brief Resolved frames that are not sampled (e.g. benchmark warm up) */
+		uint32_t skipFrames = 0;
+		/** @brief Maximum number of scopes per frame, further scopes are not timed */
+		uint32_t maxScopes = 0;
+		/** @brief Outermost scopes record pipeline statistics */
+		bool pipelineStatistics = false;
+		/** @brief Last calibration of the GPU timestamps against the trace clock (see calibrate()) */
+		Calibration calibration;
+		/** @brief Renew the calibration every 256 resolved frames also while no trace is recorded (only with calibrated timestamps) */
+		bool keepCalibrated = false;
+
+		/**
+		* Create the query pool
+		*
+		* @param device Device to create the resources on
+		* @param queueFamilyIndex Queue family the timed command buffers are submitted to
+		* @param frameCount Number of frames in flight (command buffers), each has its own query range
+		* @param maxScopes Maximum number of scopes per frame
+		* @param pipelineStatistics Also record pipeline statistics (the pipelineStatisticsQuery feature must be enabled)
+		*/
+		void prepare(vks::VulkanDevice *device, uint32_t queueFamilyIndex, uint32_t frameCount, uint32_t maxScopes = 32, bool pipelineStatistics = false)
+		{
+			this->device = device;
+			this->maxScopes = maxScopes;
+			const uint32_t validBits = device->queueFamilyProperties[queueFamilyIndex].timestampValidBits;
+			enabled = (validBits > 0) && (device->properties.limits.timestampPeriod > 0.0f);
+			if (!enabled)
+			{
+				std::cerr << "Queue family " << queueFamilyIndex << " doesn't support timestamps, GPU profiling disabled" << std::endl;
+				return;
+			}
+			timestampMask = (validBits >= 64) ? ~0ull : ((1ull << validBits) - 1);
+			frames.resize(frameCount);
+
+			vk::QueryPoolCreateInfo queryPoolInfo;
+			queryPoolInfo.setQueryType (vk::QueryType::eTimestamp)
+				.setQueryCount (2 * maxScopes * frameCount);
+			queryPool = CHECK(device->D().createQueryPool (queryPoolInfo));
+
+			this->pipelineStatistics = pipelineStatistics;
+			if (pipelineStatistics)
+			{
+				vk::QueryPoolCreateInfo statisticsPoolInfo;
+				statisticsPoolInfo.setQueryType (vk::QueryType::ePipelineStatistics)
+					.setQueryCount (maxScopes * frameCount)
+					.setPipelineStatistics (statisticsFlags());
+				statisticsPool = CHECK(device->D().createQueryPool (statisticsPoolInfo));
+			}
+		}
+
+		void destroy()
+		{
+			if (!device)
+			{
+				return;
+			}
+			if (queryPool)
+			{
+				device->D().destroyQueryPool (queryPool);
+			}
+			if (statisticsPool)
+			{
+				device->D().destroyQueryPool (statisticsPool);
+			}
+			device = nullptr;
+		}
+
+		/**
+		* Start recording the scopes of a frame, resets its query range
+		*
+		* @note Must be recorded outside of a render pass, before the frame's first scope
+		*/
+		void beginFrame(vk::CommandBuffer cmdBuffer, uint32_t frame)
+		{
+			if (!enabled)
+			{
+				return;
+			}
+			recordingFrame = frame;
+			frames[frame].scopes.clear();
+			frames[frame].statistics.clear();
+			frames[frame].submitted = false;
+			statisticsActive = false;
+			cmdBuffer.resetQueryPool (queryPool, 2 * maxScopes * frame, 2 * maxScopes);
+			if (pipelineStatistics)
+			{
+				cmdBuffer.resetQueryPool (statisticsPool, maxScopes * frame, maxScopes);
+			}
+		}
+
+		/** @brief The frame's command buffer has been submitted, its results can be resolved after the next wait on its fence */
+		void markSubmitted(uint32_t frame)
+		{
+			if (enabled)
+			{
+				frames[frame].submitted = true;
+			}
+		}
+
+		/**
+		* Use VK_EXT_calibrated_timestamps for calibrate() if the extension has been enabled on the device and it can sample the
+		* device and the performance counter (the trace clock's source) together
+		*/
+		void enableCalibratedTimestamps(vk::Instance instance)
+		{
+#if defined(VK_EXT_calibrated_timestamps)
+			if ((!enabled) || (!device->extensionEnabled(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME)))
+			{
+				return;
+			}
+			auto getTimeDomains = reinterpret_cast<PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT"));
+			getCalibratedTimestamps = reinterpret_cast<PFN_vkGetCalibratedTimestampsEXT>(vkGetDeviceProcAddr(device->GetDevice(), "vkGetCalibratedTimestampsEXT"));
+			if ((!getTimeDomains) || (!getCalibratedTimestamps))
+			{
+				return;
+			}
+			uint32_t count = 0;
+			VK_CHECK_RESULT(getTimeDomains(device->physicalDevice, &count, nullptr));
+			std::vector<VkTimeDomainEXT> timeDomains(count);
+			VK_CHECK_RESULT(getTimeDomains(device->physicalDevice, &count, timeDomains.data()));
+			const bool deviceDomain = std::find(timeDomains.begin(), timeDomains.end(), VK_TIME_DOMAIN_DEVICE_EXT) != timeDomains.end();
+			const bool hostDomain = std::find(timeDomains.begin(), timeDomains.end(), VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT) != timeDomains.end();
+			calibratedTimestamps = (deviceDomain) && (hostDomain);
+#endif
+		}
+
+		/** @brief calibrate() uses VK_EXT_calibrated_timestamps (else a timestamp submission) */
+		bool hasCalibratedTimestamps() const
+		{
+			return calibratedTimestamps;
+		}
+
+		/**
+		* Take a new calibration of the GPU timestamps against the trace clock
+		*
+		* @param queue Queue of the profiled family, used if there are no calibrated timestamps (must be idle for an accurate result)
+		*/
+		void calibrate(vk::Queue queue)
+		{
+			if (!enabled)
+			{
+				return;
+			}
+			if (calibrateTimestamps())
+			{
+				return;
+			}
+			calibration = submitCalibration(queue, device->commandPool);
+		}
+
+		/**
+		* Calibration of the timestamps written on another queue (e.g. a compute queue) against the trace clock, see traceTime()
+		*
+		* Timestamps are only comparable within a queue, with calibrated timestamps the device time domain is shared by all queues
+		*
+		* @param queue Queue the timestamps are written on (must be idle for an accurate result)
+		* @param commandPool Command pool of the queue's family
+		*
+		* @return Invalid calibration if the profiler isn't enabled
+		*/
+		Calibration calibrateQueue(vk::Queue queue, vk::CommandPool commandPool)
+		{
+			if (!enabled)
+			{
+				return Calibration();
+			}
+			if (calibrateTimestamps())
+			{
+				return calibration;
+			}
+			return submitCalibration(queue, commandPool);
+		}
+
+		/**
+		* Read the results of the frame's last submission and add them to the scope timings
+		*
+		* @note Call after the frame's fence has been waited on, before its command buffer is recorded or submitted again
+		*/
+		void resolve(uint32_t frame)
+		{
+			if ((!enabled) || (!frames[frame].submitted) || (frames[frame].scopes.empty()))
+			{
+				return;
+			}
+			const std::vector<const char*> &scopes = frames[frame].scopes;
+			results.resize(2 * scopes.size());
+			// Without the wait bit, results of a frame that hasn't completed are not read (the caller's fence makes this the exception)
+			VkResult result = vkGetQueryPoolResults(device->GetDevice(), queryPool, 2 * maxScopes * frame, static_cast<uint32_t>(results.size()),
+				results.size() * sizeof(uint64_t), results.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+			if (result == VK_NOT_READY)
+			{
+				return;
+			}
+			VK_CHECK_RESULT(result);
+
+			resolvedFrames++;
+			const bool trace = (calibration.valid) && (vks::trace::enabled());
+			if (((trace) || ((calibration.valid) && (keepCalibrated))) && (resolvedFrames % 256 == 0))
+			{
+				calibrateTimestamps();
+			}
+			const bool sample = (collectSamples) && (resolvedFrames > skipFrames);
+			for (auto& timings : scopeTimings)
+			{
+				timings.lastMs = 0.0;
+				timings.lastStatistics = PipelineStatistics();
+			}
+			for (size_t i = 0; i < scopes.size(); i++)
+			{
+				ScopeTimings &timings = timingsOf(scopes[i]);
+				const uint64_t ticks = (results[2 * i + 1] - results[2 * i]) & timestampMask;
+				timings.lastMs += (double)ticks * device->properties.limits.timestampPeriod / 1000000.0;
+				if (trace)
+				{
+					vks::trace::addGpuEvent(scopes[i], traceTime(results[2 * i]), traceTime(results[2 * i + 1]));
+				}
+				if (frames[frame].statistics[i])
+				{
+					// Only the queries of scopes with statistics have been used, so they are read one by one
+					PipelineStatistics counters;
+					const uint32_t query = maxScopes * frame + static_cast<uint32_t>(i);
+					VkResult result = vkGetQueryPoolResults(device->GetDevice(), statisticsPool, query, 1, sizeof(counters), &counters, sizeof(counters), VK_QUERY_RESULT_64_BIT);
+					if (result == VK_SUCCESS)
+					{
+						timings.hasStatistics = true;
+						timings.lastStatistics.vertexInvocations += counters.vertexInvocations;
+						timings.lastStatistics.clippingPrimitives += counters.clippingPrimitives;
+						timings.lastStatistics.fragmentInvocations += counters.fragmentInvocations;
+					}
+				}
+			}
+			for (auto& timings : scopeTimings)
+			{
+				timings.averageMs = (timings.averageMs == 0.0) ? timings.lastMs : timings.averageMs * 0.95 + timings.lastMs * 0.05;
+				if (sample)
+				{
+					timings.samples.push_back(timings.lastMs);
+					if (timings.hasStatistics)
+					{
+						timings.statisticsSamples.push_back(timings.lastStatistics);
+					}
+				}
+			}
+		}
+
+		/**
+		* Trace clock time (vks::trace::now()) of a timestamp written on the profiled queue family
+		*
+		* @note Needs a valid calibration, the counter may wrap around within its valid bits on either side of it
+		*/
+		int64_t traceTime(uint64_t ticks) const
+		{
+			return traceTime(ticks, calibration, timestampMask);
+		}
+
+		/**
+		* Trace clock time of a timestamp written on another queue
+		*
+		* @param reference Calibration of the queue the timestamp was written on (see calibrateQueue())
+		* @param mask Valid bits of the queue's family
+		*/
+		int64_t traceTime(uint64_t ticks, const Calibration &reference, uint64_t mask) const
+		{
+			const uint64_t after = (ticks - reference.gpuTicks) & mask;
+			const double delta = (after <= (mask >> 1)) ? (double)after : -(double)((reference.gpuTicks - ticks) & mask);
+			return reference.cpuNs + (int64_t)(delta * device->properties.limits.timestampPeriod);
+		}
+
+		/** @brief Timings of all scope names seen so far, in order of first appearance */
+		const std::vector<ScopeTimings>& timings() const
+		{
+			return scopeTimings;
+		}
+
+		/** @brief Add the samples of every scope as series "gpu <name> ms", pipeline statistics as "gpu <name> <counter>" */
+		void addToReport(vks::BenchmarkReport &report) const
+		{
+			for (auto& timings : scopeTimings)
+			{
+				report.addSeries(std::string("gpu ") + timings.name + " ms", timings.samples);
+				if (!timings.hasStatistics)
+				{
+					continue;
+				}
+				std::vector<double> vertexInvocations, clippingPrimitives, fragmentInvocations;
+				for (auto& statistics : timings.statisticsSamples)
+				{
+					vertexInvocations.push_back((double)statistics.vertexInvocations);
+					clippingPrimitives.push_back((double)statistics.clippingPrimitives);
+					fragmentInvocations.push_back((double)statistics.fragmentInvocations);
+				}
+				report.addSeries(std::string("gpu ") + timings.name + " vertex invocations", vertexInvocations);
+				report.addSeries(std::string("gpu ") + timings.name + " clipping primitives", clippingPrimitives);
+				report.addSeries(std::string("gpu ") + timings.name + " fragment invocations", fragmentInvocations);
+			}
+		}
+
+		/** @brief Counters recorded by the statistics queries, matches the layout of PipelineStatistics */
+		static vk::QueryPipelineStatisticFlags statisticsFlags()
+		{
+			return vk::QueryPipelineStatisticFlagBits::eVertexShaderInvocations | vk::QueryPipelineStatisticFlagBits::eClippingPrimitives |
+				vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations;
+		}
+
+	private:
+		struct Frame
+		{
+			// Scope names in order of their queries
+			std::vector<const char*> scopes;
+			// Scope i has a pipeline statistics query (outermost scopes only, queries of the same type can't nest)
+			std::vector<bool> statistics;
+			bool submitted = false;
+		};
+
+		vk::QueryPool queryPool;
+		vk::QueryPool statisticsPool;
+		bool statisticsActive = false;
+		uint64_t timestampMask = 0;
+		std::vector<Frame> frames;
+		uint32_t recordingFrame = 0;
+		uint64_t resolvedFrames = 0;
+		std::vector<ScopeTimings> scopeTimings;
+		std::vector<uint64_t> results;
+		bool calibratedTimestamps = false;
+#if defined(VK_EXT_calibrated_timestamps)
+		PFN_vkGetCalibratedTimestampsEXT getCalibratedTimestamps = nullptr;
+#endif
+
+		// Calibration from a timestamp written between a submission and its fence wait returning
+		Calibration submitCalibration(vk::Queue queue, vk::CommandPool commandPool)
+		{
+			vk::QueryPoolCreateInfo queryPoolInfo;
+			queryPoolInfo.setQueryType (vk::QueryType::eTimestamp)
+				.setQueryCount (1);
+			vk::QueryPool calibrationPool = CHECK(device->D().createQueryPool (queryPoolInfo));
+			vk::CommandBufferAllocateInfo cmdBufAllocateInfo;
+			cmdBufAllocateInfo.setCommandPool (commandPool)
+				.setLevel (vk::CommandBufferLevel::ePrimary)
+				.setCommandBufferCount (1);
+			vk::CommandBuffer cmdBuffer = CHECK(device->D().allocateCommandBuffers (cmdBufAllocateInfo)).front();
+			VK_CHECK_RESULT(cmdBuffer.begin (vk::CommandBufferBeginInfo()));
+			cmdBuffer.resetQueryPool (calibrationPool, 0, 1);
+			cmdBuffer.writeTimestamp (vk::PipelineStageFlagBits::eTopOfPipe, calibrationPool, 0);
+			cmdBuffer.end();
+			VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo();
+			VkFence fence;
+			VK_CHECK_RESULT(vkCreateFence(device->GetDevice(), &fenceInfo, nullptr, &fence));
+
+			// The timestamp is written somewhere between the submission and the fence wait returning
+			vk::SubmitInfo submitInfo;
+			submitInfo.setCommandBufferCount (1)
+				.setPCommandBuffers (&cmdBuffer);
+			const int64_t submitNs = vks::trace::now();
+			VK_CHECK_RESULT(queue.submit (submitInfo, fence));
+			VK_CHECK_RESULT(vkWaitForFences(device->GetDevice(), 1, &fence, VK_TRUE, UINT64_MAX));
+			const int64_t signaledNs = vks::trace::now();
+
+			uint64_t ticks = 0;
+			VK_CHECK_RESULT(vkGetQueryPoolResults(device->GetDevice(), calibrationPool, 0, 1, sizeof(ticks), &ticks, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+			Calibration result;
+			result.gpuTicks = ticks;
+			result.cpuNs = submitNs + (signaledNs - submitNs) / 2;
+			result.valid = true;
+
+			vkDestroyFence(device->GetDevice(), fence, nullptr);
+			device->D().freeCommandBuffers (commandPool, cmdBuffer);
+			device->D().destroyQueryPool (calibrationPool);
+			return result;
+		}
+
+		// Calibration from VK_EXT_calibrated_timestamps, returns false if it isn't available
+		bool calibrateTimestamps()
+		{
+#if defined(VK_EXT_calibrated_timestamps)
+			if (!calibratedTimestamps)
+			{
+				return false;
+			}
+			std::array<VkCalibratedTimestampInfoEXT, 2> timestampInfos = {};
+			timestampInfos[0].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+			timestampInfos[0].timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+			timestampInfos[1].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+			timestampInfos[1].timeDomain = VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT;
+			std::array<uint64_t, 2> timestamps;
+			uint64_t maxDeviation;
+			if (getCalibratedTimestamps(device->GetDevice(), static_cast<uint32_t>(timestampInfos.size()), timestampInfos.data(), timestamps.data(), &maxDeviation) != VK_SUCCESS)
+			{
+				return false;
+			}
+			// The host sample is a performance counter value, move it back from the current counter to the trace clock
+			LARGE_INTEGER counter, frequency;
+			const int64_t nowNs = vks::trace::now();
+			QueryPerformanceCounter(&counter);
+			QueryPerformanceFrequency(&frequency);
+			const double elapsedNs = (double)(counter.QuadPart - (int64_t)timestamps[1]) * 1000000000.0 / (double)frequency.QuadPart;
+			calibration.gpuTicks = timestamps[0];
+			calibration.cpuNs = nowNs - (int64_t)elapsedNs;
+			calibration.valid = true;
+			return true;
+#else
+			return false;
+#endif
+		}
+
+		// Returns the scope's query index within the frame, or ~0u if it isn't timed
+		uint32_t beginScope(vk::CommandBuffer cmdBuffer, const char* name)
+		{
+			if (!enabled)
+			{
+				return ~0u;
+			}
+			std::vector<const char*> &scopes = frames[recordingFrame].scopes;
+			if (scopes.size() >= maxScopes)
+			{
+				return ~0u;
+			}
+			const uint32_t query = static_cast<uint32_t>(scopes.size());
+			const bool statistics = (pipelineStatistics) && (!statisticsActive);
+			scopes.push_back(name);
+			frames[recordingFrame].statistics.push_back(statistics);
+			cmdBuffer.writeTimestamp (vk::PipelineStageFlagBits::eTopOfPipe, queryPool, 2 * (maxScopes * recordingFrame + query));
+			if (statistics)
+			{
+				cmdBuffer.beginQuery (statisticsPool, maxScopes * recordingFrame + query, vk::QueryControlFlags());
+				statisticsActive = true;
+			}
+			return query;
+		}
+
+		void endScope(vk::CommandBuffer cmdBuffer, uint32_t query)
+		{
+			if (query == ~0u)
+			{
+				return;
+			}
+			if (frames[recordingFrame].statistics[query])
+			{
+				cmdBuffer.endQuery (statisticsPool, maxScopes * recordingFrame + query);
+				statisticsActive = false;
+			}
+			cmdBuffer.writeTimestamp (vk::PipelineStageFlagBits::eBottomOfPipe, queryPool, 2 * (maxScopes * recordingFrame + query) + 1);
+		}
+
+		ScopeTimings& timingsOf(const char* name)
+		{
+			for (auto& timings : scopeTimings)
+			{
+				if ((timings.name == name) || (strcmp(timings.name, name) == 0))
+				{
+					return timings;
+				}
+			}
+			ScopeTimings timings;
+			timings.name = name;
+			scopeTimings.push_back(timings);
+			return scopeTimings.back();
+		}
+	};
+}
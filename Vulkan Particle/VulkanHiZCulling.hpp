@@ -0,0 +1,713 @@
+#pragma once
+
+/*
+* Vulkan hierarchical-z occlusion culling class
+*
+* Two phase occlusion culling against a depth pyramid (Hi-Z) built by compute from the depth attachment:
+* - Phase 0 : Objects inside the frustum are tested against last frame's pyramid, passing objects are drawn in the early render pass
+* - The pyramid is rebuilt from the early pass depth
+* - Phase 1 : Objects rejected in phase 0 are re-tested against the new pyramid, newly visible objects are drawn in the late render pass
+* - The pyramid is rebuilt again from the final depth for the next frame
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+
+#include "vulkan/vulkan.h"
+#include <vulkan/vulkan.hpp>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include "vksTools.h"
+#include "VulkanBuffer.hpp"
+#include "VulkanDevice.hpp"
+#include "VulkanInitializers.h"
+#include "VulkanIndirectDraw.hpp"
+#include "VulkanFrustumCulling.hpp"
+
+namespace vks
+{
+	struct HiZCulling
+	{
+		/** @brief Must match local_size_x of hiz_cull.comp */
+		static const uint32_t workgroupSize = 64;
+		/** @brief Must match local_size_x/y of hiz_downsample.comp */
+		static const uint32_t downsampleGroupSize = 8;
+		/** @brief Max. number of pyramid levels (32768 x 32768) */
+		static const uint32_t maxMipCount = 16;
+
+		/** @brief Per-frame culling results, layout matches the Statistics block of hiz_cull.comp */
+		struct Statistics
+		{
+			/** @brief Objects outside of the view frustum */
+			uint32_t frustumCulled;
+			/** @brief Objects drawn in the early pass (visible in last frame's pyramid) */
+			uint32_t visibleEarly;
+			/** @brief Objects drawn in the late pass (occluded in last frame's pyramid, visible in the current one) */
+			uint32_t visibleLate;
+			/** @brief Objects occluded in both pyramids */
+			uint32_t occluded;
+		};
+
+		/** @brief Layout matches the culling shader's uniform block (std140) */
+		struct Params
+		{
+			glm::mat4 viewProjection;
+			/** @brief Matrix the pyramid content of the previous frame has been rendered with */
+			glm::mat4 prevViewProjection;
+			glm::vec4 planes[6];
+			glm::vec2 pyramidSize;
+			uint32_t objectCount;
+			uint32_t pad;
+		};
+
+		vks::VulkanDevice *device = nullptr;
+		VkQueue queue = VK_NULL_HANDLE;
+		bool prepared = false;
+		uint32_t regionCount = 0;
+
+		/** @brief Draw records of the early (phase 0) and late (phase 1) pass, device local */
+		vks::IndirectDrawBuffer earlyDraws;
+		vks::IndirectDrawBuffer lateDraws;
+
+		vks::Buffer objectBuffer;
+		vks::Buffer meshBuffer;
+		/** @brief One uint per object, 1 = drawn early, 0 = occluded in phase 0 (re-test in phase 1), 2 = outside of the frustum */
+		vks::Buffer visibilityBuffer;
+		/** @brief Per-region params (host visible, persistently mapped) */
+		vks::Buffer paramsBuffer;
+		VkDeviceSize paramsStride = 0;
+		/** @brief Per-region statistics (host visible, read once the region's fence has been signaled) */
+		vks::Buffer statisticsBuffer;
+		VkDeviceSize statisticsStride = 0;
+
+		/** @brief Depth pyramid (R32_SFLOAT, max. depth of the covered texels, GENERAL layout) */
+		struct {
+			VkImage image = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			/** @brief View of all levels, sampled by the culling shader */
+			VkImageView view = VK_NULL_HANDLE;
+			/** @brief One view per level, written by the downsample shader */
+			std::vector<VkImageView> mipViews;
+			uint32_t width = 0;
+			uint32_t height = 0;
+			uint32_t mipCount = 0;
+		} pyramid;
+
+		/** @brief Depth attachment the pyramid is built from */
+		struct {
+			VkImage image = VK_NULL_HANDLE;
+			/** @brief Depth aspect only view for sampling */
+			VkImageView view = VK_NULL_HANDLE;
+			VkFormat format;
+			VkImageAspectFlags aspectMask;
+			uint32_t width;
+			uint32_t height;
+		} depth;
+
+		vk::Sampler sampler;
+
+		/** @brief Early pass clears the attachments, late pass loads them and transitions the color attachment for presentation */
+		vk::RenderPass earlyRenderPass;
+		vk::RenderPass lateRenderPass;
+
+		vk::DescriptorSetLayout cullSetLayout;
+		vk::DescriptorSetLayout downsampleSetLayout;
+		vk::PipelineLayout cullPipelineLayout;
+		vk::PipelineLayout downsamplePipelineLayout;
+		/** @brief One pipeline per phase (specialization constant) */
+		std::array<vk::Pipeline, 2> cullPipelines;
+		vk::Pipeline downsamplePipeline;
+		vk::DescriptorPool descriptorPool;
+		/** @brief One culling descriptor set per region */
+		std::vector<vk::DescriptorSet> cullSets;
+		/** @brief One downsample descriptor set per pyramid level */
+		std::vector<vk::DescriptorSet> downsampleSets;
+
+		std::vector<CullObject> objects;
+		Frustum frustum;
+		glm::mat4 lastViewProjection;
+
+		/** @brief Results of the most recently completed frame */
+		Statistics statistics = {};
+
+		/**
+		* Create all resources
+		*
+		* @param device Device to create the resources on
+		* @param queue Queue used for initial uploads and layout transitions
+		* @param pipelineCache Pipeline cache to use
+		* @param meshArena Meshes referenced by the objects
+		* @param objects Bounding spheres and meshes of all objects
+		* @param colorFormat Format of the color attachment (swap chain)
+		* @param depthFormat Format of the depth attachment
+		* @param depthImage Depth attachment image (needs VK_IMAGE_USAGE_SAMPLED_BIT)
+		* @param width Width of the depth attachment
+		* @param height Height of the depth attachment
+		* @param regionCount Number of frames in flight (command buffers)
+		* @param presentLayout Layout the late pass leaves the color attachment in
+		*/
+		void prepare(vks::VulkanDevice *device, VkQueue queue, vk::PipelineCache pipelineCache, const vks::MeshArena &meshArena, const std::vector<CullObject> &objects,
+			VkFormat colorFormat, VkFormat depthFormat, VkImage depthImage, uint32_t width, uint32_t height, uint32_t regionCount,
+			vk::ImageLayout presentLayout = vk::ImageLayout::ePresentSrcKHR)
+		{
+			this->device = device;
+			this->queue = queue;
+			this->objects = objects;
+			this->regionCount = regionCount;
+			depth.format = depthFormat;
+			depth.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+			if ((depthFormat == VK_FORMAT_D32_SFLOAT_S8_UINT) || (depthFormat == VK_FORMAT_D24_UNORM_S8_UINT) || (depthFormat == VK_FORMAT_D16_UNORM_S8_UINT))
+			{
+				depth.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+			}
+
+			const uint32_t objectCount = static_cast<uint32_t>(objects.size());
+			earlyDraws.create(device, objectCount, regionCount, false);
+			lateDraws.create(device, objectCount, regionCount, false);
+
+			VK_CHECK_RESULT(device->createDeviceLocalBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &objectBuffer,
+				objects.size() * sizeof(CullObject), (void*)objects.data(), queue));
+			std::vector<uint32_t> meshData;
+			for (auto& mesh : meshArena.meshes)
+			{
+				meshData.insert(meshData.end(), { mesh.indexCount, mesh.firstIndex, static_cast<uint32_t>(mesh.vertexOffset), 0 });
+			}
+			VK_CHECK_RESULT(device->createDeviceLocalBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &meshBuffer,
+				meshData.size() * sizeof(uint32_t), meshData.data(), queue));
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, vk::MemoryPropertyFlagBits::eDeviceLocal,
+				&visibilityBuffer, objects.size() * sizeof(uint32_t)));
+
+			const VkDeviceSize uniformAlignment = device->properties.limits.minUniformBufferOffsetAlignment;
+			const VkDeviceSize storageAlignment = device->properties.limits.minStorageBufferOffsetAlignment;
+			paramsStride = (sizeof(Params) + uniformAlignment - 1) / uniformAlignment * uniformAlignment;
+			statisticsStride = (sizeof(Statistics) + storageAlignment - 1) / storageAlignment * storageAlignment;
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, &paramsBuffer, paramsStride * regionCount));
+			VK_CHECK_RESULT(paramsBuffer.map());
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, &statisticsBuffer, statisticsStride * regionCount));
+			VK_CHECK_RESULT(statisticsBuffer.map());
+			memset(statisticsBuffer.mapped, 0, statisticsStride * regionCount);
+
+			// Nearest filtering, the 2x2 texel footprint of the culling shader is conservative on its own
+			vk::SamplerCreateInfo samplerInfo;
+			samplerInfo.setMagFilter (vk::Filter::eNearest)
+				.setMinFilter (vk::Filter::eNearest)
+				.setMipmapMode (vk::SamplerMipmapMode::eNearest)
+				.setAddressModeU (vk::SamplerAddressMode::eClampToEdge)
+				.setAddressModeV (vk::SamplerAddressMode::eClampToEdge)
+				.setAddressModeW (vk::SamplerAddressMode::eClampToEdge)
+				.setMinLod (0.0f)
+				.setMaxLod ((float)maxMipCount)
+				.setMaxAnisotropy (1.0f);
+			sampler = CHECK(device->D().createSampler (samplerInfo));
+
+			earlyRenderPass = createRenderPass(colorFormat, depthFormat, false, presentLayout);
+			lateRenderPass = createRenderPass(colorFormat, depthFormat, true, presentLayout);
+
+			prepareDescriptorSetLayouts();
+			preparePipelines(pipelineCache);
+			prepareDescriptorSets();
+
+			resize(depthImage, width, height);
+			prepared = true;
+		}
+
+		void destroy()
+		{
+			if (!device)
+			{
+				return;
+			}
+			destroyPyramid();
+			device->D().destroyPipeline (cullPipelines[0]);
+			device->D().destroyPipeline (cullPipelines[1]);
+			device->D().destroyPipeline (downsamplePipeline);
+			device->D().destroyPipelineLayout (cullPipelineLayout);
+			device->D().destroyPipelineLayout (downsamplePipelineLayout);
+			device->D().destroyDescriptorSetLayout (cullSetLayout);
+			device->D().destroyDescriptorSetLayout (downsampleSetLayout);
+			device->D().destroyDescriptorPool (descriptorPool);
+			device->D().destroyRenderPass (earlyRenderPass);
+			device->D().destroyRenderPass (lateRenderPass);
+			device->D().destroySampler (sampler);
+			earlyDraws.destroy();
+			lateDraws.destroy();
+			objectBuffer.destroy();
+			meshBuffer.destroy();
+			visibilityBuffer.destroy();
+			paramsBuffer.unmap();
+			paramsBuffer.destroy();
+			statisticsBuffer.unmap();
+			statisticsBuffer.destroy();
+		}
+
+		/**
+		* (Re)create the depth pyramid for a new depth attachment (e.g. after a window resize)
+		*
+		* @note The device must be idle
+		*/
+		void resize(VkImage depthImage, uint32_t width, uint32_t height)
+		{
+			destroyPyramid();
+			depth.image = depthImage;
+			depth.width = width;
+			depth.height = height;
+
+			// Depth only view for sampling (combined depth/stencil images can't be sampled with both aspects)
+			VkImageViewCreateInfo viewInfo = vks::initializers::imageViewCreateInfo();
+			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewInfo.format = depth.format;
+			viewInfo.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+			viewInfo.image = depthImage;
+			VK_CHECK_RESULT(vkCreateImageView(device->GetDevice(), &viewInfo, nullptr, &depth.view));
+
+			// Level 0 is the largest power of two that fits into the depth attachment, so all further levels halve exactly
+			pyramid.width = previousPowerOfTwo(width);
+			pyramid.height = previousPowerOfTwo(height);
+			pyramid.mipCount = 1;
+			while (((pyramid.width >> pyramid.mipCount) > 0 || (pyramid.height >> pyramid.mipCount) > 0) && (pyramid.mipCount < maxMipCount))
+			{
+				pyramid.mipCount++;
+			}
+
+			VkImageCreateInfo imageInfo = vks::initializers::imageCreateInfo();
+			imageInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageInfo.format = VK_FORMAT_R32_SFLOAT;
+			imageInfo.extent = { pyramid.width, pyramid.height, 1 };
+			imageInfo.mipLevels = pyramid.mipCount;
+			imageInfo.arrayLayers = 1;
+			imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+			VK_CHECK_RESULT(device->createImage(&imageInfo, &pyramid.image, "hiz pyramid"));
+
+			VkMemoryRequirements memReqs;
+			vkGetImageMemoryRequirements(device->GetDevice(), pyramid.image, &memReqs);
+			VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+			memAlloc.allocationSize = memReqs.size;
+			memAlloc.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal);
+			VK_CHECK_RESULT(vkAllocateMemory(device->GetDevice(), &memAlloc, nullptr, &pyramid.memory));
+			VK_CHECK_RESULT(vkBindImageMemory(device->GetDevice(), pyramid.image, pyramid.memory, 0));
+
+			viewInfo.format = VK_FORMAT_R32_SFLOAT;
+			viewInfo.image = pyramid.image;
+			viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, pyramid.mipCount, 0, 1 };
+			VK_CHECK_RESULT(vkCreateImageView(device->GetDevice(), &viewInfo, nullptr, &pyramid.view));
+			pyramid.mipViews.resize(pyramid.mipCount);
+			for (uint32_t i = 0; i < pyramid.mipCount; i++)
+			{
+				viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1 };
+				VK_CHECK_RESULT(vkCreateImageView(device->GetDevice(), &viewInfo, nullptr, &pyramid.mipViews[i]));
+			}
+
+			// Transition to general layout and clear to the far plane, so nothing is occluded before the first pyramid has been built
+			vk::CommandBuffer cmdBuffer = device->createCommandBuffer(vk::CommandBufferLevel::ePrimary, true);
+			vk::ImageSubresourceRange range(vk::ImageAspectFlagBits::eColor, 0, pyramid.mipCount, 0, 1);
+			vk::ImageMemoryBarrier imageBarrier;
+			imageBarrier.setOldLayout (vk::ImageLayout::eUndefined)
+				.setNewLayout (vk::ImageLayout::eGeneral)
+				.setSrcQueueFamilyIndex (VK_QUEUE_FAMILY_IGNORED)
+				.setDstQueueFamilyIndex (VK_QUEUE_FAMILY_IGNORED)
+				.setDstAccessMask (vk::AccessFlagBits::eTransferWrite)
+				.setImage (pyramid.image)
+				.setSubresourceRange (range);
+			cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags(), nullptr, nullptr, imageBarrier);
+			cmdBuffer.clearColorImage (pyramid.image, vk::ImageLayout::eGeneral, vk::ClearColorValue(std::array<float, 4>{ { 1.0f, 1.0f, 1.0f, 1.0f } }), range);
+			imageBarrier.setOldLayout (vk::ImageLayout::eGeneral)
+				.setSrcAccessMask (vk::AccessFlagBits::eTransferWrite)
+				.setDstAccessMask (vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+			cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlags(), nullptr, nullptr, imageBarrier);
+			device->flushCommandBuffer(cmdBuffer, queue);
+
+			updateDescriptorSets();
+		}
+
+		/**
+		* Update the per-frame parameters of a region and fetch the statistics of its previous use
+		*
+		* @param region Region of the frame about to be submitted (its fence must have been waited on)
+		* @param viewProjection Matrix transforming the object bounding spheres to clip space (e.g. projection * view * model)
+		*/
+		void updateFrame(uint32_t region, const glm::mat4 &viewProjection)
+		{
+			statistics = *reinterpret_cast<Statistics*>(static_cast<uint8_t*>(statisticsBuffer.mapped) + statisticsStride * region);
+
+			frustum.update(viewProjection);
+			Params *params = reinterpret_cast<Params*>(static_cast<uint8_t*>(paramsBuffer.mapped) + paramsStride * region);
+			params->viewProjection = viewProjection;
+			// Frames are executed in submission order, so the pyramid read in phase 0 was rendered with the matrix of the previous submission
+			params->prevViewProjection = lastViewProjection;
+			std::copy(frustum.planes.begin(), frustum.planes.end(), params->planes);
+			params->pyramidSize = glm::vec2((float)pyramid.width, (float)pyramid.height);
+			params->objectCount = static_cast<uint32_t>(objects.size());
+			lastViewProjection = viewProjection;
+		}
+
+		/** @brief Draw records written by a phase */
+		vks::IndirectDrawBuffer& draws(uint32_t phase) { return (phase == 0) ? earlyDraws : lateDraws; }
+
+		/**
+		* Record the culling pass of a phase
+		*
+		* @param phase 0 = test against last frame's pyramid, 1 = re-test objects rejected in phase 0 against the current pyramid
+		*
+		* @note Must be recorded outside of a render pass
+		*/
+		void buildCullCommandBuffer(vk::CommandBuffer cmdBuffer, uint32_t region, uint32_t phase)
+		{
+			vks::IndirectDrawBuffer &output = draws(phase);
+			if (!output.drawIndexedIndirectCount)
+			{
+				cmdBuffer.fillBuffer (output.commands.buffer, output.regionOffset(region), output.regionSize(), 0);
+			}
+			cmdBuffer.fillBuffer (output.count.buffer, output.countOffset(region), output.countRegionSize(), 0);
+			if (phase == 0)
+			{
+				cmdBuffer.fillBuffer (statisticsBuffer.buffer, statisticsStride * region, statisticsStride, 0);
+			}
+
+			std::vector<vk::BufferMemoryBarrier> barriers = {
+				vks::initializers::bufferBarrier(output.commands.buffer, vk::AccessFlagBits::eTransferWrite,
+					vk::AccessFlagBits::eShaderWrite, output.regionOffset(region), output.regionSize()),
+				vks::initializers::bufferBarrier(output.count.buffer, vk::AccessFlagBits::eTransferWrite,
+					vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite, output.countOffset(region), output.countRegionSize()),
+				vks::initializers::bufferBarrier(statisticsBuffer.buffer, vk::AccessFlagBits::eTransferWrite,
+					vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite, statisticsStride * region, statisticsStride),
+				// Phase 1 reads the visibility written by phase 0
+				vks::initializers::bufferBarrier(visibilityBuffer.buffer, vk::AccessFlagBits::eShaderWrite,
+					vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite)
+			};
+			cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eDrawIndirect,
+				vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlags(), nullptr, barriers, nullptr);
+
+			cmdBuffer.bindPipeline (vk::PipelineBindPoint::eCompute, cullPipelines[phase]);
+			cmdBuffer.bindDescriptorSets (vk::PipelineBindPoint::eCompute, cullPipelineLayout, 0, cullSets[region], {});
+			cmdBuffer.dispatch ((static_cast<uint32_t>(objects.size()) + workgroupSize - 1) / workgroupSize, 1, 1);
+
+			std::array<vk::BufferMemoryBarrier, 2> drawBarriers = {
+				vks::initializers::bufferBarrier(output.commands.buffer, vk::AccessFlagBits::eShaderWrite,
+					vk::AccessFlagBits::eIndirectCommandRead, output.regionOffset(region), output.regionSize()),
+				vks::initializers::bufferBarrier(output.count.buffer, vk::AccessFlagBits::eShaderWrite,
+					vk::AccessFlagBits::eIndirectCommandRead, output.countOffset(region), output.countRegionSize())
+			};
+			cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eDrawIndirect,
+				vk::DependencyFlags(), nullptr, drawBarriers, nullptr);
+		}
+
+		/**
+		* Record the pyramid build from the depth attachment
+		*
+		* @param restoreDepthLayout If true, the depth attachment is transitioned back to attachment layout for a following render pass
+		*
+		* @note Expects the depth attachment in depth stencil attachment layout (final layout of both render passes)
+		*/
+		void buildPyramidCommandBuffer(vk::CommandBuffer cmdBuffer, bool restoreDepthLayout)
+		{
+			vk::ImageSubresourceRange depthRange(vk::ImageAspectFlags(depth.aspectMask), 0, 1, 0, 1);
+			vk::ImageMemoryBarrier depthBarrier;
+			depthBarrier.setOldLayout (vk::ImageLayout::eDepthStencilAttachmentOptimal)
+				.setNewLayout (vk::ImageLayout::eDepthStencilReadOnlyOptimal)
+				.setSrcQueueFamilyIndex (VK_QUEUE_FAMILY_IGNORED)
+				.setDstQueueFamilyIndex (VK_QUEUE_FAMILY_IGNORED)
+				.setSrcAccessMask (vk::AccessFlagBits::eDepthStencilAttachmentWrite)
+				.setDstAccessMask (vk::AccessFlagBits::eShaderRead)
+				.setImage (depth.image)
+				.setSubresourceRange (depthRange);
+			// Previous readers of the pyramid (culling) must be done before it is overwritten
+			vk::MemoryBarrier pyramidBarrier(vk::AccessFlagBits::eShaderRead, vk::AccessFlagBits::eShaderWrite);
+			cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eLateFragmentTests | vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+				vk::DependencyFlags(), pyramidBarrier, nullptr, depthBarrier);
+
+			cmdBuffer.bindPipeline (vk::PipelineBindPoint::eCompute, downsamplePipeline);
+			uint32_t srcWidth = depth.width;
+			uint32_t srcHeight = depth.height;
+			for (uint32_t i = 0; i < pyramid.mipCount; i++)
+			{
+				const uint32_t dstWidth = std::max(pyramid.width >> i, 1u);
+				const uint32_t dstHeight = std::max(pyramid.height >> i, 1u);
+				const std::array<uint32_t, 4> pushConstants = { srcWidth, srcHeight, dstWidth, dstHeight };
+				cmdBuffer.bindDescriptorSets (vk::PipelineBindPoint::eCompute, downsamplePipelineLayout, 0, downsampleSets[i], {});
+				cmdBuffer.pushConstants (downsamplePipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(pushConstants), pushConstants.data());
+				cmdBuffer.dispatch ((dstWidth + downsampleGroupSize - 1) / downsampleGroupSize, (dstHeight + downsampleGroupSize - 1) / downsampleGroupSize, 1);
+
+				// The next level reads this one (the last barrier makes the pyramid visible to the culling pass)
+				vk::ImageMemoryBarrier mipBarrier;
+				mipBarrier.setOldLayout (vk::ImageLayout::eGeneral)
+					.setNewLayout (vk::ImageLayout::eGeneral)
+					.setSrcQueueFamilyIndex (VK_QUEUE_FAMILY_IGNORED)
+					.setDstQueueFamilyIndex (VK_QUEUE_FAMILY_IGNORED)
+					.setSrcAccessMask (vk::AccessFlagBits::eShaderWrite)
+					.setDstAccessMask (vk::AccessFlagBits::eShaderRead)
+					.setImage (pyramid.image)
+					.setSubresourceRange (vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, i, 1, 0, 1));
+				cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+					vk::DependencyFlags(), nullptr, nullptr, mipBarrier);
+
+				srcWidth = dstWidth;
+				srcHeight = dstHeight;
+			}
+
+			if (restoreDepthLayout)
+			{
+				depthBarrier.setOldLayout (vk::ImageLayout::eDepthStencilReadOnlyOptimal)
+					.setNewLayout (vk::ImageLayout::eDepthStencilAttachmentOptimal)
+					.setSrcAccessMask (vk::AccessFlagBits::eShaderRead)
+					.setDstAccessMask (vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite);
+				cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eEarlyFragmentTests,
+					vk::DependencyFlags(), nullptr, nullptr, depthBarrier);
+			}
+		}
+
+	private:
+		static uint32_t previousPowerOfTwo(uint32_t value)
+		{
+			uint32_t result = 1;
+			while ((result << 1) <= value)
+			{
+				result <<= 1;
+			}
+			return result;
+		}
+
+		void destroyPyramid()
+		{
+			VkDevice logicalDevice = device->GetDevice();
+			for (auto& view : pyramid.mipViews)
+			{
+				vkDestroyImageView(logicalDevice, view, nullptr);
+			}
+			pyramid.mipViews.clear();
+			if (pyramid.view)
+			{
+				vkDestroyImageView(logicalDevice, pyramid.view, nullptr);
+				vkDestroyImage(logicalDevice, pyramid.image, nullptr);
+				vkFreeMemory(logicalDevice, pyramid.memory, nullptr);
+				pyramid.view = VK_NULL_HANDLE;
+			}
+			if (depth.view)
+			{
+				vkDestroyImageView(logicalDevice, depth.view, nullptr);
+				depth.view = VK_NULL_HANDLE;
+			}
+		}
+
+		vk::RenderPass createRenderPass(VkFormat colorFormat, VkFormat depthFormat, bool late, vk::ImageLayout presentLayout)
+		{
+			std::array<vk::AttachmentDescription, 2> attachments;
+			// Color attachment
+			attachments[0].setFormat ((vk::Format)colorFormat)
+				.setSamples			(vk::SampleCountFlagBits::e1)
+				.setLoadOp			(late ? vk::AttachmentLoadOp::eLoad : vk::AttachmentLoadOp::eClear)
+				.setStoreOp			(vk::AttachmentStoreOp::eStore)
+				.setStencilLoadOp	(vk::AttachmentLoadOp::eDontCare)
+				.setStencilStoreOp	(vk::AttachmentStoreOp::eDontCare)
+				.setInitialLayout	(late ? vk::ImageLayout::eColorAttachmentOptimal : vk::ImageLayout::eUndefined)
+				.setFinalLayout		(late ? presentLayout : vk::ImageLayout::eColorAttachmentOptimal);
+			// Depth attachment, both passes leave it in attachment layout for the pyramid build
+			attachments[1].setFormat ((vk::Format)depthFormat)
+				.setSamples			(vk::SampleCountFlagBits::e1)
+				.setLoadOp			(late ? vk::AttachmentLoadOp::eLoad : vk::AttachmentLoadOp::eClear)
+				.setStoreOp			(vk::AttachmentStoreOp::eStore)
+				.setStencilLoadOp	(vk::AttachmentLoadOp::eDontCare)
+				.setStencilStoreOp	(vk::AttachmentStoreOp::eDontCare)
+				.setInitialLayout	(late ? vk::ImageLayout::eDepthStencilAttachmentOptimal : vk::ImageLayout::eUndefined)
+				.setFinalLayout		(vk::ImageLayout::eDepthStencilAttachmentOptimal);
+
+			vk::AttachmentReference colorReference(0, vk::ImageLayout::eColorAttachmentOptimal);
+			vk::AttachmentReference depthReference(1, vk::ImageLayout::eDepthStencilAttachmentOptimal);
+
+			vk::SubpassDescription subpassDescription;
+			subpassDescription.setPipelineBindPoint (vk::PipelineBindPoint::eGraphics)
+				.setColorAttachmentCount (1)
+				.setPColorAttachments (&colorReference)
+				.setPDepthStencilAttachment (&depthReference);
+
+			std::array<vk::SubpassDependency, 2> dependencies;
+			// Wait for the previous color writes (late pass) or presentation (early pass), and for the pyramid build reading the depth attachment
+			dependencies[0].setSrcSubpass (VK_SUBPASS_EXTERNAL)
+				.setDstSubpass		(0)
+				.setSrcStageMask	(vk::PipelineStageFlagBits::eBottomOfPipe | vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eComputeShader)
+				.setDstStageMask	(vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests)
+				.setSrcAccessMask	(vk::AccessFlagBits::eColorAttachmentWrite)
+				.setDstAccessMask	(vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite |
+									 vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite);
+			dependencies[1].setSrcSubpass (0)
+				.setDstSubpass		(VK_SUBPASS_EXTERNAL)
+				.setSrcStageMask	(vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eLateFragmentTests)
+				.setDstStageMask	(vk::PipelineStageFlagBits::eBottomOfPipe | vk::PipelineStageFlagBits::eComputeShader)
+				.setSrcAccessMask	(vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite)
+				.setDstAccessMask	(vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eShaderRead);
+
+			vk::RenderPassCreateInfo renderPassInfo;
+			renderPassInfo.setAttachmentCount (static_cast<uint32_t>(attachments.size()))
+				.setPAttachments (attachments.data())
+				.setSubpassCount (1)
+				.setPSubpasses (&subpassDescription)
+				.setDependencyCount (static_cast<uint32_t>(dependencies.size()))
+				.setPDependencies (dependencies.data());
+			return CHECK(device->D().createRenderPass (renderPassInfo));
+		}
+
+		void prepareDescriptorSetLayouts()
+		{
+			// Culling
+			// Binding 0 : Params (matrices, frustum planes)
+			// Binding 1 : Objects
+			// Binding 2 : Meshes
+			// Binding 3 : Early draw records
+			// Binding 4 : Early draw count
+			// Binding 5 : Late draw records
+			// Binding 6 : Late draw count
+			// Binding 7 : Visibility
+			// Binding 8 : Statistics
+			// Binding 9 : Depth pyramid
+			std::array<vk::DescriptorSetLayoutBinding, 10> cullBindings;
+			for (uint32_t i = 0; i < cullBindings.size(); i++)
+			{
+				cullBindings[i].setBinding (i)
+					.setDescriptorType (vk::DescriptorType::eStorageBuffer)
+					.setDescriptorCount (1)
+					.setStageFlags (vk::ShaderStageFlagBits::eCompute);
+			}
+			cullBindings[0].setDescriptorType (vk::DescriptorType::eUniformBuffer);
+			cullBindings[9].setDescriptorType (vk::DescriptorType::eCombinedImageSampler);
+			vk::DescriptorSetLayoutCreateInfo descriptorLayout;
+			descriptorLayout.setBindingCount (static_cast<uint32_t>(cullBindings.size()))
+				.setPBindings (cullBindings.data());
+			cullSetLayout = CHECK(device->D().createDescriptorSetLayout (descriptorLayout));
+
+			// Downsample
+			// Binding 0 : Source (depth attachment or previous pyramid level)
+			// Binding 1 : Destination pyramid level
+			std::array<vk::DescriptorSetLayoutBinding, 2> downsampleBindings;
+			downsampleBindings[0].setBinding (0)
+				.setDescriptorType (vk::DescriptorType::eCombinedImageSampler)
+				.setDescriptorCount (1)
+				.setStageFlags (vk::ShaderStageFlagBits::eCompute);
+			downsampleBindings[1].setBinding (1)
+				.setDescriptorType (vk::DescriptorType::eStorageImage)
+				.setDescriptorCount (1)
+				.setStageFlags (vk::ShaderStageFlagBits::eCompute);
+			descriptorLayout.setBindingCount (static_cast<uint32_t>(downsampleBindings.size()))
+				.setPBindings (downsampleBindings.data());
+			downsampleSetLayout = CHECK(device->D().createDescriptorSetLayout (descriptorLayout));
+
+			vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo;
+			pipelineLayoutCreateInfo.setSetLayoutCount (1)
+				.setPSetLayouts (&cullSetLayout);
+			cullPipelineLayout = CHECK(device->D().createPipelineLayout (pipelineLayoutCreateInfo));
+
+			// Source and destination size
+			vk::PushConstantRange pushConstantRange(vk::ShaderStageFlagBits::eCompute, 0, 4 * sizeof(uint32_t));
+			pipelineLayoutCreateInfo.setPSetLayouts (&downsampleSetLayout)
+				.setPushConstantRangeCount (1)
+				.setPPushConstantRanges (&pushConstantRange);
+			downsamplePipelineLayout = CHECK(device->D().createPipelineLayout (pipelineLayoutCreateInfo));
+		}
+
+		void preparePipelines(vk::PipelineCache pipelineCache)
+		{
+			// The phase is a specialization constant, so each pipeline only contains the code path of its phase
+			for (uint32_t phase = 0; phase < 2; phase++)
+			{
+				vk::SpecializationMapEntry specializationEntry(0, 0, sizeof(uint32_t));
+				vk::SpecializationInfo specializationInfo(1, &specializationEntry, sizeof(uint32_t), &phase);
+				cullPipelines[phase] = vks::tools::createComputePipeline(device->D(), pipelineCache, cullPipelineLayout, "shaders/hiz_cull.comp.spv", &specializationInfo);
+			}
+			downsamplePipeline = vks::tools::createComputePipeline(device->D(), pipelineCache, downsamplePipelineLayout, "shaders/hiz_downsample.comp.spv");
+		}
+
+		void prepareDescriptorSets()
+		{
+			std::array<vk::DescriptorPoolSize, 4> poolSizes;
+			poolSizes[0].setType (vk::DescriptorType::eUniformBuffer).setDescriptorCount (regionCount);
+			poolSizes[1].setType (vk::DescriptorType::eStorageBuffer).setDescriptorCount (8 * regionCount);
+			poolSizes[2].setType (vk::DescriptorType::eCombinedImageSampler).setDescriptorCount (regionCount + maxMipCount);
+			poolSizes[3].setType (vk::DescriptorType::eStorageImage).setDescriptorCount (maxMipCount);
+			vk::DescriptorPoolCreateInfo descriptorPoolInfo;
+			descriptorPoolInfo.setPoolSizeCount (static_cast<uint32_t>(poolSizes.size()))
+				.setPPoolSizes (poolSizes.data())
+				.setMaxSets (regionCount + maxMipCount);
+			descriptorPool = CHECK(device->D().createDescriptorPool (descriptorPoolInfo));
+
+			std::vector<vk::DescriptorSetLayout> cullLayouts(regionCount, cullSetLayout);
+			vk::DescriptorSetAllocateInfo allocInfo;
+			allocInfo.setDescriptorPool (descriptorPool)
+				.setDescriptorSetCount (regionCount)
+				.setPSetLayouts (cullLayouts.data());
+			cullSets = CHECK(device->D().allocateDescriptorSets (allocInfo));
+
+			// Sets for all possible levels, the pyramid size changes with the window size
+			std::vector<vk::DescriptorSetLayout> downsampleLayouts(maxMipCount, downsampleSetLayout);
+			allocInfo.setDescriptorSetCount (maxMipCount)
+				.setPSetLayouts (downsampleLayouts.data());
+			downsampleSets = CHECK(device->D().allocateDescriptorSets (allocInfo));
+
+			// Buffer bindings don't change on resize
+			for (uint32_t region = 0; region < regionCount; region++)
+			{
+				std::array<vk::DescriptorBufferInfo, 9> bufferInfos = {
+					vk::DescriptorBufferInfo(paramsBuffer.buffer, paramsStride * region, sizeof(Params)),
+					vk::DescriptorBufferInfo(objectBuffer.buffer, 0, VK_WHOLE_SIZE),
+					vk::DescriptorBufferInfo(meshBuffer.buffer, 0, VK_WHOLE_SIZE),
+					vk::DescriptorBufferInfo(earlyDraws.commands.buffer, earlyDraws.regionOffset(region), earlyDraws.regionSize()),
+					vk::DescriptorBufferInfo(earlyDraws.count.buffer, earlyDraws.countOffset(region), sizeof(uint32_t)),
+					vk::DescriptorBufferInfo(lateDraws.commands.buffer, lateDraws.regionOffset(region), lateDraws.regionSize()),
+					vk::DescriptorBufferInfo(lateDraws.count.buffer, lateDraws.countOffset(region), sizeof(uint32_t)),
+					vk::DescriptorBufferInfo(visibilityBuffer.buffer, 0, VK_WHOLE_SIZE),
+					vk::DescriptorBufferInfo(statisticsBuffer.buffer, statisticsStride * region, sizeof(Statistics))
+				};
+				std::array<vk::WriteDescriptorSet, 9> writeDescriptorSets;
+				for (uint32_t i = 0; i < writeDescriptorSets.size(); i++)
+				{
+					writeDescriptorSets[i].setDstSet (cullSets[region])
+						.setDstBinding (i)
+						.setDescriptorCount (1)
+						.setDescriptorType ((i == 0) ? vk::DescriptorType::eUniformBuffer : vk::DescriptorType::eStorageBuffer)
+						.setPBufferInfo (&bufferInfos[i]);
+				}
+				device->D().updateDescriptorSets (writeDescriptorSets, {});
+			}
+		}
+
+		/** @brief Update the image bindings for the current pyramid */
+		void updateDescriptorSets()
+		{
+			std::vector<vk::WriteDescriptorSet> writeDescriptorSets;
+			std::vector<vk::DescriptorImageInfo> imageInfos;
+			imageInfos.reserve(regionCount + 2 * pyramid.mipCount);
+
+			for (uint32_t region = 0; region < regionCount; region++)
+			{
+				imageInfos.push_back(vk::DescriptorImageInfo(sampler, pyramid.view, vk::ImageLayout::eGeneral));
+				writeDescriptorSets.push_back(vk::WriteDescriptorSet(cullSets[region], 9, 0, 1, vk::DescriptorType::eCombinedImageSampler, &imageInfos.back()));
+			}
+			for (uint32_t i = 0; i < pyramid.mipCount; i++)
+			{
+				// Level 0 is reduced from the depth attachment, all others from the previous level
+				if (i == 0)
+				{
+					imageInfos.push_back(vk::DescriptorImageInfo(sampler, depth.view, vk::ImageLayout::eDepthStencilReadOnlyOptimal));
+				}
+				else
+				{
+					imageInfos.push_back(vk::DescriptorImageInfo(sampler, pyramid.mipViews[i - 1], vk::ImageLayout::eGeneral));
+				}
+				writeDescriptorSets.push_back(vk::WriteDescriptorSet(downsampleSets[i], 0, 0, 1, vk::DescriptorType::eCombinedImageSampler, &imageInfos.back()));
+				imageInfos.push_back(vk::DescriptorImageInfo(nullptr, pyramid.mipViews[i], vk::ImageLayout::eGeneral));
+				writeDescriptorSets.push_back(vk::WriteDescriptorSet(downsampleSets[i], 1, 0, 1, vk::DescriptorType::eStorageImage, &imageInfos.back()));
+			}
+			device->D().updateDescriptorSets (writeDescriptorSets, {});
+		}
+	};
+}
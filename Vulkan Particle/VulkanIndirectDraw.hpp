@@ -0,0 +1,266 @@
+#pragma once
+
+/*
+* Vulkan indirect draw classes
+*
+* Mesh arena : All meshes share one vertex and one index buffer, a mesh is just a range inside of them
+* Indirect draw buffer : Draw records (VkDrawIndexedIndirectCommand) and draw count stored in a buffer,
+* so a static command buffer can draw a scene whose draw list changes every frame
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cmath>
+#include <algorithm>
+
+#include "vulkan/vulkan.h"
+#include <vulkan/vulkan.hpp>
+
+#include "vksTools.h"
+#include "VulkanBuffer.hpp"
+#include "VulkanDevice.hpp"
+
+namespace vks
+{
+	/** @brief Range of a mesh inside the shared vertex and index buffers */
+	struct MeshRange
+	{
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		int32_t vertexOffset;
+		/** @brief Radius of a bounding sphere around the mesh origin */
+		float radius;
+	};
+
+	/**
+	* @brief Shared vertex/index storage for all meshes of a scene
+	*
+	* @note Meshes are collected on the host and uploaded to device local memory at once with upload()
+	*/
+	struct MeshArena
+	{
+		vks::Buffer vertexBuffer;
+		vks::Buffer indexBuffer;
+		std::vector<MeshRange> meshes;
+		/** @brief Size of one vertex in bytes, all meshes in an arena must share the same vertex layout */
+		uint32_t vertexStride = 0;
+
+		std::vector<uint8_t> vertexData;
+		std::vector<uint32_t> indexData;
+
+		/**
+		* Append a mesh to the arena
+		*
+		* @param vertices Vertices of the mesh (V must have a float position[3] member for the bounding sphere)
+		* @param indices Indices of the mesh, relative to the first vertex of the mesh
+		*
+		* @return Index of the mesh (into meshes)
+		*/
+		template <typename V>
+		uint32_t addMesh(const std::vector<V> &vertices, const std::vector<uint32_t> &indices)
+		{
+			assert((vertexStride == 0) || (vertexStride == sizeof(V)));
+			vertexStride = sizeof(V);
+
+			MeshRange range;
+			range.firstIndex = static_cast<uint32_t>(indexData.size());
+			range.indexCount = static_cast<uint32_t>(indices.size());
+			range.vertexOffset = static_cast<int32_t>(vertexData.size() / vertexStride);
+			range.radius = 0.0f;
+			for (auto& vertex : vertices)
+			{
+				float lengthSq = vertex.position[0] * vertex.position[0] + vertex.position[1] * vertex.position[1] + vertex.position[2] * vertex.position[2];
+				range.radius = std::max(range.radius, std::sqrt(lengthSq));
+			}
+			meshes.push_back(range);
+
+			const uint8_t *bytes = reinterpret_cast<const uint8_t*>(vertices.data());
+			vertexData.insert(vertexData.end(), bytes, bytes + vertices.size() * sizeof(V));
+			indexData.insert(indexData.end(), indices.begin(), indices.end());
+
+			return static_cast<uint32_t>(meshes.size() - 1);
+		}
+
+		/**
+		* Upload all meshes to device local buffers using a staging buffer
+		*
+		* @param device Device to create the buffers on
+		* @param queue Queue used for the staging copies (waits for completion)
+		*/
+		void upload(vks::VulkanDevice *device, VkQueue queue)
+		{
+			VK_CHECK_RESULT(device->createDeviceLocalBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				&vertexBuffer, vertexData.size(), vertexData.data(), queue));
+			VK_CHECK_RESULT(device->createDeviceLocalBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				&indexBuffer, indexData.size() * sizeof(uint32_t), indexData.data(), queue));
+		}
+
+		/** @brief Bind the shared vertex (at the given binding) and index buffer */
+		void bind(vk::CommandBuffer cmdBuffer, uint32_t binding = 0)
+		{
+			cmdBuffer.bindVertexBuffers (binding, vk::Buffer(vertexBuffer.buffer), {0});
+			cmdBuffer.bindIndexBuffer (indexBuffer.buffer, 0, vk::IndexType::eUint32);
+		}
+
+		void destroy()
+		{
+			vertexBuffer.destroy();
+			indexBuffer.destroy();
+		}
+	};
+
+	/** @brief Device extensions that provide vkCmdDrawIndexedIndirectCount (same signature for both) */
+	static const char* const drawIndirectCountExtensionKHR = "VK_KHR_draw_indirect_count";
+	static const char* const drawIndirectCountExtensionAMD = "VK_AMD_draw_indirect_count";
+
+	typedef void (VKAPI_PTR *PFN_DrawIndexedIndirectCount)(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset,
+		VkBuffer countBuffer, VkDeviceSize countBufferOffset, uint32_t maxDrawCount, uint32_t stride);
+
+	/**
+	* @brief Encapsulates indirect draw records and the draw count
+	*
+	* Like the instance buffer it is split into one region per frame in flight. Command buffers are recorded once
+	* for maxDrawCount records, the host (or a compute shader) decides how many of them are actually drawn.
+	*
+	* Submission path depends on device support:
+	* - Draw count extension : vkCmdDrawIndexedIndirectCount reads the count from the count buffer
+	* - multiDrawIndirect : a single vkCmdDrawIndexedIndirect over all records, unused records have an instance count of zero
+	* - Otherwise : one vkCmdDrawIndexedIndirect per record
+	*/
+	struct IndirectDrawBuffer
+	{
+		vks::Buffer commands;
+		vks::Buffer count;
+		uint32_t maxDrawCount = 0;
+		uint32_t regionCount = 0;
+		/** @brief Regions start at multiples of the storage buffer offset alignment, so they can be bound as storage buffers */
+		VkDeviceSize alignment = 16;
+		/** @brief True if the buffers are host visible and persistently mapped */
+		bool hostAccess = true;
+		/** @brief Number of valid records written to each region by the host */
+		std::vector<uint32_t> drawCounts;
+
+		PFN_DrawIndexedIndirectCount drawIndexedIndirectCount = nullptr;
+		bool multiDrawIndirect = false;
+
+		/**
+		* Create the draw record and count buffers
+		*
+		* @param device Device to create the buffers on (enabled features and extensions select the submission path)
+		* @param maxDrawCount Max. number of draw records per region
+		* @param regionCount Number of regions (frames in flight)
+		* @param hostAccess If true, the buffers are host visible and persistently mapped, else they are device local and written by the device
+		*/
+		void create(vks::VulkanDevice *device, uint32_t maxDrawCount, uint32_t regionCount, bool hostAccess = true)
+		{
+			this->maxDrawCount = maxDrawCount;
+			this->regionCount = regionCount;
+			this->hostAccess = hostAccess;
+			this->alignment = std::max((VkDeviceSize)16, (VkDeviceSize)device->properties.limits.minStorageBufferOffsetAlignment);
+			drawCounts.assign(regionCount, 0);
+
+			vk::MemoryPropertyFlags memoryFlags = hostAccess ?
+				(vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent) :
+				vk::MemoryPropertyFlags(vk::MemoryPropertyFlagBits::eDeviceLocal);
+			const VkBufferUsageFlags usage = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+			VK_CHECK_RESULT(device->createBuffer(usage, memoryFlags, &commands, regionSize() * regionCount));
+			VK_CHECK_RESULT(device->createBuffer(usage, memoryFlags, &count, countRegionSize() * regionCount));
+			if (hostAccess)
+			{
+				VK_CHECK_RESULT(commands.map());
+				VK_CHECK_RESULT(count.map());
+				memset(commands.mapped, 0, regionSize() * regionCount);
+				memset(count.mapped, 0, countRegionSize() * regionCount);
+			}
+
+			multiDrawIndirect = (device->enabledFeatures.multiDrawIndirect == VK_TRUE);
+			if (device->extensionEnabled(drawIndirectCountExtensionKHR))
+			{
+				drawIndexedIndirectCount = reinterpret_cast<PFN_DrawIndexedIndirectCount>(vkGetDeviceProcAddr(device->GetDevice(), "vkCmdDrawIndexedIndirectCountKHR"));
+			}
+			else if (device->extensionEnabled(drawIndirectCountExtensionAMD))
+			{
+				drawIndexedIndirectCount = reinterpret_cast<PFN_DrawIndexedIndirectCount>(vkGetDeviceProcAddr(device->GetDevice(), "vkCmdDrawIndexedIndirectCountAMD"));
+			}
+		}
+
+		void destroy()
+		{
+			commands.unmap();
+			count.unmap();
+			commands.destroy();
+			count.destroy();
+		}
+
+		/** @brief Size of a draw record region in bytes (padded to the alignment) */
+		VkDeviceSize regionSize() const { return alignedSize((VkDeviceSize)maxDrawCount * sizeof(VkDrawIndexedIndirectCommand)); }
+		/** @brief Byte offset of a draw record region */
+		VkDeviceSize regionOffset(uint32_t region) const { return regionSize() * region; }
+		/** @brief Each count occupies a full aligned block */
+		VkDeviceSize countRegionSize() const { return alignment; }
+		/** @brief Byte offset of the draw count of a region */
+		VkDeviceSize countOffset(uint32_t region) const { return countRegionSize() * region; }
+
+		VkDeviceSize alignedSize(VkDeviceSize size) const { return (size + alignment - 1) / alignment * alignment; }
+
+		/** @brief Host pointer to the draw records of a region (host access only) */
+		VkDrawIndexedIndirectCommand* region(uint32_t region)
+		{
+			assert(hostAccess && commands.mapped && region < regionCount);
+			return reinterpret_cast<VkDrawIndexedIndirectCommand*>(static_cast<uint8_t*>(commands.mapped) + regionOffset(region));
+		}
+
+		/**
+		* Finish writing the draw list of a region
+		*
+		* @param region Region the records have been written to with region()
+		* @param drawCount Number of valid records at the start of the region
+		*
+		* @note Records beyond the draw count that were used by the previous list of this region are disabled (instance count 0),
+		* as the paths without the draw count extension always submit all records
+		*/
+		void setDrawCount(uint32_t region, uint32_t drawCount)
+		{
+			assert(drawCount <= maxDrawCount);
+			VkDrawIndexedIndirectCommand *records = this->region(region);
+			for (uint32_t i = drawCount; i < drawCounts[region]; i++)
+			{
+				records[i].instanceCount = 0;
+			}
+			drawCounts[region] = drawCount;
+			*reinterpret_cast<uint32_t*>(static_cast<uint8_t*>(count.mapped) + countOffset(region)) = drawCount;
+		}
+
+		/**
+		* Record the indirect draw(s) of a region
+		*
+		* @note Pipeline, vertex and index buffers must already be bound
+		* @note Only the draw count path skips unused records on the device, the others submit all maxDrawCount records
+		*/
+		void draw(vk::CommandBuffer cmdBuffer, uint32_t region)
+		{
+			const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+			if (drawIndexedIndirectCount)
+			{
+				drawIndexedIndirectCount(cmdBuffer, commands.buffer, regionOffset(region), count.buffer, countOffset(region), maxDrawCount, stride);
+			}
+			else if (multiDrawIndirect)
+			{
+				cmdBuffer.drawIndexedIndirect (commands.buffer, regionOffset(region), maxDrawCount, stride);
+			}
+			else
+			{
+				for (uint32_t i = 0; i < maxDrawCount; i++)
+				{
+					cmdBuffer.drawIndexedIndirect (commands.buffer, regionOffset(region) + i * stride, 1, stride);
+				}
+			}
+		}
+	};
+}
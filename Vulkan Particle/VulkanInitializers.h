@@ -23,7 +23,8 @@ namespace vks
 /////////////////////////////////////////////////////////////////////////////////
 		inline vk::DeviceQueueCreateInfo deviceQueueInfo (uint32_t queueFamilyIndex)
 		{
-			const float defaultQueuePriority(0.0f);
+			// Static, the create info keeps a pointer to it
+			static const float defaultQueuePriority(0.0f);
 			vk::DeviceQueueCreateInfo queueInfo{};
 			queueInfo.setQueueFamilyIndex(queueFamilyIndex)
 				.setQueueCount(1)
@@ -592,5 +593,20 @@ namespace vks
 			specializationInfo.pData = data;
 			return specializationInfo;
 		}
+
+		/** @brief Initialize a buffer memory barrier for a buffer range with no queue family ownership transfer */
+		inline vk::BufferMemoryBarrier bufferBarrier(vk::Buffer buffer, vk::AccessFlags srcAccessMask, vk::AccessFlags dstAccessMask,
+			vk::DeviceSize offset = 0, vk::DeviceSize size = VK_WHOLE_SIZE)
+		{
+			vk::BufferMemoryBarrier bufferBarrier;
+			bufferBarrier.setSrcAccessMask (srcAccessMask)
+				.setDstAccessMask (dstAccessMask)
+				.setSrcQueueFamilyIndex (VK_QUEUE_FAMILY_IGNORED)
+				.setDstQueueFamilyIndex (VK_QUEUE_FAMILY_IGNORED)
+				.setBuffer (buffer)
+				.setOffset (offset)
+				.setSize (size);
+			return bufferBarrier;
+		}
 	}
 }
\ No newline at end of file
@@ -0,0 +1,144 @@
+#pragma once
+
+/*
+* Vulkan instance buffer class
+*
+* Per-instance vertex attribute stream (transform + color) backed by a persistently mapped buffer
+* Bound as a second vertex binding with VK_VERTEX_INPUT_RATE_INSTANCE so a whole scene of copies can be drawn in one call
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include <vulkan/vulkan.hpp>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include "vksTools.h"
+#include "VulkanBuffer.hpp"
+#include "VulkanDevice.hpp"
+
+namespace vks
+{
+	/**
+	* @brief Per-instance data layout as seen by the vertex shader
+	*
+	* Matches the following shader layout (see instancing.vert):
+	*	layout (location = 2) in mat4 instanceModel;	(occupies locations 2..5)
+	*	layout (location = 6) in vec4 instanceColor;
+	*/
+	struct InstanceData
+	{
+		glm::mat4 model;
+		glm::vec4 color;
+	};
+
+	/**
+	* @brief Encapsulates a persistently mapped per-instance vertex buffer
+	*
+	* @note The buffer holds one region per frame in flight (usually one per swap chain image), so the host
+	* can write the region of the current frame while the device still reads the others
+	*/
+	struct InstanceBuffer
+	{
+		vks::Buffer buffer;
+		/** @brief Max. number of instances per region */
+		uint32_t capacity = 0;
+		/** @brief Number of regions (frames in flight) */
+		uint32_t regionCount = 0;
+		/** @brief Number of instances written to each region */
+		uint32_t count = 0;
+
+		/**
+		* Create the buffer and keep it mapped for the lifetime of the object
+		*
+		* @param device Device to create the buffer on
+		* @param capacity Max. number of instances per region
+		* @param regionCount Number of regions (frames in flight)
+		*/
+		void create(vks::VulkanDevice *device, uint32_t capacity, uint32_t regionCount)
+		{
+			this->capacity = capacity;
+			this->regionCount = regionCount;
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+				&buffer, regionSize() * regionCount));
+			// Persistent mapping, host coherent memory makes explicit flushes unnecessary
+			VK_CHECK_RESULT(buffer.map());
+		}
+
+		void destroy()
+		{
+			buffer.unmap();
+			buffer.destroy();
+		}
+
+		/** @brief Size of a single region in bytes */
+		VkDeviceSize regionSize() const { return (VkDeviceSize)capacity * sizeof(InstanceData); }
+
+		/** @brief Byte offset of a region, to be passed to vkCmdBindVertexBuffers */
+		VkDeviceSize regionOffset(uint32_t region) const { return regionSize() * region; }
+
+		/**
+		* Get a host pointer to the instances of a region
+		*
+		* @note Only write to a region once the frame that last used it has finished executing (fence wait)
+		*/
+		InstanceData* region(uint32_t region)
+		{
+			assert(buffer.mapped && region < regionCount);
+			return reinterpret_cast<InstanceData*>(static_cast<uint8_t*>(buffer.mapped) + regionOffset(region));
+		}
+
+		/** @brief Copy the same instance data to all regions (for static scenes) */
+		void writeAll(const std::vector<InstanceData> &instances)
+		{
+			count = std::min(capacity, static_cast<uint32_t>(instances.size()));
+			for (uint32_t i = 0; i < regionCount; i++)
+			{
+				memcpy(region(i), instances.data(), count * sizeof(InstanceData));
+			}
+		}
+
+		/** @brief Vertex input binding with per-instance input rate */
+		static vk::VertexInputBindingDescription bindingDescription(uint32_t binding)
+		{
+			vk::VertexInputBindingDescription desc;
+			desc.setBinding (binding)
+				.setStride (sizeof(InstanceData))
+				.setInputRate (vk::VertexInputRate::eInstance);
+			return desc;
+		}
+
+		/**
+		* Attribute descriptions for the instance binding
+		*
+		* @param binding Binding point the instance buffer is bound to
+		* @param firstLocation First shader location, the mat4 takes four consecutive locations followed by the color
+		*/
+		static std::array<vk::VertexInputAttributeDescription, 5> attributeDescriptions(uint32_t binding, uint32_t firstLocation)
+		{
+			std::array<vk::VertexInputAttributeDescription, 5> attributes;
+			// A mat4 attribute is passed as four vec4 columns
+			for (uint32_t i = 0; i < 4; i++)
+			{
+				attributes[i].setBinding (binding)
+					.setLocation (firstLocation + i)
+					.setFormat (vk::Format::eR32G32B32A32Sfloat)
+					.setOffset (offsetof(InstanceData, model) + i * sizeof(glm::vec4));
+			}
+			attributes[4].setBinding (binding)
+				.setLocation (firstLocation + 4)
+				.setFormat (vk::Format::eR32G32B32A32Sfloat)
+				.setOffset (offsetof(InstanceData, color));
+			return attributes;
+		}
+	};
+}
@@ -0,0 +1,503 @@
+#pragma once
+
+/*
+* Vulkan particle emitter class
+*
+* Fixed size particle pool with emission and death handled entirely on the device:
+* - Free pool slots are kept in a dead list (stack of indices), live ones in two alive lists that alternate every frame
+* - Emit    : pops slots from the dead list for this frame's new particles and appends them to the current alive list
+* - Update  : indirect dispatch over the current alive list, expired particles go back to the dead list,
+*             survivors are compacted into the next alive list with an atomic counter
+* - Draw    : indirect draw of the next alive list, the vertex count is written by the device
+* The host only writes a small per-frame parameter block (emitter positions and spawn counts) and reads the counters
+* of a frame once its fence has been signaled, so nothing waits on the device.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <iostream>
+#include <cassert>
+#include <cstddef>
+
+#include "vulkan/vulkan.h"
+#include <vulkan/vulkan.hpp>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include "vksTools.h"
+#include "VulkanBuffer.hpp"
+#include "VulkanDevice.hpp"
+#include "VulkanInitializers.h"
+
+namespace vks
+{
+	struct ParticleEmitters
+	{
+		/** @brief Must match local_size_x of particle_emit.comp */
+		static const uint32_t emitGroupSize = 64;
+		/** @brief Must match local_size_x of particle_update.comp (and updateGroupSize of particle_args.comp) */
+		static const uint32_t updateGroupSize = 256;
+		/** @brief Must match the size of the emitters array in particle_emit.comp */
+		static const uint32_t maxEmitters = 8;
+
+		/** @brief Pool entry, layout matches the Particle struct of the shaders (std430) */
+		struct Particle
+		{
+			/** @brief xyz = position, w = remaining lifetime */
+			glm::vec4 position;
+			glm::vec3 velocity;
+			/** @brief RGBA8 */
+			uint32_t color;
+		};
+
+		/** @brief Host side emitter state */
+		struct Emitter
+		{
+			glm::vec3 position = glm::vec3(0.0f);
+			/** @brief Max. random start velocity per axis */
+			float spread = 1.0f;
+			glm::vec3 velocity = glm::vec3(0.0f, -3.0f, 0.0f);
+			/** @brief Max. lifetime in seconds (particles live between half and all of it) */
+			float lifetime = 1.0f;
+			glm::vec4 color = glm::vec4(1.0f);
+			/** @brief Particles per second */
+			float rate = 0.0f;
+			/** @brief Fractional particles carried over to the next frame */
+			float accumulator = 0.0f;
+		};
+
+		/** @brief Layout matches the Emitter struct of particle_emit.comp (std140) */
+		struct EmitterParams
+		{
+			glm::vec4 position;
+			glm::vec4 velocity;
+			glm::vec4 color;
+			uint32_t first;
+			uint32_t count;
+			uint32_t pad[2];
+		};
+
+		/** @brief Layout matches the Params block of the compute shaders (std140) */
+		struct Params
+		{
+			/** @brief xyz = acceleration, w = time step */
+			glm::vec4 gravity;
+			float damping;
+			float floorHeight;
+			float restitution;
+			uint32_t emitCount;
+			uint32_t emitterCount;
+			uint32_t seed;
+			uint32_t pad[2];
+			EmitterParams emitters[maxEmitters];
+		};
+
+		/** @brief Layout matches the Counters block of the compute shaders (std430), also used as indirect argument buffer */
+		struct Counters
+		{
+			/** @brief Indirect dispatch of the update pass (x, y, z, unused) */
+			uint32_t dispatch[4];
+			/** @brief Indirect draw of the live particles, vertexCount = live particles after the update */
+			VkDrawIndirectCommand draw;
+			/** @brief Number of free pool slots */
+			int32_t deadCount;
+			uint32_t aliveCount[2];
+			/** @brief Particles spawned and expired in the frame */
+			uint32_t emitted;
+			uint32_t died;
+		};
+
+		vks::VulkanDevice *device = nullptr;
+		bool prepared = false;
+		uint32_t regionCount = 0;
+		uint32_t maxParticles = 0;
+		/** @brief Max. number of particles spawned per frame (sizes the emit dispatch) */
+		uint32_t maxEmitPerFrame = 0;
+
+		glm::vec3 gravity = glm::vec3(0.0f, 4.0f, 0.0f);
+		float damping = 0.995f;
+		float floorHeight = 1.0f;
+		float restitution = 0.5f;
+		std::vector<Emitter> emitters;
+
+		/** @brief Particle pool, device local */
+		vks::Buffer particleBuffer;
+		/** @brief Two lists of maxParticles indices, device local */
+		vks::Buffer aliveBuffer;
+		/** @brief Indices of free pool slots, device local */
+		vks::Buffer deadBuffer;
+		/** @brief Counters and indirect arguments, device local */
+		vks::Buffer counterBuffer;
+		/** @brief Per-region params (host visible, persistently mapped) */
+		vks::Buffer paramsBuffer;
+		VkDeviceSize paramsStride = 0;
+		/** @brief Per-region copy of the counters at the end of the frame (host visible, read once the region's fence has been signaled) */
+		vks::Buffer statisticsBuffer;
+		VkDeviceSize statisticsStride = 0;
+
+		vk::DescriptorSetLayout computeSetLayout;
+		vk::DescriptorSetLayout drawSetLayout;
+		vk::PipelineLayout computePipelineLayout;
+		/** @brief Layout of the draw pipeline (created by the application, see particle_alive.vert) */
+		vk::PipelineLayout drawPipelineLayout;
+		vk::Pipeline emitPipeline;
+		vk::Pipeline updatePipeline;
+		/** @brief Update dispatch and draw arguments (specialization constant) */
+		std::array<vk::Pipeline, 2> argsPipelines;
+		vk::DescriptorPool descriptorPool;
+		/** @brief One compute descriptor set per region */
+		std::vector<vk::DescriptorSet> computeSets;
+		vk::DescriptorSet drawSet;
+
+		/** @brief Alive list read by the next update, alternates every frame */
+		uint32_t current = 0;
+		/** @brief Particles spawned by the frame being recorded */
+		uint32_t emitCount = 0;
+		uint64_t frameIndex = 0;
+
+		/** @brief Counters of the most recently completed frame */
+		Counters statistics = {};
+
+		/**
+		* Create all resources
+		*
+		* @param device Device to create the resources on
+		* @param queue Queue used for the initial uploads
+		* @param pipelineCache Pipeline cache to use
+		* @param maxParticles Size of the particle pool
+		* @param maxEmitPerFrame Max. number of particles spawned per frame
+		* @param camera Uniform buffer with the camera matrices (binding 0 of the draw set)
+		* @param regionCount Number of frames in flight (command buffers)
+		*/
+		void prepare(vks::VulkanDevice *device, VkQueue queue, vk::PipelineCache pipelineCache, uint32_t maxParticles, uint32_t maxEmitPerFrame,
+			const vk::DescriptorBufferInfo &camera, uint32_t regionCount)
+		{
+			this->device = device;
+			this->regionCount = regionCount;
+			this->maxParticles = maxParticles;
+			this->maxEmitPerFrame = std::min(maxEmitPerFrame, maxParticles);
+
+			// All slots start out free, the dead list is used as a stack (top = deadCount - 1)
+			std::vector<uint32_t> deadList(maxParticles);
+			std::iota(deadList.begin(), deadList.end(), 0u);
+			Counters counters = {};
+			counters.dispatch[1] = counters.dispatch[2] = 1;
+			counters.draw.instanceCount = 1;
+			counters.deadCount = static_cast<int32_t>(maxParticles);
+
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, vk::MemoryPropertyFlagBits::eDeviceLocal,
+				&particleBuffer, maxParticles * sizeof(Particle)));
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, vk::MemoryPropertyFlagBits::eDeviceLocal,
+				&aliveBuffer, 2 * maxParticles * sizeof(uint32_t)));
+			VK_CHECK_RESULT(device->createDeviceLocalBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &deadBuffer,
+				deadList.size() * sizeof(uint32_t), deadList.data(), queue));
+			VK_CHECK_RESULT(device->createDeviceLocalBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				&counterBuffer, sizeof(Counters), &counters, queue));
+
+			const VkDeviceSize uniformAlignment = device->properties.limits.minUniformBufferOffsetAlignment;
+			const VkDeviceSize copyAlignment = 16;
+			paramsStride = (sizeof(Params) + uniformAlignment - 1) / uniformAlignment * uniformAlignment;
+			statisticsStride = (sizeof(Counters) + copyAlignment - 1) / copyAlignment * copyAlignment;
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, &paramsBuffer, paramsStride * regionCount));
+			VK_CHECK_RESULT(paramsBuffer.map());
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, &statisticsBuffer, statisticsStride * regionCount));
+			VK_CHECK_RESULT(statisticsBuffer.map());
+			memset(statisticsBuffer.mapped, 0, statisticsStride * regionCount);
+
+			prepareDescriptorSetLayouts();
+			preparePipelines(pipelineCache);
+			prepareDescriptorSets(camera);
+			prepared = true;
+		}
+
+		void destroy()
+		{
+			if (!device)
+			{
+				return;
+			}
+			device->D().destroyPipeline (emitPipeline);
+			device->D().destroyPipeline (updatePipeline);
+			device->D().destroyPipeline (argsPipelines[0]);
+			device->D().destroyPipeline (argsPipelines[1]);
+			device->D().destroyPipelineLayout (computePipelineLayout);
+			device->D().destroyPipelineLayout (drawPipelineLayout);
+			device->D().destroyDescriptorSetLayout (computeSetLayout);
+			device->D().destroyDescriptorSetLayout (drawSetLayout);
+			device->D().destroyDescriptorPool (descriptorPool);
+			particleBuffer.destroy();
+			aliveBuffer.destroy();
+			deadBuffer.destroy();
+			counterBuffer.destroy();
+			paramsBuffer.unmap();
+			paramsBuffer.destroy();
+			statisticsBuffer.unmap();
+			statisticsBuffer.destroy();
+		}
+
+		/** @brief Continuous emission rate of all emitters (particles per second) */
+		float emissionRate() const
+		{
+			float rate = 0.0f;
+			for (auto& emitter : emitters)
+			{
+				rate += emitter.rate;
+			}
+			return rate;
+		}
+
+		/**
+		* Advance the emitters, write the per-frame parameters of a region and fetch the counters of its previous use
+		*
+		* @param region Region of the frame about to be recorded (its fence must have been waited on)
+		* @param dt Time step in seconds
+		*
+		* @note Must be called once per frame before buildCommandBuffer, it flips the alive lists
+		*/
+		void updateFrame(uint32_t region, float dt)
+		{
+			assert(emitters.size() <= maxEmitters);
+			statistics = *reinterpret_cast<Counters*>(static_cast<uint8_t*>(statisticsBuffer.mapped) + statisticsStride * region);
+
+			Params *params = reinterpret_cast<Params*>(static_cast<uint8_t*>(paramsBuffer.mapped) + paramsStride * region);
+			params->gravity = glm::vec4(gravity, dt);
+			params->damping = damping;
+			params->floorHeight = floorHeight;
+			params->restitution = restitution;
+			params->emitterCount = static_cast<uint32_t>(emitters.size());
+			params->seed = static_cast<uint32_t>(frameIndex);
+
+			// Spawn counts of this frame, the remainder is carried over so low rates still emit on average
+			emitCount = 0;
+			for (uint32_t i = 0; i < emitters.size(); i++)
+			{
+				Emitter &emitter = emitters[i];
+				emitter.accumulator += emitter.rate * dt;
+				const uint32_t count = std::min(static_cast<uint32_t>(emitter.accumulator), maxEmitPerFrame - emitCount);
+				emitter.accumulator = std::min(emitter.accumulator - (float)count, 1.0f);
+
+				EmitterParams &emitterParams = params->emitters[i];
+				emitterParams.position = glm::vec4(emitter.position, emitter.spread);
+				emitterParams.velocity = glm::vec4(emitter.velocity, emitter.lifetime);
+				emitterParams.color = emitter.color;
+				emitterParams.first = emitCount;
+				emitterParams.count = count;
+				emitCount += count;
+			}
+			params->emitCount = emitCount;
+
+			// The list compacted by the previous frame's update is this frame's input
+			current = static_cast<uint32_t>(frameIndex & 1);
+			frameIndex++;
+		}
+
+		/**
+		* Record emission, update and the argument passes of a frame
+		*
+		* @note Must be recorded outside of a render pass, on the queue that draws the particles
+		*/
+		void buildCommandBuffer(vk::CommandBuffer cmdBuffer, uint32_t region)
+		{
+			const std::array<uint32_t, 2> pushConstants = { current, maxParticles };
+			vk::MemoryBarrier computeBarrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+
+			// The previous frame's draw and counter copy are done with the lists before they are modified
+			vk::MemoryBarrier frameBarrier(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eTransferRead,
+				vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferWrite);
+			cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eTransfer,
+				vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags(), frameBarrier, nullptr, nullptr);
+			// Per-frame statistics (emitted, died)
+			cmdBuffer.fillBuffer (counterBuffer.buffer, offsetof(Counters, emitted), 2 * sizeof(uint32_t), 0);
+			vk::BufferMemoryBarrier fillBarrier = vks::initializers::bufferBarrier(counterBuffer.buffer, vk::AccessFlagBits::eTransferWrite,
+				vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+			cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader,
+				vk::DependencyFlags(), nullptr, fillBarrier, nullptr);
+
+			cmdBuffer.bindDescriptorSets (vk::PipelineBindPoint::eCompute, computePipelineLayout, 0, computeSets[region], {});
+			cmdBuffer.pushConstants (computePipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(pushConstants), pushConstants.data());
+
+			if (emitCount > 0)
+			{
+				cmdBuffer.bindPipeline (vk::PipelineBindPoint::eCompute, emitPipeline);
+				cmdBuffer.dispatch ((emitCount + emitGroupSize - 1) / emitGroupSize, 1, 1);
+				cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+					vk::DependencyFlags(), computeBarrier, nullptr, nullptr);
+			}
+
+			// Update dispatch size from the current alive count
+			cmdBuffer.bindPipeline (vk::PipelineBindPoint::eCompute, argsPipelines[0]);
+			cmdBuffer.dispatch (1, 1, 1);
+			vk::MemoryBarrier argsBarrier(vk::AccessFlagBits::eShaderWrite,
+				vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+			cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eComputeShader,
+				vk::DependencyFlags(), argsBarrier, nullptr, nullptr);
+
+			cmdBuffer.bindPipeline (vk::PipelineBindPoint::eCompute, updatePipeline);
+			cmdBuffer.dispatchIndirect (counterBuffer.buffer, offsetof(Counters, dispatch));
+			cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+				vk::DependencyFlags(), computeBarrier, nullptr, nullptr);
+
+			// Draw arguments from the compacted alive count
+			cmdBuffer.bindPipeline (vk::PipelineBindPoint::eCompute, argsPipelines[1]);
+			cmdBuffer.dispatch (1, 1, 1);
+			vk::MemoryBarrier drawBarrier(vk::AccessFlagBits::eShaderWrite,
+				vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eTransferRead);
+			cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eComputeShader,
+				vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eTransfer,
+				vk::DependencyFlags(), drawBarrier, nullptr, nullptr);
+
+			// Counters of this frame for the host, read after the region's fence instead of stalling on a readback
+			cmdBuffer.copyBuffer (counterBuffer.buffer, statisticsBuffer.buffer, vk::BufferCopy(0, statisticsStride * region, sizeof(Counters)));
+			vk::BufferMemoryBarrier hostBarrier = vks::initializers::bufferBarrier(statisticsBuffer.buffer, vk::AccessFlagBits::eTransferWrite,
+				vk::AccessFlagBits::eHostRead, statisticsStride * region, statisticsStride);
+			cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost,
+				vk::DependencyFlags(), nullptr, hostBarrier, nullptr);
+		}
+
+		/**
+		* Draw the live particles (expects a point list pipeline created with drawPipelineLayout)
+		*
+		* @note Must be recorded inside a render pass after buildCommandBuffer of the same frame
+		*/
+		void draw(vk::CommandBuffer cmdBuffer)
+		{
+			const std::array<uint32_t, 2> pushConstants = { 1 - current, maxParticles };
+			cmdBuffer.bindDescriptorSets (vk::PipelineBindPoint::eGraphics, drawPipelineLayout, 0, drawSet, {});
+			cmdBuffer.pushConstants (drawPipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(pushConstants), pushConstants.data());
+			cmdBuffer.drawIndirect (counterBuffer.buffer, offsetof(Counters, draw), 1, sizeof(VkDrawIndirectCommand));
+		}
+
+	private:
+		void prepareDescriptorSetLayouts()
+		{
+			// Compute
+			// Binding 0 : Params
+			// Binding 1 : Particles
+			// Binding 2 : Alive lists
+			// Binding 3 : Dead list
+			// Binding 4 : Counters
+			std::array<vk::DescriptorSetLayoutBinding, 5> computeBindings;
+			for (uint32_t i = 0; i < computeBindings.size(); i++)
+			{
+				computeBindings[i].setBinding (i)
+					.setDescriptorType ((i == 0) ? vk::DescriptorType::eUniformBuffer : vk::DescriptorType::eStorageBuffer)
+					.setDescriptorCount (1)
+					.setStageFlags (vk::ShaderStageFlagBits::eCompute);
+			}
+			vk::DescriptorSetLayoutCreateInfo descriptorLayout;
+			descriptorLayout.setBindingCount (static_cast<uint32_t>(computeBindings.size()))
+				.setPBindings (computeBindings.data());
+			computeSetLayout = CHECK(device->D().createDescriptorSetLayout (descriptorLayout));
+
+			// Draw
+			// Binding 0 : Camera matrices
+			// Binding 1 : Particles
+			// Binding 2 : Alive lists
+			std::array<vk::DescriptorSetLayoutBinding, 3> drawBindings;
+			for (uint32_t i = 0; i < drawBindings.size(); i++)
+			{
+				drawBindings[i].setBinding (i)
+					.setDescriptorType ((i == 0) ? vk::DescriptorType::eUniformBuffer : vk::DescriptorType::eStorageBuffer)
+					.setDescriptorCount (1)
+					.setStageFlags (vk::ShaderStageFlagBits::eVertex);
+			}
+			descriptorLayout.setBindingCount (static_cast<uint32_t>(drawBindings.size()))
+				.setPBindings (drawBindings.data());
+			drawSetLayout = CHECK(device->D().createDescriptorSetLayout (descriptorLayout));
+
+			// Alive list selection and list size
+			vk::PushConstantRange pushConstantRange(vk::ShaderStageFlagBits::eCompute, 0, 2 * sizeof(uint32_t));
+			vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo;
+			pipelineLayoutCreateInfo.setSetLayoutCount (1)
+				.setPSetLayouts (&computeSetLayout)
+				.setPushConstantRangeCount (1)
+				.setPPushConstantRanges (&pushConstantRange);
+			computePipelineLayout = CHECK(device->D().createPipelineLayout (pipelineLayoutCreateInfo));
+
+			pushConstantRange.setStageFlags (vk::ShaderStageFlagBits::eVertex);
+			pipelineLayoutCreateInfo.setPSetLayouts (&drawSetLayout);
+			drawPipelineLayout = CHECK(device->D().createPipelineLayout (pipelineLayoutCreateInfo));
+		}
+
+		void preparePipelines(vk::PipelineCache pipelineCache)
+		{
+			emitPipeline = vks::tools::createComputePipeline(device->D(), pipelineCache, computePipelineLayout, "shaders/particle_emit.comp.spv");
+			updatePipeline = vks::tools::createComputePipeline(device->D(), pipelineCache, computePipelineLayout, "shaders/particle_update.comp.spv");
+			for (uint32_t mode = 0; mode < 2; mode++)
+			{
+				vk::SpecializationMapEntry specializationEntry(0, 0, sizeof(uint32_t));
+				vk::SpecializationInfo specializationInfo(1, &specializationEntry, sizeof(uint32_t), &mode);
+				argsPipelines[mode] = vks::tools::createComputePipeline(device->D(), pipelineCache, computePipelineLayout, "shaders/particle_args.comp.spv", &specializationInfo);
+			}
+		}
+
+		void prepareDescriptorSets(const vk::DescriptorBufferInfo &camera)
+		{
+			std::array<vk::DescriptorPoolSize, 2> poolSizes;
+			poolSizes[0].setType (vk::DescriptorType::eUniformBuffer).setDescriptorCount (regionCount + 1);
+			poolSizes[1].setType (vk::DescriptorType::eStorageBuffer).setDescriptorCount (4 * regionCount + 2);
+			vk::DescriptorPoolCreateInfo descriptorPoolInfo;
+			descriptorPoolInfo.setPoolSizeCount (static_cast<uint32_t>(poolSizes.size()))
+				.setPPoolSizes (poolSizes.data())
+				.setMaxSets (regionCount + 1);
+			descriptorPool = CHECK(device->D().createDescriptorPool (descriptorPoolInfo));
+
+			std::vector<vk::DescriptorSetLayout> computeLayouts(regionCount, computeSetLayout);
+			vk::DescriptorSetAllocateInfo allocInfo;
+			allocInfo.setDescriptorPool (descriptorPool)
+				.setDescriptorSetCount (regionCount)
+				.setPSetLayouts (computeLayouts.data());
+			computeSets = CHECK(device->D().allocateDescriptorSets (allocInfo));
+			allocInfo.setDescriptorSetCount (1)
+				.setPSetLayouts (&drawSetLayout);
+			drawSet = CHECK(device->D().allocateDescriptorSets (allocInfo))[0];
+
+			for (uint32_t region = 0; region < regionCount; region++)
+			{
+				std::array<vk::DescriptorBufferInfo, 5> bufferInfos = {
+					vk::DescriptorBufferInfo(paramsBuffer.buffer, paramsStride * region, sizeof(Params)),
+					vk::DescriptorBufferInfo(particleBuffer.buffer, 0, VK_WHOLE_SIZE),
+					vk::DescriptorBufferInfo(aliveBuffer.buffer, 0, VK_WHOLE_SIZE),
+					vk::DescriptorBufferInfo(deadBuffer.buffer, 0, VK_WHOLE_SIZE),
+					vk::DescriptorBufferInfo(counterBuffer.buffer, 0, VK_WHOLE_SIZE)
+				};
+				std::array<vk::WriteDescriptorSet, 5> writeDescriptorSets;
+				for (uint32_t i = 0; i < writeDescriptorSets.size(); i++)
+				{
+					writeDescriptorSets[i].setDstSet (computeSets[region])
+						.setDstBinding (i)
+						.setDescriptorCount (1)
+						.setDescriptorType ((i == 0) ? vk::DescriptorType::eUniformBuffer : vk::DescriptorType::eStorageBuffer)
+						.setPBufferInfo (&bufferInfos[i]);
+				}
+				device->D().updateDescriptorSets (writeDescriptorSets, {});
+			}
+
+			std::array<vk::DescriptorBufferInfo, 3> drawInfos = {
+				camera,
+				vk::DescriptorBufferInfo(particleBuffer.buffer, 0, VK_WHOLE_SIZE),
+				vk::DescriptorBufferInfo(aliveBuffer.buffer, 0, VK_WHOLE_SIZE)
+			};
+			std::array<vk::WriteDescriptorSet, 3> writeDescriptorSets;
+			for (uint32_t i = 0; i < writeDescriptorSets.size(); i++)
+			{
+				writeDescriptorSets[i].setDstSet (drawSet)
+					.setDstBinding (i)
+					.setDescriptorCount (1)
+					.setDescriptorType ((i == 0) ? vk::DescriptorType::eUniformBuffer : vk::DescriptorType::eStorageBuffer)
+					.setPBufferInfo (&drawInfos[i]);
+			}
+			device->D().updateDescriptorSets (writeDescriptorSets, {});
+		}
+	};
+}
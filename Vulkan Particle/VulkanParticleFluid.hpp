@@ -0,0 +1,326 @@
+#pragma once
+
+/*
+* Vulkan particle fluid class
+*
+* Smoothed particle hydrodynamics (SPH) fluid in compute passes, per substep:
+* - Neighbor search : uniform grid with the kernel radius as cell size (see VulkanParticleGrid.hpp)
+* - Density         : density (poly6 kernel) and pressure of each particle
+* - Forces          : pressure (spiky kernel) and viscosity forces, integration and container walls
+* Every frame advances the simulation by a fixed time, split into substeps that keep the time step below the CFL limit.
+* The kernel radius and the workgroup size are specialization constants of the SPH shaders.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <array>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+#include "vulkan/vulkan.h"
+#include <vulkan/vulkan.hpp>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include "vksTools.h"
+#include "VulkanBuffer.hpp"
+#include "VulkanDevice.hpp"
+#include "VulkanInitializers.h"
+#include "VulkanParticleSystem.hpp"
+#include "VulkanParticleGrid.hpp"
+
+namespace vks
+{
+	/** @brief Fluid parameters, layout matches the std140 uniform block of the SPH shaders */
+	struct FluidParams
+	{
+		/** @brief xyz = acceleration, w = substep time (set by ParticleFluid::prepare) */
+		glm::vec4 gravity = glm::vec4(0.0f, 4.0f, 0.0f, 0.0f);
+		/** @brief xyz = min. corner of the container, w = fraction of the velocity kept when hitting a wall */
+		glm::vec4 boundsMin = glm::vec4(-1.0f, -1.0f, -0.5f, 0.5f);
+		/** @brief xyz = max. corner of the container (+y points down, so this is the floor) */
+		glm::vec4 boundsMax = glm::vec4(1.0f, 1.0f, 0.5f, 0.0f);
+		float restDensity = 1000.0f;
+		/** @brief Pressure per density above the rest density (squared speed of sound) */
+		float stiffness = 50.0f;
+		float viscosity = 3.0f;
+		/** @brief Set by ParticleFluid::prepare, the initial particle lattice has the rest density */
+		float particleMass = 0.0f;
+	};
+
+	/**
+	* @brief SPH fluid in a single particle buffer, simulated and drawn on the graphics queue
+	*
+	* The initial state is a block of fluid at the left wall of the container (dam break)
+	*/
+	struct ParticleFluid
+	{
+		/** @brief Default of the workgroup size specialization constant */
+		static const uint32_t defaultWorkgroupSize = 128;
+
+		vks::VulkanDevice *device = nullptr;
+		FluidParams params;
+		uint32_t particleCount = 0;
+		/** @brief Smoothing kernel radius (twice the initial particle spacing), also the grid cell size */
+		float kernelRadius = 0.0f;
+		uint32_t workgroupSize = defaultWorkgroupSize;
+		/** @brief Simulated time per frame, independent of the frame rate */
+		float frameTime = 1.0f / 60.0f;
+		uint32_t substeps = 1;
+
+		/** @brief Particle state, also drawn as vertex buffer */
+		vks::Buffer particleBuffer;
+		/** @brief Density and pressure per particle (in grid cell order) */
+		vks::Buffer densityBuffer;
+		vks::Buffer paramsBuffer;
+		/** @brief Neighbor search, set 0 of the SPH passes */
+		vks::ParticleGrid grid;
+
+		vk::DescriptorSetLayout descriptorSetLayout;
+		vk::PipelineLayout pipelineLayout;
+		vk::Pipeline densityPipeline;
+		vk::Pipeline forcesPipeline;
+		vk::DescriptorPool descriptorPool;
+		vk::DescriptorSet descriptorSet;
+
+		/**
+		* Create the particles, the neighbor search and the SPH pipelines
+		*
+		* @param device Device to create the resources on
+		* @param queue Queue used for the initial upload
+		* @param pipelineCache Pipeline cache to use
+		* @param particleCount Number of particles
+		* @param params Fluid parameters (substep time and particle mass are set by this function)
+		* @param substeps Substeps per frame, 0 selects the number needed for a CFL number of 0.4
+		* @param workgroupSize Local size of the SPH passes (clamped to the device limits)
+		*/
+		void prepare(vks::VulkanDevice *device, vk::Queue queue, vk::PipelineCache pipelineCache, uint32_t particleCount, const FluidParams &params = FluidParams(),
+			uint32_t substeps = 0, uint32_t workgroupSize = defaultWorkgroupSize)
+		{
+			this->device = device;
+			this->params = params;
+			const vk::PhysicalDeviceLimits &limits = device->properties.limits;
+			this->workgroupSize = std::max(std::min({ workgroupSize, limits.maxComputeWorkGroupSize[0], limits.maxComputeWorkGroupInvocations }), 1u);
+			const uint64_t maxParticleCount = (uint64_t)limits.maxComputeWorkGroupCount[0] * std::min(this->workgroupSize, ParticleGrid::workgroupSize);
+			if (particleCount > maxParticleCount)
+			{
+				std::cerr << "Fluid particle count exceeds the max. dispatch size, clamped to " << maxParticleCount << std::endl;
+				particleCount = static_cast<uint32_t>(maxParticleCount);
+			}
+			this->particleCount = particleCount;
+
+			// Dam break: a block of half the container width and 60% of its height, particles on a cubic lattice
+			const glm::vec3 boundsMin = glm::vec3(params.boundsMin);
+			const glm::vec3 boundsMax = glm::vec3(params.boundsMax);
+			const glm::vec3 block = (boundsMax - boundsMin) * glm::vec3(0.5f, 0.6f, 1.0f);
+			const float spacing = std::cbrt(block.x * block.y * block.z / particleCount);
+			kernelRadius = 2.0f * spacing;
+			const uint32_t columns = std::max(static_cast<uint32_t>(block.x / spacing), 1u);
+			const uint32_t rows = std::max(static_cast<uint32_t>(block.z / spacing), 1u);
+			std::vector<Particle> particles(particleCount);
+			for (uint32_t i = 0; i < particleCount; i++)
+			{
+				const uint32_t x = i % columns;
+				const uint32_t z = (i / columns) % rows;
+				const uint32_t y = i / (columns * rows);
+				// Slight jitter breaks the symmetry of the lattice
+				const float jitter = (particles::random01(i) - 0.5f) * 0.01f * spacing;
+				particles[i].position = glm::vec4(boundsMin.x + (x + 0.5f) * spacing + jitter, boundsMax.y - (y + 0.5f) * spacing,
+					boundsMin.z + (z + 0.5f) * spacing - jitter, 2.0f);
+				particles[i].velocity = glm::vec3(0.0f);
+				particles[i].generation = 0;
+			}
+			this->params.particleMass = this->params.restDensity / latticeDensity(spacing);
+
+			// Time step limit of the fastest expected particle: speed of sound + free fall over the container height
+			const float maxSpeed = std::sqrt(params.stiffness) + std::sqrt(2.0f * std::abs(params.gravity.y) * (boundsMax.y - boundsMin.y));
+			this->substeps = (substeps > 0) ? substeps : std::max(static_cast<uint32_t>(std::ceil(frameTime / (0.4f * kernelRadius / maxSpeed))), 1u);
+			this->params.gravity.w = frameTime / this->substeps;
+
+			VK_CHECK_RESULT(device->createDeviceLocalBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+				&particleBuffer, particles.size() * sizeof(Particle), particles.data(), queue));
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, vk::MemoryPropertyFlagBits::eDeviceLocal,
+				&densityBuffer, (VkDeviceSize)particleCount * sizeof(glm::vec2)));
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, &paramsBuffer, sizeof(FluidParams), &this->params));
+
+			// One cell of margin around the container, the cell size is the kernel radius
+			GridParams gridParams;
+			gridParams.origin = glm::vec4(boundsMin - kernelRadius, kernelRadius);
+			gridParams.dims = glm::uvec4(glm::uvec3(glm::ceil((boundsMax - boundsMin) / kernelRadius)) + 2u, 0);
+			gridParams.radius = 0.5f * kernelRadius;
+			gridParams.dt = this->params.gravity.w;
+			grid.prepare(device, pipelineCache, gridParams, { vk::Buffer(particleBuffer.buffer) }, particleCount, sizeof(Particle));
+
+			prepareDescriptorSetLayout();
+			preparePipelines(pipelineCache);
+			prepareDescriptorSet();
+		}
+
+		void destroy()
+		{
+			if (!device)
+			{
+				return;
+			}
+			device->D().destroyPipeline (densityPipeline);
+			device->D().destroyPipeline (forcesPipeline);
+			device->D().destroyPipelineLayout (pipelineLayout);
+			device->D().destroyDescriptorSetLayout (descriptorSetLayout);
+			device->D().destroyDescriptorPool (descriptorPool);
+			grid.destroy();
+			particleBuffer.destroy();
+			densityBuffer.destroy();
+			paramsBuffer.destroy();
+			device = nullptr;
+		}
+
+		/**
+		* Record the substeps of one frame
+		*
+		* @note Must be recorded outside of a render pass, the particles are ready for vertex input afterwards
+		*/
+		void buildCommandBuffer(vk::CommandBuffer cmdBuffer)
+		{
+			const uint32_t groupCount = (particleCount + workgroupSize - 1) / workgroupSize;
+			// The previous frame is done drawing the particles before they are written
+			cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eVertexInput, vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer,
+				vk::DependencyFlags(), nullptr, nullptr, nullptr);
+
+			for (uint32_t i = 0; i < substeps; i++)
+			{
+				grid.buildNeighborSearch(cmdBuffer, 0);
+
+				const std::array<vk::DescriptorSet, 2> sets = { grid.descriptorSets[0], descriptorSet };
+				cmdBuffer.bindDescriptorSets (vk::PipelineBindPoint::eCompute, pipelineLayout, 0, sets, {});
+				cmdBuffer.bindPipeline (vk::PipelineBindPoint::eCompute, densityPipeline);
+				cmdBuffer.dispatch (groupCount, 1, 1);
+				vk::BufferMemoryBarrier densityBarrier = vks::initializers::bufferBarrier(densityBuffer.buffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+				cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+					vk::DependencyFlags(), nullptr, densityBarrier, nullptr);
+
+				// Reads the sorted copy, so the particles can be written in place
+				cmdBuffer.bindPipeline (vk::PipelineBindPoint::eCompute, forcesPipeline);
+				cmdBuffer.dispatch (groupCount, 1, 1);
+				// The next substep's neighbor search makes the particle writes visible to its passes
+			}
+
+			vk::BufferMemoryBarrier drawBarrier = vks::initializers::bufferBarrier(particleBuffer.buffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eVertexAttributeRead);
+			cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eVertexInput,
+				vk::DependencyFlags(), nullptr, drawBarrier, nullptr);
+		}
+
+		/** @brief Bind the particles as vertex buffer (same layout as ParticleSystem::bindingDescription) */
+		void bind(vk::CommandBuffer cmdBuffer, uint32_t binding = 0)
+		{
+			cmdBuffer.bindVertexBuffers (binding, vk::Buffer(particleBuffer.buffer), {0});
+		}
+
+	private:
+		// Density of an infinite lattice with one unit mass particle per spacing^3, as summed by fluid_density.comp
+		float latticeDensity(float spacing) const
+		{
+			const float h2 = kernelRadius * kernelRadius;
+			const float poly6 = 315.0f / (64.0f * glm::pi<float>() * std::pow(kernelRadius, 9.0f));
+			float density = 0.0f;
+			for (int32_t z = -2; z <= 2; z++)
+			{
+				for (int32_t y = -2; y <= 2; y++)
+				{
+					for (int32_t x = -2; x <= 2; x++)
+					{
+						const float r2 = (float)(x * x + y * y + z * z) * spacing * spacing;
+						if (r2 < h2)
+						{
+							const float w = h2 - r2;
+							density += w * w * w;
+						}
+					}
+				}
+			}
+			return density * poly6;
+		}
+
+		void prepareDescriptorSetLayout()
+		{
+			// Binding 0 : Fluid parameters
+			// Binding 1 : Density and pressure
+			std::array<vk::DescriptorSetLayoutBinding, 2> setLayoutBindings;
+			for (uint32_t i = 0; i < setLayoutBindings.size(); i++)
+			{
+				setLayoutBindings[i].setBinding (i)
+					.setDescriptorType ((i == 0) ? vk::DescriptorType::eUniformBuffer : vk::DescriptorType::eStorageBuffer)
+					.setDescriptorCount (1)
+					.setStageFlags (vk::ShaderStageFlagBits::eCompute);
+			}
+			vk::DescriptorSetLayoutCreateInfo descriptorLayout;
+			descriptorLayout.setBindingCount (static_cast<uint32_t>(setLayoutBindings.size()))
+				.setPBindings (setLayoutBindings.data());
+			descriptorSetLayout = CHECK(device->D().createDescriptorSetLayout (descriptorLayout));
+
+			// Set 0 : Grid (particles, sorted particles and cell tables), set 1 : Fluid
+			const std::array<vk::DescriptorSetLayout, 2> setLayouts = { grid.descriptorSetLayout, descriptorSetLayout };
+			vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo;
+			pipelineLayoutCreateInfo.setSetLayoutCount (static_cast<uint32_t>(setLayouts.size()))
+				.setPSetLayouts (setLayouts.data());
+			pipelineLayout = CHECK(device->D().createPipelineLayout (pipelineLayoutCreateInfo));
+		}
+
+		void preparePipelines(vk::PipelineCache pipelineCache)
+		{
+			// Constant 0 : Workgroup size
+			// Constant 1 : Kernel radius
+			struct {
+				uint32_t workgroupSize;
+				float kernelRadius;
+			} specializationData = { workgroupSize, kernelRadius };
+			const std::array<vk::SpecializationMapEntry, 2> specializationEntries = {
+				vk::SpecializationMapEntry(0, 0, sizeof(uint32_t)),
+				vk::SpecializationMapEntry(1, sizeof(uint32_t), sizeof(float))
+			};
+			vk::SpecializationInfo specializationInfo(static_cast<uint32_t>(specializationEntries.size()), specializationEntries.data(), sizeof(specializationData), &specializationData);
+			densityPipeline = vks::tools::createComputePipeline(device->D(), pipelineCache, pipelineLayout, "shaders/fluid_density.comp.spv", &specializationInfo);
+			forcesPipeline = vks::tools::createComputePipeline(device->D(), pipelineCache, pipelineLayout, "shaders/fluid_forces.comp.spv", &specializationInfo);
+		}
+
+		void prepareDescriptorSet()
+		{
+			std::array<vk::DescriptorPoolSize, 2> poolSizes;
+			poolSizes[0].setType (vk::DescriptorType::eUniformBuffer).setDescriptorCount (1);
+			poolSizes[1].setType (vk::DescriptorType::eStorageBuffer).setDescriptorCount (1);
+			vk::DescriptorPoolCreateInfo descriptorPoolInfo;
+			descriptorPoolInfo.setPoolSizeCount (static_cast<uint32_t>(poolSizes.size()))
+				.setPPoolSizes (poolSizes.data())
+				.setMaxSets (1);
+			descriptorPool = CHECK(device->D().createDescriptorPool (descriptorPoolInfo));
+
+			vk::DescriptorSetAllocateInfo allocInfo;
+			allocInfo.setDescriptorPool (descriptorPool)
+				.setDescriptorSetCount (1)
+				.setPSetLayouts (&descriptorSetLayout);
+			descriptorSet = CHECK(device->D().allocateDescriptorSets (allocInfo)).front();
+
+			std::array<vk::DescriptorBufferInfo, 2> bufferInfos = {
+				vk::DescriptorBufferInfo(paramsBuffer.buffer, 0, sizeof(FluidParams)),
+				vk::DescriptorBufferInfo(densityBuffer.buffer, 0, VK_WHOLE_SIZE)
+			};
+			std::array<vk::WriteDescriptorSet, 2> writeDescriptorSets;
+			for (uint32_t i = 0; i < writeDescriptorSets.size(); i++)
+			{
+				writeDescriptorSets[i].setDstSet (descriptorSet)
+					.setDstBinding (i)
+					.setDescriptorCount (1)
+					.setDescriptorType ((i == 0) ? vk::DescriptorType::eUniformBuffer : vk::DescriptorType::eStorageBuffer)
+					.setPBufferInfo (&bufferInfos[i]);
+			}
+			device->D().updateDescriptorSets (writeDescriptorSets, {});
+		}
+	};
+}
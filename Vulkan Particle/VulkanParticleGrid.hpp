@@ -0,0 +1,400 @@
+#pragma once
+
+/*
+* Vulkan particle grid class
+*
+* Uniform grid neighbor search for particle-particle collisions in compute passes:
+* - Hash    : cell index of each particle (sort key) and the particle index (sort value)
+* - Sort    : radix sort by cell index, only as many key bits as the cell count needs
+* - Cells   : first and one past the last sorted index of each occupied cell, particles are copied in cell order
+* - Collide : spring and damping forces against the particles of the 27 surrounding cells
+* Every pass is linear in the particle count, the cell size must be at least the particle diameter.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <array>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+
+#include "vulkan/vulkan.h"
+#include <vulkan/vulkan.hpp>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include "vksTools.h"
+#include "VulkanBuffer.hpp"
+#include "VulkanDevice.hpp"
+#include "VulkanInitializers.h"
+#include "VulkanRadixSort.hpp"
+
+namespace vks
+{
+	/** @brief Grid and collision parameters, layout matches the std140 uniform block of the grid shaders */
+	struct GridParams
+	{
+		/** @brief xyz = min. corner of the grid, w = cell size (at least twice the particle radius) */
+		glm::vec4 origin = glm::vec4(-2.56f, -2.56f, -2.56f, 0.04f);
+		/** @brief xyz = number of cells per axis, w = particle count (set by ParticleGrid::prepare) */
+		glm::uvec4 dims = glm::uvec4(128, 128, 128, 0);
+		float radius = 0.02f;
+		/** @brief Spring constant of the overlap (separation) force */
+		float stiffness = 500.0f;
+		/** @brief Relative velocity damping of touching particles */
+		float damping = 2.0f;
+		/** @brief Time step in seconds */
+		float dt = 1.0f / 60.0f;
+		/** @brief Set by ParticleGrid::prepare, the cell of a position is floor((position - origin) * invCellSize) */
+		float invCellSize = 0.0f;
+		/** @brief Max. contacts per particle, bounds the cost of crowded cells (e.g. at an emitter) */
+		uint32_t maxContacts = 64;
+		uint32_t pad[2];
+	};
+
+	/**
+	* @brief Host reference of the grid passes
+	*
+	* Uses the same cell computation (exact in float), a stable sort (same order as the radix sort) and the same neighbor
+	* order as the shaders, only the square roots of the contact distances may round differently
+	*/
+	namespace grid
+	{
+		inline uint32_t cellCount(const GridParams &params)
+		{
+			return params.dims.x * params.dims.y * params.dims.z;
+		}
+
+		/** @brief Cell coordinates of a position, positions outside of the grid go to the border cells */
+		inline glm::ivec3 cell(const glm::vec3 &position, const GridParams &params)
+		{
+			glm::ivec3 coords;
+			for (uint32_t i = 0; i < 3; i++)
+			{
+				const float scaled = (position[i] - params.origin[i]) * params.invCellSize;
+				coords[i] = (int32_t)std::min(std::max(std::floor(scaled), 0.0f), (float)(params.dims[i] - 1));
+			}
+			return coords;
+		}
+
+		inline uint32_t cellKey(const glm::ivec3 &coords, const GridParams &params)
+		{
+			return ((uint32_t)coords.z * params.dims.y + (uint32_t)coords.y) * params.dims.x + (uint32_t)coords.x;
+		}
+
+		/**
+		* Apply one collision step to the particle velocities
+		*
+		* @param particles Particles with position (xyz) and velocity members
+		*/
+		template <typename ParticleType>
+		void collide(std::vector<ParticleType> &particles, const GridParams &params)
+		{
+			const uint32_t count = static_cast<uint32_t>(particles.size());
+			std::vector<uint32_t> keys(count);
+			std::vector<uint32_t> order(count);
+			for (uint32_t i = 0; i < count; i++)
+			{
+				keys[i] = cellKey(cell(glm::vec3(particles[i].position), params), params);
+			}
+			std::iota(order.begin(), order.end(), 0u);
+			std::stable_sort(order.begin(), order.end(), [&keys](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+
+			std::vector<uint32_t> cellStart(cellCount(params), UINT32_MAX);
+			std::vector<uint32_t> cellEnd(cellCount(params), 0);
+			std::vector<ParticleType> sorted(count);
+			for (uint32_t i = 0; i < count; i++)
+			{
+				const uint32_t key = keys[order[i]];
+				if ((i == 0) || (keys[order[i - 1]] != key))
+				{
+					cellStart[key] = i;
+				}
+				if ((i == count - 1) || (keys[order[i + 1]] != key))
+				{
+					cellEnd[key] = i + 1;
+				}
+				sorted[i] = particles[order[i]];
+			}
+
+			const float diameter = 2.0f * params.radius;
+			for (uint32_t i = 0; i < count; i++)
+			{
+				const glm::vec3 position = glm::vec3(sorted[i].position);
+				const glm::vec3 velocity = sorted[i].velocity;
+				const glm::ivec3 center = cell(position, params);
+				glm::vec3 force(0.0f);
+				uint32_t contacts = 0;
+				for (int32_t z = -1; z <= 1; z++)
+				{
+					for (int32_t y = -1; y <= 1; y++)
+					{
+						for (int32_t x = -1; x <= 1; x++)
+						{
+							const glm::ivec3 neighbor = center + glm::ivec3(x, y, z);
+							if (glm::any(glm::lessThan(neighbor, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(neighbor, glm::ivec3(params.dims))))
+							{
+								continue;
+							}
+							const uint32_t key = cellKey(neighbor, params);
+							if (cellStart[key] == UINT32_MAX)
+							{
+								continue;
+							}
+							for (uint32_t j = cellStart[key]; (j < cellEnd[key]) && (contacts < params.maxContacts); j++)
+							{
+								const glm::vec3 delta = glm::vec3(sorted[j].position) - position;
+								const float distanceSquared = delta.x * delta.x + delta.y * delta.y + delta.z * delta.z;
+								// Coincident particles (e.g. respawned at the emitter) have no separation direction
+								if ((j == i) || (distanceSquared >= diameter * diameter) || (distanceSquared == 0.0f))
+								{
+									continue;
+								}
+								const float distance = std::sqrt(distanceSquared);
+								const glm::vec3 normal = delta / distance;
+								force -= normal * (params.stiffness * (diameter - distance));
+								force += (sorted[j].velocity - velocity) * params.damping;
+								contacts++;
+							}
+						}
+					}
+				}
+				particles[order[i]].velocity = velocity + force * params.dt;
+			}
+		}
+	}
+
+	/**
+	* @brief Grid neighbor search and collision response on particle buffers (e.g. those of a ParticleSystem)
+	*
+	* Reads and updates the particles in place, recorded after the integration step that wrote them
+	* Other solvers can record the neighbor search only and read the cell tables with their own passes (set 0 = descriptorSets[i])
+	*/
+	struct ParticleGrid
+	{
+		/** @brief Must match local_size_x of the grid shaders */
+		static const uint32_t workgroupSize = 256;
+
+		vks::VulkanDevice *device = nullptr;
+		GridParams params;
+		uint32_t particleCount = 0;
+		/** @brief Sort key bits needed for the cell indices (multiple of 8) */
+		uint32_t keyBits = 32;
+
+		/** @brief Sorts the cell indices (keys[0]) and particle indices (values[0]) */
+		vks::RadixSort sort;
+		vks::Buffer paramsBuffer;
+		/** @brief Particles in cell order, read by the collision pass */
+		vks::Buffer sortedParticles;
+		/** @brief First sorted index of each cell, UINT32_MAX for empty cells */
+		vks::Buffer cellStart;
+		/** @brief One past the last sorted index of each occupied cell */
+		vks::Buffer cellEnd;
+
+		vk::DescriptorSetLayout descriptorSetLayout;
+		vk::PipelineLayout pipelineLayout;
+		vk::Pipeline hashPipeline;
+		vk::Pipeline cellsPipeline;
+		vk::Pipeline collidePipeline;
+		vk::DescriptorPool descriptorPool;
+		/** @brief Set i updates the i-th particle buffer passed to prepare */
+		std::vector<vk::DescriptorSet> descriptorSets;
+
+		/**
+		* Create the buffers and pipelines
+		*
+		* @param device Device to create the resources on
+		* @param pipelineCache Pipeline cache to use
+		* @param params Grid and collision parameters (particle count and inverse cell size are set by this function)
+		* @param particles Particle buffers the collisions are applied to (one descriptor set each)
+		* @param particleCount Number of particles per buffer
+		* @param particleSize Size of one particle (layout of the Particle struct of the grid shaders)
+		*/
+		void prepare(vks::VulkanDevice *device, vk::PipelineCache pipelineCache, const GridParams &params, const std::vector<vk::Buffer> &particles, uint32_t particleCount, uint32_t particleSize)
+		{
+			this->device = device;
+			this->particleCount = particleCount;
+			this->params = params;
+			this->params.dims.w = particleCount;
+			this->params.invCellSize = 1.0f / params.origin.w;
+			// Contacts further apart than one cell would be missed by the 27 cell neighborhood
+			assert(params.origin.w >= 2.0f * params.radius);
+
+			const uint64_t cells = (uint64_t)params.dims.x * params.dims.y * params.dims.z;
+			assert((cells > 0) && (cells <= UINT32_MAX));
+			uint32_t bits = 0;
+			while ((1ull << bits) < cells)
+			{
+				bits++;
+			}
+			keyBits = std::max((bits + 7) / 8 * 8, 8u);
+
+			sort.prepare(device, pipelineCache, particleCount);
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, &paramsBuffer, sizeof(GridParams), &this->params));
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, vk::MemoryPropertyFlagBits::eDeviceLocal,
+				&sortedParticles, (VkDeviceSize)std::max(particleCount, 1u) * particleSize));
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, vk::MemoryPropertyFlagBits::eDeviceLocal,
+				&cellStart, cells * sizeof(uint32_t)));
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, vk::MemoryPropertyFlagBits::eDeviceLocal,
+				&cellEnd, cells * sizeof(uint32_t)));
+
+			prepareDescriptorSetLayout();
+			preparePipelines(pipelineCache);
+			prepareDescriptorSets(particles);
+		}
+
+		void destroy()
+		{
+			if (!device)
+			{
+				return;
+			}
+			device->D().destroyPipeline (hashPipeline);
+			device->D().destroyPipeline (cellsPipeline);
+			device->D().destroyPipeline (collidePipeline);
+			device->D().destroyPipelineLayout (pipelineLayout);
+			device->D().destroyDescriptorSetLayout (descriptorSetLayout);
+			device->D().destroyDescriptorPool (descriptorPool);
+			sort.destroy();
+			paramsBuffer.destroy();
+			sortedParticles.destroy();
+			cellStart.destroy();
+			cellEnd.destroy();
+		}
+
+		/**
+		* Record the neighbor search and collision response of a particle buffer
+		*
+		* @note Shader writes to the particles before are made visible by this function, the updated velocities are written
+		* in the compute shader stage
+		*/
+		void buildCommandBuffer(vk::CommandBuffer cmdBuffer, uint32_t bufferIndex)
+		{
+			buildNeighborSearch(cmdBuffer, bufferIndex);
+			cmdBuffer.bindPipeline (vk::PipelineBindPoint::eCompute, collidePipeline);
+			cmdBuffer.bindDescriptorSets (vk::PipelineBindPoint::eCompute, pipelineLayout, 0, descriptorSets[bufferIndex], {});
+			cmdBuffer.dispatch ((particleCount + workgroupSize - 1) / workgroupSize, 1, 1);
+		}
+
+		/**
+		* Record the hash, sort and cell passes of a particle buffer
+		*
+		* @note Ends with a barrier making the sorted particles and cell tables visible to compute shader reads
+		*/
+		void buildNeighborSearch(vk::CommandBuffer cmdBuffer, uint32_t bufferIndex)
+		{
+			const uint32_t groupCount = (particleCount + workgroupSize - 1) / workgroupSize;
+
+			// The previous pass reading the cell tables is done before they are cleared
+			vk::MemoryBarrier clearBarrier(vk::AccessFlags(), vk::AccessFlagBits::eTransferWrite);
+			cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer,
+				vk::DependencyFlags(), clearBarrier, nullptr, nullptr);
+			cmdBuffer.fillBuffer (vk::Buffer(cellStart.buffer), 0, VK_WHOLE_SIZE, UINT32_MAX);
+			// Cleared cell starts and the particles written by the integration step
+			vk::MemoryBarrier inputBarrier(vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferWrite,
+				vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+			cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader,
+				vk::DependencyFlags(), inputBarrier, nullptr, nullptr);
+
+			cmdBuffer.bindPipeline (vk::PipelineBindPoint::eCompute, hashPipeline);
+			cmdBuffer.bindDescriptorSets (vk::PipelineBindPoint::eCompute, pipelineLayout, 0, descriptorSets[bufferIndex], {});
+			cmdBuffer.dispatch (groupCount, 1, 1);
+
+			sort.buildCommandBuffer(cmdBuffer, particleCount, keyBits);
+
+			// The sort changed the bindings
+			cmdBuffer.bindPipeline (vk::PipelineBindPoint::eCompute, cellsPipeline);
+			cmdBuffer.bindDescriptorSets (vk::PipelineBindPoint::eCompute, pipelineLayout, 0, descriptorSets[bufferIndex], {});
+			cmdBuffer.dispatch (groupCount, 1, 1);
+			vk::MemoryBarrier computeBarrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+			cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+				vk::DependencyFlags(), computeBarrier, nullptr, nullptr);
+		}
+
+	private:
+		void prepareDescriptorSetLayout()
+		{
+			// Binding 0 : Grid parameters
+			// Binding 1 : Particles
+			// Binding 2 : Cell indices (sort keys)
+			// Binding 3 : Particle indices (sort values)
+			// Binding 4 : Particles in cell order
+			// Binding 5 : Cell start indices
+			// Binding 6 : Cell end indices
+			std::array<vk::DescriptorSetLayoutBinding, 7> setLayoutBindings;
+			for (uint32_t i = 0; i < setLayoutBindings.size(); i++)
+			{
+				setLayoutBindings[i].setBinding (i)
+					.setDescriptorType ((i == 0) ? vk::DescriptorType::eUniformBuffer : vk::DescriptorType::eStorageBuffer)
+					.setDescriptorCount (1)
+					.setStageFlags (vk::ShaderStageFlagBits::eCompute);
+			}
+			vk::DescriptorSetLayoutCreateInfo descriptorLayout;
+			descriptorLayout.setBindingCount (static_cast<uint32_t>(setLayoutBindings.size()))
+				.setPBindings (setLayoutBindings.data());
+			descriptorSetLayout = CHECK(device->D().createDescriptorSetLayout (descriptorLayout));
+
+			vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo;
+			pipelineLayoutCreateInfo.setSetLayoutCount (1)
+				.setPSetLayouts (&descriptorSetLayout);
+			pipelineLayout = CHECK(device->D().createPipelineLayout (pipelineLayoutCreateInfo));
+		}
+
+		void preparePipelines(vk::PipelineCache pipelineCache)
+		{
+			hashPipeline = vks::tools::createComputePipeline(device->D(), pipelineCache, pipelineLayout, "shaders/grid_hash.comp.spv");
+			cellsPipeline = vks::tools::createComputePipeline(device->D(), pipelineCache, pipelineLayout, "shaders/grid_cells.comp.spv");
+			collidePipeline = vks::tools::createComputePipeline(device->D(), pipelineCache, pipelineLayout, "shaders/grid_collide.comp.spv");
+		}
+
+		void prepareDescriptorSets(const std::vector<vk::Buffer> &particles)
+		{
+			const uint32_t setCount = static_cast<uint32_t>(particles.size());
+			std::array<vk::DescriptorPoolSize, 2> poolSizes;
+			poolSizes[0].setType (vk::DescriptorType::eStorageBuffer).setDescriptorCount (setCount * 6);
+			poolSizes[1].setType (vk::DescriptorType::eUniformBuffer).setDescriptorCount (setCount);
+			vk::DescriptorPoolCreateInfo descriptorPoolInfo;
+			descriptorPoolInfo.setPoolSizeCount (static_cast<uint32_t>(poolSizes.size()))
+				.setPPoolSizes (poolSizes.data())
+				.setMaxSets (setCount);
+			descriptorPool = CHECK(device->D().createDescriptorPool (descriptorPoolInfo));
+
+			std::vector<vk::DescriptorSetLayout> layouts(setCount, descriptorSetLayout);
+			vk::DescriptorSetAllocateInfo allocInfo;
+			allocInfo.setDescriptorPool (descriptorPool)
+				.setDescriptorSetCount (static_cast<uint32_t>(layouts.size()))
+				.setPSetLayouts (layouts.data());
+			descriptorSets = CHECK(device->D().allocateDescriptorSets (allocInfo));
+
+			for (uint32_t i = 0; i < setCount; i++)
+			{
+				std::array<vk::DescriptorBufferInfo, 7> bufferInfos = {
+					vk::DescriptorBufferInfo(paramsBuffer.buffer, 0, sizeof(GridParams)),
+					vk::DescriptorBufferInfo(particles[i], 0, VK_WHOLE_SIZE),
+					vk::DescriptorBufferInfo(sort.keys[0].buffer, 0, VK_WHOLE_SIZE),
+					vk::DescriptorBufferInfo(sort.values[0].buffer, 0, VK_WHOLE_SIZE),
+					vk::DescriptorBufferInfo(sortedParticles.buffer, 0, VK_WHOLE_SIZE),
+					vk::DescriptorBufferInfo(cellStart.buffer, 0, VK_WHOLE_SIZE),
+					vk::DescriptorBufferInfo(cellEnd.buffer, 0, VK_WHOLE_SIZE)
+				};
+				std::array<vk::WriteDescriptorSet, 7> writeDescriptorSets;
+				for (uint32_t j = 0; j < writeDescriptorSets.size(); j++)
+				{
+					writeDescriptorSets[j].setDstSet (descriptorSets[i])
+						.setDstBinding (j)
+						.setDescriptorCount (1)
+						.setDescriptorType ((j == 0) ? vk::DescriptorType::eUniformBuffer : vk::DescriptorType::eStorageBuffer)
+						.setPBufferInfo (&bufferInfos[j]);
+				}
+				device->D().updateDescriptorSets (writeDescriptorSets, {});
+			}
+		}
+	};
+}
@@ -0,0 +1,425 @@
+#pragma once
+
+/*
+* Vulkan N-body class
+*
+* Softened gravity between all bodies in compute passes, two modes:
+* - Direct       : all pairs, bodies are streamed through workgroup shared memory in tiles of one workgroup each
+* - Hierarchical : bodies are sorted into the finest level of a complete octree (uniform grid neighbor search), cells of
+*                  all levels store their mass and center of mass (monopole). Bodies in the 27 surrounding finest cells are
+*                  summed directly, farther bodies via the monopoles of each level's interaction list (children of the
+*                  parent's neighbors that are not adjacent), so the cost per body no longer grows with the body count.
+* Bodies use the Particle layout with position.w = mass and are double buffered (a step reads one buffer and writes the other).
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <array>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+
+#include "vulkan/vulkan.h"
+#include <vulkan/vulkan.hpp>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include "vksTools.h"
+#include "VulkanBuffer.hpp"
+#include "VulkanDevice.hpp"
+#include "VulkanInitializers.h"
+#include "VulkanParticleSystem.hpp"
+#include "VulkanParticleGrid.hpp"
+
+namespace vks
+{
+	/** @brief N-body parameters, layout matches the std140 uniform block of the N-body shaders */
+	struct NBodyParams
+	{
+		/** @brief xyz = min. corner of the octree root cell, w = root cell size (bodies outside go to the border cells) */
+		glm::vec4 origin = glm::vec4(-2.0f, -2.0f, -2.0f, 4.0f);
+		/** @brief Gravitational constant */
+		float gravity = 1.0f;
+		/** @brief Softening length, keeps close encounters finite */
+		float softening = 0.02f;
+		/** @brief Time step in seconds of simulation time */
+		float dt = 0.005f;
+		/** @brief Set by ParticleNBody::prepare */
+		uint32_t bodyCount = 0;
+		/** @brief Finest octree level (2^levels cells per axis) of the hierarchical mode */
+		uint32_t levels = 6;
+		uint32_t pad[3];
+	};
+
+	/**
+	* @brief Host reference of the direct mode
+	*
+	* Sums the bodies in the same tiles and order as nbody_tiled.comp, the host additionally blocks the bodies it computes
+	* so each tile is reused from the cache. Only the reciprocal square roots may round differently on the device.
+	*/
+	namespace nbody
+	{
+		/** @brief Acceleration (without the gravitational constant) of a body at position by body (xyz = position, w = mass) */
+		inline glm::vec3 attraction(const glm::vec3 &position, const glm::vec4 &body, float softeningSquared)
+		{
+			const glm::vec3 delta = glm::vec3(body) - position;
+			const float distanceSquared = delta.x * delta.x + delta.y * delta.y + delta.z * delta.z + softeningSquared;
+			const float inverseDistance = 1.0f / std::sqrt(distanceSquared);
+			const float inverseDistanceCubed = inverseDistance * inverseDistance * inverseDistance;
+			return delta * (body.w * inverseDistanceCubed);
+		}
+
+		/**
+		* Integrate the bodies [first, last) for one step
+		*
+		* @param tileSize Bodies per tile, the workgroup size of the device kernel
+		*/
+		inline void step(const std::vector<Particle> &src, std::vector<Particle> &dst, const NBodyParams &params, uint32_t tileSize, uint32_t first, uint32_t last)
+		{
+			const uint32_t count = static_cast<uint32_t>(src.size());
+			const float softeningSquared = params.softening * params.softening;
+			const uint32_t blockSize = 64;
+			std::vector<glm::vec3> accelerations(blockSize);
+			for (uint32_t blockStart = first; blockStart < last; blockStart += blockSize)
+			{
+				const uint32_t blockEnd = std::min(blockStart + blockSize, last);
+				std::fill(accelerations.begin(), accelerations.end(), glm::vec3(0.0f));
+				for (uint32_t tileStart = 0; tileStart < count; tileStart += tileSize)
+				{
+					const uint32_t tileEnd = std::min(tileStart + tileSize, count);
+					for (uint32_t i = blockStart; i < blockEnd; i++)
+					{
+						const glm::vec3 position = glm::vec3(src[i].position);
+						glm::vec3 acceleration = accelerations[i - blockStart];
+						// The body itself adds zero (zero distance)
+						for (uint32_t j = tileStart; j < tileEnd; j++)
+						{
+							acceleration += attraction(position, src[j].position, softeningSquared);
+						}
+						accelerations[i - blockStart] = acceleration;
+					}
+				}
+				for (uint32_t i = blockStart; i < blockEnd; i++)
+				{
+					const glm::vec3 velocity = src[i].velocity + accelerations[i - blockStart] * (params.gravity * params.dt);
+					dst[i].position = glm::vec4(glm::vec3(src[i].position) + velocity * params.dt, src[i].position.w);
+					dst[i].velocity = velocity;
+					dst[i].generation = src[i].generation;
+				}
+			}
+		}
+
+		/** @brief Rotating disc in the xz plane with unit total mass and approximately circular orbits (G = 1) */
+		inline Particle disc(uint32_t index, uint32_t count)
+		{
+			const float radius = std::sqrt(particles::random01(index * 3u));
+			const float angle = particles::random01(index * 3u + 1u) * glm::two_pi<float>();
+			const float height = (particles::random01(index * 3u + 2u) - 0.5f) * 0.05f;
+			// Uniform surface density: the enclosed mass grows with radius^2
+			const float speed = std::sqrt(radius);
+			Particle body;
+			body.position = glm::vec4(std::cos(angle) * radius, height, std::sin(angle) * radius, 1.0f / count);
+			body.velocity = glm::vec3(-std::sin(angle), 0.0f, std::cos(angle)) * speed;
+			body.generation = 0;
+			return body;
+		}
+	}
+
+	/**
+	* @brief Double buffered N-body simulation, recorded into the caller's (graphics or compute) command buffer
+	*/
+	struct ParticleNBody
+	{
+		/** @brief Default of the workgroup (= tile) size specialization constant of nbody_tiled.comp */
+		static const uint32_t defaultTileSize = 256;
+
+		vks::VulkanDevice *device = nullptr;
+		NBodyParams params;
+		uint32_t bodyCount = 0;
+		uint32_t tileSize = defaultTileSize;
+		/** @brief Hierarchical (octree monopole) forces instead of all pairs */
+		bool hierarchical = false;
+		/** @brief Index of the buffer written by the most recently recorded step */
+		uint32_t current = 0;
+
+		std::array<vks::Buffer, 2> buffers;
+		vks::Buffer paramsBuffer;
+		/** @brief Monopoles (xyz = center of mass, w = mass) of all octree levels, level l starts at (8^l - 1) / 7 */
+		vks::Buffer cellBuffer;
+		/** @brief Finest octree level, set i sorts buffers[i] */
+		vks::ParticleGrid grid;
+
+		vk::DescriptorSetLayout descriptorSetLayout;
+		/** @brief Set 0 : N-body */
+		vk::PipelineLayout directPipelineLayout;
+		/** @brief Set 0 : grid, set 1 : N-body, push constant : octree level */
+		vk::PipelineLayout hierarchicalPipelineLayout;
+		vk::Pipeline directPipeline;
+		/** @brief Monopoles of the finest level (from the bodies) and of the coarser levels (from their children) */
+		std::array<vk::Pipeline, 2> monopolePipelines;
+		vk::Pipeline hierarchicalPipeline;
+		vk::DescriptorPool descriptorPool;
+		/** @brief Set i writes buffers[i] and reads the other one */
+		std::vector<vk::DescriptorSet> descriptorSets;
+
+		/**
+		* Create the bodies and pipelines
+		*
+		* @param device Device to create the resources on
+		* @param queue Queue used for the initial upload
+		* @param pipelineCache Pipeline cache to use
+		* @param bodies Initial state of all bodies (position.w = mass)
+		* @param params Simulation parameters (body count is set by this function)
+		* @param hierarchical Use the octree monopole approximation instead of all pairs
+		* @param tileSize Bodies per shared memory tile of the direct mode (clamped to the device limits)
+		*/
+		void prepare(vks::VulkanDevice *device, vk::Queue queue, vk::PipelineCache pipelineCache, const std::vector<Particle> &bodies, const NBodyParams &params = NBodyParams(),
+			bool hierarchical = false, uint32_t tileSize = defaultTileSize)
+		{
+			this->device = device;
+			this->params = params;
+			this->hierarchical = hierarchical;
+			const vk::PhysicalDeviceLimits &limits = device->properties.limits;
+			// One vec4 of shared memory per body of a tile
+			this->tileSize = std::max(std::min({ tileSize, limits.maxComputeWorkGroupSize[0], limits.maxComputeWorkGroupInvocations,
+				limits.maxComputeSharedMemorySize / static_cast<uint32_t>(sizeof(glm::vec4)) }), 1u);
+			bodyCount = static_cast<uint32_t>(bodies.size());
+			const uint32_t gridWorkgroupSize = ParticleGrid::workgroupSize;
+			const uint64_t maxBodyCount = (uint64_t)limits.maxComputeWorkGroupCount[0] * std::min(this->tileSize, gridWorkgroupSize);
+			if (bodyCount > maxBodyCount)
+			{
+				std::cerr << "Body count exceeds the max. dispatch size, clamped to " << maxBodyCount << std::endl;
+				bodyCount = static_cast<uint32_t>(maxBodyCount);
+			}
+			this->params.bodyCount = bodyCount;
+
+			const VkDeviceSize bufferSize = (VkDeviceSize)bodyCount * sizeof(Particle);
+			for (auto& buffer : buffers)
+			{
+				VK_CHECK_RESULT(device->createDeviceLocalBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+					&buffer, bufferSize, (void*)bodies.data(), queue));
+			}
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, &paramsBuffer, sizeof(NBodyParams), &this->params));
+			// The direct mode doesn't read the cells, the binding only has to be valid
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, vk::MemoryPropertyFlagBits::eDeviceLocal,
+				&cellBuffer, (hierarchical ? levelOffset(params.levels + 1) : 1) * sizeof(glm::vec4)));
+
+			if (hierarchical)
+			{
+				// The finest level is the grid, neighbor search cell size = finest cell size
+				const uint32_t cellsPerAxis = 1u << params.levels;
+				GridParams gridParams;
+				gridParams.origin = glm::vec4(glm::vec3(params.origin), params.origin.w / cellsPerAxis);
+				gridParams.dims = glm::uvec4(cellsPerAxis, cellsPerAxis, cellsPerAxis, 0);
+				gridParams.radius = 0.5f * gridParams.origin.w;
+				grid.prepare(device, pipelineCache, gridParams, { vk::Buffer(buffers[0].buffer), vk::Buffer(buffers[1].buffer) }, bodyCount, sizeof(Particle));
+			}
+
+			prepareDescriptorSetLayout();
+			preparePipelines(pipelineCache);
+			prepareDescriptorSets();
+		}
+
+		void destroy()
+		{
+			if (!device)
+			{
+				return;
+			}
+			device->D().destroyPipeline (directPipeline);
+			device->D().destroyPipeline (monopolePipelines[0]);
+			device->D().destroyPipeline (monopolePipelines[1]);
+			device->D().destroyPipeline (hierarchicalPipeline);
+			device->D().destroyPipelineLayout (directPipelineLayout);
+			device->D().destroyPipelineLayout (hierarchicalPipelineLayout);
+			device->D().destroyDescriptorSetLayout (descriptorSetLayout);
+			device->D().destroyDescriptorPool (descriptorPool);
+			grid.destroy();
+			for (auto& buffer : buffers)
+			{
+				buffer.destroy();
+			}
+			paramsBuffer.destroy();
+			cellBuffer.destroy();
+			device = nullptr;
+		}
+
+		/** @brief First cell of octree level l in the cell buffer (= number of cells of all coarser levels) */
+		static uint64_t levelOffset(uint32_t level)
+		{
+			return ((1ull << (3 * level)) - 1) / 7;
+		}
+
+		/** @brief Body pairs evaluated per step by the direct mode */
+		uint64_t interactionsPerStep() const
+		{
+			return (uint64_t)bodyCount * bodyCount;
+		}
+
+		/**
+		* Record one step, reading the buffer written by the previous one
+		*
+		* @note Must be recorded outside of a render pass, the written buffer (see bind) is ready for vertex input afterwards
+		*/
+		void buildStep(vk::CommandBuffer cmdBuffer)
+		{
+			const uint32_t dst = 1 - current;
+			const uint32_t src = current;
+			current = dst;
+
+			// The source was written by the previous step, the destination was drawn two steps ago
+			vk::MemoryBarrier inputBarrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+			cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eVertexInput, vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer,
+				vk::DependencyFlags(), inputBarrier, nullptr, nullptr);
+
+			if (!hierarchical)
+			{
+				cmdBuffer.bindPipeline (vk::PipelineBindPoint::eCompute, directPipeline);
+				cmdBuffer.bindDescriptorSets (vk::PipelineBindPoint::eCompute, directPipelineLayout, 0, descriptorSets[dst], {});
+				cmdBuffer.dispatch ((bodyCount + tileSize - 1) / tileSize, 1, 1);
+			}
+			else
+			{
+				buildHierarchicalStep(cmdBuffer, src, dst);
+			}
+
+			vk::BufferMemoryBarrier drawBarrier = vks::initializers::bufferBarrier(buffers[dst].buffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eVertexAttributeRead);
+			cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eVertexInput,
+				vk::DependencyFlags(), nullptr, drawBarrier, nullptr);
+		}
+
+		/** @brief Bind the bodies written by the most recently recorded step as vertex buffer (Particle layout) */
+		void bind(vk::CommandBuffer cmdBuffer, uint32_t binding = 0)
+		{
+			cmdBuffer.bindVertexBuffers (binding, vk::Buffer(buffers[current].buffer), {0});
+		}
+
+	private:
+		void buildHierarchicalStep(vk::CommandBuffer cmdBuffer, uint32_t src, uint32_t dst)
+		{
+			const uint32_t workgroupSize = ParticleGrid::workgroupSize;
+			vk::MemoryBarrier computeBarrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+
+			grid.buildNeighborSearch(cmdBuffer, src);
+
+			const std::array<vk::DescriptorSet, 2> sets = { grid.descriptorSets[src], descriptorSets[dst] };
+			cmdBuffer.bindDescriptorSets (vk::PipelineBindPoint::eCompute, hierarchicalPipelineLayout, 0, sets, {});
+
+			// Finest level from the bodies in each cell, then each coarser level from its children
+			for (int32_t level = static_cast<int32_t>(params.levels); level >= 0; level--)
+			{
+				const uint32_t cellCount = 1u << (3 * level);
+				cmdBuffer.bindPipeline (vk::PipelineBindPoint::eCompute, monopolePipelines[(level == static_cast<int32_t>(params.levels)) ? 0 : 1]);
+				cmdBuffer.pushConstants (hierarchicalPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(uint32_t), &level);
+				cmdBuffer.dispatch ((cellCount + workgroupSize - 1) / workgroupSize, 1, 1);
+				cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+					vk::DependencyFlags(), computeBarrier, nullptr, nullptr);
+			}
+
+			cmdBuffer.bindPipeline (vk::PipelineBindPoint::eCompute, hierarchicalPipeline);
+			cmdBuffer.dispatch ((bodyCount + workgroupSize - 1) / workgroupSize, 1, 1);
+		}
+
+		void prepareDescriptorSetLayout()
+		{
+			// Binding 0 : Parameters
+			// Binding 1 : Source bodies
+			// Binding 2 : Destination bodies
+			// Binding 3 : Octree cell monopoles
+			std::array<vk::DescriptorSetLayoutBinding, 4> setLayoutBindings;
+			for (uint32_t i = 0; i < setLayoutBindings.size(); i++)
+			{
+				setLayoutBindings[i].setBinding (i)
+					.setDescriptorType ((i == 0) ? vk::DescriptorType::eUniformBuffer : vk::DescriptorType::eStorageBuffer)
+					.setDescriptorCount (1)
+					.setStageFlags (vk::ShaderStageFlagBits::eCompute);
+			}
+			vk::DescriptorSetLayoutCreateInfo descriptorLayout;
+			descriptorLayout.setBindingCount (static_cast<uint32_t>(setLayoutBindings.size()))
+				.setPBindings (setLayoutBindings.data());
+			descriptorSetLayout = CHECK(device->D().createDescriptorSetLayout (descriptorLayout));
+
+			vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo;
+			pipelineLayoutCreateInfo.setSetLayoutCount (1)
+				.setPSetLayouts (&descriptorSetLayout);
+			directPipelineLayout = CHECK(device->D().createPipelineLayout (pipelineLayoutCreateInfo));
+
+			if (hierarchical)
+			{
+				const std::array<vk::DescriptorSetLayout, 2> setLayouts = { grid.descriptorSetLayout, descriptorSetLayout };
+				// Octree level
+				vk::PushConstantRange pushConstantRange(vk::ShaderStageFlagBits::eCompute, 0, sizeof(uint32_t));
+				pipelineLayoutCreateInfo.setSetLayoutCount (static_cast<uint32_t>(setLayouts.size()))
+					.setPSetLayouts (setLayouts.data())
+					.setPushConstantRangeCount (1)
+					.setPPushConstantRanges (&pushConstantRange);
+				hierarchicalPipelineLayout = CHECK(device->D().createPipelineLayout (pipelineLayoutCreateInfo));
+			}
+		}
+
+		void preparePipelines(vk::PipelineCache pipelineCache)
+		{
+			const uint32_t localSize = tileSize;
+			vk::SpecializationMapEntry specializationEntry(0, 0, sizeof(uint32_t));
+			vk::SpecializationInfo specializationInfo(1, &specializationEntry, sizeof(uint32_t), &localSize);
+			directPipeline = vks::tools::createComputePipeline(device->D(), pipelineCache, directPipelineLayout, "shaders/nbody_tiled.comp.spv", &specializationInfo);
+
+			if (hierarchical)
+			{
+				for (uint32_t mode = 0; mode < 2; mode++)
+				{
+					specializationInfo.setPData (&mode);
+					monopolePipelines[mode] = vks::tools::createComputePipeline(device->D(), pipelineCache, hierarchicalPipelineLayout, "shaders/nbody_monopoles.comp.spv", &specializationInfo);
+				}
+				hierarchicalPipeline = vks::tools::createComputePipeline(device->D(), pipelineCache, hierarchicalPipelineLayout, "shaders/nbody_hierarchical.comp.spv");
+			}
+		}
+
+		void prepareDescriptorSets()
+		{
+			std::array<vk::DescriptorPoolSize, 2> poolSizes;
+			poolSizes[0].setType (vk::DescriptorType::eUniformBuffer).setDescriptorCount (2);
+			poolSizes[1].setType (vk::DescriptorType::eStorageBuffer).setDescriptorCount (2 * 3);
+			vk::DescriptorPoolCreateInfo descriptorPoolInfo;
+			descriptorPoolInfo.setPoolSizeCount (static_cast<uint32_t>(poolSizes.size()))
+				.setPPoolSizes (poolSizes.data())
+				.setMaxSets (2);
+			descriptorPool = CHECK(device->D().createDescriptorPool (descriptorPoolInfo));
+
+			std::array<vk::DescriptorSetLayout, 2> layouts = { descriptorSetLayout, descriptorSetLayout };
+			vk::DescriptorSetAllocateInfo allocInfo;
+			allocInfo.setDescriptorPool (descriptorPool)
+				.setDescriptorSetCount (static_cast<uint32_t>(layouts.size()))
+				.setPSetLayouts (layouts.data());
+			descriptorSets = CHECK(device->D().allocateDescriptorSets (allocInfo));
+
+			for (uint32_t i = 0; i < 2; i++)
+			{
+				std::array<vk::DescriptorBufferInfo, 4> bufferInfos = {
+					vk::DescriptorBufferInfo(paramsBuffer.buffer, 0, sizeof(NBodyParams)),
+					vk::DescriptorBufferInfo(buffers[1 - i].buffer, 0, VK_WHOLE_SIZE),
+					vk::DescriptorBufferInfo(buffers[i].buffer, 0, VK_WHOLE_SIZE),
+					vk::DescriptorBufferInfo(cellBuffer.buffer, 0, VK_WHOLE_SIZE)
+				};
+				std::array<vk::WriteDescriptorSet, 4> writeDescriptorSets;
+				for (uint32_t j = 0; j < writeDescriptorSets.size(); j++)
+				{
+					writeDescriptorSets[j].setDstSet (descriptorSets[i])
+						.setDstBinding (j)
+						.setDescriptorCount (1)
+						.setDescriptorType ((j == 0) ? vk::DescriptorType::eUniformBuffer : vk::DescriptorType::eStorageBuffer)
+						.setPBufferInfo (&bufferInfos[j]);
+				}
+				device->D().updateDescriptorSets (writeDescriptorSets, {});
+			}
+		}
+	};
+}
@@ -0,0 +1,712 @@
+#pragma once
+
+/*
+* Vulkan low resolution particle class
+*
+* Renders blended particles into an offscreen target of 1/ratio the size of the frame and composites them with a depth aware upsample:
+* - Scene pass     : opaque geometry at full resolution (color + depth), recorded by the application
+* - Particle pass  : subpass 0 reduces the full resolution depth to the farthest depth of each low resolution texel's footprint,
+*                    subpass 1 draws the particles (premultiplied alpha) with depth test against it
+* - Composite pass : each pixel blends the four nearest low resolution texels over the frame, weighted bilinearly and by how well
+*                    their depth matches the pixel's full resolution depth (texels across a depth edge are rejected)
+* The farthest depth keeps particles visible in texels that are only partially occluded, the composite removes them again at pixels of the occluder.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+#include "vulkan/vulkan.h"
+#include <vulkan/vulkan.hpp>
+
+#include "vksTools.h"
+#include "VulkanDevice.hpp"
+#include "VulkanInitializers.h"
+#include "VulkanParticleQuads.hpp"
+
+namespace vks
+{
+	struct ParticleOffscreen
+	{
+		/** @brief Format of the low resolution particle color (premultiplied, alpha = coverage) */
+		static const VkFormat colorFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+
+		/** @brief Push constants of the downsample and composite shaders */
+		struct PushConstants
+		{
+			uint32_t ratio;
+			/** @brief Depth difference at which a low resolution texel's weight has halved */
+			float depthTolerance;
+		};
+
+		/** @brief Image with its memory and views */
+		struct Attachment
+		{
+			VkImage image = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			/** @brief All aspects, used as attachment */
+			VkImageView view = VK_NULL_HANDLE;
+			/** @brief Depth or color aspect only, used for sampling */
+			VkImageView sampledView = VK_NULL_HANDLE;
+		};
+
+		vks::VulkanDevice *device = nullptr;
+		bool prepared = false;
+		/** @brief Full resolution size divided by the low resolution size (per axis) */
+		uint32_t ratio = 2;
+		float depthTolerance = 0.0005f;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t lowWidth = 0;
+		uint32_t lowHeight = 0;
+
+		VkFormat targetFormat;
+		VkFormat depthFormat;
+		VkImageAspectFlags depthAspectMask;
+		/** @brief Final layout of the composited targets (present for swap chain images) */
+		vk::ImageLayout targetLayout;
+
+		/** @brief Full resolution depth, written by the scene pass (depth only view for sampling) */
+		struct {
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			VkImageView sampledView = VK_NULL_HANDLE;
+		} depth;
+		Attachment lowColor;
+		Attachment lowDepth;
+
+		/** @brief Clears color and depth, leaves the depth readable by the particle and composite passes */
+		vk::RenderPass scenePass;
+		/** @brief Subpass 0 : depth downsample, subpass 1 : particles */
+		vk::RenderPass particlePass;
+		/** @brief Blends the particles over the scene color and transitions it to the target layout */
+		vk::RenderPass compositePass;
+		/** @brief Per target : color + full resolution depth */
+		std::vector<vk::Framebuffer> sceneFramebuffers;
+		/** @brief Per target : color */
+		std::vector<vk::Framebuffer> compositeFramebuffers;
+		vk::Framebuffer particleFramebuffer;
+
+		vk::Sampler sampler;
+		vk::DescriptorSetLayout downsampleSetLayout;
+		vk::DescriptorSetLayout compositeSetLayout;
+		vk::PipelineLayout downsamplePipelineLayout;
+		vk::PipelineLayout compositePipelineLayout;
+		vk::Pipeline downsamplePipeline;
+		vk::Pipeline particlePipeline;
+		vk::Pipeline compositePipeline;
+		vk::DescriptorPool descriptorPool;
+		vk::DescriptorSet downsampleSet;
+		vk::DescriptorSet compositeSet;
+
+		/** @brief Vertex pulling resources of the drawn particle buffers (descriptor sets, quad size) */
+		vks::ParticleQuads *quads = nullptr;
+
+		/**
+		* Create the render passes, pipelines and the low resolution targets
+		*
+		* @param device Device to create the resources on
+		* @param pipelineCache Pipeline cache to use
+		* @param quads Vertex pulling resources of the particle buffers, the particles are drawn with particle_pull.vert
+		* @param targetFormat Format of the composited targets
+		* @param targetLayout Final layout of the composited targets
+		* @param depthFormat Format of the full resolution depth (the low resolution depth uses the same)
+		* @param depthImage Full resolution depth attachment (needs VK_IMAGE_USAGE_SAMPLED_BIT)
+		* @param depthView Attachment view of the depth image
+		* @param targets Color views of all targets (e.g. the swap chain images)
+		* @param width Width of the targets
+		* @param height Height of the targets
+		* @param ratio Low resolution divisor, 1 renders the particles at full resolution through the same passes
+		*/
+		void prepare(vks::VulkanDevice *device, vk::PipelineCache pipelineCache, vks::ParticleQuads &quads, VkFormat targetFormat, vk::ImageLayout targetLayout,
+			VkFormat depthFormat, VkImage depthImage, VkImageView depthView, const std::vector<VkImageView> &targets, uint32_t width, uint32_t height, uint32_t ratio = 2)
+		{
+			this->device = device;
+			this->quads = &quads;
+			this->targetFormat = targetFormat;
+			this->targetLayout = targetLayout;
+			this->depthFormat = depthFormat;
+			this->ratio = std::max(ratio, 1u);
+			depthAspectMask = depthAttachmentAspects(depthFormat);
+
+			// Texels are read with texelFetch, the sampler only has to be valid
+			vk::SamplerCreateInfo samplerInfo;
+			samplerInfo.setMagFilter (vk::Filter::eNearest)
+				.setMinFilter (vk::Filter::eNearest)
+				.setMipmapMode (vk::SamplerMipmapMode::eNearest)
+				.setAddressModeU (vk::SamplerAddressMode::eClampToEdge)
+				.setAddressModeV (vk::SamplerAddressMode::eClampToEdge)
+				.setAddressModeW (vk::SamplerAddressMode::eClampToEdge)
+				.setMaxAnisotropy (1.0f);
+			sampler = CHECK(device->D().createSampler (samplerInfo));
+
+			prepareRenderPasses();
+			prepareDescriptorSetLayouts();
+			preparePipelines(pipelineCache);
+			prepareDescriptorSets();
+
+			resize(depthImage, depthView, targets, width, height);
+			prepared = true;
+		}
+
+		void destroy()
+		{
+			if (!device)
+			{
+				return;
+			}
+			destroyTargets();
+			device->D().destroyPipeline (downsamplePipeline);
+			device->D().destroyPipeline (particlePipeline);
+			device->D().destroyPipeline (compositePipeline);
+			device->D().destroyPipelineLayout (downsamplePipelineLayout);
+			device->D().destroyPipelineLayout (compositePipelineLayout);
+			device->D().destroyDescriptorSetLayout (downsampleSetLayout);
+			device->D().destroyDescriptorSetLayout (compositeSetLayout);
+			device->D().destroyDescriptorPool (descriptorPool);
+			device->D().destroyRenderPass (scenePass);
+			device->D().destroyRenderPass (particlePass);
+			device->D().destroyRenderPass (compositePass);
+			device->D().destroySampler (sampler);
+			device = nullptr;
+			prepared = false;
+		}
+
+		/**
+		* (Re)create the low resolution targets and frame buffers (e.g. after a window resize)
+		*
+		* @note The device must be idle
+		*/
+		void resize(VkImage depthImage, VkImageView depthView, const std::vector<VkImageView> &targets, uint32_t width, uint32_t height)
+		{
+			destroyTargets();
+			this->width = width;
+			this->height = height;
+			lowWidth = (width + ratio - 1) / ratio;
+			lowHeight = (height + ratio - 1) / ratio;
+			depth.image = depthImage;
+			depth.view = depthView;
+
+			// Depth only view for sampling (combined depth/stencil images can't be sampled with both aspects)
+			VkImageViewCreateInfo viewInfo = vks::initializers::imageViewCreateInfo();
+			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewInfo.format = depthFormat;
+			viewInfo.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+			viewInfo.image = depthImage;
+			VK_CHECK_RESULT(vkCreateImageView(device->GetDevice(), &viewInfo, nullptr, &depth.sampledView));
+
+			createAttachment(lowColor, colorFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+			createAttachment(lowDepth, depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, depthAspectMask, VK_IMAGE_ASPECT_DEPTH_BIT);
+
+			vk::FramebufferCreateInfo framebufferInfo;
+			for (VkImageView target : targets)
+			{
+				const std::array<vk::ImageView, 2> sceneAttachments = { target, depthView };
+				framebufferInfo.setRenderPass (scenePass)
+					.setAttachmentCount (static_cast<uint32_t>(sceneAttachments.size()))
+					.setPAttachments (sceneAttachments.data())
+					.setWidth (width)
+					.setHeight (height)
+					.setLayers (1);
+				sceneFramebuffers.push_back(CHECK(device->D().createFramebuffer (framebufferInfo)));
+
+				const vk::ImageView compositeAttachment = target;
+				framebufferInfo.setRenderPass (compositePass)
+					.setAttachmentCount (1)
+					.setPAttachments (&compositeAttachment);
+				compositeFramebuffers.push_back(CHECK(device->D().createFramebuffer (framebufferInfo)));
+			}
+			const std::array<vk::ImageView, 2> particleAttachments = { lowColor.view, lowDepth.view };
+			framebufferInfo.setRenderPass (particlePass)
+				.setAttachmentCount (static_cast<uint32_t>(particleAttachments.size()))
+				.setPAttachments (particleAttachments.data())
+				.setWidth (lowWidth)
+				.setHeight (lowHeight);
+			particleFramebuffer = CHECK(device->D().createFramebuffer (framebufferInfo));
+
+			updateDescriptorSets();
+		}
+
+		/**
+		* Begin the full resolution scene pass of a target, the application records its opaque geometry and ends the pass
+		*
+		* @note Pipelines created for the application's default render pass (same attachment formats) are compatible
+		*/
+		void beginScenePass(vk::CommandBuffer cmdBuffer, uint32_t target)
+		{
+			std::array<vk::ClearValue, 2> clearValues;
+			clearValues[0].color = std::array<float, 4>{ { 0.0f, 0.0f, 0.0f, 1.0f } };
+			clearValues[1].depthStencil = vk::ClearDepthStencilValue(1.0f, 0);
+			vk::RenderPassBeginInfo renderPassBeginInfo;
+			renderPassBeginInfo.setRenderPass (scenePass)
+				.setFramebuffer (sceneFramebuffers[target])
+				.setRenderArea (vk::Rect2D(vk::Offset2D(0, 0), vk::Extent2D(width, height)))
+				.setClearValueCount (static_cast<uint32_t>(clearValues.size()))
+				.setPClearValues (clearValues.data());
+			cmdBuffer.beginRenderPass (renderPassBeginInfo, vk::SubpassContents::eInline);
+			setViewport(cmdBuffer, width, height);
+		}
+
+		/**
+		* Record the low resolution particle pass (after the scene pass has ended)
+		*
+		* @param bufferIndex Particle buffer to draw (index into the vertex pulling descriptor sets)
+		* @param count Number of particles
+		*/
+		void buildParticlePass(vk::CommandBuffer cmdBuffer, uint32_t bufferIndex, uint32_t count)
+		{
+			std::array<vk::ClearValue, 2> clearValues;
+			clearValues[0].color = std::array<float, 4>{ { 0.0f, 0.0f, 0.0f, 0.0f } };
+			clearValues[1].depthStencil = vk::ClearDepthStencilValue(1.0f, 0);
+			vk::RenderPassBeginInfo renderPassBeginInfo;
+			renderPassBeginInfo.setRenderPass (particlePass)
+				.setFramebuffer (particleFramebuffer)
+				.setRenderArea (vk::Rect2D(vk::Offset2D(0, 0), vk::Extent2D(lowWidth, lowHeight)))
+				.setClearValueCount (static_cast<uint32_t>(clearValues.size()))
+				.setPClearValues (clearValues.data());
+			cmdBuffer.beginRenderPass (renderPassBeginInfo, vk::SubpassContents::eInline);
+			setViewport(cmdBuffer, lowWidth, lowHeight);
+
+			const PushConstants pushConstants = { ratio, depthTolerance };
+			cmdBuffer.bindPipeline (vk::PipelineBindPoint::eGraphics, downsamplePipeline);
+			cmdBuffer.bindDescriptorSets (vk::PipelineBindPoint::eGraphics, downsamplePipelineLayout, 0, downsampleSet, {});
+			cmdBuffer.pushConstants (downsamplePipelineLayout, vk::ShaderStageFlagBits::eFragment, 0, sizeof(PushConstants), &pushConstants);
+			cmdBuffer.draw (3, 1, 0, 0);
+
+			cmdBuffer.nextSubpass (vk::SubpassContents::eInline);
+			cmdBuffer.bindPipeline (vk::PipelineBindPoint::eGraphics, particlePipeline);
+			quads->drawPulled(cmdBuffer, bufferIndex, count);
+			cmdBuffer.endRenderPass ();
+		}
+
+		/**
+		* Record the composite of the particles over a target (after the particle pass)
+		*
+		* @param overlay (Optional) Records further draws over the composite before the pass ends (e.g. a text overlay)
+		*/
+		void buildCompositePass(vk::CommandBuffer cmdBuffer, uint32_t target, const std::function<void(vk::CommandBuffer, vk::RenderPass)> &overlay = nullptr)
+		{
+			vk::RenderPassBeginInfo renderPassBeginInfo;
+			renderPassBeginInfo.setRenderPass (compositePass)
+				.setFramebuffer (compositeFramebuffers[target])
+				.setRenderArea (vk::Rect2D(vk::Offset2D(0, 0), vk::Extent2D(width, height)));
+			cmdBuffer.beginRenderPass (renderPassBeginInfo, vk::SubpassContents::eInline);
+			setViewport(cmdBuffer, width, height);
+
+			const PushConstants pushConstants = { ratio, depthTolerance };
+			cmdBuffer.bindPipeline (vk::PipelineBindPoint::eGraphics, compositePipeline);
+			cmdBuffer.bindDescriptorSets (vk::PipelineBindPoint::eGraphics, compositePipelineLayout, 0, compositeSet, {});
+			cmdBuffer.pushConstants (compositePipelineLayout, vk::ShaderStageFlagBits::eFragment, 0, sizeof(PushConstants), &pushConstants);
+			cmdBuffer.draw (3, 1, 0, 0);
+			if (overlay)
+			{
+				overlay(cmdBuffer, compositePass);
+			}
+			cmdBuffer.endRenderPass ();
+		}
+
+		/** @brief Aspects of an attachment view of a depth format (depth, plus stencil for combined formats) */
+		static VkImageAspectFlags depthAttachmentAspects(VkFormat format)
+		{
+			VkImageAspectFlags aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+			if ((format == VK_FORMAT_D32_SFLOAT_S8_UINT) || (format == VK_FORMAT_D24_UNORM_S8_UINT) || (format == VK_FORMAT_D16_UNORM_S8_UINT))
+			{
+				aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+			}
+			return aspectMask;
+		}
+
+		/** @brief Particle fragments are shaded at 1 / (ratio * ratio) of the full resolution pixel count */
+		uint64_t particlePixels() const
+		{
+			return (uint64_t)lowWidth * lowHeight;
+		}
+
+	private:
+		static void setViewport(vk::CommandBuffer cmdBuffer, uint32_t width, uint32_t height)
+		{
+			cmdBuffer.setViewport (0, vk::Viewport(0.0f, 0.0f, (float)width, (float)height, 0.0f, 1.0f));
+			cmdBuffer.setScissor (0, vk::Rect2D(vk::Offset2D(0, 0), vk::Extent2D(width, height)));
+		}
+
+		void createAttachment(Attachment &attachment, VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspectMask, VkImageAspectFlags sampledAspectMask)
+		{
+			VkImageCreateInfo imageInfo = vks::initializers::imageCreateInfo();
+			imageInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageInfo.format = format;
+			imageInfo.extent = { lowWidth, lowHeight, 1 };
+			imageInfo.mipLevels = 1;
+			imageInfo.arrayLayers = 1;
+			imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageInfo.usage = usage;
+			VK_CHECK_RESULT(device->createImage(&imageInfo, &attachment.image, (aspectMask & VK_IMAGE_ASPECT_COLOR_BIT) ? "low res color" : "low res depth"));
+
+			VkMemoryRequirements memReqs;
+			vkGetImageMemoryRequirements(device->GetDevice(), attachment.image, &memReqs);
+			VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+			memAlloc.allocationSize = memReqs.size;
+			memAlloc.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal);
+			VK_CHECK_RESULT(vkAllocateMemory(device->GetDevice(), &memAlloc, nullptr, &attachment.memory));
+			VK_CHECK_RESULT(vkBindImageMemory(device->GetDevice(), attachment.image, attachment.memory, 0));
+
+			VkImageViewCreateInfo viewInfo = vks::initializers::imageViewCreateInfo();
+			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewInfo.format = format;
+			viewInfo.image = attachment.image;
+			viewInfo.subresourceRange = { aspectMask, 0, 1, 0, 1 };
+			VK_CHECK_RESULT(vkCreateImageView(device->GetDevice(), &viewInfo, nullptr, &attachment.view));
+			viewInfo.subresourceRange = { sampledAspectMask, 0, 1, 0, 1 };
+			VK_CHECK_RESULT(vkCreateImageView(device->GetDevice(), &viewInfo, nullptr, &attachment.sampledView));
+		}
+
+		void destroyAttachment(Attachment &attachment)
+		{
+			if (attachment.image)
+			{
+				vkDestroyImageView(device->GetDevice(), attachment.view, nullptr);
+				vkDestroyImageView(device->GetDevice(), attachment.sampledView, nullptr);
+				vkDestroyImage(device->GetDevice(), attachment.image, nullptr);
+				vkFreeMemory(device->GetDevice(), attachment.memory, nullptr);
+				attachment = Attachment();
+			}
+		}
+
+		void destroyTargets()
+		{
+			for (auto& framebuffer : sceneFramebuffers)
+			{
+				device->D().destroyFramebuffer (framebuffer);
+			}
+			for (auto& framebuffer : compositeFramebuffers)
+			{
+				device->D().destroyFramebuffer (framebuffer);
+			}
+			sceneFramebuffers.clear();
+			compositeFramebuffers.clear();
+			if (particleFramebuffer)
+			{
+				device->D().destroyFramebuffer (particleFramebuffer);
+				particleFramebuffer = vk::Framebuffer();
+			}
+			destroyAttachment(lowColor);
+			destroyAttachment(lowDepth);
+			if (depth.sampledView)
+			{
+				vkDestroyImageView(device->GetDevice(), depth.sampledView, nullptr);
+				depth.sampledView = VK_NULL_HANDLE;
+			}
+		}
+
+		void prepareRenderPasses()
+		{
+			// Scene : color and depth cleared, the depth ends up read only for the particle and composite passes
+			std::array<vk::AttachmentDescription, 2> attachments;
+			attachments[0].setFormat ((vk::Format)targetFormat)
+				.setSamples			(vk::SampleCountFlagBits::e1)
+				.setLoadOp			(vk::AttachmentLoadOp::eClear)
+				.setStoreOp			(vk::AttachmentStoreOp::eStore)
+				.setStencilLoadOp	(vk::AttachmentLoadOp::eDontCare)
+				.setStencilStoreOp	(vk::AttachmentStoreOp::eDontCare)
+				.setInitialLayout	(vk::ImageLayout::eUndefined)
+				.setFinalLayout		(vk::ImageLayout::eColorAttachmentOptimal);
+			attachments[1].setFormat ((vk::Format)depthFormat)
+				.setSamples			(vk::SampleCountFlagBits::e1)
+				.setLoadOp			(vk::AttachmentLoadOp::eClear)
+				.setStoreOp			(vk::AttachmentStoreOp::eStore)
+				.setStencilLoadOp	(vk::AttachmentLoadOp::eDontCare)
+				.setStencilStoreOp	(vk::AttachmentStoreOp::eDontCare)
+				.setInitialLayout	(vk::ImageLayout::eUndefined)
+				.setFinalLayout		(vk::ImageLayout::eDepthStencilReadOnlyOptimal);
+
+			vk::AttachmentReference colorReference(0, vk::ImageLayout::eColorAttachmentOptimal);
+			vk::AttachmentReference depthReference(1, vk::ImageLayout::eDepthStencilAttachmentOptimal);
+			vk::SubpassDescription subpassDescription;
+			subpassDescription.setPipelineBindPoint (vk::PipelineBindPoint::eGraphics)
+				.setColorAttachmentCount (1)
+				.setPColorAttachments (&colorReference)
+				.setPDepthStencilAttachment (&depthReference);
+
+			std::array<vk::SubpassDependency, 2> dependencies;
+			// Wait for presentation and for the previous frame's passes sampling the depth
+			dependencies[0].setSrcSubpass (VK_SUBPASS_EXTERNAL)
+				.setDstSubpass		(0)
+				.setSrcStageMask	(vk::PipelineStageFlagBits::eBottomOfPipe | vk::PipelineStageFlagBits::eFragmentShader)
+				.setDstStageMask	(vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests)
+				.setSrcAccessMask	(vk::AccessFlags())
+				.setDstAccessMask	(vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite |
+									 vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite);
+			dependencies[1].setSrcSubpass (0)
+				.setDstSubpass		(VK_SUBPASS_EXTERNAL)
+				.setSrcStageMask	(vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eLateFragmentTests)
+				.setDstStageMask	(vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eColorAttachmentOutput)
+				.setSrcAccessMask	(vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite)
+				.setDstAccessMask	(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite);
+
+			vk::RenderPassCreateInfo renderPassInfo;
+			renderPassInfo.setAttachmentCount (static_cast<uint32_t>(attachments.size()))
+				.setPAttachments (attachments.data())
+				.setSubpassCount (1)
+				.setPSubpasses (&subpassDescription)
+				.setDependencyCount (static_cast<uint32_t>(dependencies.size()))
+				.setPDependencies (dependencies.data());
+			scenePass = CHECK(device->D().createRenderPass (renderPassInfo));
+
+			// Particles : both attachments end up sampled by the composite
+			attachments[0].setFormat ((vk::Format)colorFormat)
+				.setFinalLayout		(vk::ImageLayout::eShaderReadOnlyOptimal);
+			attachments[1].setFinalLayout (vk::ImageLayout::eDepthStencilReadOnlyOptimal);
+
+			std::array<vk::SubpassDescription, 2> subpasses;
+			// Subpass 0 : depth downsample (depth only)
+			subpasses[0].setPipelineBindPoint (vk::PipelineBindPoint::eGraphics)
+				.setPDepthStencilAttachment (&depthReference);
+			// Subpass 1 : particles, depth tested without writes
+			subpasses[1].setPipelineBindPoint (vk::PipelineBindPoint::eGraphics)
+				.setColorAttachmentCount (1)
+				.setPColorAttachments (&colorReference)
+				.setPDepthStencilAttachment (&depthReference);
+
+			std::array<vk::SubpassDependency, 4> particleDependencies;
+			// Wait for the previous frame's composite sampling the low resolution targets (depth is cleared in subpass 0, color in subpass 1)
+			particleDependencies[0].setSrcSubpass (VK_SUBPASS_EXTERNAL)
+				.setDstSubpass		(0)
+				.setSrcStageMask	(vk::PipelineStageFlagBits::eFragmentShader)
+				.setDstStageMask	(vk::PipelineStageFlagBits::eEarlyFragmentTests)
+				.setSrcAccessMask	(vk::AccessFlags())
+				.setDstAccessMask	(vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite);
+			particleDependencies[3].setSrcSubpass (VK_SUBPASS_EXTERNAL)
+				.setDstSubpass		(1)
+				.setSrcStageMask	(vk::PipelineStageFlagBits::eFragmentShader)
+				.setDstStageMask	(vk::PipelineStageFlagBits::eColorAttachmentOutput)
+				.setSrcAccessMask	(vk::AccessFlags())
+				.setDstAccessMask	(vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite);
+			particleDependencies[1].setSrcSubpass (0)
+				.setDstSubpass		(1)
+				.setSrcStageMask	(vk::PipelineStageFlagBits::eLateFragmentTests)
+				.setDstStageMask	(vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests)
+				.setSrcAccessMask	(vk::AccessFlagBits::eDepthStencilAttachmentWrite)
+				.setDstAccessMask	(vk::AccessFlagBits::eDepthStencilAttachmentRead)
+				.setDependencyFlags	(vk::DependencyFlagBits::eByRegion);
+			particleDependencies[2].setSrcSubpass (1)
+				.setDstSubpass		(VK_SUBPASS_EXTERNAL)
+				.setSrcStageMask	(vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eLateFragmentTests)
+				.setDstStageMask	(vk::PipelineStageFlagBits::eFragmentShader)
+				.setSrcAccessMask	(vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite)
+				.setDstAccessMask	(vk::AccessFlagBits::eShaderRead);
+
+			renderPassInfo.setSubpassCount (static_cast<uint32_t>(subpasses.size()))
+				.setPSubpasses (subpasses.data())
+				.setDependencyCount (static_cast<uint32_t>(particleDependencies.size()))
+				.setPDependencies (particleDependencies.data());
+			particlePass = CHECK(device->D().createRenderPass (renderPassInfo));
+
+			// Composite : loads the scene color, blends the particles over it and hands it to presentation (or the target layout)
+			vk::AttachmentDescription targetAttachment;
+			targetAttachment.setFormat ((vk::Format)targetFormat)
+				.setSamples			(vk::SampleCountFlagBits::e1)
+				.setLoadOp			(vk::AttachmentLoadOp::eLoad)
+				.setStoreOp			(vk::AttachmentStoreOp::eStore)
+				.setStencilLoadOp	(vk::AttachmentLoadOp::eDontCare)
+				.setStencilStoreOp	(vk::AttachmentStoreOp::eDontCare)
+				.setInitialLayout	(vk::ImageLayout::eColorAttachmentOptimal)
+				.setFinalLayout		(targetLayout);
+			vk::SubpassDescription compositeSubpass;
+			compositeSubpass.setPipelineBindPoint (vk::PipelineBindPoint::eGraphics)
+				.setColorAttachmentCount (1)
+				.setPColorAttachments (&colorReference);
+			std::array<vk::SubpassDependency, 2> compositeDependencies;
+			compositeDependencies[0].setSrcSubpass (VK_SUBPASS_EXTERNAL)
+				.setDstSubpass		(0)
+				.setSrcStageMask	(vk::PipelineStageFlagBits::eColorAttachmentOutput)
+				.setDstStageMask	(vk::PipelineStageFlagBits::eColorAttachmentOutput)
+				.setSrcAccessMask	(vk::AccessFlagBits::eColorAttachmentWrite)
+				.setDstAccessMask	(vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite);
+			compositeDependencies[1].setSrcSubpass (0)
+				.setDstSubpass		(VK_SUBPASS_EXTERNAL)
+				.setSrcStageMask	(vk::PipelineStageFlagBits::eColorAttachmentOutput)
+				.setDstStageMask	(vk::PipelineStageFlagBits::eBottomOfPipe | vk::PipelineStageFlagBits::eTransfer)
+				.setSrcAccessMask	(vk::AccessFlagBits::eColorAttachmentWrite)
+				.setDstAccessMask	(vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eTransferRead);
+
+			renderPassInfo.setAttachmentCount (1)
+				.setPAttachments (&targetAttachment)
+				.setSubpassCount (1)
+				.setPSubpasses (&compositeSubpass)
+				.setDependencyCount (static_cast<uint32_t>(compositeDependencies.size()))
+				.setPDependencies (compositeDependencies.data());
+			compositePass = CHECK(device->D().createRenderPass (renderPassInfo));
+		}
+
+		void prepareDescriptorSetLayouts()
+		{
+			// Downsample
+			// Binding 0 : Full resolution depth
+			vk::DescriptorSetLayoutBinding downsampleBinding(0, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment);
+			vk::DescriptorSetLayoutCreateInfo descriptorLayout;
+			descriptorLayout.setBindingCount (1)
+				.setPBindings (&downsampleBinding);
+			downsampleSetLayout = CHECK(device->D().createDescriptorSetLayout (descriptorLayout));
+
+			// Composite
+			// Binding 0 : Low resolution particle color
+			// Binding 1 : Low resolution depth
+			// Binding 2 : Full resolution depth
+			std::array<vk::DescriptorSetLayoutBinding, 3> compositeBindings;
+			for (uint32_t i = 0; i < compositeBindings.size(); i++)
+			{
+				compositeBindings[i].setBinding (i)
+					.setDescriptorType (vk::DescriptorType::eCombinedImageSampler)
+					.setDescriptorCount (1)
+					.setStageFlags (vk::ShaderStageFlagBits::eFragment);
+			}
+			descriptorLayout.setBindingCount (static_cast<uint32_t>(compositeBindings.size()))
+				.setPBindings (compositeBindings.data());
+			compositeSetLayout = CHECK(device->D().createDescriptorSetLayout (descriptorLayout));
+
+			vk::PushConstantRange pushConstantRange(vk::ShaderStageFlagBits::eFragment, 0, sizeof(PushConstants));
+			vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo;
+			pipelineLayoutCreateInfo.setSetLayoutCount (1)
+				.setPSetLayouts (&downsampleSetLayout)
+				.setPushConstantRangeCount (1)
+				.setPPushConstantRanges (&pushConstantRange);
+			downsamplePipelineLayout = CHECK(device->D().createPipelineLayout (pipelineLayoutCreateInfo));
+			pipelineLayoutCreateInfo.setPSetLayouts (&compositeSetLayout);
+			compositePipelineLayout = CHECK(device->D().createPipelineLayout (pipelineLayoutCreateInfo));
+		}
+
+		void preparePipelines(vk::PipelineCache pipelineCache)
+		{
+			// No vertex input (full screen triangle or vertex pulling)
+			vk::PipelineVertexInputStateCreateInfo vertexInputState;
+			vk::PipelineInputAssemblyStateCreateInfo inputAssemblyState;
+			inputAssemblyState.setTopology (vk::PrimitiveTopology::eTriangleList);
+			vk::PipelineRasterizationStateCreateInfo rasterizationState;
+			rasterizationState.setPolygonMode (vk::PolygonMode::eFill)
+				.setCullMode (vk::CullModeFlagBits::eNone)
+				.setFrontFace (vk::FrontFace::eCounterClockwise)
+				.setLineWidth (1.0f);
+			vk::PipelineColorBlendAttachmentState blendAttachmentState;
+			blendAttachmentState.setColorWriteMask (vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA);
+			vk::PipelineColorBlendStateCreateInfo colorBlendState;
+			colorBlendState.setAttachmentCount (0)
+				.setPAttachments (&blendAttachmentState);
+			vk::PipelineViewportStateCreateInfo viewportState;
+			viewportState.setViewportCount (1)
+				.setScissorCount (1);
+			std::array<vk::DynamicState, 2> dynamicStates = { vk::DynamicState::eViewport, vk::DynamicState::eScissor };
+			vk::PipelineDynamicStateCreateInfo dynamicState;
+			dynamicState.setDynamicStateCount (static_cast<uint32_t>(dynamicStates.size()))
+				.setPDynamicStates (dynamicStates.data());
+			// Downsample writes the depth of every texel
+			vk::PipelineDepthStencilStateCreateInfo depthStencilState;
+			depthStencilState.setDepthTestEnable (true)
+				.setDepthWriteEnable (true)
+				.setDepthCompareOp (vk::CompareOp::eAlways);
+			vk::PipelineMultisampleStateCreateInfo multisampleState;
+			multisampleState.setRasterizationSamples (vk::SampleCountFlagBits::e1);
+
+			std::array<vk::PipelineShaderStageCreateInfo, 2> shaderStages;
+			shaderStages[0].setStage (vk::ShaderStageFlagBits::eVertex)
+				.setModule (vks::tools::loadSPIRVShader("shaders/fullscreen.vert.spv", device->D()))
+				.setPName ("main");
+			shaderStages[1].setStage (vk::ShaderStageFlagBits::eFragment)
+				.setModule (vks::tools::loadSPIRVShader("shaders/depth_downsample.frag.spv", device->D()))
+				.setPName ("main");
+
+			vk::GraphicsPipelineCreateInfo pipelineCreateInfo;
+			pipelineCreateInfo.setLayout (downsamplePipelineLayout)
+				.setRenderPass (particlePass)
+				.setSubpass (0)
+				.setStageCount (static_cast<uint32_t>(shaderStages.size()))
+				.setPStages (shaderStages.data())
+				.setPVertexInputState (&vertexInputState)
+				.setPInputAssemblyState (&inputAssemblyState)
+				.setPRasterizationState (&rasterizationState)
+				.setPColorBlendState (&colorBlendState)
+				.setPMultisampleState (&multisampleState)
+				.setPViewportState (&viewportState)
+				.setPDepthStencilState (&depthStencilState)
+				.setPDynamicState (&dynamicState);
+			downsamplePipeline = device->createGraphicsPipeline(pipelineCache, pipelineCreateInfo, "low res downsample");
+			device->D().destroyShaderModule (shaderStages[1].module);
+
+			// Composite : premultiplied particles over the scene, no depth attachment
+			colorBlendState.setAttachmentCount (1);
+			blendAttachmentState.setBlendEnable (true)
+				.setSrcColorBlendFactor (vk::BlendFactor::eOne)
+				.setDstColorBlendFactor (vk::BlendFactor::eOneMinusSrcAlpha)
+				.setColorBlendOp (vk::BlendOp::eAdd)
+				.setSrcAlphaBlendFactor (vk::BlendFactor::eZero)
+				.setDstAlphaBlendFactor (vk::BlendFactor::eOne)
+				.setAlphaBlendOp (vk::BlendOp::eAdd);
+			shaderStages[1].setModule (vks::tools::loadSPIRVShader("shaders/upsample_composite.frag.spv", device->D()));
+			pipelineCreateInfo.setLayout (compositePipelineLayout)
+				.setRenderPass (compositePass)
+				.setSubpass (0)
+				.setPDepthStencilState (nullptr);
+			compositePipeline = device->createGraphicsPipeline(pipelineCache, pipelineCreateInfo, "low res composite");
+			device->D().destroyShaderModule (shaderStages[0].module);
+			device->D().destroyShaderModule (shaderStages[1].module);
+
+			// Particles : vertex pulled quads, premultiplied alpha accumulated front to back independent (over operator)
+			blendAttachmentState.setSrcAlphaBlendFactor (vk::BlendFactor::eOne)
+				.setDstAlphaBlendFactor (vk::BlendFactor::eOneMinusSrcAlpha);
+			depthStencilState.setDepthWriteEnable (false)
+				.setDepthCompareOp (vk::CompareOp::eLessOrEqual);
+			vk::SpecializationMapEntry quadSizeEntry;
+			const vk::SpecializationInfo quadSpecialization = quads->specializationInfo(quadSizeEntry);
+			shaderStages[0].setModule (vks::tools::loadSPIRVShader("shaders/particle_pull.vert.spv", device->D()))
+				.setPSpecializationInfo (&quadSpecialization);
+			shaderStages[1].setModule (vks::tools::loadSPIRVShader("shaders/particle_soft.frag.spv", device->D()));
+			pipelineCreateInfo.setLayout (quads->pipelineLayout)
+				.setRenderPass (particlePass)
+				.setSubpass (1)
+				.setPDepthStencilState (&depthStencilState);
+			particlePipeline = device->createGraphicsPipeline(pipelineCache, pipelineCreateInfo, "low res particles");
+			device->D().destroyShaderModule (shaderStages[0].module);
+			device->D().destroyShaderModule (shaderStages[1].module);
+		}
+
+		void prepareDescriptorSets()
+		{
+			vk::DescriptorPoolSize poolSize(vk::DescriptorType::eCombinedImageSampler, 4);
+			vk::DescriptorPoolCreateInfo descriptorPoolInfo;
+			descriptorPoolInfo.setPoolSizeCount (1)
+				.setPPoolSizes (&poolSize)
+				.setMaxSets (2);
+			descriptorPool = CHECK(device->D().createDescriptorPool (descriptorPoolInfo));
+
+			std::array<vk::DescriptorSetLayout, 2> layouts = { downsampleSetLayout, compositeSetLayout };
+			vk::DescriptorSetAllocateInfo allocInfo;
+			allocInfo.setDescriptorPool (descriptorPool)
+				.setDescriptorSetCount (static_cast<uint32_t>(layouts.size()))
+				.setPSetLayouts (layouts.data());
+			std::vector<vk::DescriptorSet> sets = CHECK(device->D().allocateDescriptorSets (allocInfo));
+			downsampleSet = sets[0];
+			compositeSet = sets[1];
+		}
+
+		/** @brief Update the image bindings for the current targets */
+		void updateDescriptorSets()
+		{
+			std::array<vk::DescriptorImageInfo, 3> imageInfos = {
+				vk::DescriptorImageInfo(sampler, lowColor.sampledView, vk::ImageLayout::eShaderReadOnlyOptimal),
+				vk::DescriptorImageInfo(sampler, lowDepth.sampledView, vk::ImageLayout::eDepthStencilReadOnlyOptimal),
+				vk::DescriptorImageInfo(sampler, depth.sampledView, vk::ImageLayout::eDepthStencilReadOnlyOptimal)
+			};
+			std::array<vk::WriteDescriptorSet, 4> writeDescriptorSets = {
+				vk::WriteDescriptorSet(downsampleSet, 0, 0, 1, vk::DescriptorType::eCombinedImageSampler, &imageInfos[2]),
+				vk::WriteDescriptorSet(compositeSet, 0, 0, 1, vk::DescriptorType::eCombinedImageSampler, &imageInfos[0]),
+				vk::WriteDescriptorSet(compositeSet, 1, 0, 1, vk::DescriptorType::eCombinedImageSampler, &imageInfos[1]),
+				vk::WriteDescriptorSet(compositeSet, 2, 0, 1, vk::DescriptorType::eCombinedImageSampler, &imageInfos[2])
+			};
+			device->D().updateDescriptorSets (writeDescriptorSets, {});
+		}
+	};
+}
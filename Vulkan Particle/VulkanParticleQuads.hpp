@@ -0,0 +1,239 @@
+#pragma once
+
+/*
+* Vulkan particle quads class
+*
+* Draws particles (Particle layout) as camera facing quads, either
+* - Instanced      : one instance of a four corner triangle strip per particle, the particle buffer is an instance rate vertex binding
+* - Vertex pulling : no vertex input, six vertices per particle read their particle from the storage buffer (gl_VertexIndex / 6)
+* Both read the simulation buffers in place, there is no copy into a separate render buffer.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include <vulkan/vulkan.hpp>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include "vksTools.h"
+#include "VulkanBuffer.hpp"
+#include "VulkanDevice.hpp"
+#include "VulkanParticleSystem.hpp"
+
+namespace vks
+{
+	/** @brief How particles are turned into primitives */
+	enum class ParticleRenderMode
+	{
+		Points,			// Point list, the particle buffer is the vertex buffer
+		Instanced,		// Instanced quads, the particle buffer is a per-instance vertex buffer
+		VertexPulling	// Quads expanded in the vertex shader from the particle storage buffer
+	};
+
+	/** @brief Name of a render mode for log output */
+	inline const char* particleRenderModeName(ParticleRenderMode mode)
+	{
+		switch (mode)
+		{
+		case ParticleRenderMode::Points: return "points";
+		case ParticleRenderMode::Instanced: return "instanced quads";
+		case ParticleRenderMode::VertexPulling: return "vertex pulling";
+		}
+		return "unknown";
+	}
+
+	/**
+	* @brief Resources for drawing particle buffers as quads
+	*
+	* The pipelines are created by the application (render pass and states are its own):
+	*	Instanced      : bindingDescriptions() / attributeDescriptions(), particle_quad.vert, the application's layout (binding 0 = camera)
+	*	Vertex pulling : no vertex input, particle_pull.vert, pipelineLayout (binding 0 = camera, binding 1 = particles)
+	* Both pass the quad size as specialization constant 0 (see specializationInfo())
+	*/
+	struct ParticleQuads
+	{
+		/** @brief Vertices per particle of the vertex pulling draw (two triangles) */
+		static const uint32_t verticesPerQuad = 6;
+
+		vks::VulkanDevice *device = nullptr;
+		/** @brief Edge length of the quads in world units */
+		float size = 0.01f;
+
+		/** @brief Triangle strip corners (vec2, -1..1) of the instanced draw */
+		vks::Buffer cornerBuffer;
+
+		vk::DescriptorSetLayout descriptorSetLayout;
+		vk::PipelineLayout pipelineLayout;
+		vk::DescriptorPool descriptorPool;
+		/** @brief Set i reads particle buffer i */
+		std::vector<vk::DescriptorSet> descriptorSets;
+
+		/**
+		* Create the corner buffer and the vertex pulling descriptor sets
+		*
+		* @param device Device to create the resources on
+		* @param queue Queue used for the corner upload
+		* @param camera Uniform buffer with the camera matrices (same layout as the point pipeline's binding 0)
+		* @param particles Particle buffers that are drawn (e.g. both buffers of a double buffered simulation)
+		* @param size Edge length of the quads in world units
+		*/
+		void prepare(vks::VulkanDevice *device, vk::Queue queue, const vk::DescriptorBufferInfo &camera, const std::vector<vk::Buffer> &particles, float size = 0.01f)
+		{
+			this->device = device;
+			this->size = size;
+
+			const std::array<glm::vec2, 4> corners = { glm::vec2(-1.0f, -1.0f), glm::vec2(1.0f, -1.0f), glm::vec2(-1.0f, 1.0f), glm::vec2(1.0f, 1.0f) };
+			VK_CHECK_RESULT(device->createDeviceLocalBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &cornerBuffer, sizeof(corners), (void*)corners.data(), queue));
+
+			// Binding 0 : Camera matrices
+			// Binding 1 : Particles
+			std::array<vk::DescriptorSetLayoutBinding, 2> setLayoutBindings;
+			for (uint32_t i = 0; i < setLayoutBindings.size(); i++)
+			{
+				setLayoutBindings[i].setBinding (i)
+					.setDescriptorType ((i == 0) ? vk::DescriptorType::eUniformBuffer : vk::DescriptorType::eStorageBuffer)
+					.setDescriptorCount (1)
+					.setStageFlags (vk::ShaderStageFlagBits::eVertex);
+			}
+			vk::DescriptorSetLayoutCreateInfo descriptorLayout;
+			descriptorLayout.setBindingCount (static_cast<uint32_t>(setLayoutBindings.size()))
+				.setPBindings (setLayoutBindings.data());
+			descriptorSetLayout = CHECK(device->D().createDescriptorSetLayout (descriptorLayout));
+
+			vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo;
+			pipelineLayoutCreateInfo.setSetLayoutCount (1)
+				.setPSetLayouts (&descriptorSetLayout);
+			pipelineLayout = CHECK(device->D().createPipelineLayout (pipelineLayoutCreateInfo));
+
+			const uint32_t setCount = static_cast<uint32_t>(particles.size());
+			std::array<vk::DescriptorPoolSize, 2> poolSizes;
+			poolSizes[0].setType (vk::DescriptorType::eUniformBuffer).setDescriptorCount (setCount);
+			poolSizes[1].setType (vk::DescriptorType::eStorageBuffer).setDescriptorCount (setCount);
+			vk::DescriptorPoolCreateInfo descriptorPoolInfo;
+			descriptorPoolInfo.setPoolSizeCount (static_cast<uint32_t>(poolSizes.size()))
+				.setPPoolSizes (poolSizes.data())
+				.setMaxSets (setCount);
+			descriptorPool = CHECK(device->D().createDescriptorPool (descriptorPoolInfo));
+
+			std::vector<vk::DescriptorSetLayout> layouts(setCount, descriptorSetLayout);
+			vk::DescriptorSetAllocateInfo allocInfo;
+			allocInfo.setDescriptorPool (descriptorPool)
+				.setDescriptorSetCount (setCount)
+				.setPSetLayouts (layouts.data());
+			descriptorSets = CHECK(device->D().allocateDescriptorSets (allocInfo));
+
+			for (uint32_t i = 0; i < setCount; i++)
+			{
+				std::array<vk::DescriptorBufferInfo, 2> bufferInfos = {
+					camera,
+					vk::DescriptorBufferInfo(particles[i], 0, VK_WHOLE_SIZE)
+				};
+				std::array<vk::WriteDescriptorSet, 2> writeDescriptorSets;
+				for (uint32_t j = 0; j < writeDescriptorSets.size(); j++)
+				{
+					writeDescriptorSets[j].setDstSet (descriptorSets[i])
+						.setDstBinding (j)
+						.setDescriptorCount (1)
+						.setDescriptorType ((j == 0) ? vk::DescriptorType::eUniformBuffer : vk::DescriptorType::eStorageBuffer)
+						.setPBufferInfo (&bufferInfos[j]);
+				}
+				device->D().updateDescriptorSets (writeDescriptorSets, {});
+			}
+		}
+
+		void destroy()
+		{
+			if (!device)
+			{
+				return;
+			}
+			device->D().destroyPipelineLayout (pipelineLayout);
+			device->D().destroyDescriptorSetLayout (descriptorSetLayout);
+			device->D().destroyDescriptorPool (descriptorPool);
+			cornerBuffer.destroy();
+			device = nullptr;
+		}
+
+		/** @brief Specialization constant 0 of both vertex shaders (quad size), entry and data must outlive the pipeline creation */
+		vk::SpecializationInfo specializationInfo(vk::SpecializationMapEntry &entry) const
+		{
+			entry = vk::SpecializationMapEntry(0, 0, sizeof(float));
+			return vk::SpecializationInfo(1, &entry, sizeof(float), &size);
+		}
+
+		/** @brief Binding 0 : corners (per vertex), binding 1 : particles (per instance) */
+		static std::array<vk::VertexInputBindingDescription, 2> bindingDescriptions()
+		{
+			std::array<vk::VertexInputBindingDescription, 2> bindings;
+			bindings[0].setBinding (0)
+				.setStride (sizeof(glm::vec2))
+				.setInputRate (vk::VertexInputRate::eVertex);
+			bindings[1].setBinding (1)
+				.setStride (sizeof(Particle))
+				.setInputRate (vk::VertexInputRate::eInstance);
+			return bindings;
+		}
+
+		/** @brief Location 0 : corner (vec2), location 1 : position + remaining lifetime (vec4), location 2 : velocity (vec3) */
+		static std::array<vk::VertexInputAttributeDescription, 3> attributeDescriptions()
+		{
+			std::array<vk::VertexInputAttributeDescription, 3> attributes;
+			attributes[0].setBinding (0)
+				.setLocation (0)
+				.setFormat (vk::Format::eR32G32Sfloat)
+				.setOffset (0);
+			attributes[1].setBinding (1)
+				.setLocation (1)
+				.setFormat (vk::Format::eR32G32B32A32Sfloat)
+				.setOffset (offsetof(Particle, position));
+			attributes[2].setBinding (1)
+				.setLocation (2)
+				.setFormat (vk::Format::eR32G32B32Sfloat)
+				.setOffset (offsetof(Particle, velocity));
+			return attributes;
+		}
+
+		/**
+		* Record the instanced draw of a particle buffer
+		*
+		* @note The instanced pipeline and its camera descriptor set must be bound
+		*/
+		void drawInstanced(vk::CommandBuffer cmdBuffer, vk::Buffer particles, uint32_t count)
+		{
+			const std::array<vk::Buffer, 2> vertexBuffers = { vk::Buffer(cornerBuffer.buffer), particles };
+			const std::array<vk::DeviceSize, 2> offsets = { 0, 0 };
+			cmdBuffer.bindVertexBuffers (0, vertexBuffers, offsets);
+			cmdBuffer.draw (4, count, 0, 0);
+		}
+
+		/**
+		* Record the vertex pulling draw of particle buffer bufferIndex (as passed to prepare)
+		*
+		* @note The vertex pulling pipeline must be bound
+		*/
+		void drawPulled(vk::CommandBuffer cmdBuffer, uint32_t bufferIndex, uint32_t count)
+		{
+			cmdBuffer.bindDescriptorSets (vk::PipelineBindPoint::eGraphics, pipelineLayout, 0, descriptorSets[bufferIndex], {});
+			cmdBuffer.draw (count * verticesPerQuad, 1, 0, 0);
+		}
+
+		/** @brief Vertex shader invocations per particle */
+		static uint32_t verticesPerParticle(ParticleRenderMode mode)
+		{
+			switch (mode)
+			{
+			case ParticleRenderMode::Instanced: return 4;
+			case ParticleRenderMode::VertexPulling: return verticesPerQuad;
+			default: return 1;
+			}
+		}
+	};
+}
@@ -0,0 +1,1076 @@
+#pragma once
+
+/*
+* Vulkan compute particle system class
+*
+* Particle state lives in two storage buffers, each step reads one and writes the other on the compute queue.
+* If the device has a dedicated compute queue family, the written buffer is released to the graphics queue family
+* for rendering (as vertex buffer) and released back to compute afterwards (queue family ownership transfer).
+* Compute steps and graphics frames are chained with semaphores, so both queues can work without host stalls.
+* With async compute (dedicated compute family only) a third buffer decouples the queues: the step of frame N + 1
+* integrates on the compute queue while the graphics queue draws the state of frame N, at one frame of extra latency.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <array>
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+#include <iostream>
+#include <cstring>
+#include <cassert>
+
+#include "vulkan/vulkan.h"
+#include <vulkan/vulkan.hpp>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include "vksSimd.h"
+#include "vksTools.h"
+#include "VulkanBuffer.hpp"
+#include "VulkanDevice.hpp"
+#include "VulkanGpuProfiler.hpp"
+#include "VulkanInitializers.h"
+#include "VulkanRadixSort.hpp"
+#include "VulkanParticleGrid.hpp"
+
+namespace vks
+{
+	/**
+	* @brief Particle layout shared by the compute kernel, the vertex input and the host simulator
+	*
+	* Matches the std430 Particle struct of particle_simulate.comp
+	*/
+	struct Particle
+	{
+		/** @brief xyz = position, w = remaining lifetime in seconds */
+		glm::vec4 position;
+		glm::vec3 velocity;
+		/** @brief Number of respawns, seeds the emitter random numbers */
+		uint32_t generation;
+	};
+
+	/** @brief Simulation parameters, layout matches the std140 uniform block of particle_simulate.comp */
+	struct ParticleParams
+	{
+		/** @brief xyz = acceleration, w = time step in seconds */
+		glm::vec4 gravity = glm::vec4(0.0f, 4.0f, 0.0f, 1.0f / 60.0f);
+		/** @brief xyz = spawn position, w = max. sideways start velocity */
+		glm::vec4 emitter = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		/** @brief Velocity scale per step */
+		float damping = 0.995f;
+		/** @brief Particles bounce off the plane y = floorHeight (+y points down on screen) */
+		float floorHeight = 1.0f;
+		/** @brief Fraction of the vertical velocity kept when bouncing */
+		float restitution = 0.5f;
+		/** @brief Max. lifetime in seconds */
+		float lifetime = 4.0f;
+		/** @brief Upward start velocity */
+		float launchSpeed = 3.0f;
+		uint32_t particleCount = 0;
+		uint32_t pad[2];
+	};
+
+	/**
+	* @brief Host implementation of the simulation step
+	*
+	* Every operation matches particle_simulate.comp one to one (the shader marks all results precise to prevent fused
+	* multiply-adds), so with IEEE float rounding on both sides host and device results are bit identical
+	*/
+	VKS_FP_CONTRACT_OFF_BEGIN
+	namespace particles
+	{
+		inline uint32_t hash(uint32_t x)
+		{
+			x ^= x >> 16;
+			x *= 0x7feb352du;
+			x ^= x >> 15;
+			x *= 0x846ca68bu;
+			x ^= x >> 16;
+			return x;
+		}
+
+		/** @brief Uniform random number in [0..1), exact in float (24 bit mantissa) */
+		inline float random01(uint32_t x)
+		{
+			return (float)(hash(x) >> 8) * (1.0f / 16777216.0f);
+		}
+
+		/** @brief Start state of a particle for the given generation */
+		inline void respawn(uint32_t index, uint32_t generation, const ParticleParams &params, glm::vec3 &position, glm::vec3 &velocity, float &life)
+		{
+			const uint32_t seed = hash(index ^ hash(generation));
+			const float r0 = random01(seed);
+			const float r1 = random01(seed + 1u);
+			const float r2 = random01(seed + 2u);
+			const float r3 = random01(seed + 3u);
+			position = glm::vec3(params.emitter);
+			velocity.x = (r0 * 2.0f - 1.0f) * params.emitter.w;
+			velocity.y = -params.launchSpeed * (0.75f + 0.25f * r1);
+			velocity.z = (r2 * 2.0f - 1.0f) * params.emitter.w;
+			life = params.lifetime * (0.5f + 0.5f * r3);
+		}
+
+		/** @brief Initial state, lifetimes are staggered so particles don't all respawn at once */
+		inline Particle initial(uint32_t index, const ParticleParams &params)
+		{
+			Particle particle;
+			glm::vec3 position;
+			float life;
+			respawn(index, 0, params, position, particle.velocity, life);
+			particle.position = glm::vec4(position, params.lifetime * random01(index ^ 0x9e3779b9u));
+			particle.generation = 0;
+			return particle;
+		}
+
+		/** @brief Scalar reference of one integration step */
+		inline Particle step(uint32_t index, const Particle &src, const ParticleParams &params)
+		{
+			const float dt = params.gravity.w;
+			Particle dst;
+			glm::vec3 position;
+			glm::vec3 velocity;
+			float life = src.position.w - dt;
+			dst.generation = src.generation;
+			if (life <= 0.0f)
+			{
+				dst.generation = src.generation + 1u;
+				respawn(index, dst.generation, params, position, velocity, life);
+			}
+			else
+			{
+				for (uint32_t i = 0; i < 3; i++)
+				{
+					velocity[i] = src.velocity[i] + params.gravity[i] * dt;
+					velocity[i] = velocity[i] * params.damping;
+					position[i] = src.position[i] + velocity[i] * dt;
+				}
+				if (position.y > params.floorHeight)
+				{
+					position.y = params.floorHeight;
+					velocity.y = -velocity.y * params.restitution;
+				}
+			}
+			dst.position = glm::vec4(position, life);
+			dst.velocity = velocity;
+			return dst;
+		}
+	}
+	VKS_FP_CONTRACT_OFF_END
+
+	/**
+	* @brief Double buffered compute particle simulation with queue family ownership transfers
+	*
+	* Per frame:
+	*	submitStep()			Compute queue : acquire the previous buffer, integrate into the other one, release it to graphics
+	*	buildGraphicsAcquire()	Graphics queue : acquire the written buffer before drawing it
+	*	buildGraphicsRelease()	Graphics queue : release it back to compute after drawing
+	* The graphics submission has to wait on graphicsWaitSemaphore() and signal graphicsSignalSemaphore() (exactly once per step)
+	*
+	* Async compute (triple buffered), step s writes buffers[s % 3] and reads buffers[(s - 1) % 3]:
+	*	submitStep()			Compute queue : acquire the destination (drawn by the previous frame), integrate, release the source to graphics
+	*	Graphics frame s		Draws buffers[(s - 2) % 3] (the source of step s - 1), concurrently with step s
+	* Step s waits for graphics frame s - 1, graphics frame s for step s - 1, so neither queue waits for the other's current work
+	*/
+	struct ParticleSystem
+	{
+		/** @brief Must match the workgroup size specialization constant default of particle_simulate.comp */
+		static const uint32_t workgroupSize = 256;
+
+		vks::VulkanDevice *device = nullptr;
+		ParticleParams params;
+		uint32_t particleCount = 0;
+
+		/** @brief Buffers needed to overlap the step with the graphics frame */
+		static const uint32_t maxBufferCount = 3;
+
+		/** @brief Particle state, step n writes buffers[n % bufferCount] and reads buffers[(n - 1) % bufferCount] */
+		std::array<vks::Buffer, maxBufferCount> buffers;
+		/** @brief 2, or 3 with async compute */
+		uint32_t bufferCount = 2;
+		/** @brief The graphics frame draws the state before the one being integrated (see class description) */
+		bool asyncCompute = false;
+		vks::Buffer paramsBuffer;
+		/** @brief Host visible copy of a step's source and result particles (in that order), created on the first readback request */
+		vks::Buffer readbackBuffer;
+
+		struct {
+			vk::Queue queue;
+			uint32_t queueFamilyIndex;
+			vk::CommandPool commandPool;
+			/** @brief One command buffer per destination buffer */
+			std::vector<vk::CommandBuffer> commandBuffers;
+			/** @brief One time command buffer of a step that also copies its result to the readback buffer */
+			vk::CommandBuffer readbackCommandBuffer;
+			/** @brief One per command buffer */
+			std::array<vk::Fence, maxBufferCount> fences;
+		} compute;
+		uint32_t graphicsQueueFamilyIndex;
+		/** @brief True if compute and graphics use different queue families (ownership transfers required) */
+		bool dedicatedComputeQueue = false;
+
+		/** @brief Signaled by step s (slot s % 2), waited on by the graphics submission drawing its result (at graphicsReadStages) */
+		std::array<vk::Semaphore, 2> computeComplete;
+		/** @brief Signaled by graphics frame s (slot s % 2), waited on by step s + 1 */
+		std::array<vk::Semaphore, 2> graphicsComplete;
+
+		vk::DescriptorSetLayout descriptorSetLayout;
+		vk::PipelineLayout pipelineLayout;
+		vk::Pipeline pipeline;
+		vk::DescriptorPool descriptorPool;
+		std::vector<vk::DescriptorSet> descriptorSets;
+
+		/** @brief Optional back-to-front order of the particles for blending (see prepareDepthSort) */
+		struct {
+			vks::RadixSort *sort = nullptr;
+			vk::DescriptorSetLayout descriptorSetLayout;
+			vk::PipelineLayout pipelineLayout;
+			/** @brief Writes the depth keys and particle indices */
+			vk::Pipeline keyPipeline;
+			vk::DescriptorPool descriptorPool;
+			/** @brief Set i reads buffers[i] */
+			std::vector<vk::DescriptorSet> descriptorSets;
+		} depthSort;
+
+		/** @brief Optional particle-particle collisions, applied to the result of each step */
+		vks::ParticleGrid grid;
+		bool collisions = false;
+
+		/** @brief Two timestamps per command buffer */
+		vk::QueryPool queryPool;
+		bool timestampsSupported = false;
+		uint64_t timestampMask = ~0ull;
+
+		/**
+		* @brief Timeline of steps and the graphics frames submitted with them (see buildGraphicsTimestamp)
+		*
+		* Timestamps are only comparable within a queue, so the intervals of step s and graphics frame s are moved to the trace
+		* clock with a calibration of each queue (see calibrateTimeline()) before they are intersected
+		*/
+		struct {
+			/** @brief Two timestamps per step slot, written by the graphics queue */
+			vk::QueryPool queryPool;
+			bool supported = false;
+			uint64_t timestampMask = ~0ull;
+			/** @brief Converts the timestamps of both queues, null until calibrateTimeline() succeeded (no overlap is measured) */
+			const vks::GpuProfiler *profiler = nullptr;
+			vks::GpuProfiler::Calibration graphicsCalibration;
+			vks::GpuProfiler::Calibration computeCalibration;
+			/** @brief Start and end (ticks) of the most recent resolved step */
+			uint64_t stepBegin = 0;
+			uint64_t stepEnd = 0;
+			/** @brief Exponential moving averages (ms) of the graphics frame time and the part of the step running concurrently with it */
+			double graphicsMs = 0.0;
+			double overlapMs = 0.0;
+		} timeline;
+		/** @brief Number of submitted steps */
+		uint64_t stepCount = 0;
+		/** @brief GPU time of the most recent completed step (ms) */
+		double stepTimeMs = 0.0;
+		/** @brief Exponential moving average of the step time (ms) */
+		double averageStepTimeMs = 0.0;
+
+		/**
+		* Create the particle buffers, pipeline, compute command buffers and synchronization primitives
+		*
+		* @param device Device to create the resources on (compute queue family taken from its queue family indices)
+		* @param graphicsQueue Queue used for the initial upload and ownership transfer
+		* @param pipelineCache Pipeline cache to use
+		* @param particleCount Number of particles
+		* @param params Simulation parameters (particle count is set by this function)
+		* @param gridParams Enables collisions between the particles if set (time step is taken from params)
+		* @param asyncCompute Overlap the step with the graphics frame (needs a dedicated compute queue family, falls back to the serial schedule)
+		*/
+		void prepare(vks::VulkanDevice *device, vk::Queue graphicsQueue, vk::PipelineCache pipelineCache, uint32_t particleCount, const ParticleParams &params = ParticleParams(),
+			const GridParams *gridParams = nullptr, bool asyncCompute = false)
+		{
+			this->device = device;
+			// One invocation per particle in a one dimensional dispatch
+			const uint64_t maxParticleCount = (uint64_t)device->properties.limits.maxComputeWorkGroupCount[0] * workgroupSize;
+			if (particleCount > maxParticleCount)
+			{
+				std::cerr << "Particle count exceeds the max. dispatch size, clamped to " << maxParticleCount << std::endl;
+				particleCount = static_cast<uint32_t>(maxParticleCount);
+			}
+			this->particleCount = particleCount;
+			this->params = params;
+			this->params.particleCount = particleCount;
+
+			graphicsQueueFamilyIndex = device->queueFamilyIndices.graphics;
+			compute.queueFamilyIndex = device->queueFamilyIndices.compute;
+			compute.queue = device->D().getQueue (compute.queueFamilyIndex, 0);
+			dedicatedComputeQueue = (compute.queueFamilyIndex != graphicsQueueFamilyIndex);
+			// A single queue executes the step and the frame in submission order anyway
+			this->asyncCompute = asyncCompute && dedicatedComputeQueue;
+			bufferCount = this->asyncCompute ? 3 : 2;
+			if (asyncCompute && !dedicatedComputeQueue)
+			{
+				std::cerr << "No dedicated compute queue family, async compute falls back to the serial schedule on the shared queue" << std::endl;
+			}
+
+			// Initial state, all buffers start identical
+			std::vector<Particle> particles(particleCount);
+			for (uint32_t i = 0; i < particleCount; i++)
+			{
+				particles[i] = particles::initial(i, this->params);
+			}
+			const VkDeviceSize bufferSize = particles.size() * sizeof(Particle);
+			for (uint32_t i = 0; i < bufferCount; i++)
+			{
+				VK_CHECK_RESULT(device->createDeviceLocalBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+					&buffers[i], bufferSize, particles.data(), graphicsQueue));
+			}
+
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, &paramsBuffer, sizeof(ParticleParams), &this->params));
+
+			if (gridParams)
+			{
+				GridParams collisionParams = *gridParams;
+				collisionParams.dt = this->params.gravity.w;
+				grid.prepare(device, pipelineCache, collisionParams, bufferHandles(), particleCount, sizeof(Particle));
+				collisions = true;
+			}
+
+			prepareTimestamps();
+			preparePipeline(pipelineCache);
+			prepareSynchronizationPrimitives();
+			transferInitialOwnership(graphicsQueue);
+			buildComputeCommandBuffers();
+		}
+
+		void destroy()
+		{
+			if (!device)
+			{
+				return;
+			}
+			for (auto& buffer : buffers)
+			{
+				buffer.destroy();
+			}
+			paramsBuffer.destroy();
+			readbackBuffer.destroy();
+			grid.destroy();
+			device->D().destroyPipeline (pipeline);
+			device->D().destroyPipelineLayout (pipelineLayout);
+			device->D().destroyDescriptorSetLayout (descriptorSetLayout);
+			device->D().destroyDescriptorPool (descriptorPool);
+			device->D().destroyCommandPool (compute.commandPool);
+			for (auto& fence : compute.fences)
+			{
+				device->D().destroyFence (fence);
+			}
+			for (uint32_t i = 0; i < 2; i++)
+			{
+				device->D().destroySemaphore (computeComplete[i]);
+				device->D().destroySemaphore (graphicsComplete[i]);
+			}
+			if (queryPool)
+			{
+				device->D().destroyQueryPool (queryPool);
+			}
+			if (timeline.queryPool)
+			{
+				device->D().destroyQueryPool (timeline.queryPool);
+			}
+			if (depthSort.sort)
+			{
+				device->D().destroyPipeline (depthSort.keyPipeline);
+				device->D().destroyPipelineLayout (depthSort.pipelineLayout);
+				device->D().destroyDescriptorSetLayout (depthSort.descriptorSetLayout);
+				device->D().destroyDescriptorPool (depthSort.descriptorPool);
+			}
+		}
+
+		/** @brief Stages reading the particles on the graphics queue: vertex input, vertex shader (vertex pulling) and compute shader (depth sort) */
+		static vk::PipelineStageFlags graphicsReadStages()
+		{
+			return vk::PipelineStageFlagBits::eVertexInput | vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eComputeShader;
+		}
+
+		/** @brief Index of the buffer drawn by the graphics frame of the most recent step (written by it, or by the one before with async compute) */
+		uint32_t currentBuffer() const { return static_cast<uint32_t>((stepCount + bufferCount - (asyncCompute ? 3 : 1)) % bufferCount); }
+
+		/** @brief Handles of all particle buffers (index = buffer index) */
+		std::vector<vk::Buffer> bufferHandles() const
+		{
+			std::vector<vk::Buffer> handles;
+			for (uint32_t i = 0; i < bufferCount; i++)
+			{
+				handles.push_back(vk::Buffer(buffers[i].buffer));
+			}
+			return handles;
+		}
+
+		/** @brief Semaphore the graphics submission of the most recent step has to wait on (null for the first async frame, nothing to wait for) */
+		vk::Semaphore graphicsWaitSemaphore() const
+		{
+			if (asyncCompute)
+			{
+				// Step s - 1 has finished reading the drawn buffer and released it
+				return (stepCount > 1) ? computeComplete[(stepCount - 2) % 2] : vk::Semaphore();
+			}
+			return computeComplete[(stepCount - 1) % 2];
+		}
+
+		/** @brief Semaphore the graphics submission of the most recent step has to signal */
+		vk::Semaphore graphicsSignalSemaphore() const
+		{
+			return graphicsComplete[(stepCount - 1) % 2];
+		}
+
+		/**
+		* Submit the next simulation step to the compute queue
+		*
+		* Waits on the fence of the step that last used the same command buffer (two steps ago) and reads its timestamps
+		*
+		* @param readback Also copy the source and the result of this step to the host (see readbackStep())
+		*
+		* @return Index of the buffer written by this step
+		*/
+		uint32_t submitStep(bool readback = false)
+		{
+			const uint32_t index = static_cast<uint32_t>(stepCount % bufferCount);
+			VK_CHECK_RESULT(device->D().waitForFences (compute.fences[index], VK_TRUE, UINT64_MAX));
+			VK_CHECK_RESULT(device->D().resetFences (compute.fences[index]));
+			if (stepCount >= bufferCount)
+			{
+				readTimestamps(index);
+			}
+
+			// The first step has no previous graphics frame to wait for
+			vk::CommandBuffer cmdBuffer = compute.commandBuffers[index];
+			if (readback)
+			{
+				cmdBuffer = buildReadbackCommandBuffer(index);
+			}
+
+			// Serial : the previous frame drew the source, async : the previous frame drew the destination
+			vk::PipelineStageFlags waitStageMask = vk::PipelineStageFlagBits::eComputeShader;
+			vk::SubmitInfo submitInfo;
+			submitInfo.setCommandBufferCount (1)
+				.setPCommandBuffers (&cmdBuffer)
+				.setSignalSemaphoreCount (1)
+				.setPSignalSemaphores (&computeComplete[stepCount % 2]);
+			if (stepCount > 0)
+			{
+				submitInfo.setWaitSemaphoreCount (1)
+					.setPWaitSemaphores (&graphicsComplete[(stepCount - 1) % 2])
+					.setPWaitDstStageMask (&waitStageMask);
+			}
+			VK_CHECK_RESULT(compute.queue.submit (submitInfo, compute.fences[index]));
+			stepCount++;
+			return index;
+		}
+
+		/**
+		* Wait for the most recent step submitted with readback enabled and copy its result
+		*
+		* @param source Optional destination for the particles the step started from, so a single step can be replayed
+		*
+		* @note Stalls until the step has finished, meant for validation only
+		*/
+		std::vector<Particle> readbackStep(std::vector<Particle> *source = nullptr)
+		{
+			std::vector<Particle> particles;
+			if (!compute.readbackCommandBuffer)
+			{
+				return particles;
+			}
+			const uint32_t index = static_cast<uint32_t>((stepCount - 1) % bufferCount);
+			VK_CHECK_RESULT(device->D().waitForFences (compute.fences[index], VK_TRUE, UINT64_MAX));
+			particles.resize(particleCount);
+			VK_CHECK_RESULT(readbackBuffer.map());
+			const uint8_t *mapped = static_cast<const uint8_t*>(readbackBuffer.mapped);
+			memcpy(particles.data(), mapped + buffers[index].size, particles.size() * sizeof(Particle));
+			if (source)
+			{
+				source->resize(particleCount);
+				memcpy(source->data(), mapped, source->size() * sizeof(Particle));
+			}
+			readbackBuffer.unmap();
+			device->D().freeCommandBuffers (compute.commandPool, compute.readbackCommandBuffer);
+			compute.readbackCommandBuffer = nullptr;
+			return particles;
+		}
+
+		/**
+		* Record the acquire of a particle buffer on the graphics queue (before drawing it)
+		*
+		* @note Must be recorded outside of a render pass
+		*/
+		void buildGraphicsAcquire(vk::CommandBuffer cmdBuffer, uint32_t bufferIndex)
+		{
+			if (!dedicatedComputeQueue)
+			{
+				// Same queue: the step's release barrier already makes the writes visible to vertex input
+				return;
+			}
+			// The depth sort reads the particles in a compute shader on the graphics queue, vertex pulling in the vertex shader
+			vk::BufferMemoryBarrier barrier = ownershipBarrier(bufferIndex, vk::AccessFlags(), vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eShaderRead,
+				compute.queueFamilyIndex, graphicsQueueFamilyIndex);
+			cmdBuffer.pipelineBarrier (graphicsReadStages(), graphicsReadStages(),
+				vk::DependencyFlags(), nullptr, barrier, nullptr);
+		}
+
+		/**
+		* Record the release of a particle buffer from the graphics queue (after drawing it)
+		*
+		* @note Must be recorded outside of a render pass
+		*/
+		void buildGraphicsRelease(vk::CommandBuffer cmdBuffer, uint32_t bufferIndex)
+		{
+			if (!dedicatedComputeQueue)
+			{
+				return;
+			}
+			vk::BufferMemoryBarrier barrier = ownershipBarrier(bufferIndex, vk::AccessFlags(), vk::AccessFlags(),
+				graphicsQueueFamilyIndex, compute.queueFamilyIndex);
+			cmdBuffer.pipelineBarrier (graphicsReadStages(), vk::PipelineStageFlagBits::eBottomOfPipe,
+				vk::DependencyFlags(), nullptr, barrier, nullptr);
+		}
+
+		/**
+		* Record the start (begin = true, first command) or end (last command) timestamp of the graphics frame of the most recent step
+		*
+		* The overlap with the step is resolved when its slot is reused (see overlapFraction())
+		*/
+		void buildGraphicsTimestamp(vk::CommandBuffer cmdBuffer, bool begin)
+		{
+			if (!timeline.supported)
+			{
+				return;
+			}
+			const uint32_t slot = static_cast<uint32_t>((stepCount - 1) % bufferCount);
+			if (begin)
+			{
+				// Vertex input is held back by the wait for the step, a top of pipe timestamp would be written before it
+				cmdBuffer.resetQueryPool (timeline.queryPool, slot * 2, 2);
+				cmdBuffer.writeTimestamp (vk::PipelineStageFlagBits::eVertexInput, timeline.queryPool, slot * 2);
+			}
+			else
+			{
+				cmdBuffer.writeTimestamp (vk::PipelineStageFlagBits::eBottomOfPipe, timeline.queryPool, slot * 2 + 1);
+			}
+		}
+
+		/** @brief Average part of the step time that ran concurrently with a graphics frame (0 = fully serialized) */
+		double overlapFraction() const
+		{
+			return (averageStepTimeMs > 0.0) ? std::min(timeline.overlapMs / averageStepTimeMs, 1.0) : 0.0;
+		}
+
+		/** @brief The overlap is measured (both queues have been calibrated) */
+		bool overlapMeasured() const
+		{
+			return timeline.profiler != nullptr;
+		}
+
+		/**
+		* Calibrate the timestamps of the graphics and the compute queue against the trace clock, enables the overlap measurement
+		*
+		* @param profiler Enabled GPU profiler, otherwise only the per queue durations are measured
+		* @param graphicsQueue Queue the graphics frames are submitted to
+		*
+		* @note Call while both queues are idle
+		*/
+		void calibrateTimeline(vks::GpuProfiler &profiler, vk::Queue graphicsQueue)
+		{
+			if ((!timeline.supported) || (!profiler.enabled))
+			{
+				return;
+			}
+			timeline.graphicsCalibration = profiler.calibrateQueue(graphicsQueue, device->commandPool);
+			timeline.computeCalibration = profiler.calibrateQueue(compute.queue, compute.commandPool);
+			if ((timeline.graphicsCalibration.valid) && (timeline.computeCalibration.valid))
+			{
+				timeline.profiler = &profiler;
+			}
+		}
+
+		/**
+		* Enable sorting the particles by view depth on the graphics queue
+		*
+		* @param sort Radix sort with room for all particles, the sorted indices end up in its values[0] (index buffer usage)
+		* @param pipelineCache Pipeline cache to use
+		* @param camera Uniform buffer with the projection, model and view matrices
+		*/
+		void prepareDepthSort(vks::RadixSort *sort, vk::PipelineCache pipelineCache, const vk::DescriptorBufferInfo &camera)
+		{
+			assert(sort->maxCount >= particleCount);
+			depthSort.sort = sort;
+
+			// Binding 0 : Particles
+			// Binding 1 : Camera matrices
+			// Binding 2 : Keys
+			// Binding 3 : Values
+			std::array<vk::DescriptorSetLayoutBinding, 4> setLayoutBindings;
+			for (uint32_t i = 0; i < setLayoutBindings.size(); i++)
+			{
+				setLayoutBindings[i].setBinding (i)
+					.setDescriptorType ((i == 1) ? vk::DescriptorType::eUniformBuffer : vk::DescriptorType::eStorageBuffer)
+					.setDescriptorCount (1)
+					.setStageFlags (vk::ShaderStageFlagBits::eCompute);
+			}
+			vk::DescriptorSetLayoutCreateInfo descriptorLayout;
+			descriptorLayout.setBindingCount (static_cast<uint32_t>(setLayoutBindings.size()))
+				.setPBindings (setLayoutBindings.data());
+			depthSort.descriptorSetLayout = CHECK(device->D().createDescriptorSetLayout (descriptorLayout));
+
+			// Particle count
+			vk::PushConstantRange pushConstantRange(vk::ShaderStageFlagBits::eCompute, 0, sizeof(uint32_t));
+			vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo;
+			pipelineLayoutCreateInfo.setSetLayoutCount (1)
+				.setPSetLayouts (&depthSort.descriptorSetLayout)
+				.setPushConstantRangeCount (1)
+				.setPPushConstantRanges (&pushConstantRange);
+			depthSort.pipelineLayout = CHECK(device->D().createPipelineLayout (pipelineLayoutCreateInfo));
+			depthSort.keyPipeline = vks::tools::createComputePipeline(device->D(), pipelineCache, depthSort.pipelineLayout, "shaders/particle_depth_keys.comp.spv");
+
+			std::array<vk::DescriptorPoolSize, 2> poolSizes;
+			poolSizes[0].setType (vk::DescriptorType::eStorageBuffer).setDescriptorCount (3 * bufferCount);
+			poolSizes[1].setType (vk::DescriptorType::eUniformBuffer).setDescriptorCount (bufferCount);
+			vk::DescriptorPoolCreateInfo descriptorPoolInfo;
+			descriptorPoolInfo.setPoolSizeCount (static_cast<uint32_t>(poolSizes.size()))
+				.setPPoolSizes (poolSizes.data())
+				.setMaxSets (bufferCount);
+			depthSort.descriptorPool = CHECK(device->D().createDescriptorPool (descriptorPoolInfo));
+
+			std::vector<vk::DescriptorSetLayout> layouts(bufferCount, depthSort.descriptorSetLayout);
+			vk::DescriptorSetAllocateInfo allocInfo;
+			allocInfo.setDescriptorPool (depthSort.descriptorPool)
+				.setDescriptorSetCount (static_cast<uint32_t>(layouts.size()))
+				.setPSetLayouts (layouts.data());
+			depthSort.descriptorSets = CHECK(device->D().allocateDescriptorSets (allocInfo));
+
+			for (uint32_t i = 0; i < bufferCount; i++)
+			{
+				std::array<vk::DescriptorBufferInfo, 4> bufferInfos = {
+					vk::DescriptorBufferInfo(buffers[i].buffer, 0, VK_WHOLE_SIZE),
+					camera,
+					vk::DescriptorBufferInfo(sort->keys[0].buffer, 0, VK_WHOLE_SIZE),
+					vk::DescriptorBufferInfo(sort->values[0].buffer, 0, VK_WHOLE_SIZE)
+				};
+				std::array<vk::WriteDescriptorSet, 4> writeDescriptorSets;
+				for (uint32_t j = 0; j < writeDescriptorSets.size(); j++)
+				{
+					writeDescriptorSets[j].setDstSet (depthSort.descriptorSets[i])
+						.setDstBinding (j)
+						.setDescriptorCount (1)
+						.setDescriptorType ((j == 1) ? vk::DescriptorType::eUniformBuffer : vk::DescriptorType::eStorageBuffer)
+						.setPBufferInfo (&bufferInfos[j]);
+				}
+				device->D().updateDescriptorSets (writeDescriptorSets, {});
+			}
+		}
+
+		/**
+		* Record the depth key generation and sort of a particle buffer, the result is ready for an indexed draw
+		*
+		* @note Must be recorded outside of a render pass after buildGraphicsAcquire of the same buffer
+		*/
+		void buildDepthSort(vk::CommandBuffer cmdBuffer, uint32_t bufferIndex)
+		{
+			vks::RadixSort &sort = *depthSort.sort;
+			// The previous frame's draw is done reading the sorted indices before they are overwritten
+			vk::MemoryBarrier indexBarrier(vk::AccessFlagBits::eIndexRead, vk::AccessFlagBits::eShaderWrite);
+			cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eVertexInput, vk::PipelineStageFlagBits::eComputeShader,
+				vk::DependencyFlags(), indexBarrier, nullptr, nullptr);
+
+			cmdBuffer.bindPipeline (vk::PipelineBindPoint::eCompute, depthSort.keyPipeline);
+			cmdBuffer.bindDescriptorSets (vk::PipelineBindPoint::eCompute, depthSort.pipelineLayout, 0, depthSort.descriptorSets[bufferIndex], {});
+			cmdBuffer.pushConstants (depthSort.pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(uint32_t), &particleCount);
+			cmdBuffer.dispatch ((particleCount + workgroupSize - 1) / workgroupSize, 1, 1);
+
+			sort.buildCommandBuffer(cmdBuffer, particleCount);
+
+			vk::BufferMemoryBarrier drawBarrier = vks::initializers::bufferBarrier(sort.values[0].buffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eIndexRead);
+			cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eVertexInput,
+				vk::DependencyFlags(), nullptr, drawBarrier, nullptr);
+		}
+
+		/** @brief Bind the particles written by the most recent step as vertex buffer */
+		void bind(vk::CommandBuffer cmdBuffer, uint32_t binding = 0)
+		{
+			cmdBuffer.bindVertexBuffers (binding, vk::Buffer(buffers[currentBuffer()].buffer), {0});
+		}
+
+		/** @brief Vertex input binding for drawing particles as points */
+		static vk::VertexInputBindingDescription bindingDescription(uint32_t binding)
+		{
+			vk::VertexInputBindingDescription desc;
+			desc.setBinding (binding)
+				.setStride (sizeof(Particle))
+				.setInputRate (vk::VertexInputRate::eVertex);
+			return desc;
+		}
+
+		/** @brief Location 0 : position + remaining lifetime (vec4), location 1 : velocity (vec3) */
+		static std::array<vk::VertexInputAttributeDescription, 2> attributeDescriptions(uint32_t binding)
+		{
+			std::array<vk::VertexInputAttributeDescription, 2> attributes;
+			attributes[0].setBinding (binding)
+				.setLocation (0)
+				.setFormat (vk::Format::eR32G32B32A32Sfloat)
+				.setOffset (offsetof(Particle, position));
+			attributes[1].setBinding (binding)
+				.setLocation (1)
+				.setFormat (vk::Format::eR32G32B32Sfloat)
+				.setOffset (offsetof(Particle, velocity));
+			return attributes;
+		}
+
+	private:
+		vk::BufferMemoryBarrier ownershipBarrier(uint32_t bufferIndex, vk::AccessFlags srcAccess, vk::AccessFlags dstAccess, uint32_t srcFamily, uint32_t dstFamily)
+		{
+			vk::BufferMemoryBarrier barrier = vks::initializers::bufferBarrier(buffers[bufferIndex].buffer, srcAccess, dstAccess);
+			if (dedicatedComputeQueue)
+			{
+				barrier.setSrcQueueFamilyIndex (srcFamily)
+					.setDstQueueFamilyIndex (dstFamily);
+			}
+			return barrier;
+		}
+
+		void prepareTimestamps()
+		{
+			const uint32_t validBits = device->queueFamilyProperties[compute.queueFamilyIndex].timestampValidBits;
+			timestampsSupported = (validBits > 0) && (device->properties.limits.timestampPeriod > 0.0f);
+			if (!timestampsSupported)
+			{
+				std::cerr << "Compute queue doesn't support timestamps, no simulation timings available" << std::endl;
+				return;
+			}
+			timestampMask = (validBits >= 64) ? ~0ull : ((1ull << validBits) - 1);
+			vk::QueryPoolCreateInfo queryPoolInfo;
+			queryPoolInfo.setQueryType (vk::QueryType::eTimestamp)
+				.setQueryCount (2 * bufferCount);
+			queryPool = CHECK(device->D().createQueryPool (queryPoolInfo));
+
+			const uint32_t graphicsValidBits = device->queueFamilyProperties[graphicsQueueFamilyIndex].timestampValidBits;
+			timeline.supported = (graphicsValidBits > 0);
+			if (timeline.supported)
+			{
+				timeline.timestampMask = (graphicsValidBits >= 64) ? ~0ull : ((1ull << graphicsValidBits) - 1);
+				timeline.queryPool = CHECK(device->D().createQueryPool (queryPoolInfo));
+			}
+		}
+
+		void readTimestamps(uint32_t index)
+		{
+			if (!timestampsSupported)
+			{
+				return;
+			}
+			// The fence has been waited on, so the results are available
+			uint64_t timestamps[2];
+			VK_CHECK_RESULT(vkGetQueryPoolResults(device->GetDevice(), queryPool, index * 2, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT));
+			const uint64_t ticks = (timestamps[1] - timestamps[0]) & timestampMask;
+			stepTimeMs = (double)ticks * device->properties.limits.timestampPeriod / 1000000.0;
+			averageStepTimeMs = (averageStepTimeMs == 0.0) ? stepTimeMs : averageStepTimeMs * 0.95 + stepTimeMs * 0.05;
+			timeline.stepBegin = timestamps[0];
+			timeline.stepEnd = timestamps[1];
+			readTimeline(index);
+		}
+
+		// Intersects the step in slot index with the graphics frame submitted after it
+		// The frame has finished once the next step (which waits for it) has, otherwise the sample is skipped (no stall)
+		void readTimeline(uint32_t index)
+		{
+			if (!timeline.supported || (device->D().getFenceStatus (compute.fences[(index + 1) % bufferCount]) != vk::Result::eSuccess))
+			{
+				return;
+			}
+			uint64_t timestamps[2];
+			if (vkGetQueryPoolResults(device->GetDevice(), timeline.queryPool, index * 2, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+			{
+				return;
+			}
+			const double period = device->properties.limits.timestampPeriod / 1000000.0;
+			const double graphicsMs = (double)((timestamps[1] - timestamps[0]) & timeline.timestampMask) * period;
+			double overlapMs = 0.0;
+			if (timeline.profiler)
+			{
+				// Both intervals on the trace clock, each converted with the calibration of the queue that wrote it
+				const vks::GpuProfiler &profiler = *timeline.profiler;
+				const int64_t begin = std::max(profiler.traceTime(timestamps[0], timeline.graphicsCalibration, timeline.timestampMask),
+					profiler.traceTime(timeline.stepBegin, timeline.computeCalibration, timestampMask));
+				const int64_t end = std::min(profiler.traceTime(timestamps[1], timeline.graphicsCalibration, timeline.timestampMask),
+					profiler.traceTime(timeline.stepEnd, timeline.computeCalibration, timestampMask));
+				overlapMs = (end > begin) ? (end - begin) / 1000000.0 : 0.0;
+			}
+			if (timeline.graphicsMs == 0.0)
+			{
+				timeline.graphicsMs = graphicsMs;
+				timeline.overlapMs = overlapMs;
+				return;
+			}
+			timeline.graphicsMs = timeline.graphicsMs * 0.95 + graphicsMs * 0.05;
+			timeline.overlapMs = timeline.overlapMs * 0.95 + overlapMs * 0.05;
+		}
+
+		void preparePipeline(vk::PipelineCache pipelineCache)
+		{
+			// Binding 0 : Source particles
+			// Binding 1 : Destination particles
+			// Binding 2 : Simulation parameters
+			std::array<vk::DescriptorSetLayoutBinding, 3> setLayoutBindings;
+			for (uint32_t i = 0; i < setLayoutBindings.size(); i++)
+			{
+				setLayoutBindings[i].setBinding (i)
+					.setDescriptorType ((i == 2) ? vk::DescriptorType::eUniformBuffer : vk::DescriptorType::eStorageBuffer)
+					.setDescriptorCount (1)
+					.setStageFlags (vk::ShaderStageFlagBits::eCompute);
+			}
+			vk::DescriptorSetLayoutCreateInfo descriptorLayout;
+			descriptorLayout.setBindingCount (static_cast<uint32_t>(setLayoutBindings.size()))
+				.setPBindings (setLayoutBindings.data());
+			descriptorSetLayout = CHECK(device->D().createDescriptorSetLayout (descriptorLayout));
+
+			vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo;
+			pipelineLayoutCreateInfo.setSetLayoutCount (1)
+				.setPSetLayouts (&descriptorSetLayout);
+			pipelineLayout = CHECK(device->D().createPipelineLayout (pipelineLayoutCreateInfo));
+
+			vk::SpecializationMapEntry specializationEntry(0, 0, sizeof(uint32_t));
+			const uint32_t localSize = workgroupSize;
+			vk::SpecializationInfo specializationInfo(1, &specializationEntry, sizeof(uint32_t), &localSize);
+			pipeline = vks::tools::createComputePipeline(device->D(), pipelineCache, pipelineLayout, "shaders/particle_simulate.comp.spv", &specializationInfo);
+
+			std::array<vk::DescriptorPoolSize, 2> poolSizes;
+			poolSizes[0].setType (vk::DescriptorType::eStorageBuffer).setDescriptorCount (2 * bufferCount);
+			poolSizes[1].setType (vk::DescriptorType::eUniformBuffer).setDescriptorCount (bufferCount);
+			vk::DescriptorPoolCreateInfo descriptorPoolInfo;
+			descriptorPoolInfo.setPoolSizeCount (static_cast<uint32_t>(poolSizes.size()))
+				.setPPoolSizes (poolSizes.data())
+				.setMaxSets (bufferCount);
+			descriptorPool = CHECK(device->D().createDescriptorPool (descriptorPoolInfo));
+
+			std::vector<vk::DescriptorSetLayout> layouts(bufferCount, descriptorSetLayout);
+			vk::DescriptorSetAllocateInfo allocInfo;
+			allocInfo.setDescriptorPool (descriptorPool)
+				.setDescriptorSetCount (static_cast<uint32_t>(layouts.size()))
+				.setPSetLayouts (layouts.data());
+			descriptorSets = CHECK(device->D().allocateDescriptorSets (allocInfo));
+
+			// Set i writes buffer i and reads the one before
+			for (uint32_t i = 0; i < bufferCount; i++)
+			{
+				std::array<vk::DescriptorBufferInfo, 3> bufferInfos = {
+					vk::DescriptorBufferInfo(buffers[sourceBuffer(i)].buffer, 0, VK_WHOLE_SIZE),
+					vk::DescriptorBufferInfo(buffers[i].buffer, 0, VK_WHOLE_SIZE),
+					vk::DescriptorBufferInfo(paramsBuffer.buffer, 0, sizeof(ParticleParams))
+				};
+				std::array<vk::WriteDescriptorSet, 3> writeDescriptorSets;
+				for (uint32_t j = 0; j < writeDescriptorSets.size(); j++)
+				{
+					writeDescriptorSets[j].setDstSet (descriptorSets[i])
+						.setDstBinding (j)
+						.setDescriptorCount (1)
+						.setDescriptorType ((j == 2) ? vk::DescriptorType::eUniformBuffer : vk::DescriptorType::eStorageBuffer)
+						.setPBufferInfo (&bufferInfos[j]);
+				}
+				device->D().updateDescriptorSets (writeDescriptorSets, {});
+			}
+		}
+
+		void prepareSynchronizationPrimitives()
+		{
+			compute.commandPool = device->createCommandPool(compute.queueFamilyIndex);
+			vk::CommandBufferAllocateInfo allocInfo;
+			allocInfo.setCommandPool (compute.commandPool)
+				.setLevel (vk::CommandBufferLevel::ePrimary)
+				.setCommandBufferCount (bufferCount);
+			compute.commandBuffers = CHECK(device->D().allocateCommandBuffers (allocInfo));
+
+			vk::FenceCreateInfo fenceCreateInfo;
+			fenceCreateInfo.flags = vk::FenceCreateFlagBits::eSignaled;
+			for (uint32_t i = 0; i < bufferCount; i++)
+			{
+				compute.fences[i] = CHECK(device->D().createFence (fenceCreateInfo));
+			}
+			for (uint32_t i = 0; i < 2; i++)
+			{
+				computeComplete[i] = CHECK(device->D().createSemaphore (vk::SemaphoreCreateInfo()));
+				graphicsComplete[i] = CHECK(device->D().createSemaphore (vk::SemaphoreCreateInfo()));
+			}
+		}
+
+		// The buffers have been uploaded on the graphics queue
+		// Serial : step 0 reads buffer 1 (acquired by its command buffer like every other step) and writes buffer 0, which has to be owned by compute already
+		// Async  : step 0 acquires buffer 0 (like every other step) and reads buffer 2, which has to be owned by compute,
+		//          graphics frame 0 acquires buffer 1, which has to be released by compute
+		void transferInitialOwnership(vk::Queue graphicsQueue)
+		{
+			if (!dedicatedComputeQueue)
+			{
+				return;
+			}
+			vk::CommandBuffer cmdBuffer = device->createCommandBuffer(vk::CommandBufferLevel::ePrimary, true);
+			std::vector<vk::BufferMemoryBarrier> releaseBarriers;
+			for (uint32_t i = 0; i < bufferCount; i++)
+			{
+				releaseBarriers.push_back(ownershipBarrier(i, vk::AccessFlagBits::eTransferWrite, vk::AccessFlags(), graphicsQueueFamilyIndex, compute.queueFamilyIndex));
+			}
+			cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe,
+				vk::DependencyFlags(), nullptr, releaseBarriers, nullptr);
+			device->flushCommandBuffer(cmdBuffer, graphicsQueue);
+
+			vk::CommandBufferAllocateInfo allocInfo(compute.commandPool, vk::CommandBufferLevel::ePrimary, 1);
+			vk::CommandBuffer acquireCmdBuffer = CHECK(device->D().allocateCommandBuffers (allocInfo)).front();
+			VK_CHECK_RESULT(acquireCmdBuffer.begin (vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit)));
+			std::vector<vk::BufferMemoryBarrier> acquireBarriers;
+			if (asyncCompute)
+			{
+				acquireBarriers.push_back(ownershipBarrier(1, vk::AccessFlags(), vk::AccessFlagBits::eShaderRead, graphicsQueueFamilyIndex, compute.queueFamilyIndex));
+				acquireBarriers.push_back(ownershipBarrier(2, vk::AccessFlags(), vk::AccessFlagBits::eShaderRead, graphicsQueueFamilyIndex, compute.queueFamilyIndex));
+			}
+			else
+			{
+				acquireBarriers.push_back(ownershipBarrier(0, vk::AccessFlags(), vk::AccessFlagBits::eShaderWrite, graphicsQueueFamilyIndex, compute.queueFamilyIndex));
+			}
+			acquireCmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eComputeShader,
+				vk::DependencyFlags(), nullptr, acquireBarriers, nullptr);
+			if (asyncCompute)
+			{
+				vk::BufferMemoryBarrier releaseBarrier = ownershipBarrier(1, vk::AccessFlags(), vk::AccessFlags(), compute.queueFamilyIndex, graphicsQueueFamilyIndex);
+				acquireCmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eBottomOfPipe,
+					vk::DependencyFlags(), nullptr, releaseBarrier, nullptr);
+			}
+			VK_CHECK_RESULT(acquireCmdBuffer.end());
+			vk::SubmitInfo submitInfo;
+			submitInfo.setCommandBufferCount (1)
+				.setPCommandBuffers (&acquireCmdBuffer);
+			VK_CHECK_RESULT(compute.queue.submit (submitInfo, nullptr));
+			VK_CHECK_RESULT(compute.queue.waitIdle ());
+			device->D().freeCommandBuffers (compute.commandPool, acquireCmdBuffer);
+		}
+
+		void buildComputeCommandBuffers()
+		{
+			for (uint32_t i = 0; i < bufferCount; i++)
+			{
+				VK_CHECK_RESULT(compute.commandBuffers[i].begin (vk::CommandBufferBeginInfo()));
+				buildStep(compute.commandBuffers[i], i, false);
+				VK_CHECK_RESULT(compute.commandBuffers[i].end());
+			}
+		}
+
+		vk::CommandBuffer buildReadbackCommandBuffer(uint32_t index)
+		{
+			if (!readbackBuffer.buffer)
+			{
+				VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+					vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, &readbackBuffer, 2 * buffers[0].size));
+			}
+			// The previous readback has to be collected first (readbackStep() frees its command buffer)
+			assert(!compute.readbackCommandBuffer);
+			vk::CommandBufferAllocateInfo allocInfo(compute.commandPool, vk::CommandBufferLevel::ePrimary, 1);
+			compute.readbackCommandBuffer = CHECK(device->D().allocateCommandBuffers (allocInfo)).front();
+			VK_CHECK_RESULT(compute.readbackCommandBuffer.begin (vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit)));
+			buildStep(compute.readbackCommandBuffer, index, true);
+			VK_CHECK_RESULT(compute.readbackCommandBuffer.end());
+			return compute.readbackCommandBuffer;
+		}
+
+		/** @brief Buffer read by the step writing buffers[index] */
+		uint32_t sourceBuffer(uint32_t index) const { return (index + bufferCount - 1) % bufferCount; }
+
+		// Step writing buffers[index], optionally with copies of its source and result to the readback buffer
+		// The copies happen between the acquire and the release, so the buffer ownership sequence is the same as for a regular step
+		void buildStep(vk::CommandBuffer cmdBuffer, uint32_t index, bool readback)
+		{
+			const uint32_t src = sourceBuffer(index);
+
+			if (timestampsSupported)
+			{
+				cmdBuffer.resetQueryPool (queryPool, index * 2, 2);
+			}
+
+			if (asyncCompute)
+			{
+				// Acquire the destination from graphics (drawn in the previous frame, execution dependency only)
+				// The source was written by the previous step on this queue and stayed here
+				std::array<vk::BufferMemoryBarrier, 2> barriers = {
+					ownershipBarrier(index, vk::AccessFlags(), vk::AccessFlagBits::eShaderWrite, graphicsQueueFamilyIndex, compute.queueFamilyIndex),
+					vks::initializers::bufferBarrier(buffers[src].buffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead)
+				};
+				cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+					vk::DependencyFlags(), nullptr, barriers, nullptr);
+			}
+			else
+			{
+				// Acquire the source from graphics (drawn in the previous frame)
+				// The destination was the source of the previous step, which only read it (execution dependency only)
+				vk::BufferMemoryBarrier acquireBarrier = ownershipBarrier(src, vk::AccessFlags(), vk::AccessFlagBits::eShaderRead,
+					graphicsQueueFamilyIndex, compute.queueFamilyIndex);
+				cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+					vk::DependencyFlags(), nullptr, acquireBarrier, nullptr);
+			}
+
+			vk::PipelineStageFlags releaseSrcStage = vk::PipelineStageFlagBits::eComputeShader;
+			vk::AccessFlags releaseSrcAccess = vk::AccessFlagBits::eShaderWrite;
+			if (readback)
+			{
+				// The source is only read by the step, so the copy doesn't have to finish before the dispatch
+				vk::BufferMemoryBarrier sourceBarrier = vks::initializers::bufferBarrier(buffers[src].buffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eTransferRead);
+				cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer,
+					vk::DependencyFlags(), nullptr, sourceBarrier, nullptr);
+				cmdBuffer.copyBuffer (vk::Buffer(buffers[src].buffer), vk::Buffer(readbackBuffer.buffer), vk::BufferCopy(0, 0, buffers[src].size));
+				releaseSrcStage |= vk::PipelineStageFlagBits::eTransfer;
+			}
+
+			if (timestampsSupported)
+			{
+				// After the wait for the previous graphics frame (compute shader stage), like the graphics frame's begin timestamp
+				cmdBuffer.writeTimestamp (vk::PipelineStageFlagBits::eComputeShader, queryPool, index * 2);
+			}
+			cmdBuffer.bindPipeline (vk::PipelineBindPoint::eCompute, pipeline);
+			cmdBuffer.bindDescriptorSets (vk::PipelineBindPoint::eCompute, pipelineLayout, 0, descriptorSets[index], {});
+			cmdBuffer.dispatch ((particleCount + workgroupSize - 1) / workgroupSize, 1, 1);
+			if (collisions)
+			{
+				grid.buildCommandBuffer(cmdBuffer, index);
+			}
+			if (timestampsSupported)
+			{
+				cmdBuffer.writeTimestamp (vk::PipelineStageFlagBits::eBottomOfPipe, queryPool, index * 2 + 1);
+			}
+
+			if (readback)
+			{
+				vk::BufferMemoryBarrier copyBarrier = vks::initializers::bufferBarrier(buffers[index].buffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eTransferRead);
+				cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer,
+					vk::DependencyFlags(), nullptr, copyBarrier, nullptr);
+				cmdBuffer.copyBuffer (vk::Buffer(buffers[index].buffer), vk::Buffer(readbackBuffer.buffer), vk::BufferCopy(0, buffers[index].size, buffers[index].size));
+				vk::BufferMemoryBarrier hostBarrier = vks::initializers::bufferBarrier(readbackBuffer.buffer, vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eHostRead);
+				cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost,
+					vk::DependencyFlags(), nullptr, hostBarrier, nullptr);
+			}
+
+			if (asyncCompute)
+			{
+				// Release the source to graphics (drawn by the next frame), the destination stays for the next step
+				// The source's writes (previous step) were made available by the barrier above
+				vk::BufferMemoryBarrier releaseBarrier = ownershipBarrier(src, vk::AccessFlags(), vk::AccessFlags(), compute.queueFamilyIndex, graphicsQueueFamilyIndex);
+				cmdBuffer.pipelineBarrier (releaseSrcStage, vk::PipelineStageFlagBits::eBottomOfPipe,
+					vk::DependencyFlags(), nullptr, releaseBarrier, nullptr);
+				return;
+			}
+
+			// Release the destination to graphics, on a shared queue this is a plain barrier to the graphics reads (see graphicsReadStages)
+			vk::BufferMemoryBarrier releaseBarrier = ownershipBarrier(index, releaseSrcAccess,
+				dedicatedComputeQueue ? vk::AccessFlags() : (vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eShaderRead),
+				compute.queueFamilyIndex, graphicsQueueFamilyIndex);
+			cmdBuffer.pipelineBarrier (releaseSrcStage,
+				dedicatedComputeQueue ? vk::PipelineStageFlags(vk::PipelineStageFlagBits::eBottomOfPipe) : graphicsReadStages(),
+				vk::DependencyFlags(), nullptr, releaseBarrier, nullptr);
+		}
+	};
+}
@@ -0,0 +1,304 @@
+#pragma once
+
+/*
+* Vulkan radix sort class
+*
+* Stable least significant digit radix sort of 32 bit keys with 32 bit values in compute passes.
+* Each pass sorts by 4 bits:
+* - Histogram : per-block digit counts, stored digit major
+* - Scan      : exclusive prefix sum of the histogram (two levels), yielding the output offset of each digit of each block
+* - Scatter   : keys and values are moved to their offsets, ranked per chunk with a shared memory prefix sum (stable)
+* Keys and values ping-pong between two buffer pairs, the number of passes is even so the result ends up in the first pair.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <cassert>
+
+#include "vulkan/vulkan.h"
+#include <vulkan/vulkan.hpp>
+
+#include "vksTools.h"
+#include "VulkanBuffer.hpp"
+#include "VulkanDevice.hpp"
+#include "VulkanInitializers.h"
+
+namespace vks
+{
+	struct RadixSort
+	{
+		/** @brief Must match local_size_x of the radix sort shaders */
+		static const uint32_t workgroupSize = 256;
+		/** @brief Keys per thread of the histogram and scatter passes (specialization constant) */
+		static const uint32_t itemsPerThread = 16;
+		static const uint32_t blockSize = workgroupSize * itemsPerThread;
+		/** @brief Bits sorted per pass (16 digits) */
+		static const uint32_t radixBits = 4;
+		static const uint32_t radixSize = 1 << radixBits;
+		/** @brief Values scanned per workgroup of radix_scan.comp */
+		static const uint32_t scanBlockSize = 1024;
+
+		vks::VulkanDevice *device = nullptr;
+		uint32_t maxCount = 0;
+
+		/**
+		* @brief Keys and values, the input is written to (and the sorted result read from) index 0
+		*
+		* Values also have index buffer usage, so sorted indices can be drawn directly
+		*/
+		std::array<vks::Buffer, 2> keys;
+		std::array<vks::Buffer, 2> values;
+		/** @brief Digit counts of all blocks of a pass, scanned in place */
+		vks::Buffer histogram;
+		/** @brief Totals of the scan blocks, scanned by a single workgroup */
+		vks::Buffer blockSums;
+		/** @brief Total of the block totals (written by the second scan level, unused) */
+		vks::Buffer scanTotal;
+
+		vk::DescriptorSetLayout sortSetLayout;
+		vk::DescriptorSetLayout scanSetLayout;
+		vk::PipelineLayout sortPipelineLayout;
+		vk::PipelineLayout scanPipelineLayout;
+		vk::Pipeline histogramPipeline;
+		vk::Pipeline scatterPipeline;
+		/** @brief Block scan and block sum add (specialization constant) */
+		std::array<vk::Pipeline, 2> scanPipelines;
+		vk::DescriptorPool descriptorPool;
+		/** @brief Set i reads keys[i] and values[i] and writes the other pair */
+		std::array<vk::DescriptorSet, 2> sortSets;
+		/** @brief Set 0 scans the histogram, set 1 the block sums */
+		std::array<vk::DescriptorSet, 2> scanSets;
+
+		/**
+		* Create the buffers and pipelines
+		*
+		* @param device Device to create the resources on
+		* @param pipelineCache Pipeline cache to use
+		* @param maxCount Max. number of keys per sort
+		*/
+		void prepare(vks::VulkanDevice *device, vk::PipelineCache pipelineCache, uint32_t maxCount)
+		{
+			this->device = device;
+			this->maxCount = maxCount;
+			const uint32_t maxBlockCount = blockCount(maxCount);
+			// Two scan levels cover scanBlockSize * scanBlockSize histogram entries (about 268M keys)
+			assert(maxBlockCount * radixSize <= scanBlockSize * scanBlockSize);
+
+			const VkDeviceSize bufferSize = std::max(maxCount, 1u) * sizeof(uint32_t);
+			for (uint32_t i = 0; i < 2; i++)
+			{
+				VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+					vk::MemoryPropertyFlagBits::eDeviceLocal, &keys[i], bufferSize));
+				VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+					vk::MemoryPropertyFlagBits::eDeviceLocal, &values[i], bufferSize));
+			}
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, vk::MemoryPropertyFlagBits::eDeviceLocal,
+				&histogram, maxBlockCount * radixSize * sizeof(uint32_t)));
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, vk::MemoryPropertyFlagBits::eDeviceLocal,
+				&blockSums, scanBlockSize * sizeof(uint32_t)));
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, vk::MemoryPropertyFlagBits::eDeviceLocal,
+				&scanTotal, sizeof(uint32_t)));
+
+			prepareDescriptorSetLayouts();
+			preparePipelines(pipelineCache);
+			prepareDescriptorSets();
+		}
+
+		void destroy()
+		{
+			if (!device)
+			{
+				return;
+			}
+			device->D().destroyPipeline (histogramPipeline);
+			device->D().destroyPipeline (scatterPipeline);
+			device->D().destroyPipeline (scanPipelines[0]);
+			device->D().destroyPipeline (scanPipelines[1]);
+			device->D().destroyPipelineLayout (sortPipelineLayout);
+			device->D().destroyPipelineLayout (scanPipelineLayout);
+			device->D().destroyDescriptorSetLayout (sortSetLayout);
+			device->D().destroyDescriptorSetLayout (scanSetLayout);
+			device->D().destroyDescriptorPool (descriptorPool);
+			for (uint32_t i = 0; i < 2; i++)
+			{
+				keys[i].destroy();
+				values[i].destroy();
+			}
+			histogram.destroy();
+			blockSums.destroy();
+			scanTotal.destroy();
+		}
+
+		/** @brief Number of histogram/scatter workgroups for a key count */
+		static uint32_t blockCount(uint32_t count)
+		{
+			return std::max((count + blockSize - 1) / blockSize, 1u);
+		}
+
+		/**
+		* Record the sort of the first count keys and values of keys[0] and values[0]
+		*
+		* @param count Number of keys to sort (at most maxCount)
+		* @param keyBits Number of low key bits to sort by (multiple of 8, fewer bits need fewer passes)
+		*
+		* @note Writes to keys[0] and values[0] by compute shaders or transfers are made visible by the sort, consumers of the result
+		* need a barrier from the compute shader stage (shader writes)
+		*/
+		void buildCommandBuffer(vk::CommandBuffer cmdBuffer, uint32_t count, uint32_t keyBits = 32)
+		{
+			assert(count <= maxCount);
+			assert((keyBits % (2 * radixBits) == 0) && (keyBits <= 32));
+			const uint32_t blocks = blockCount(count);
+			const uint32_t histogramSize = blocks * radixSize;
+			const uint32_t scanGroups = (histogramSize + scanBlockSize - 1) / scanBlockSize;
+			vk::MemoryBarrier computeBarrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+
+			// Input written by the caller, and a previous sort still reading the scratch buffers
+			vk::MemoryBarrier inputBarrier(vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferWrite,
+				vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+			cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader,
+				vk::DependencyFlags(), inputBarrier, nullptr, nullptr);
+
+			for (uint32_t pass = 0; pass < keyBits / radixBits; pass++)
+			{
+				const std::array<uint32_t, 3> sortConstants = { count, pass * radixBits, blocks };
+				cmdBuffer.bindDescriptorSets (vk::PipelineBindPoint::eCompute, sortPipelineLayout, 0, sortSets[pass % 2], {});
+				cmdBuffer.pushConstants (sortPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(sortConstants), sortConstants.data());
+				cmdBuffer.bindPipeline (vk::PipelineBindPoint::eCompute, histogramPipeline);
+				cmdBuffer.dispatch (blocks, 1, 1);
+				cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+					vk::DependencyFlags(), computeBarrier, nullptr, nullptr);
+
+				// Scan the histogram blocks, then their totals, then add the scanned totals to the blocks
+				cmdBuffer.bindPipeline (vk::PipelineBindPoint::eCompute, scanPipelines[0]);
+				cmdBuffer.bindDescriptorSets (vk::PipelineBindPoint::eCompute, scanPipelineLayout, 0, scanSets[0], {});
+				cmdBuffer.pushConstants (scanPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(uint32_t), &histogramSize);
+				cmdBuffer.dispatch (scanGroups, 1, 1);
+				cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+					vk::DependencyFlags(), computeBarrier, nullptr, nullptr);
+				cmdBuffer.bindDescriptorSets (vk::PipelineBindPoint::eCompute, scanPipelineLayout, 0, scanSets[1], {});
+				cmdBuffer.pushConstants (scanPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(uint32_t), &scanGroups);
+				cmdBuffer.dispatch (1, 1, 1);
+				cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+					vk::DependencyFlags(), computeBarrier, nullptr, nullptr);
+				cmdBuffer.bindPipeline (vk::PipelineBindPoint::eCompute, scanPipelines[1]);
+				cmdBuffer.bindDescriptorSets (vk::PipelineBindPoint::eCompute, scanPipelineLayout, 0, scanSets[0], {});
+				cmdBuffer.pushConstants (scanPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(uint32_t), &histogramSize);
+				cmdBuffer.dispatch (scanGroups, 1, 1);
+				cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+					vk::DependencyFlags(), computeBarrier, nullptr, nullptr);
+
+				// The scan layout disturbed the sort bindings
+				cmdBuffer.bindPipeline (vk::PipelineBindPoint::eCompute, scatterPipeline);
+				cmdBuffer.bindDescriptorSets (vk::PipelineBindPoint::eCompute, sortPipelineLayout, 0, sortSets[pass % 2], {});
+				cmdBuffer.pushConstants (sortPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(sortConstants), sortConstants.data());
+				cmdBuffer.dispatch (blocks, 1, 1);
+				cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+					vk::DependencyFlags(), computeBarrier, nullptr, nullptr);
+			}
+		}
+
+	private:
+		void prepareDescriptorSetLayouts()
+		{
+			// Sort
+			// Binding 0 : Input keys
+			// Binding 1 : Input values
+			// Binding 2 : Output keys
+			// Binding 3 : Output values
+			// Binding 4 : Histogram
+			std::array<vk::DescriptorSetLayoutBinding, 5> sortBindings;
+			for (uint32_t i = 0; i < sortBindings.size(); i++)
+			{
+				sortBindings[i].setBinding (i)
+					.setDescriptorType (vk::DescriptorType::eStorageBuffer)
+					.setDescriptorCount (1)
+					.setStageFlags (vk::ShaderStageFlagBits::eCompute);
+			}
+			vk::DescriptorSetLayoutCreateInfo descriptorLayout;
+			descriptorLayout.setBindingCount (static_cast<uint32_t>(sortBindings.size()))
+				.setPBindings (sortBindings.data());
+			sortSetLayout = CHECK(device->D().createDescriptorSetLayout (descriptorLayout));
+
+			// Scan
+			// Binding 0 : Values to scan
+			// Binding 1 : Block totals
+			descriptorLayout.setBindingCount (2);
+			scanSetLayout = CHECK(device->D().createDescriptorSetLayout (descriptorLayout));
+
+			// Key count, digit shift and block count
+			vk::PushConstantRange pushConstantRange(vk::ShaderStageFlagBits::eCompute, 0, 3 * sizeof(uint32_t));
+			vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo;
+			pipelineLayoutCreateInfo.setSetLayoutCount (1)
+				.setPSetLayouts (&sortSetLayout)
+				.setPushConstantRangeCount (1)
+				.setPPushConstantRanges (&pushConstantRange);
+			sortPipelineLayout = CHECK(device->D().createPipelineLayout (pipelineLayoutCreateInfo));
+
+			// Value count
+			pushConstantRange.setSize (sizeof(uint32_t));
+			pipelineLayoutCreateInfo.setPSetLayouts (&scanSetLayout);
+			scanPipelineLayout = CHECK(device->D().createPipelineLayout (pipelineLayoutCreateInfo));
+		}
+
+		void preparePipelines(vk::PipelineCache pipelineCache)
+		{
+			const uint32_t items = itemsPerThread;
+			vk::SpecializationMapEntry specializationEntry(0, 0, sizeof(uint32_t));
+			vk::SpecializationInfo specializationInfo(1, &specializationEntry, sizeof(uint32_t), &items);
+			histogramPipeline = vks::tools::createComputePipeline(device->D(), pipelineCache, sortPipelineLayout, "shaders/radix_histogram.comp.spv", &specializationInfo);
+			scatterPipeline = vks::tools::createComputePipeline(device->D(), pipelineCache, sortPipelineLayout, "shaders/radix_scatter.comp.spv", &specializationInfo);
+			for (uint32_t mode = 0; mode < 2; mode++)
+			{
+				specializationInfo.setPData (&mode);
+				scanPipelines[mode] = vks::tools::createComputePipeline(device->D(), pipelineCache, scanPipelineLayout, "shaders/radix_scan.comp.spv", &specializationInfo);
+			}
+		}
+
+		void prepareDescriptorSets()
+		{
+			vk::DescriptorPoolSize poolSize(vk::DescriptorType::eStorageBuffer, 2 * 5 + 2 * 2);
+			vk::DescriptorPoolCreateInfo descriptorPoolInfo;
+			descriptorPoolInfo.setPoolSizeCount (1)
+				.setPPoolSizes (&poolSize)
+				.setMaxSets (4);
+			descriptorPool = CHECK(device->D().createDescriptorPool (descriptorPoolInfo));
+
+			std::array<vk::DescriptorSetLayout, 4> layouts = { sortSetLayout, sortSetLayout, scanSetLayout, scanSetLayout };
+			vk::DescriptorSetAllocateInfo allocInfo;
+			allocInfo.setDescriptorPool (descriptorPool)
+				.setDescriptorSetCount (static_cast<uint32_t>(layouts.size()))
+				.setPSetLayouts (layouts.data());
+			std::vector<vk::DescriptorSet> sets = CHECK(device->D().allocateDescriptorSets (allocInfo));
+			std::copy(sets.begin(), sets.begin() + 2, sortSets.begin());
+			std::copy(sets.begin() + 2, sets.end(), scanSets.begin());
+
+			std::vector<vk::DescriptorBufferInfo> bufferInfos;
+			bufferInfos.reserve(2 * 5 + 2 * 2);
+			std::vector<vk::WriteDescriptorSet> writeDescriptorSets;
+			auto addBuffer = [&](vk::DescriptorSet set, uint32_t binding, const vks::Buffer &buffer)
+			{
+				bufferInfos.push_back(vk::DescriptorBufferInfo(buffer.buffer, 0, VK_WHOLE_SIZE));
+				writeDescriptorSets.push_back(vk::WriteDescriptorSet(set, binding, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &bufferInfos.back()));
+			};
+			for (uint32_t i = 0; i < 2; i++)
+			{
+				addBuffer(sortSets[i], 0, keys[i]);
+				addBuffer(sortSets[i], 1, values[i]);
+				addBuffer(sortSets[i], 2, keys[1 - i]);
+				addBuffer(sortSets[i], 3, values[1 - i]);
+				addBuffer(sortSets[i], 4, histogram);
+			}
+			addBuffer(scanSets[0], 0, histogram);
+			addBuffer(scanSets[0], 1, blockSums);
+			addBuffer(scanSets[1], 0, blockSums);
+			addBuffer(scanSets[1], 1, scanTotal);
+			device->D().updateDescriptorSets (writeDescriptorSets, {});
+		}
+	};
+}
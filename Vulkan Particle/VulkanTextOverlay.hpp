@@ -0,0 +1,570 @@
+#pragma once
+
+/*
+* Vulkan text overlay
+*
+* Screen space text and rectangles (e.g. frame statistics and graphs) drawn as a single instanced draw at the end of the
+* application's last render pass. Each glyph is an instance (rectangle, atlas cell, color) expanded to a quad in the
+* vertex shader, the instance data and the indirect draw parameters of every frame in flight live in a persistently
+* mapped buffer. The command buffers therefore don't have to be recorded again when the text changes, a frame's slice is
+* only rewritten when its content is stale.
+*
+* Glyphs come from an 8x16 pixel ASCII font (32..126, rasterized from DejaVu Sans Mono) uploaded once as R8 atlas.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include <vulkan/vulkan.hpp>
+
+#include "vksTools.h"
+#include "VulkanBuffer.hpp"
+#include "VulkanDevice.hpp"
+#include "VulkanInitializers.h"
+
+namespace vks
+{
+	class TextOverlay
+	{
+	public:
+		enum class Align { Left, Right };
+
+		/** @brief Glyph cell size in atlas pixels */
+		static const uint32_t glyphWidth = 8;
+		static const uint32_t glyphHeight = 16;
+		/** @brief Atlas layout, cell (code - 32), the last cell is solid (rectangles) */
+		static const uint32_t atlasColumns = 16;
+		static const uint32_t atlasRows = 6;
+		static const uint32_t solidCell = atlasColumns * atlasRows - 1;
+
+		vks::VulkanDevice *device = nullptr;
+		bool prepared = false;
+		/** @brief Glyph instances per frame, further text is dropped */
+		uint32_t maxGlyphs = 0;
+		/** @brief Screen pixels per atlas pixel */
+		float scale = 1.0f;
+
+		/**
+		* Upload the font atlas and create the instance buffer
+		*
+		* @param device Device to create the resources on
+		* @param queue Queue used for the atlas upload
+		* @param pipelineCache Pipeline cache used for the pipelines (created per render pass on first use)
+		* @param frameCount Number of frames in flight (command buffers), each reads its own slice of the instance buffer
+		* @param maxGlyphs Maximum number of glyphs and rectangles per frame
+		*/
+		void prepare(vks::VulkanDevice *device, vk::Queue queue, vk::PipelineCache pipelineCache, uint32_t frameCount, uint32_t maxGlyphs = 2048)
+		{
+			this->device = device;
+			this->pipelineCache = pipelineCache;
+			this->maxGlyphs = maxGlyphs;
+			frameVersions.assign(frameCount, ~0ull);
+
+			prepareAtlas(queue);
+			prepareDescriptorSet();
+
+			// Per frame : the indirect draw parameters at the start, the glyph instances after all of them
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, &buffer, glyphOffset(frameCount)));
+			VK_CHECK_RESULT(buffer.map());
+			for (uint32_t frame = 0; frame < frameCount; frame++)
+			{
+				VkDrawIndirectCommand draw = { 4, 0, 0, 0 };
+				memcpy(static_cast<char*>(buffer.mapped) + frame * sizeof(VkDrawIndirectCommand), &draw, sizeof(draw));
+			}
+			prepared = true;
+		}
+
+		void destroy()
+		{
+			if (!device)
+			{
+				return;
+			}
+			for (auto& pipeline : pipelines)
+			{
+				device->D().destroyPipeline (pipeline.second);
+			}
+			pipelines.clear();
+			device->D().destroyPipelineLayout (pipelineLayout);
+			device->D().destroyDescriptorSetLayout (descriptorSetLayout);
+			device->D().destroyDescriptorPool (descriptorPool);
+			device->D().destroySampler (sampler);
+			device->D().destroyImageView (atlasView);
+			device->D().destroyImage (atlas);
+			device->D().freeMemory (atlasMemory);
+			buffer.destroy();
+			prepared = false;
+			device = nullptr;
+		}
+
+		/** @brief Start a new content, the previous one is shown until endTextUpdate() */
+		void beginTextUpdate()
+		{
+			glyphs.clear();
+		}
+
+		/**
+		* Add a line of text
+		*
+		* @param text ASCII text, other characters are drawn as '?'
+		* @param x Horizontal position in pixels (left or right end of the text)
+		* @param y Top of the line in pixels
+		* @param color RGBA8 color (red in the lowest byte)
+		* @param background RGBA8 color of a rectangle behind the text (none if fully transparent)
+		*/
+		void addText(const std::string &text, float x, float y, Align align = Align::Left, uint32_t color = 0xffffffff, uint32_t background = 0)
+		{
+			const float advance = glyphWidth * scale;
+			if (align == Align::Right)
+			{
+				x -= advance * text.size();
+			}
+			if ((background >> 24) != 0)
+			{
+				addRect(x - 2.0f * scale, y, advance * text.size() + 4.0f * scale, lineHeight(), background);
+			}
+			for (char c : text)
+			{
+				const uint32_t code = static_cast<unsigned char>(c);
+				if (code != ' ')
+				{
+					const uint32_t cell = ((code > ' ') && (code < 127)) ? code - 32 : '?' - 32;
+					addGlyph(Glyph{ x, y, advance, glyphHeight * scale, cell, color });
+				}
+				x += advance;
+			}
+		}
+
+		/** @brief Add a filled rectangle (e.g. a graph bar or a text background), in pixels */
+		void addRect(float x, float y, float width, float height, uint32_t color)
+		{
+			addGlyph(Glyph{ x, y, width, height, solidCell, color });
+		}
+
+		/** @brief Height of a line of text in pixels */
+		float lineHeight() const
+		{
+			return glyphHeight * scale;
+		}
+
+		/** @brief The content is complete, frames pick it up in update() */
+		void endTextUpdate()
+		{
+			version++;
+		}
+
+		/**
+		* Copy the current content into the frame's slice if it is stale
+		*
+		* @note Call once the frame's previous submission has completed (e.g. after waiting for its fence)
+		*/
+		void update(uint32_t frame)
+		{
+			if ((!prepared) || (frameVersions[frame] == version))
+			{
+				return;
+			}
+			char *mapped = static_cast<char*>(buffer.mapped);
+			memcpy(mapped + glyphOffset(frame), glyphs.data(), glyphs.size() * sizeof(Glyph));
+			// Only the instance count changes, the other draw parameters were written in prepare()
+			const uint32_t instanceCount = static_cast<uint32_t>(glyphs.size());
+			memcpy(mapped + frame * sizeof(VkDrawIndirectCommand) + offsetof(VkDrawIndirectCommand, instanceCount), &instanceCount, sizeof(uint32_t));
+			frameVersions[frame] = version;
+		}
+
+		/**
+		* Record the draw of a frame's slice
+		*
+		* @param renderPass Render pass the command buffer is in, the subpass must have a single color attachment
+		* @param width Width of the render area in pixels
+		* @param height Height of the render area in pixels
+		* @param subpass Current subpass (usually the last one)
+		*/
+		void draw(vk::CommandBuffer cmdBuffer, uint32_t frame, vk::RenderPass renderPass, uint32_t width, uint32_t height, uint32_t subpass = 0)
+		{
+			if (!prepared)
+			{
+				return;
+			}
+			const std::array<float, 2> invFrameSize = { 1.0f / (float)width, 1.0f / (float)height };
+			cmdBuffer.setViewport (0, vk::Viewport(0.0f, 0.0f, (float)width, (float)height, 0.0f, 1.0f));
+			cmdBuffer.setScissor (0, vk::Rect2D(vk::Offset2D(0, 0), vk::Extent2D(width, height)));
+			cmdBuffer.bindPipeline (vk::PipelineBindPoint::eGraphics, pipelineFor(renderPass, subpass));
+			cmdBuffer.bindDescriptorSets (vk::PipelineBindPoint::eGraphics, pipelineLayout, 0, descriptorSet, {});
+			cmdBuffer.pushConstants (pipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(invFrameSize), invFrameSize.data());
+			cmdBuffer.bindVertexBuffers (0, vk::Buffer(buffer.buffer), { glyphOffset(frame) });
+			cmdBuffer.drawIndirect (vk::Buffer(buffer.buffer), frame * sizeof(VkDrawIndirectCommand), 1, sizeof(VkDrawIndirectCommand));
+		}
+
+		/** @brief RGBA8 color from normalized components */
+		static uint32_t color(float r, float g, float b, float a = 1.0f)
+		{
+			auto channel = [](float value) { return static_cast<uint32_t>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f); };
+			return channel(r) | (channel(g) << 8) | (channel(b) << 16) | (channel(a) << 24);
+		}
+
+	private:
+		// Instance layout of text_overlay.vert
+		struct Glyph
+		{
+			float x, y, width, height;
+			uint32_t cell;
+			uint32_t color;
+		};
+
+		vk::PipelineCache pipelineCache;
+		vk::Image atlas;
+		vk::DeviceMemory atlasMemory;
+		vk::ImageView atlasView;
+		vk::Sampler sampler;
+		vk::DescriptorSetLayout descriptorSetLayout;
+		vk::PipelineLayout pipelineLayout;
+		vk::DescriptorPool descriptorPool;
+		vk::DescriptorSet descriptorSet;
+		// Pipelines of the (render pass, subpass) combinations drawn in so far
+		std::vector<std::pair<std::pair<VkRenderPass, uint32_t>, vk::Pipeline>> pipelines;
+		vks::Buffer buffer;
+		std::vector<Glyph> glyphs;
+		uint64_t version = 0;
+		// Content version in each frame's slice
+		std::vector<uint64_t> frameVersions;
+
+		vk::DeviceSize glyphOffset(uint32_t frame) const
+		{
+			return frameVersions.size() * sizeof(VkDrawIndirectCommand) + (vk::DeviceSize)frame * maxGlyphs * sizeof(Glyph);
+		}
+
+		void addGlyph(const Glyph &glyph)
+		{
+			if (glyphs.size() < maxGlyphs)
+			{
+				glyphs.push_back(glyph);
+			}
+		}
+
+		void prepareAtlas(vk::Queue queue)
+		{
+			const uint32_t atlasWidth = atlasColumns * glyphWidth;
+			const uint32_t atlasHeight = atlasRows * glyphHeight;
+			std::vector<uint8_t> texels(atlasWidth * atlasHeight, 0);
+			for (uint32_t cell = 0; cell < atlasColumns * atlasRows; cell++)
+			{
+				const uint32_t originX = (cell % atlasColumns) * glyphWidth;
+				const uint32_t originY = (cell / atlasColumns) * glyphHeight;
+				for (uint32_t y = 0; y < glyphHeight; y++)
+				{
+					for (uint32_t x = 0; x < glyphWidth; x++)
+					{
+						const bool set = (cell == solidCell) || ((glyphRows(cell)[y] >> x) & 1);
+						texels[(originY + y) * atlasWidth + originX + x] = set ? 255 : 0;
+					}
+				}
+			}
+
+			VkImageCreateInfo imageInfo = vks::initializers::imageCreateInfo();
+			imageInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageInfo.format = VK_FORMAT_R8_UNORM;
+			imageInfo.extent = { atlasWidth, atlasHeight, 1 };
+			imageInfo.mipLevels = 1;
+			imageInfo.arrayLayers = 1;
+			imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+			VkImage image;
+			VK_CHECK_RESULT(device->createImage(&imageInfo, &image, "text overlay font"));
+			atlas = vk::Image(image);
+			vk::MemoryRequirements memReqs = device->D().getImageMemoryRequirements (atlas);
+			vk::MemoryAllocateInfo memAlloc;
+			memAlloc.setAllocationSize (memReqs.size)
+				.setMemoryTypeIndex (device->getMemoryType(memReqs.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal));
+			atlasMemory = CHECK(device->D().allocateMemory (memAlloc));
+			VK_CHECK_RESULT(device->D().bindImageMemory (atlas, atlasMemory, 0));
+
+			vks::Buffer staging;
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+				&staging, texels.size(), texels.data()));
+
+			const vk::ImageSubresourceRange range(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+			vk::CommandBuffer copyCmd = device->createCommandBuffer(vk::CommandBufferLevel::ePrimary, true);
+			vk::ImageMemoryBarrier barrier;
+			barrier.setSrcQueueFamilyIndex (VK_QUEUE_FAMILY_IGNORED)
+				.setDstQueueFamilyIndex (VK_QUEUE_FAMILY_IGNORED)
+				.setImage (atlas)
+				.setSubresourceRange (range)
+				.setOldLayout (vk::ImageLayout::eUndefined)
+				.setNewLayout (vk::ImageLayout::eTransferDstOptimal)
+				.setDstAccessMask (vk::AccessFlagBits::eTransferWrite);
+			copyCmd.pipelineBarrier (vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags(), {}, {}, barrier);
+			vk::BufferImageCopy region;
+			region.setImageSubresource (vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1))
+				.setImageExtent (vk::Extent3D(atlasWidth, atlasHeight, 1));
+			copyCmd.copyBufferToImage (vk::Buffer(staging.buffer), atlas, vk::ImageLayout::eTransferDstOptimal, region);
+			barrier.setOldLayout (vk::ImageLayout::eTransferDstOptimal)
+				.setNewLayout (vk::ImageLayout::eShaderReadOnlyOptimal)
+				.setSrcAccessMask (vk::AccessFlagBits::eTransferWrite)
+				.setDstAccessMask (vk::AccessFlagBits::eShaderRead);
+			copyCmd.pipelineBarrier (vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, vk::DependencyFlags(), {}, {}, barrier);
+			device->flushCommandBuffer(copyCmd, queue);
+			staging.destroy();
+
+			vk::ImageViewCreateInfo viewInfo;
+			viewInfo.setImage (atlas)
+				.setViewType (vk::ImageViewType::e2D)
+				.setFormat (vk::Format::eR8Unorm)
+				.setSubresourceRange (range);
+			atlasView = CHECK(device->D().createImageView (viewInfo));
+
+			// Drawn at integer scales, nearest keeps the glyphs sharp
+			vk::SamplerCreateInfo samplerInfo;
+			samplerInfo.setMagFilter (vk::Filter::eNearest)
+				.setMinFilter (vk::Filter::eNearest)
+				.setMipmapMode (vk::SamplerMipmapMode::eNearest)
+				.setAddressModeU (vk::SamplerAddressMode::eClampToEdge)
+				.setAddressModeV (vk::SamplerAddressMode::eClampToEdge)
+				.setAddressModeW (vk::SamplerAddressMode::eClampToEdge)
+				.setMaxAnisotropy (1.0f);
+			sampler = CHECK(device->D().createSampler (samplerInfo));
+		}
+
+		void prepareDescriptorSet()
+		{
+			vk::DescriptorSetLayoutBinding binding;
+			binding.setBinding (0)
+				.setDescriptorType (vk::DescriptorType::eCombinedImageSampler)
+				.setDescriptorCount (1)
+				.setStageFlags (vk::ShaderStageFlagBits::eFragment);
+			vk::DescriptorSetLayoutCreateInfo descriptorLayout;
+			descriptorLayout.setBindingCount (1)
+				.setPBindings (&binding);
+			descriptorSetLayout = CHECK(device->D().createDescriptorSetLayout (descriptorLayout));
+
+			// Reciprocal of the render area size
+			vk::PushConstantRange pushConstantRange(vk::ShaderStageFlagBits::eVertex, 0, 2 * sizeof(float));
+			vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo;
+			pipelineLayoutCreateInfo.setSetLayoutCount (1)
+				.setPSetLayouts (&descriptorSetLayout)
+				.setPushConstantRangeCount (1)
+				.setPPushConstantRanges (&pushConstantRange);
+			pipelineLayout = CHECK(device->D().createPipelineLayout (pipelineLayoutCreateInfo));
+
+			vk::DescriptorPoolSize poolSize(vk::DescriptorType::eCombinedImageSampler, 1);
+			vk::DescriptorPoolCreateInfo descriptorPoolInfo;
+			descriptorPoolInfo.setPoolSizeCount (1)
+				.setPPoolSizes (&poolSize)
+				.setMaxSets (1);
+			descriptorPool = CHECK(device->D().createDescriptorPool (descriptorPoolInfo));
+
+			vk::DescriptorSetAllocateInfo allocInfo;
+			allocInfo.setDescriptorPool (descriptorPool)
+				.setDescriptorSetCount (1)
+				.setPSetLayouts (&descriptorSetLayout);
+			descriptorSet = CHECK(device->D().allocateDescriptorSets (allocInfo)).front();
+
+			vk::DescriptorImageInfo imageInfo(sampler, atlasView, vk::ImageLayout::eShaderReadOnlyOptimal);
+			vk::WriteDescriptorSet writeDescriptorSet;
+			writeDescriptorSet.setDstSet (descriptorSet)
+				.setDstBinding (0)
+				.setDescriptorCount (1)
+				.setDescriptorType (vk::DescriptorType::eCombinedImageSampler)
+				.setPImageInfo (&imageInfo);
+			device->D().updateDescriptorSets (writeDescriptorSet, {});
+		}
+
+		// Pipelines only depend on the render pass through its compatibility, one is created per pass and subpass drawn in
+		vk::Pipeline pipelineFor(vk::RenderPass renderPass, uint32_t subpass)
+		{
+			const std::pair<VkRenderPass, uint32_t> key(static_cast<VkRenderPass>(renderPass), subpass);
+			for (auto& pipeline : pipelines)
+			{
+				if (pipeline.first == key)
+				{
+					return pipeline.second;
+				}
+			}
+
+			vk::VertexInputBindingDescription binding(0, sizeof(Glyph), vk::VertexInputRate::eInstance);
+			std::array<vk::VertexInputAttributeDescription, 3> attributes = {
+				vk::VertexInputAttributeDescription(0, 0, vk::Format::eR32G32B32A32Sfloat, offsetof(Glyph, x)),
+				vk::VertexInputAttributeDescription(1, 0, vk::Format::eR32Uint, offsetof(Glyph, cell)),
+				vk::VertexInputAttributeDescription(2, 0, vk::Format::eR8G8B8A8Unorm, offsetof(Glyph, color))
+			};
+			vk::PipelineVertexInputStateCreateInfo vertexInputState;
+			vertexInputState.setVertexBindingDescriptionCount (1)
+				.setPVertexBindingDescriptions (&binding)
+				.setVertexAttributeDescriptionCount (static_cast<uint32_t>(attributes.size()))
+				.setPVertexAttributeDescriptions (attributes.data());
+			vk::PipelineInputAssemblyStateCreateInfo inputAssemblyState;
+			inputAssemblyState.setTopology (vk::PrimitiveTopology::eTriangleStrip);
+			vk::PipelineRasterizationStateCreateInfo rasterizationState;
+			rasterizationState.setPolygonMode (vk::PolygonMode::eFill)
+				.setCullMode (vk::CullModeFlagBits::eNone)
+				.setFrontFace (vk::FrontFace::eCounterClockwise)
+				.setLineWidth (1.0f);
+			vk::PipelineColorBlendAttachmentState blendAttachmentState;
+			blendAttachmentState.setBlendEnable (true)
+				.setSrcColorBlendFactor (vk::BlendFactor::eSrcAlpha)
+				.setDstColorBlendFactor (vk::BlendFactor::eOneMinusSrcAlpha)
+				.setColorBlendOp (vk::BlendOp::eAdd)
+				.setSrcAlphaBlendFactor (vk::BlendFactor::eZero)
+				.setDstAlphaBlendFactor (vk::BlendFactor::eOne)
+				.setAlphaBlendOp (vk::BlendOp::eAdd)
+				.setColorWriteMask (vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA);
+			vk::PipelineColorBlendStateCreateInfo colorBlendState;
+			colorBlendState.setAttachmentCount (1)
+				.setPAttachments (&blendAttachmentState);
+			vk::PipelineViewportStateCreateInfo viewportState;
+			viewportState.setViewportCount (1)
+				.setScissorCount (1);
+			std::array<vk::DynamicState, 2> dynamicStates = { vk::DynamicState::eViewport, vk::DynamicState::eScissor };
+			vk::PipelineDynamicStateCreateInfo dynamicState;
+			dynamicState.setDynamicStateCount (static_cast<uint32_t>(dynamicStates.size()))
+				.setPDynamicStates (dynamicStates.data());
+			// Drawn over everything, depth is neither tested nor written
+			vk::PipelineDepthStencilStateCreateInfo depthStencilState;
+			vk::PipelineMultisampleStateCreateInfo multisampleState;
+			multisampleState.setRasterizationSamples (vk::SampleCountFlagBits::e1);
+
+			std::array<vk::PipelineShaderStageCreateInfo, 2> shaderStages;
+			shaderStages[0].setStage (vk::ShaderStageFlagBits::eVertex)
+				.setModule (vks::tools::loadSPIRVShader("shaders/text_overlay.vert.spv", device->D()))
+				.setPName ("main");
+			shaderStages[1].setStage (vk::ShaderStageFlagBits::eFragment)
+				.setModule (vks::tools::loadSPIRVShader("shaders/text_overlay.frag.spv", device->D()))
+				.setPName ("main");
+
+			vk::GraphicsPipelineCreateInfo pipelineCreateInfo;
+			pipelineCreateInfo.setLayout (pipelineLayout)
+				.setRenderPass (renderPass)
+				.setSubpass (subpass)
+				.setStageCount (static_cast<uint32_t>(shaderStages.size()))
+				.setPStages (shaderStages.data())
+				.setPVertexInputState (&vertexInputState)
+				.setPInputAssemblyState (&inputAssemblyState)
+				.setPRasterizationState (&rasterizationState)
+				.setPColorBlendState (&colorBlendState)
+				.setPMultisampleState (&multisampleState)
+				.setPViewportState (&viewportState)
+				.setPDepthStencilState (&depthStencilState)
+				.setPDynamicState (&dynamicState);
+			vk::Pipeline pipeline = device->createGraphicsPipeline(pipelineCache, pipelineCreateInfo, "text overlay");
+			device->D().destroyShaderModule (shaderStages[0].module);
+			device->D().destroyShaderModule (shaderStages[1].module);
+			pipelines.push_back({ key, pipeline });
+			return pipeline;
+		}
+
+		// 8x16 glyphs 32..126 (DejaVu Sans Mono 13 px, thresholded to one bit per pixel), a byte per row, bit x = pixel x
+		static const uint8_t* glyphRows(uint32_t cell)
+		{
+			static const uint8_t font[atlasColumns * atlasRows - 1][glyphHeight] = {
+				{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },	// ' '
+				{ 0x00, 0x00, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00 },	// '!'
+				{ 0x00, 0x00, 0x24, 0x24, 0x24, 0x24, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },	// '"'
+				{ 0x00, 0x48, 0x68, 0x28, 0xfe, 0x24, 0x24, 0x7f, 0x16, 0x12, 0x12, 0x00, 0x00, 0x00, 0x00, 0x00 },	// '#'
+				{ 0x00, 0x00, 0x00, 0x3c, 0x16, 0x02, 0x1c, 0x38, 0x40, 0x62, 0x3c, 0x00, 0x00, 0x00, 0x00, 0x00 },	// '$'
+				{ 0x00, 0x00, 0x0e, 0x09, 0x09, 0x6e, 0x18, 0x76, 0xd0, 0xd0, 0x70, 0x00, 0x00, 0x00, 0x00, 0x00 },	// '%'
+				{ 0x00, 0x00, 0x3c, 0x06, 0x04, 0x0c, 0x9a, 0xd3, 0x63, 0x62, 0x5c, 0x00, 0x00, 0x00, 0x00, 0x00 },	// '&'
+				{ 0x00, 0x00, 0x18, 0x18, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },	// '''
+				{ 0x10, 0x10, 0x18, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x18, 0x10, 0x10, 0x00, 0x00, 0x00, 0x00 },	// '('
+				{ 0x0c, 0x08, 0x18, 0x18, 0x10, 0x10, 0x10, 0x10, 0x10, 0x18, 0x08, 0x0c, 0x00, 0x00, 0x00, 0x00 },	// ')'
+				{ 0x00, 0x00, 0x08, 0x4a, 0x1c, 0x1c, 0x4a, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },	// '*'
+				{ 0x00, 0x00, 0x00, 0x18, 0x18, 0x18, 0x7f, 0x18, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },	// '+'
+				{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x08, 0x08, 0x00, 0x00, 0x00 },	// ','
+				{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3c, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },	// '-'
+				{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00 },	// '.'
+				{ 0x00, 0x00, 0x60, 0x20, 0x30, 0x10, 0x10, 0x08, 0x08, 0x0c, 0x04, 0x06, 0x02, 0x00, 0x00, 0x00 },	// '/'
+				{ 0x00, 0x00, 0x3c, 0x26, 0x62, 0x42, 0x5a, 0x42, 0x62, 0x26, 0x3c, 0x00, 0x00, 0x00, 0x00, 0x00 },	// '0'
+				{ 0x00, 0x00, 0x1e, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x7c, 0x00, 0x00, 0x00, 0x00, 0x00 },	// '1'
+				{ 0x00, 0x00, 0x3c, 0x22, 0x60, 0x20, 0x30, 0x18, 0x0c, 0x06, 0x7e, 0x00, 0x00, 0x00, 0x00, 0x00 },	// '2'
+				{ 0x00, 0x00, 0x3c, 0x22, 0x60, 0x20, 0x3c, 0x60, 0x60, 0x62, 0x3c, 0x00, 0x00, 0x00, 0x00, 0x00 },	// '3'
+				{ 0x00, 0x00, 0x30, 0x38, 0x28, 0x24, 0x26, 0x22, 0x7e, 0x20, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00 },	// '4'
+				{ 0x00, 0x00, 0x3e, 0x06, 0x06, 0x3e, 0x20, 0x60, 0x60, 0x22, 0x1c, 0x00, 0x00, 0x00, 0x00, 0x00 },	// '5'
+				{ 0x00, 0x00, 0x3c, 0x06, 0x02, 0x3e, 0x66, 0x42, 0x42, 0x66, 0x3c, 0x00, 0x00, 0x00, 0x00, 0x00 },	// '6'
+				{ 0x00, 0x00, 0x7e, 0x60, 0x20, 0x30, 0x10, 0x18, 0x18, 0x08, 0x0c, 0x00, 0x00, 0x00, 0x00, 0x00 },	// '7'
+				{ 0x00, 0x00, 0x3c, 0x66, 0x62, 0x26, 0x3c, 0x66, 0x42, 0x66, 0x3c, 0x00, 0x00, 0x00, 0x00, 0x00 },	// '8'
+				{ 0x00, 0x00, 0x3c, 0x26, 0x62, 0x62, 0x66, 0x7c, 0x60, 0x20, 0x1c, 0x00, 0x00, 0x00, 0x00, 0x00 },	// '9'
+				{ 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00 },	// ':'
+				{ 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00, 0x18, 0x18, 0x08, 0x08, 0x00, 0x00, 0x00 },	// ';'
+				{ 0x00, 0x00, 0x00, 0x00, 0x40, 0x38, 0x06, 0x06, 0x38, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },	// '<'
+				{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x7f, 0x00, 0x00, 0x7f, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },	// '='
+				{ 0x00, 0x00, 0x00, 0x00, 0x02, 0x1c, 0x70, 0x70, 0x1c, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },	// '>'
+				{ 0x00, 0x00, 0x3c, 0x60, 0x60, 0x30, 0x18, 0x08, 0x00, 0x08, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00 },	// '?'
+				{ 0x00, 0x00, 0x3c, 0x46, 0x42, 0xf3, 0xc9, 0xc9, 0xc9, 0xf3, 0x02, 0x06, 0x38, 0x00, 0x00, 0x00 },	// '@'
+				{ 0x00, 0x00, 0x18, 0x18, 0x3c, 0x34, 0x24, 0x66, 0x7e, 0x42, 0xc3, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'A'
+				{ 0x00, 0x00, 0x3e, 0x62, 0x62, 0x62, 0x3e, 0x62, 0x42, 0x62, 0x3e, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'B'
+				{ 0x00, 0x00, 0x38, 0x44, 0x06, 0x02, 0x02, 0x02, 0x06, 0x44, 0x38, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'C'
+				{ 0x00, 0x00, 0x1e, 0x22, 0x62, 0x42, 0x42, 0x42, 0x62, 0x22, 0x1e, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'D'
+				{ 0x00, 0x00, 0x7e, 0x06, 0x06, 0x06, 0x7e, 0x06, 0x06, 0x06, 0x7e, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'E'
+				{ 0x00, 0x00, 0x7e, 0x06, 0x06, 0x06, 0x7e, 0x06, 0x06, 0x06, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'F'
+				{ 0x00, 0x00, 0x3c, 0x46, 0x02, 0x02, 0x72, 0x42, 0x42, 0x46, 0x3c, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'G'
+				{ 0x00, 0x00, 0x42, 0x42, 0x42, 0x42, 0x7e, 0x42, 0x42, 0x42, 0x42, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'H'
+				{ 0x00, 0x00, 0x7e, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x7e, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'I'
+				{ 0x00, 0x00, 0x3c, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x32, 0x1e, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'J'
+				{ 0x00, 0x00, 0x42, 0x22, 0x12, 0x0e, 0x1e, 0x12, 0x32, 0x62, 0x42, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'K'
+				{ 0x00, 0x00, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x7e, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'L'
+				{ 0x00, 0x00, 0x67, 0x67, 0x67, 0x5f, 0x5b, 0x5b, 0x43, 0x43, 0x43, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'M'
+				{ 0x00, 0x00, 0x46, 0x46, 0x4e, 0x4a, 0x5a, 0x52, 0x72, 0x62, 0x62, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'N'
+				{ 0x00, 0x00, 0x3c, 0x66, 0x62, 0x42, 0x42, 0x42, 0x62, 0x66, 0x3c, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'O'
+				{ 0x00, 0x00, 0x3e, 0x66, 0x46, 0x46, 0x66, 0x3e, 0x06, 0x06, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'P'
+				{ 0x00, 0x00, 0x3c, 0x66, 0x62, 0x42, 0x42, 0x42, 0x62, 0x66, 0x3c, 0x30, 0x20, 0x00, 0x00, 0x00 },	// 'Q'
+				{ 0x00, 0x00, 0x3e, 0x62, 0x62, 0x62, 0x3e, 0x32, 0x62, 0x42, 0xc2, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'R'
+				{ 0x00, 0x00, 0x3c, 0x06, 0x02, 0x06, 0x3c, 0x60, 0x40, 0x62, 0x3c, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'S'
+				{ 0x00, 0x00, 0xff, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'T'
+				{ 0x00, 0x00, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x66, 0x3c, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'U'
+				{ 0x00, 0x00, 0x43, 0x42, 0x62, 0x26, 0x24, 0x24, 0x3c, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'V'
+				{ 0x00, 0x00, 0xc1, 0xc3, 0xc3, 0x5b, 0x5a, 0x5a, 0x76, 0x66, 0x66, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'W'
+				{ 0x00, 0x00, 0x42, 0x66, 0x3c, 0x18, 0x18, 0x3c, 0x24, 0x66, 0x43, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'X'
+				{ 0x00, 0x00, 0x43, 0x66, 0x24, 0x3c, 0x18, 0x18, 0x18, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'Y'
+				{ 0x00, 0x00, 0x7e, 0x60, 0x20, 0x30, 0x18, 0x08, 0x04, 0x06, 0x7e, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'Z'
+				{ 0x38, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x38, 0x00, 0x00, 0x00, 0x00 },	// '['
+				{ 0x00, 0x00, 0x02, 0x06, 0x04, 0x0c, 0x08, 0x08, 0x10, 0x10, 0x30, 0x20, 0x60, 0x00, 0x00, 0x00 },	// backslash
+				{ 0x1c, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1c, 0x00, 0x00, 0x00, 0x00 },	// ']'
+				{ 0x00, 0x00, 0x18, 0x3c, 0x26, 0x42, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },	// '^'
+				{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x00, 0x00 },	// '_'
+				{ 0x00, 0x0c, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },	// '`'
+				{ 0x00, 0x00, 0x00, 0x00, 0x3c, 0x22, 0x60, 0x7c, 0x62, 0x62, 0x7c, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'a'
+				{ 0x02, 0x02, 0x02, 0x02, 0x3e, 0x66, 0x46, 0x42, 0x46, 0x66, 0x3e, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'b'
+				{ 0x00, 0x00, 0x00, 0x00, 0x38, 0x44, 0x06, 0x06, 0x06, 0x44, 0x38, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'c'
+				{ 0x60, 0x60, 0x60, 0x60, 0x7c, 0x66, 0x62, 0x62, 0x62, 0x66, 0x7c, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'd'
+				{ 0x00, 0x00, 0x00, 0x00, 0x3c, 0x66, 0x42, 0x7e, 0x02, 0x46, 0x3c, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'e'
+				{ 0x70, 0x18, 0x08, 0x08, 0x7e, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'f'
+				{ 0x00, 0x00, 0x00, 0x00, 0x7c, 0x66, 0x62, 0x62, 0x62, 0x66, 0x7c, 0x60, 0x20, 0x1c, 0x00, 0x00 },	// 'g'
+				{ 0x02, 0x02, 0x02, 0x02, 0x3e, 0x66, 0x66, 0x62, 0x62, 0x62, 0x62, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'h'
+				{ 0x18, 0x00, 0x00, 0x00, 0x1c, 0x18, 0x18, 0x18, 0x18, 0x18, 0x7e, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'i'
+				{ 0x10, 0x00, 0x00, 0x00, 0x1c, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x18, 0x0e, 0x00, 0x00 },	// 'j'
+				{ 0x06, 0x06, 0x06, 0x06, 0x66, 0x36, 0x1e, 0x1e, 0x36, 0x66, 0x46, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'k'
+				{ 0x0e, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x70, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'l'
+				{ 0x00, 0x00, 0x00, 0x00, 0x7e, 0x5a, 0x5a, 0x5a, 0x5a, 0x5a, 0x5a, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'm'
+				{ 0x00, 0x00, 0x00, 0x00, 0x3e, 0x66, 0x66, 0x62, 0x62, 0x62, 0x62, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'n'
+				{ 0x00, 0x00, 0x00, 0x00, 0x3c, 0x66, 0x42, 0x42, 0x42, 0x66, 0x3c, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'o'
+				{ 0x00, 0x00, 0x00, 0x00, 0x3e, 0x66, 0x46, 0x42, 0x46, 0x66, 0x3e, 0x02, 0x02, 0x02, 0x00, 0x00 },	// 'p'
+				{ 0x00, 0x00, 0x00, 0x00, 0x7c, 0x66, 0x62, 0x62, 0x62, 0x66, 0x7c, 0x60, 0x60, 0x60, 0x00, 0x00 },	// 'q'
+				{ 0x00, 0x00, 0x00, 0x00, 0x7c, 0x0c, 0x0c, 0x0c, 0x0c, 0x0c, 0x0c, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'r'
+				{ 0x00, 0x00, 0x00, 0x00, 0x3c, 0x26, 0x06, 0x3c, 0x20, 0x22, 0x3c, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 's'
+				{ 0x00, 0x00, 0x08, 0x08, 0x7e, 0x08, 0x08, 0x08, 0x08, 0x08, 0x78, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 't'
+				{ 0x00, 0x00, 0x00, 0x00, 0x62, 0x62, 0x62, 0x62, 0x66, 0x66, 0x7c, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'u'
+				{ 0x00, 0x00, 0x00, 0x00, 0x42, 0x62, 0x26, 0x24, 0x34, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'v'
+				{ 0x00, 0x00, 0x00, 0x00, 0xc1, 0xc3, 0x5a, 0x5a, 0x7e, 0x66, 0x26, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'w'
+				{ 0x00, 0x00, 0x00, 0x00, 0x62, 0x24, 0x18, 0x18, 0x3c, 0x24, 0x42, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'x'
+				{ 0x00, 0x00, 0x00, 0x00, 0x42, 0x66, 0x24, 0x24, 0x3c, 0x18, 0x18, 0x18, 0x08, 0x06, 0x00, 0x00 },	// 'y'
+				{ 0x00, 0x00, 0x00, 0x00, 0x7e, 0x20, 0x10, 0x18, 0x0c, 0x04, 0x7e, 0x00, 0x00, 0x00, 0x00, 0x00 },	// 'z'
+				{ 0x30, 0x18, 0x18, 0x18, 0x08, 0x0e, 0x08, 0x18, 0x18, 0x18, 0x18, 0x30, 0x00, 0x00, 0x00, 0x00 },	// '{'
+				{ 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x00, 0x00, 0x00 },	// '|'
+				{ 0x0e, 0x08, 0x18, 0x18, 0x18, 0x30, 0x18, 0x18, 0x18, 0x08, 0x08, 0x0e, 0x00, 0x00, 0x00, 0x00 },	// '}'
+				{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0e, 0x70, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },	// '~'
+			};
+			return font[cell];
+		}
+	};
+}
@@ -8,8 +8,21 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/constants.hpp>
 
 #include "VulkanBase.h"
+#include "VulkanInstanceBuffer.hpp"
+#include "VulkanIndirectDraw.hpp"
+#include "VulkanFrustumCulling.hpp"
+#include "VulkanHiZCulling.hpp"
+#include "SceneTransforms.hpp"
+#include "VulkanParticleSystem.hpp"
+#include "ParticleSimulator.hpp"
+#include "VulkanParticleEmitters.hpp"
+#include "VulkanParticleFluid.hpp"
+#include "VulkanParticleNBody.hpp"
+#include "VulkanParticleQuads.hpp"
+#include "VulkanParticleOffscreen.hpp"
 
 class VulkanExample : public VulkanExampleBase 
 {
@@ -42,6 +55,13 @@ public:
 		vk::DescriptorBufferInfo descriptor;
 	}  uniformBufferVS;
 
+	// Low latency mode: one slice of matrices per frame slot, written right before the frame's submission and copied into
+	// the uniform buffer at the start of its batch, so frames still queued on the device keep the matrices they were recorded for
+	struct {
+		vks::Buffer buffer;
+		std::vector<vk::CommandBuffer> copyCmdBuffers;
+	} uniformSlices;
+
 	// For simplicity we use the same uniform block layout as in the shader:
 	//
 	//	layout(set = 0, binding = 0) uniform UBO
@@ -84,12 +104,324 @@ public:
 	// Used to check the completion of queue operations (e.g. command buffer execution)
 	std::vector<VkFence> waitFences;
 
+	// Ways of drawing the scene
+	enum class DrawMode
+	{
+		Single,			// One draw of the mesh (no instance data)
+		PerObject,		// One draw per object, each one selecting its instance data via firstInstance
+		Instanced,		// All objects in a single instanced draw
+		Indirect,		// One draw record per object in an indirect buffer, submitted with a single indirect draw
+		HostTransforms,	// Objects transformed and frustum culled on the host, one instanced draw of the visible ones with precomputed MVPs
+		Particles,		// Particles simulated on the compute queue, drawn as points
+		HostParticles,	// Particles simulated on the host (SoA, AVX2/NEON), streamed into a mapped vertex buffer
+		EmittedParticles,	// Particles spawned and killed on the device (dead/alive lists), indirect update and draw
+		Fluid,				// SPH fluid simulated in substeps on the graphics queue, drawn as points
+		NBody				// Gravitating bodies (direct tiled or hierarchical) simulated on the graphics queue, drawn as points
+	};
+
+	// Example options (set via command line arguments)
+	struct {
+		DrawMode drawMode = DrawMode::Single;
+		uint32_t instanceCount = 100000;
+		// Half size of the cube the objects are distributed in
+		float sceneExtent = 1.0f;
+		// Cull the indirect scene against the view frustum in a compute pass
+		bool gpuCulling = false;
+		// Cull the indirect scene against the view frustum and a depth pyramid (two phase occlusion culling)
+		bool occlusionCulling = false;
+		// Compare the device culling results with the host reference after preparing
+		bool validateCulling = false;
+		// Compare per-object and instanced draws instead of running the render loop
+		bool benchmarkInstancing = false;
+		uint32_t benchmarkFrames = 500;
+		// Compare the scalar, SSE and AVX2 host transform kernels instead of running the render loop
+		bool benchmarkTransforms = false;
+		uint32_t particleCount = 1024 * 1024;
+		// Compare the compute particle simulation with the host simulator on the first frame (F4 at any time)
+		bool validateParticles = false;
+		// Compare the host particle simulator kernels instead of running the render loop
+		bool benchmarkParticles = false;
+		// Draw the compute particles back to front with alpha blending (depth sorted on the device)
+		bool sortParticles = false;
+		// Primitives of the compute particles (unsorted): points, instanced quads or quads pulled from the storage buffer
+		vks::ParticleRenderMode particleRender = vks::ParticleRenderMode::Points;
+		// Compare the particle render modes instead of running the render loop
+		bool benchmarkParticleRender = false;
+		// Draw the compute particles as soft quads into a target of 1 / lowResRatio the frame size and upsample them over the scene, 0 = off
+		uint32_t lowResRatio = 0;
+		// Compare the particle pass cost and image error of full and reduced resolution instead of running the render loop
+		bool benchmarkLowRes = false;
+		// Compare the device radix sort with std::sort instead of running the render loop
+		bool benchmarkSort = false;
+		uint32_t sortCount = 10 * 1000 * 1000;
+		// Collide the compute particles with each other (uniform grid neighbor search)
+		bool collisions = false;
+		// Integrate the next frame's particles on the compute queue while the graphics queue draws the current ones (triple buffered)
+		bool asyncCompute = false;
+		uint32_t fluidCount = 128 * 1024;
+		// Substeps per frame of the fluid, 0 = as many as the CFL condition needs
+		uint32_t fluidSubsteps = 0;
+		// Compare the fluid simulation throughput of different workgroup sizes instead of running the render loop
+		bool benchmarkFluid = false;
+		uint32_t nbodyCount = 32 * 1024;
+		// Octree monopole approximation of the N-body forces instead of all pairs
+		bool nbodyHierarchical = false;
+		// Compare the direct and hierarchical N-body steps with the tiled host reference instead of running the render loop
+		bool benchmarkNBody = false;
+	} options;
+
+	// Per-instance transforms and colors (vertex binding 1)
+	vks::InstanceBuffer instanceBuffer;
+
+	// Same states as the default pipeline, but with an additional per-instance vertex binding
+	vk::Pipeline instancingPipeline;
+
+	// Meshes of the indirect scene in shared vertex and index buffers
+	vks::MeshArena meshArena;
+	// Per-frame draw records of the indirect scene (one per object, firstInstance selects the object's instance data)
+	vks::IndirectDrawBuffer indirectDraws;
+	// Mesh drawn by each object of the indirect scene
+	std::vector<uint32_t> objectMeshes;
+	// Incremented whenever objectMeshes changes, regions of the indirect buffer are rewritten only if their version is stale
+	uint64_t drawListVersion = 0;
+	std::vector<uint64_t> drawListRegionVersions;
+	// Set by F5, the next frame moves every object of the host written draw list to the next mesh
+	bool meshReassignRequested = false;
+	// Host work of a frame, run on the job system once the frame's fence has signaled
+	vks::JobSystem::TaskGraph frameGraph;
+	// Writes the draw records of visible objects (replaces the host written draw list if enabled)
+	vks::FrustumCulling frustumCulling;
+	// Frustum and hierarchical-z occlusion culling, draws the scene in an early and a late render pass
+	vks::HiZCulling hiZCulling;
+
+	// SoA transforms of all objects, writes the MVPs of the visible ones to the instance buffer
+	vks::SceneTransforms sceneTransforms;
+	// Instanced draw sourcing the instance count (number of visible objects) from a host written indirect record
+	vks::IndirectDrawBuffer transformDraw;
+	// Instancing pipeline reading precomputed MVPs (no uniform matrices)
+	vk::Pipeline mvpPipeline;
+
+	// Double buffered particle state, integrated on the compute queue
+	vks::ParticleSystem particleSystem;
+	// Draws the particle buffer as point list
+	vk::Pipeline particlePipeline;
+	// Set by F4, the next compute step is read back and compared with the host simulator
+	bool particleValidationRequested = false;
+	// Back-to-front order of the compute particles, the sorted indices are drawn as index buffer
+	vks::RadixSort particleSort;
+	// Same as the particle pipeline, but alpha blended without depth writes
+	vk::Pipeline particleBlendPipeline;
+	// Camera facing quads reading the particle buffers in place (instanced or pulled in the vertex shader)
+	vks::ParticleQuads particleQuads;
+	vk::Pipeline particleQuadPipeline;
+	vk::Pipeline particlePullPipeline;
+	// Scene, low resolution particle and composite passes (replaces the default render pass if enabled)
+	vks::ParticleOffscreen lowResParticles;
+
+	// Host simulated particles, written to this frame's region of a persistently mapped vertex buffer
+	vks::ParticleSimulator particleSimulator;
+	vks::ParticleVertexBuffer particleVertices;
+	// Draws host simulated particles (position + packed color) as point list
+	vk::Pipeline hostParticlePipeline;
+	// Moving average of the host step time (ms)
+	double hostParticleStepMs = 0.0;
+
+	// Particle pool with device side emission and death, emitters orbit the scene center
+	vks::ParticleEmitters particleEmitters;
+	// Draws the live particles (alive list + pool read in the vertex shader) as point list
+	vk::Pipeline emitterPipeline;
+
+	// SPH fluid, drawn with the particle pipeline
+	vks::ParticleFluid particleFluid;
+
+	// Gravitating bodies, a step is recorded into each frame's command buffer
+	vks::ParticleNBody nbody;
+	// Draws the bodies as point list, colored by speed
+	vk::Pipeline nbodyPipeline;
 
 	VulkanExample ()
 		: VulkanExampleBase (false)
 	{
 		zoom = -2.5f;
 		title = "Example particle system";
+
+		for (size_t i = 0; i < args.size(); i++)
+		{
+			if (args[i] == std::string("-instanced"))
+			{
+				options.drawMode = DrawMode::Instanced;
+			}
+			if (args[i] == std::string("-indirect"))
+			{
+				options.drawMode = DrawMode::Indirect;
+			}
+			if (args[i] == std::string("-gpuculling"))
+			{
+				options.drawMode = DrawMode::Indirect;
+				options.gpuCulling = true;
+			}
+			if (args[i] == std::string("-occlusionculling"))
+			{
+				options.drawMode = DrawMode::Indirect;
+				options.occlusionCulling = true;
+			}
+			if (args[i] == std::string("-validateculling"))
+			{
+				options.validateCulling = true;
+			}
+			if ((args[i] == std::string("-sceneextent")) && (i + 1 < args.size()))
+			{
+				options.sceneExtent = std::max((float)atof(args[i + 1]), 0.01f);
+			}
+			if (args[i] == std::string("-hosttransforms"))
+			{
+				options.drawMode = DrawMode::HostTransforms;
+			}
+			if (args[i] == std::string("-benchmarktransforms"))
+			{
+				options.benchmarkTransforms = true;
+			}
+			if (args[i] == std::string("-particles"))
+			{
+				options.drawMode = DrawMode::Particles;
+			}
+			if (args[i] == std::string("-cpuparticles"))
+			{
+				options.drawMode = DrawMode::HostParticles;
+			}
+			if (args[i] == std::string("-sortparticles"))
+			{
+				options.drawMode = DrawMode::Particles;
+				options.sortParticles = true;
+			}
+			if (args[i] == std::string("-particlequads"))
+			{
+				options.drawMode = DrawMode::Particles;
+				options.particleRender = vks::ParticleRenderMode::Instanced;
+			}
+			if (args[i] == std::string("-vertexpulling"))
+			{
+				options.drawMode = DrawMode::Particles;
+				options.particleRender = vks::ParticleRenderMode::VertexPulling;
+			}
+			if (args[i] == std::string("-lowresparticles"))
+			{
+				options.drawMode = DrawMode::Particles;
+				if (options.lowResRatio == 0) { options.lowResRatio = 2; };
+			}
+			if ((args[i] == std::string("-lowresratio")) && (i + 1 < args.size()))
+			{
+				char* endptr;
+				uint32_t ratio = strtol(args[i + 1], &endptr, 10);
+				if (endptr != args[i + 1]) { options.lowResRatio = std::max(ratio, 1u); };
+			}
+			if (args[i] == std::string("-benchmarklowres"))
+			{
+				options.benchmarkLowRes = true;
+			}
+			if (args[i] == std::string("-benchmarkparticlerender"))
+			{
+				options.drawMode = DrawMode::Particles;
+				options.benchmarkParticleRender = true;
+			}
+			if (args[i] == std::string("-asynccompute"))
+			{
+				options.drawMode = DrawMode::Particles;
+				options.asyncCompute = true;
+			}
+			if (args[i] == std::string("-collisions"))
+			{
+				options.drawMode = DrawMode::Particles;
+				options.collisions = true;
+			}
+			if (args[i] == std::string("-fluid"))
+			{
+				options.drawMode = DrawMode::Fluid;
+			}
+			if ((args[i] == std::string("-fluidcount")) && (i + 1 < args.size()))
+			{
+				char* endptr;
+				uint32_t count = strtol(args[i + 1], &endptr, 10);
+				if (endptr != args[i + 1]) { options.fluidCount = std::max(count, 1u); };
+			}
+			if ((args[i] == std::string("-fluidsubsteps")) && (i + 1 < args.size()))
+			{
+				char* endptr;
+				uint32_t substeps = strtol(args[i + 1], &endptr, 10);
+				if (endptr != args[i + 1]) { options.fluidSubsteps = substeps; };
+			}
+			if (args[i] == std::string("-benchmarkfluid"))
+			{
+				options.benchmarkFluid = true;
+			}
+			if (args[i] == std::string("-nbody"))
+			{
+				options.drawMode = DrawMode::NBody;
+			}
+			if (args[i] == std::string("-nbodyapprox"))
+			{
+				options.drawMode = DrawMode::NBody;
+				options.nbodyHierarchical = true;
+			}
+			if ((args[i] == std::string("-nbodycount")) && (i + 1 < args.size()))
+			{
+				char* endptr;
+				uint32_t count = strtol(args[i + 1], &endptr, 10);
+				if (endptr != args[i + 1]) { options.nbodyCount = std::max(count, 1u); };
+			}
+			if (args[i] == std::string("-benchmarknbody"))
+			{
+				options.benchmarkNBody = true;
+			}
+			if (args[i] == std::string("-benchmarksort"))
+			{
+				options.benchmarkSort = true;
+			}
+			if ((args[i] == std::string("-sortcount")) && (i + 1 < args.size()))
+			{
+				char* endptr;
+				uint32_t count = strtol(args[i + 1], &endptr, 10);
+				if (endptr != args[i + 1]) { options.sortCount = std::max(count, 1u); };
+			}
+			if (args[i] == std::string("-emitters"))
+			{
+				options.drawMode = DrawMode::EmittedParticles;
+			}
+			if (args[i] == std::string("-validateparticles"))
+			{
+				options.validateParticles = true;
+			}
+			if (args[i] == std::string("-benchmarkparticles"))
+			{
+				options.benchmarkParticles = true;
+			}
+			if ((args[i] == std::string("-particlecount")) && (i + 1 < args.size()))
+			{
+				char* endptr;
+				uint32_t count = strtol(args[i + 1], &endptr, 10);
+				if (endptr != args[i + 1]) { options.particleCount = std::max(count, 1u); };
+			}
+			if (args[i] == std::string("-perobject"))
+			{
+				options.drawMode = DrawMode::PerObject;
+			}
+			if ((args[i] == std::string("-instances")) && (i + 1 < args.size()))
+			{
+				char* endptr;
+				uint32_t count = strtol(args[i + 1], &endptr, 10);
+				if (endptr != args[i + 1]) { options.instanceCount = count; };
+			}
+			if (args[i] == std::string("-benchmarkinstancing"))
+			{
+				options.benchmarkInstancing = true;
+			}
+			if ((args[i] == std::string("-benchmarkframes")) && (i + 1 < args.size()))
+			{
+				char* endptr;
+				uint32_t frames = strtol(args[i + 1], &endptr, 10);
+				if (endptr != args[i + 1]) { options.benchmarkFrames = frames; };
+			}
+		}
 	}
 
 	~VulkanExample()
@@ -97,6 +429,15 @@ public:
 		// Clean up used Vulkan resources 
 		// Note: Inherited destructor cleans up resources stored in base class
 		vkDestroyPipeline(device, pipeline, nullptr);
+		vkDestroyPipeline(device, instancingPipeline, nullptr);
+		vkDestroyPipeline(device, mvpPipeline, nullptr);
+		vkDestroyPipeline(device, particlePipeline, nullptr);
+		vkDestroyPipeline(device, particleBlendPipeline, nullptr);
+		vkDestroyPipeline(device, particleQuadPipeline, nullptr);
+		vkDestroyPipeline(device, particlePullPipeline, nullptr);
+		vkDestroyPipeline(device, hostParticlePipeline, nullptr);
+		vkDestroyPipeline(device, emitterPipeline, nullptr);
+		vkDestroyPipeline(device, nbodyPipeline, nullptr);
 
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
@@ -109,6 +450,29 @@ public:
 
 		vkDestroyBuffer(device, uniformBufferVS.buffer, nullptr);
 		vkFreeMemory(device, uniformBufferVS.memory, nullptr);
+		uniformSlices.buffer.destroy();
+		if (!uniformSlices.copyCmdBuffers.empty())
+		{
+			vulkanDevice->D().freeCommandBuffers (vulkanDevice->commandPool, uniformSlices.copyCmdBuffers);
+		}
+
+		instanceBuffer.destroy();
+		meshArena.destroy();
+		indirectDraws.destroy();
+		frustumCulling.destroy();
+		hiZCulling.destroy();
+		transformDraw.destroy();
+		particleSystem.destroy();
+		particleSort.destroy();
+		lowResParticles.destroy();
+		particleQuads.destroy();
+		particleEmitters.destroy();
+		particleFluid.destroy();
+		nbody.destroy();
+		if (particleVertices.buffer.buffer)
+		{
+			particleVertices.destroy();
+		}
 
 		for (auto& fence : waitFences)
 		{
@@ -162,13 +526,232 @@ public:
 			vertices.memory = vertexBuff.mem;
 
 			// Index buffer
-			BuffMem result = vulkanDevice->createBuffer(vk::BufferUsageFlagBits::eVertexBuffer,
+			BuffMem result = vulkanDevice->createBuffer(vk::BufferUsageFlagBits::eIndexBuffer,
 				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, indexBufferSize, indexBuffer.data());
 			indices.buffer = result.buff;
 			indices.memory = result.mem;
 		}
 	}
 
+	void prepareInstances()
+	{
+		// Distribute the instances on a regular grid filling the [-extent..extent] cube
+		const uint32_t instanceCount = std::max(options.instanceCount, 1u);
+		const uint32_t side = static_cast<uint32_t>(std::ceil(std::cbrt((float)instanceCount)));
+		const float spacing = 2.0f * options.sceneExtent / (float)side;
+
+		// All vertices of the triangle lie within sqrt(2) of its origin
+		const float triangleRadius = std::sqrt(2.0f);
+
+		std::vector<vks::InstanceData> instances(instanceCount);
+		sceneTransforms.resize(instanceCount);
+		for (uint32_t i = 0; i < instanceCount; i++)
+		{
+			glm::vec3 cell((float)(i % side), (float)((i / side) % side), (float)(i / (side * side)));
+			glm::vec3 pos = -glm::vec3(options.sceneExtent) + (cell + 0.5f) * spacing;
+			instances[i].model = glm::translate(glm::mat4(), pos);
+			instances[i].model = glm::scale(instances[i].model, glm::vec3(spacing * 0.4f));
+			instances[i].color = glm::vec4(cell / (float)side, 1.0f);
+			// Same placement for the host transformed scene, with a per-object start angle
+			sceneTransforms.set(i, pos, spacing * 0.4f, (float)i * 0.1f, triangleRadius, instances[i].color);
+		}
+
+		// One region per command buffer, so per-frame updates never touch data still in use by the device
+		instanceBuffer.create(vulkanDevice, instanceCount, static_cast<uint32_t>(drawCmdBuffers.size()));
+		instanceBuffer.writeAll(instances);
+
+		// A single record per region, the host only changes its instance count
+		transformDraw.create(vulkanDevice, 1, static_cast<uint32_t>(drawCmdBuffers.size()));
+		for (uint32_t i = 0; i < transformDraw.regionCount; i++)
+		{
+			VkDrawIndexedIndirectCommand *record = transformDraw.region(i);
+			record->indexCount = indices.count;
+			record->instanceCount = 0;
+			record->firstIndex = 0;
+			record->vertexOffset = 0;
+			record->firstInstance = 0;
+			transformDraw.setDrawCount(i, 1);
+		}
+	}
+
+	// Transform and cull all objects on the host, the MVPs of the visible ones are written to the instance buffer region
+	// Returns the number of visible objects
+	uint32_t updateHostTransforms(uint32_t region)
+	{
+		const glm::mat4 viewProjection = uboVS.projectionMatrix * uboVS.viewMatrix * uboVS.modelMatrix;
+		vks::Frustum frustum;
+		frustum.update(viewProjection);
+		const uint32_t visibleCount = sceneTransforms.update(viewProjection, frustum.planes, timer * 2.0f * glm::pi<float>(), instanceBuffer.region(region));
+		transformDraw.region(region)->instanceCount = visibleCount;
+		return visibleCount;
+	}
+
+	// Setup the meshes of the indirect scene and one draw record region per command buffer
+	void prepareIndirectScene()
+	{
+		// Triangle
+		meshArena.addMesh<Vertex>({
+			{ { 1.0f,  1.0f, 0.0f },{ 1.0f, 0.0f, 0.0f } },
+			{ { -1.0f,  1.0f, 0.0f },{ 0.0f, 1.0f, 0.0f } },
+			{ { 0.0f, -1.0f, 0.0f },{ 0.0f, 0.0f, 1.0f } } },
+			{ 0, 1, 2 });
+		// Quad
+		meshArena.addMesh<Vertex>({
+			{ { -1.0f, -1.0f, 0.0f },{ 1.0f, 1.0f, 0.0f } },
+			{ { 1.0f, -1.0f, 0.0f },{ 0.0f, 1.0f, 1.0f } },
+			{ { 1.0f,  1.0f, 0.0f },{ 1.0f, 0.0f, 1.0f } },
+			{ { -1.0f,  1.0f, 0.0f },{ 1.0f, 1.0f, 1.0f } } },
+			{ 0, 1, 2, 2, 3, 0 });
+		// Cube
+		std::vector<Vertex> cubeVertices;
+		for (uint32_t i = 0; i < 8; i++)
+		{
+			float x = (i & 1) ? 1.0f : -1.0f;
+			float y = (i & 2) ? 1.0f : -1.0f;
+			float z = (i & 4) ? 1.0f : -1.0f;
+			cubeVertices.push_back({ { x, y, z },{ x * 0.5f + 0.5f, y * 0.5f + 0.5f, z * 0.5f + 0.5f } });
+		}
+		meshArena.addMesh<Vertex>(cubeVertices, {
+			0, 2, 1, 1, 2, 3,	// -z
+			4, 5, 6, 5, 7, 6,	// +z
+			0, 1, 4, 1, 5, 4,	// -y
+			2, 6, 3, 3, 6, 7,	// +y
+			0, 4, 2, 2, 4, 6,	// -x
+			1, 3, 5, 3, 7, 5 });	// +x
+		meshArena.upload(vulkanDevice, queue);
+
+		objectMeshes.resize(instanceBuffer.count);
+		for (uint32_t i = 0; i < instanceBuffer.count; i++)
+		{
+			objectMeshes[i] = i % static_cast<uint32_t>(meshArena.meshes.size());
+		}
+		drawListVersion++;
+
+		if (options.occlusionCulling)
+		{
+			// The depth pyramid is built from the depth attachment in compute shaders
+			vk::FormatProperties formatProperties = physicalDevice.getFormatProperties ((vk::Format)depthFormat);
+			if (!(formatProperties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImage))
+			{
+				std::cerr << "Depth format can't be sampled, falling back to frustum culling" << std::endl;
+				options.occlusionCulling = false;
+				options.gpuCulling = true;
+			}
+		}
+
+		if (options.occlusionCulling)
+		{
+			// Draw records of both passes are owned by the culling class
+			hiZCulling.prepare(vulkanDevice, queue, pipelineCache, meshArena, buildCullObjects(), swapChain.colorFormat, depthFormat,
+				depthStencil.image, width, height, static_cast<uint32_t>(drawCmdBuffers.size()), presentLayout());
+		}
+		else if (options.gpuCulling)
+		{
+			// Draw records are written by the culling pass on the device
+			indirectDraws.create(vulkanDevice, instanceBuffer.count, static_cast<uint32_t>(drawCmdBuffers.size()), false);
+			frustumCulling.prepare(vulkanDevice, queue, pipelineCache, meshArena, buildCullObjects(), &indirectDraws);
+		}
+		else
+		{
+			indirectDraws.create(vulkanDevice, instanceBuffer.count, static_cast<uint32_t>(drawCmdBuffers.size()));
+			drawListRegionVersions.assign(indirectDraws.regionCount, ~0ull);
+			for (uint32_t i = 0; i < indirectDraws.regionCount; i++)
+			{
+				updateDrawList(i);
+			}
+		}
+	}
+
+	// World space bounding spheres of all objects (same space as the frustum extracted from projection * view * model)
+	std::vector<vks::CullObject> buildCullObjects()
+	{
+		std::vector<vks::CullObject> cullObjects(instanceBuffer.count);
+		const vks::InstanceData *instances = instanceBuffer.region(0);
+		for (uint32_t i = 0; i < instanceBuffer.count; i++)
+		{
+			const glm::mat4 &model = instances[i].model;
+			float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+			cullObjects[i].sphere = glm::vec4(glm::vec3(model[3]), meshArena.meshes[objectMeshes[i]].radius * scale);
+			cullObjects[i].mesh = objectMeshes[i];
+		}
+		return cullObjects;
+	}
+
+	// Write the draw records for all objects to a region of the indirect buffer if the region is stale
+	// The command buffers don't need to be rebuilt when the draw list changes, an unchanged list costs nothing per frame
+	void updateDrawList(uint32_t region)
+	{
+		if (drawListRegionVersions[region] == drawListVersion)
+		{
+			return;
+		}
+		VkDrawIndexedIndirectCommand *records = indirectDraws.region(region);
+		// Records are independent, so ranges of objects are written in parallel
+		jobSystem->parallelFor(0, static_cast<uint32_t>(objectMeshes.size()), 8192, [&](uint32_t first, uint32_t last)
+		{
+			for (uint32_t i = first; i < last; i++)
+			{
+				const vks::MeshRange &mesh = meshArena.meshes[objectMeshes[i]];
+				records[i].indexCount = mesh.indexCount;
+				records[i].instanceCount = 1;
+				records[i].firstIndex = mesh.firstIndex;
+				records[i].vertexOffset = mesh.vertexOffset;
+				records[i].firstInstance = i;		// Selects the object's transform and color from the instance buffer
+			}
+		});
+		indirectDraws.setDrawCount(region, static_cast<uint32_t>(objectMeshes.size()));
+		drawListRegionVersions[region] = drawListVersion;
+	}
+
+	// Host work of a frame, tasks write the current frame's regions only
+	// The text overlay slice doesn't depend on the scene and is written while the scene's host work runs
+	void prepareFrameGraph()
+	{
+		frameGraph.add([this]() { textOverlay.update(currentBuffer); });
+		if ((options.drawMode == DrawMode::Indirect) && (!options.gpuCulling) && (!options.occlusionCulling))
+		{
+			const vks::JobSystem::TaskGraph::Task edit = frameGraph.add([this]()
+			{
+				if (meshReassignRequested)
+				{
+					meshReassignRequested = false;
+					reassignMeshes();
+				}
+			});
+			// Only rewritten if the draw list changed since, regions of the other frames are rewritten once their frame comes up again
+			const vks::JobSystem::TaskGraph::Task fill = frameGraph.add([this]() { updateDrawList(currentBuffer); });
+			frameGraph.precede(edit, fill);
+		}
+		if (options.drawMode == DrawMode::HostTransforms)
+		{
+			frameGraph.add([this]() { updateHostTransforms(currentBuffer); });
+		}
+		if (options.drawMode == DrawMode::HostParticles)
+		{
+			frameGraph.add([this]()
+			{
+				auto tStart = std::chrono::high_resolution_clock::now();
+				particleSimulator.step(particleVertices.region(currentBuffer), jobSystem.get());
+				double stepMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+				hostParticleStepMs = (hostParticleStepMs == 0.0) ? stepMs : hostParticleStepMs * 0.95 + stepMs * 0.05;
+			});
+		}
+	}
+
+	// Draw every object with the next mesh of the arena, only the draw records change (the command buffers are not rebuilt)
+	void reassignMeshes()
+	{
+		const uint32_t meshCount = static_cast<uint32_t>(meshArena.meshes.size());
+		jobSystem->parallelFor(0, static_cast<uint32_t>(objectMeshes.size()), 8192, [&](uint32_t first, uint32_t last)
+		{
+			for (uint32_t i = first; i < last; i++)
+			{
+				objectMeshes[i] = (objectMeshes[i] + 1) % meshCount;
+			}
+		});
+		drawListVersion++;
+	}
+
 	void prepareUniformBuffers()
 	{
 		// Prepare and initialize a uniform buffer block containing shader uniforms
@@ -176,7 +759,12 @@ public:
 
 		vk::DeviceSize uboSize = sizeof(uboVS);
 
-		BuffMem result = vulkanDevice->createBuffer (vk::BufferUsageFlagBits::eUniformBuffer, 
+		vk::BufferUsageFlags uboUsage = vk::BufferUsageFlagBits::eUniformBuffer;
+		if (settings.lowLatency)
+		{
+			uboUsage |= vk::BufferUsageFlagBits::eTransferDst;
+		}
+		BuffMem result = vulkanDevice->createBuffer (uboUsage, 
 			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, uboSize);
 		uniformBufferVS.buffer = result.buff;
 		uniformBufferVS.memory = result.mem;
@@ -186,12 +774,71 @@ public:
 									.setOffset	(0)
 									.setRange	(uboSize);
 
+		if (settings.lowLatency)
+		{
+			prepareUniformSlices();
+		}
 		updateUniformBuffers();
 	}
 
-	void updateUniformBuffers()
+	// Low latency mode: per slot, a command buffer copying the slot's slice into the uniform buffer
+	// The copy waits for the shaders of the frames submitted before it, the frame's shaders wait for the copy
+	void prepareUniformSlices()
+	{
+		const uint32_t slotCount = static_cast<uint32_t>(drawCmdBuffers.size());
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+			&uniformSlices.buffer, slotCount * sizeof(uboVS)));
+		VK_CHECK_RESULT(uniformSlices.buffer.map());
+
+		const vk::PipelineStageFlags shaderStages = vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader;
+		vk::BufferMemoryBarrier barrier;
+		barrier.setSrcQueueFamilyIndex (VK_QUEUE_FAMILY_IGNORED)
+			.setDstQueueFamilyIndex (VK_QUEUE_FAMILY_IGNORED)
+			.setBuffer (uniformBufferVS.buffer)
+			.setSize (VK_WHOLE_SIZE);
+		for (uint32_t slot = 0; slot < slotCount; slot++)
+		{
+			vk::CommandBuffer cmdBuffer = vulkanDevice->createCommandBuffer(vk::CommandBufferLevel::ePrimary, true);
+			barrier.setSrcAccessMask (vk::AccessFlagBits::eUniformRead)
+				.setDstAccessMask (vk::AccessFlagBits::eTransferWrite);
+			cmdBuffer.pipelineBarrier (shaderStages, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags(), {}, barrier, {});
+			cmdBuffer.copyBuffer (vk::Buffer(uniformSlices.buffer.buffer), uniformBufferVS.buffer, vk::BufferCopy(slot * sizeof(uboVS), 0, sizeof(uboVS)));
+			barrier.setSrcAccessMask (vk::AccessFlagBits::eTransferWrite)
+				.setDstAccessMask (vk::AccessFlagBits::eUniformRead);
+			cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eTransfer, shaderStages, vk::DependencyFlags(), {}, barrier, {});
+			VK_CHECK_RESULT(cmdBuffer.end ());
+			vulkanDevice->setCommandBufferName(cmdBuffer, "uniform slice copy " + std::to_string(slot));
+			uniformSlices.copyCmdBuffers.push_back(cmdBuffer);
+		}
+	}
+
+	// Low latency mode: wait for the queue depth limit, sample the input and write the frame's matrices as late as possible
+	// Host side work that used the matrices earlier in the frame (culling, host transforms, occlusion matrices) keeps the ones of the frame start
+	void updateUniformSlice(uint32_t frame)
+	{
+		beginLateUpdate(frame);
+		updateMatrices();
+		memcpy(static_cast<uint8_t*>(uniformSlices.buffer.mapped) + frame * sizeof(uboVS), &uboVS, sizeof(uboVS));
+	}
+
+	// Command buffers of the current frame's batch, in low latency mode with the late matrix copy and the latency timestamp around it
+	std::vector<vk::CommandBuffer> frameCommandBuffers()
+	{
+		if (!settings.lowLatency)
+		{
+			return { drawCmdBuffers[currentBuffer] };
+		}
+		updateUniformSlice(currentBuffer);
+		std::vector<vk::CommandBuffer> cmdBuffers = { uniformSlices.copyCmdBuffers[currentBuffer], drawCmdBuffers[currentBuffer] };
+		if (latencyCommandBuffer(currentBuffer))
+		{
+			cmdBuffers.push_back(latencyCommandBuffer(currentBuffer));
+		}
+		return cmdBuffers;
+	}
+
+	void updateMatrices()
 	{
-		// Update matrices
 		uboVS.projectionMatrix = glm::perspective(glm::radians(60.0f), (float)width / (float)height, 0.1f, 256.0f);
 
 		uboVS.viewMatrix = glm::translate(glm::mat4(), glm::vec3(0.0f, 0.0f, zoom));
@@ -200,6 +847,22 @@ public:
 		uboVS.modelMatrix = glm::rotate(uboVS.modelMatrix, glm::radians(rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
 		uboVS.modelMatrix = glm::rotate(uboVS.modelMatrix, glm::radians(rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
 		uboVS.modelMatrix = glm::rotate(uboVS.modelMatrix, glm::radians(rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
+	}
+
+	void updateUniformBuffers()
+	{
+		updateMatrices();
+
+		if (options.gpuCulling)
+		{
+			frustumCulling.updateFrustum(uboVS.projectionMatrix * uboVS.viewMatrix * uboVS.modelMatrix);
+		}
+
+		if ((settings.lowLatency) && (prepared))
+		{
+			// Written to the frame's slice right before its submission (updateUniformSlice())
+			return;
+		}
 
 		// Map uniform buffer and update it
 		
@@ -348,11 +1011,160 @@ public:
 			.setPDynamicState (&dynamicState);
 
 		// Create rendering pipeline using the specified state
-		pipeline = CHECK(vulkanDevice->D().createGraphicsPipeline (pipelineCache, pipelineCreateInfo));
+		pipeline = vulkanDevice->createGraphicsPipeline(pipelineCache, pipelineCreateInfo, "scene");
 
 		// Shader modules are no longer needed once the graphics pipeline has been created
+		vkDestroyShaderModule(device, shaderStages[0].module, nullptr);
+
+		// Instancing pipeline
+		// Adds a second vertex binding that advances per instance instead of per vertex
+		std::array<vk::VertexInputBindingDescription, 2> instancingBindings = { vertexInputBinding, vks::InstanceBuffer::bindingDescription(1) };
+		// These match the following shader layout (see instancing.vert):
+		//	layout (location = 2) in mat4 instanceModel;
+		//	layout (location = 6) in vec4 instanceColor;
+		std::array<vk::VertexInputAttributeDescription, 5> instanceAttributes = vks::InstanceBuffer::attributeDescriptions(1, 2);
+		std::vector<vk::VertexInputAttributeDescription> instancingAttributes(vertexInputAttributs.begin(), vertexInputAttributs.end());
+		instancingAttributes.insert(instancingAttributes.end(), instanceAttributes.begin(), instanceAttributes.end());
+
+		vertexInputState.setVertexBindingDescriptionCount (static_cast<uint32_t>(instancingBindings.size()))
+						.setPVertexBindingDescriptions (instancingBindings.data())
+						.setVertexAttributeDescriptionCount (static_cast<uint32_t>(instancingAttributes.size()))
+						.setPVertexAttributeDescriptions (instancingAttributes.data());
+
+		shaderStages[0].setModule (vks::tools::loadSPIRVShader("shaders/instancing.vert.spv", device));
+
+		instancingPipeline = vulkanDevice->createGraphicsPipeline(pipelineCache, pipelineCreateInfo, "instancing");
+
+		vkDestroyShaderModule(device, shaderStages[0].module, nullptr);
+
+		// Host transformed instances, same vertex input but the instance matrix already is the MVP
+		shaderStages[0].setModule (vks::tools::loadSPIRVShader("shaders/instancing_mvp.vert.spv", device));
+
+		mvpPipeline = vulkanDevice->createGraphicsPipeline(pipelineCache, pipelineCreateInfo, "mvp");
+
 		vkDestroyShaderModule(device, shaderStages[0].module, nullptr);
 		vkDestroyShaderModule(device, shaderStages[1].module, nullptr);
+
+		// Particles, the particle storage buffer is bound as vertex buffer and drawn as point list
+		// These match the following shader layout (see particle.vert):
+		//	layout (location = 0) in vec4 inPos;
+		//	layout (location = 1) in vec3 inVelocity;
+		vk::VertexInputBindingDescription particleBinding = vks::ParticleSystem::bindingDescription(0);
+		std::array<vk::VertexInputAttributeDescription, 2> particleAttributes = vks::ParticleSystem::attributeDescriptions(0);
+		vertexInputState.setVertexBindingDescriptionCount (1)
+						.setPVertexBindingDescriptions (&particleBinding)
+						.setVertexAttributeDescriptionCount (static_cast<uint32_t>(particleAttributes.size()))
+						.setPVertexAttributeDescriptions (particleAttributes.data());
+		inputAssemblyState.setTopology (vk::PrimitiveTopology::ePointList);
+
+		shaderStages[0].setModule (vks::tools::loadSPIRVShader("shaders/particle.vert.spv", device));
+		shaderStages[1].setModule (vks::tools::loadSPIRVShader("shaders/particle.frag.spv", device));
+
+		particlePipeline = vulkanDevice->createGraphicsPipeline(pipelineCache, pipelineCreateInfo, "particles");
+
+		// Depth sorted particles are blended with a constant alpha, depth writes would discard particles drawn later
+		blendAttachmentState[0].setBlendEnable (true)
+							.setSrcColorBlendFactor (vk::BlendFactor::eConstantAlpha)
+							.setDstColorBlendFactor (vk::BlendFactor::eOneMinusConstantAlpha)
+							.setColorBlendOp (vk::BlendOp::eAdd)
+							.setSrcAlphaBlendFactor (vk::BlendFactor::eOne)
+							.setDstAlphaBlendFactor (vk::BlendFactor::eZero)
+							.setAlphaBlendOp (vk::BlendOp::eAdd);
+		colorBlendState.setBlendConstants ({ { 0.0f, 0.0f, 0.0f, 0.35f } });
+		depthStencilState.setDepthWriteEnable (false);
+
+		particleBlendPipeline = vulkanDevice->createGraphicsPipeline(pipelineCache, pipelineCreateInfo, "particles blend");
+
+		blendAttachmentState[0].setBlendEnable (false);
+		depthStencilState.setDepthWriteEnable (true);
+
+		vkDestroyShaderModule(device, shaderStages[0].module, nullptr);
+
+		// Particle quads, both variants pass the quad size as specialization constant
+		if (particleQuads.device)
+		{
+			const vk::ShaderModule pointFragmentShader = shaderStages[1].module;
+			vk::SpecializationMapEntry quadSizeEntry;
+			const vk::SpecializationInfo quadSpecialization = particleQuads.specializationInfo(quadSizeEntry);
+			shaderStages[0].setPSpecializationInfo (&quadSpecialization);
+			shaderStages[1].setModule (vks::tools::loadSPIRVShader("shaders/particle_quad.frag.spv", device));
+
+			// Instanced: four corner strip per instance, the particle buffer is an instance rate binding
+			// These match the following shader layout (see particle_quad.vert):
+			//	layout (location = 0) in vec2 inCorner;
+			//	layout (location = 1) in vec4 inPos;
+			//	layout (location = 2) in vec3 inVelocity;
+			const std::array<vk::VertexInputBindingDescription, 2> quadBindings = vks::ParticleQuads::bindingDescriptions();
+			const std::array<vk::VertexInputAttributeDescription, 3> quadAttributes = vks::ParticleQuads::attributeDescriptions();
+			vertexInputState.setVertexBindingDescriptionCount (static_cast<uint32_t>(quadBindings.size()))
+							.setPVertexBindingDescriptions (quadBindings.data())
+							.setVertexAttributeDescriptionCount (static_cast<uint32_t>(quadAttributes.size()))
+							.setPVertexAttributeDescriptions (quadAttributes.data());
+			inputAssemblyState.setTopology (vk::PrimitiveTopology::eTriangleStrip);
+			shaderStages[0].setModule (vks::tools::loadSPIRVShader("shaders/particle_quad.vert.spv", device));
+
+			particleQuadPipeline = vulkanDevice->createGraphicsPipeline(pipelineCache, pipelineCreateInfo, "particle quads");
+
+			vkDestroyShaderModule(device, shaderStages[0].module, nullptr);
+
+			// Vertex pulling: no vertex input, six vertices per particle (see particle_pull.vert)
+			vertexInputState.setVertexBindingDescriptionCount (0)
+							.setVertexAttributeDescriptionCount (0);
+			inputAssemblyState.setTopology (vk::PrimitiveTopology::eTriangleList);
+			shaderStages[0].setModule (vks::tools::loadSPIRVShader("shaders/particle_pull.vert.spv", device));
+			pipelineCreateInfo.setLayout (particleQuads.pipelineLayout);
+
+			particlePullPipeline = vulkanDevice->createGraphicsPipeline(pipelineCache, pipelineCreateInfo, "particle vertex pulling");
+
+			vkDestroyShaderModule(device, shaderStages[0].module, nullptr);
+			vkDestroyShaderModule(device, shaderStages[1].module, nullptr);
+
+			shaderStages[0].setPSpecializationInfo (nullptr);
+			shaderStages[1].setModule (pointFragmentShader);
+			vertexInputState.setVertexBindingDescriptionCount (1)
+							.setPVertexBindingDescriptions (&particleBinding)
+							.setVertexAttributeDescriptionCount (static_cast<uint32_t>(particleAttributes.size()))
+							.setPVertexAttributeDescriptions (particleAttributes.data());
+			inputAssemblyState.setTopology (vk::PrimitiveTopology::ePointList);
+			pipelineCreateInfo.setLayout (pipelineLayout);
+		}
+
+		// Host simulated particles, position and packed color
+		// These match the following shader layout (see particle_color.vert):
+		//	layout (location = 0) in vec3 inPos;
+		//	layout (location = 1) in vec4 inColor;
+		particleBinding = vks::ParticleVertexBuffer::bindingDescription(0);
+		particleAttributes = vks::ParticleVertexBuffer::attributeDescriptions(0);
+
+		shaderStages[0].setModule (vks::tools::loadSPIRVShader("shaders/particle_color.vert.spv", device));
+
+		hostParticlePipeline = vulkanDevice->createGraphicsPipeline(pipelineCache, pipelineCreateInfo, "host particles");
+
+		vkDestroyShaderModule(device, shaderStages[0].module, nullptr);
+
+		// N-body, same layout as the particles (see nbody.vert)
+		particleBinding = vks::ParticleSystem::bindingDescription(0);
+		particleAttributes = vks::ParticleSystem::attributeDescriptions(0);
+
+		shaderStages[0].setModule (vks::tools::loadSPIRVShader("shaders/nbody.vert.spv", device));
+
+		nbodyPipeline = vulkanDevice->createGraphicsPipeline(pipelineCache, pipelineCreateInfo, "nbody particles");
+
+		vkDestroyShaderModule(device, shaderStages[0].module, nullptr);
+
+		// Device emitted particles, no vertex input (the vertex index selects an alive list entry, see particle_alive.vert)
+		if (particleEmitters.prepared)
+		{
+			vertexInputState.setVertexBindingDescriptionCount (0)
+							.setVertexAttributeDescriptionCount (0);
+			shaderStages[0].setModule (vks::tools::loadSPIRVShader("shaders/particle_alive.vert.spv", device));
+			pipelineCreateInfo.setLayout (particleEmitters.drawPipelineLayout);
+
+			emitterPipeline = vulkanDevice->createGraphicsPipeline(pipelineCache, pipelineCreateInfo, "emitter particles");
+
+			vkDestroyShaderModule(device, shaderStages[0].module, nullptr);
+		}
+		vkDestroyShaderModule(device, shaderStages[1].module, nullptr);
 	}
 
 	void setupDescriptorPool()
@@ -435,6 +1247,7 @@ public:
 
 	void buildCommandBuffers() override
 	{
+		VKS_TRACE_SCOPE("buildCommandBuffers");
 
 		// Set clear values for all framebuffer attachments with loadOp set to clear
 		// We use two attachments (color and depth) that are cleared at the start of the subpass and as such we need to set clear values for both
@@ -458,40 +1271,1188 @@ public:
 		vk::CommandBufferBeginInfo cmdBufInfo = {};
 		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 		{
+			if (options.occlusionCulling)
+			{
+				buildOcclusionCullingCommandBuffer(i);
+				continue;
+			}
+			if (options.drawMode == DrawMode::Particles)
+			{
+				buildParticleCommandBuffer(i);
+				continue;
+			}
+			if (options.drawMode == DrawMode::EmittedParticles)
+			{
+				// Recorded each frame once the emitters have been updated
+				continue;
+			}
+			if (options.drawMode == DrawMode::Fluid)
+			{
+				buildFluidCommandBuffer(i);
+				continue;
+			}
+			if (options.drawMode == DrawMode::NBody)
+			{
+				// Recorded each frame, the body buffers alternate with every step
+				continue;
+			}
+
 			renderPassBeginInfo.setFramebuffer(frameBuffers[i]);	// Set target frame buffer
 
 			VK_CHECK_RESULT(drawCmdBuffers[i].begin (cmdBufInfo));
+			gpuProfiler.beginFrame(drawCmdBuffers[i], i);
+
+			if (options.gpuCulling)
+			{
+				// Culling has to be recorded outside of the render pass, it writes the draw records of this command buffer's region
+				vks::GpuProfiler::Scope scope(gpuProfiler, drawCmdBuffers[i], "culling");
+				frustumCulling.buildCommandBuffer(drawCmdBuffers[i], i);
+			}
 			
-			// Start the first sub pass specified in our default render pass setup by the base class
-			// This will clear the color and depth attachment
-			drawCmdBuffers[i].beginRenderPass(renderPassBeginInfo, vk::SubpassContents::eInline);
+			{
+				// Start the first sub pass specified in our default render pass setup by the base class
+				// This will clear the color and depth attachment
+				vks::GpuProfiler::Scope scope(gpuProfiler, drawCmdBuffers[i], "scene");
+				drawCmdBuffers[i].beginRenderPass(renderPassBeginInfo, vk::SubpassContents::eInline);
+
+				
+				vk::Viewport viewport {0, 0, (float)width, (float)height};
+				viewport.setMaxDepth (1.0f)
+						.setMinDepth (0.0f);
+				vk::Rect2D scissor{ { 0,0 },{ width, height } };
+		
+				drawCmdBuffers[i].setViewport(0, { viewport }); // Update dynamic viewport state
+				drawCmdBuffers[i].setScissor (0, {scissor});	// Update dynamic scissor state
 
-			
-			vk::Viewport viewport {0, 0, (float)width, (float)height};
-			viewport.setMaxDepth (1.0f)
-					.setMinDepth (0.0f);
-			vk::Rect2D scissor{ { 0,0 },{ width, height } };
-	
-			drawCmdBuffers[i].setViewport(0, { viewport }); // Update dynamic viewport state
-			drawCmdBuffers[i].setScissor (0, {scissor});	// Update dynamic scissor state
+				// Bind descriptor sets describing shader binding points
+				drawCmdBuffers[i].bindDescriptorSets(vk::PipelineBindPoint::eGraphics,pipelineLayout, 0, descriptorSet, {});
 
-			// Bind descriptor sets describing shader binding points
-			drawCmdBuffers[i].bindDescriptorSets(vk::PipelineBindPoint::eGraphics,pipelineLayout, 0, descriptorSet, {});
+				drawScene(drawCmdBuffers[i], i);
+				drawTextOverlay(drawCmdBuffers[i], i, renderPass);
 
-			// Bind the rendering pipeline
-			// The pipeline (state object) contains all states of the rendering pipeline, binding it will set all the states specified at pipeline creation time
-			drawCmdBuffers[i].bindPipeline (vk::PipelineBindPoint::eGraphics, pipeline);
+				drawCmdBuffers[i].endRenderPass ();
+				// Ending the render pass will add an implicit barrier transitioning the frame buffer color attachment to 
+				// VK_IMAGE_LAYOUT_PRESENT_SRC_KHR for presenting it to the windowing system
+			}
 
-			drawCmdBuffers[i].bindVertexBuffers (0, vertices.buffer, {0});	// Bind triangle vertex buffer (contains position and colors)
-			drawCmdBuffers[i].bindIndexBuffer (indices.buffer, 0, vk::IndexType::eUint32); // Bind triangle index buffer
-			drawCmdBuffers[i].drawIndexed (indices.count, 1, 0, 0, 1);					   // Draw indexed triangle
+			VK_CHECK_RESULT(drawCmdBuffers[i].end());
+		}
+	}
 
-			drawCmdBuffers[i].endRenderPass ();
-			// Ending the render pass will add an implicit barrier transitioning the frame buffer color attachment to 
-			// VK_IMAGE_LAYOUT_PRESENT_SRC_KHR for presenting it to the windowing system
+	// Particles:
+	//	acquire the buffer written by the latest step from the compute queue -> draw it -> release it back to compute
+	// Which buffer that is alternates with every step, so the command buffer is recorded again each frame
+	void buildParticleCommandBuffer(uint32_t index)
+	{
+		vk::CommandBuffer cmdBuffer = drawCmdBuffers[index];
+		const uint32_t particleBuffer = particleSystem.currentBuffer();
 
-			VK_CHECK_RESULT(drawCmdBuffers[i].end());
+		vk::ClearValue clearValues[2];
+		clearValues[0].color = std::array<float, 4>{ { 0.0f, 0.0f, 0.0f, 1.0f } };
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		vk::RenderPassBeginInfo renderPassBeginInfo;
+		renderPassBeginInfo.setRenderPass (renderPass)
+			.setFramebuffer (frameBuffers[index])
+			.setRenderArea (vk::Rect2D(vk::Offset2D(0, 0), vk::Extent2D(width, height)))
+			.setClearValueCount (2)
+			.setPClearValues (clearValues);
+
+		VK_CHECK_RESULT(cmdBuffer.begin (vk::CommandBufferBeginInfo()));
+		gpuProfiler.beginFrame(cmdBuffer, index);
+
+		particleSystem.buildGraphicsTimestamp(cmdBuffer, true);
+		particleSystem.buildGraphicsAcquire(cmdBuffer, particleBuffer);
+		if (options.sortParticles)
+		{
+			vks::GpuProfiler::Scope scope(gpuProfiler, cmdBuffer, "particle sort");
+			particleSystem.buildDepthSort(cmdBuffer, particleBuffer);
+		}
+
+		if (lowResParticles.prepared)
+		{
+			// Scene (the triangle as occluder) at full resolution, particles at low resolution, upsampled over the scene
+			{
+				vks::GpuProfiler::Scope scope(gpuProfiler, cmdBuffer, "scene");
+				lowResParticles.beginScenePass(cmdBuffer, index);
+				cmdBuffer.bindDescriptorSets (vk::PipelineBindPoint::eGraphics, pipelineLayout, 0, descriptorSet, {});
+				drawTriangle(cmdBuffer);
+				cmdBuffer.endRenderPass ();
+			}
+			{
+				vks::GpuProfiler::Scope scope(gpuProfiler, cmdBuffer, "particles");
+				lowResParticles.buildParticlePass(cmdBuffer, particleBuffer, particleSystem.particleCount);
+			}
+			{
+				vks::GpuProfiler::Scope scope(gpuProfiler, cmdBuffer, "composite");
+				lowResParticles.buildCompositePass(cmdBuffer, index, [this, index](vk::CommandBuffer cmdBuffer, vk::RenderPass renderPass)
+				{
+					drawTextOverlay(cmdBuffer, index, renderPass);
+				});
+			}
+
+			particleSystem.buildGraphicsRelease(cmdBuffer, particleBuffer);
+			particleSystem.buildGraphicsTimestamp(cmdBuffer, false);
+			VK_CHECK_RESULT(cmdBuffer.end());
+			return;
+		}
+
+		{
+			vks::GpuProfiler::Scope scope(gpuProfiler, cmdBuffer, "particles");
+			cmdBuffer.beginRenderPass (renderPassBeginInfo, vk::SubpassContents::eInline);
+			vk::Viewport viewport(0.0f, 0.0f, (float)width, (float)height, 0.0f, 1.0f);
+			cmdBuffer.setViewport (0, viewport);
+			cmdBuffer.setScissor (0, vk::Rect2D(vk::Offset2D(0, 0), vk::Extent2D(width, height)));
+			cmdBuffer.bindDescriptorSets (vk::PipelineBindPoint::eGraphics, pipelineLayout, 0, descriptorSet, {});
+			particleSystem.bind(cmdBuffer);
+			if (options.sortParticles)
+			{
+				// The sorted particle indices, farthest first
+				cmdBuffer.bindPipeline (vk::PipelineBindPoint::eGraphics, particleBlendPipeline);
+				cmdBuffer.bindIndexBuffer (vk::Buffer(particleSort.values[0].buffer), 0, vk::IndexType::eUint32);
+				cmdBuffer.drawIndexed (particleSystem.particleCount, 1, 0, 0, 0);
+			}
+			else if (options.particleRender == vks::ParticleRenderMode::Instanced)
+			{
+				cmdBuffer.bindPipeline (vk::PipelineBindPoint::eGraphics, particleQuadPipeline);
+				particleQuads.drawInstanced(cmdBuffer, vk::Buffer(particleSystem.buffers[particleBuffer].buffer), particleSystem.particleCount);
+			}
+			else if (options.particleRender == vks::ParticleRenderMode::VertexPulling)
+			{
+				cmdBuffer.bindPipeline (vk::PipelineBindPoint::eGraphics, particlePullPipeline);
+				particleQuads.drawPulled(cmdBuffer, particleBuffer, particleSystem.particleCount);
+			}
+			else
+			{
+				cmdBuffer.bindPipeline (vk::PipelineBindPoint::eGraphics, particlePipeline);
+				cmdBuffer.draw (particleSystem.particleCount, 1, 0, 0);
+			}
+			drawTextOverlay(cmdBuffer, index, renderPass);
+			cmdBuffer.endRenderPass ();
+		}
+
+		particleSystem.buildGraphicsRelease(cmdBuffer, particleBuffer);
+		particleSystem.buildGraphicsTimestamp(cmdBuffer, false);
+
+		VK_CHECK_RESULT(cmdBuffer.end());
+	}
+
+	// Emitted particles:
+	//	emit -> update (indirect dispatch over the alive list) -> draw (indirect, vertex count written by the update)
+	// The alive lists alternate every frame, so the command buffer is recorded again each frame
+	void buildEmitterCommandBuffer(uint32_t index)
+	{
+		vk::CommandBuffer cmdBuffer = drawCmdBuffers[index];
+
+		vk::ClearValue clearValues[2];
+		clearValues[0].color = std::array<float, 4>{ { 0.0f, 0.0f, 0.0f, 1.0f } };
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		vk::RenderPassBeginInfo renderPassBeginInfo;
+		renderPassBeginInfo.setRenderPass (renderPass)
+			.setFramebuffer (frameBuffers[index])
+			.setRenderArea (vk::Rect2D(vk::Offset2D(0, 0), vk::Extent2D(width, height)))
+			.setClearValueCount (2)
+			.setPClearValues (clearValues);
+
+		VK_CHECK_RESULT(cmdBuffer.begin (vk::CommandBufferBeginInfo()));
+		gpuProfiler.beginFrame(cmdBuffer, index);
+
+		{
+			vks::GpuProfiler::Scope scope(gpuProfiler, cmdBuffer, "emitters");
+			particleEmitters.buildCommandBuffer(cmdBuffer, index);
 		}
+
+		{
+			vks::GpuProfiler::Scope scope(gpuProfiler, cmdBuffer, "particles");
+			cmdBuffer.beginRenderPass (renderPassBeginInfo, vk::SubpassContents::eInline);
+			vk::Viewport viewport(0.0f, 0.0f, (float)width, (float)height, 0.0f, 1.0f);
+			cmdBuffer.setViewport (0, viewport);
+			cmdBuffer.setScissor (0, vk::Rect2D(vk::Offset2D(0, 0), vk::Extent2D(width, height)));
+			cmdBuffer.bindPipeline (vk::PipelineBindPoint::eGraphics, emitterPipeline);
+			particleEmitters.draw(cmdBuffer);
+			drawTextOverlay(cmdBuffer, index, renderPass);
+			cmdBuffer.endRenderPass ();
+		}
+
+		VK_CHECK_RESULT(cmdBuffer.end());
+	}
+
+	// Fluid:
+	//	substeps (neighbor search -> density -> forces and integration) -> draw
+	// The fluid advances by the same time every frame, so the command buffers are only recorded once
+	void buildFluidCommandBuffer(uint32_t index)
+	{
+		vk::CommandBuffer cmdBuffer = drawCmdBuffers[index];
+
+		vk::ClearValue clearValues[2];
+		clearValues[0].color = std::array<float, 4>{ { 0.0f, 0.0f, 0.0f, 1.0f } };
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		vk::RenderPassBeginInfo renderPassBeginInfo;
+		renderPassBeginInfo.setRenderPass (renderPass)
+			.setFramebuffer (frameBuffers[index])
+			.setRenderArea (vk::Rect2D(vk::Offset2D(0, 0), vk::Extent2D(width, height)))
+			.setClearValueCount (2)
+			.setPClearValues (clearValues);
+
+		VK_CHECK_RESULT(cmdBuffer.begin (vk::CommandBufferBeginInfo()));
+		gpuProfiler.beginFrame(cmdBuffer, index);
+
+		{
+			vks::GpuProfiler::Scope scope(gpuProfiler, cmdBuffer, "fluid step");
+			particleFluid.buildCommandBuffer(cmdBuffer);
+		}
+
+		{
+			vks::GpuProfiler::Scope scope(gpuProfiler, cmdBuffer, "particles");
+			cmdBuffer.beginRenderPass (renderPassBeginInfo, vk::SubpassContents::eInline);
+			vk::Viewport viewport(0.0f, 0.0f, (float)width, (float)height, 0.0f, 1.0f);
+			cmdBuffer.setViewport (0, viewport);
+			cmdBuffer.setScissor (0, vk::Rect2D(vk::Offset2D(0, 0), vk::Extent2D(width, height)));
+			cmdBuffer.bindDescriptorSets (vk::PipelineBindPoint::eGraphics, pipelineLayout, 0, descriptorSet, {});
+			cmdBuffer.bindPipeline (vk::PipelineBindPoint::eGraphics, particlePipeline);
+			particleFluid.bind(cmdBuffer);
+			cmdBuffer.draw (particleFluid.particleCount, 1, 0, 0);
+			drawTextOverlay(cmdBuffer, index, renderPass);
+			cmdBuffer.endRenderPass ();
+		}
+
+		VK_CHECK_RESULT(cmdBuffer.end());
+	}
+
+	// N-body:
+	//	step (reads the bodies of the previous frame, writes the other buffer) -> draw the written buffer
+	// Steps are recorded in submission order, so the command buffer is recorded again each frame
+	void buildNBodyCommandBuffer(uint32_t index)
+	{
+		vk::CommandBuffer cmdBuffer = drawCmdBuffers[index];
+
+		vk::ClearValue clearValues[2];
+		clearValues[0].color = std::array<float, 4>{ { 0.0f, 0.0f, 0.0f, 1.0f } };
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		vk::RenderPassBeginInfo renderPassBeginInfo;
+		renderPassBeginInfo.setRenderPass (renderPass)
+			.setFramebuffer (frameBuffers[index])
+			.setRenderArea (vk::Rect2D(vk::Offset2D(0, 0), vk::Extent2D(width, height)))
+			.setClearValueCount (2)
+			.setPClearValues (clearValues);
+
+		VK_CHECK_RESULT(cmdBuffer.begin (vk::CommandBufferBeginInfo()));
+		gpuProfiler.beginFrame(cmdBuffer, index);
+
+		{
+			vks::GpuProfiler::Scope scope(gpuProfiler, cmdBuffer, "nbody step");
+			nbody.buildStep(cmdBuffer);
+		}
+
+		{
+			vks::GpuProfiler::Scope scope(gpuProfiler, cmdBuffer, "particles");
+			cmdBuffer.beginRenderPass (renderPassBeginInfo, vk::SubpassContents::eInline);
+			vk::Viewport viewport(0.0f, 0.0f, (float)width, (float)height, 0.0f, 1.0f);
+			cmdBuffer.setViewport (0, viewport);
+			cmdBuffer.setScissor (0, vk::Rect2D(vk::Offset2D(0, 0), vk::Extent2D(width, height)));
+			cmdBuffer.bindDescriptorSets (vk::PipelineBindPoint::eGraphics, pipelineLayout, 0, descriptorSet, {});
+			cmdBuffer.bindPipeline (vk::PipelineBindPoint::eGraphics, nbodyPipeline);
+			nbody.bind(cmdBuffer);
+			cmdBuffer.draw (nbody.bodyCount, 1, 0, 0);
+			drawTextOverlay(cmdBuffer, index, renderPass);
+			cmdBuffer.endRenderPass ();
+		}
+
+		VK_CHECK_RESULT(cmdBuffer.end());
+	}
+
+	// Four emitters of different colors orbiting the scene center
+	// The combined rate turns the pool over about once per lifetime, so it stays close to full
+	void prepareEmitters()
+	{
+		const float lifetime = 0.5f;
+		const std::array<glm::vec4, 4> colors = { {
+			glm::vec4(1.0f, 0.4f, 0.1f, 1.0f), glm::vec4(0.2f, 0.6f, 1.0f, 1.0f),
+			glm::vec4(0.4f, 1.0f, 0.3f, 1.0f), glm::vec4(1.0f, 0.3f, 0.8f, 1.0f) } };
+		for (auto& color : colors)
+		{
+			vks::ParticleEmitters::Emitter emitter;
+			emitter.color = color;
+			emitter.lifetime = lifetime;
+			emitter.spread = 1.0f;
+			emitter.rate = (float)options.particleCount / (lifetime * colors.size());
+			particleEmitters.emitters.push_back(emitter);
+		}
+		// At most twice the average spawn count of a 60 fps frame, a frame time spike does not burst the pool
+		const uint32_t maxEmitPerFrame = static_cast<uint32_t>(particleEmitters.emissionRate() / 30.0f);
+		particleEmitters.prepare(vulkanDevice, queue, pipelineCache, options.particleCount, std::max(maxEmitPerFrame, 1u),
+			uniformBufferVS.descriptor, static_cast<uint32_t>(drawCmdBuffers.size()));
+		std::cout << "Emitted particles: pool of " << particleEmitters.maxParticles << ", " << particleEmitters.emissionRate() << " particles/sec" << std::endl;
+	}
+
+	void updateEmitters(uint32_t region)
+	{
+		const float dt = std::min(frameTimer, 0.1f);
+		const float angle = timer * 2.0f * glm::pi<float>();
+		for (size_t i = 0; i < particleEmitters.emitters.size(); i++)
+		{
+			const float emitterAngle = angle + (float)i * glm::half_pi<float>();
+			particleEmitters.emitters[i].position = glm::vec3(cos(emitterAngle), 0.0f, sin(emitterAngle)) * 0.5f;
+		}
+		particleEmitters.updateFrame(region, dt);
+	}
+
+	// Occlusion culled scene:
+	//	cull (last frame's pyramid) -> early pass -> build pyramid -> cull (current pyramid) -> late pass -> build pyramid for the next frame
+	void buildOcclusionCullingCommandBuffer(uint32_t index)
+	{
+		vk::CommandBuffer cmdBuffer = drawCmdBuffers[index];
+
+		vk::ClearValue clearValues[2];
+		clearValues[0].color = std::array<float, 4>{ { 0.0f, 0.0f, 0.2f, 1.0f } };
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		// The base class frame buffers are compatible with both render passes (same attachment formats)
+		vk::RenderPassBeginInfo renderPassBeginInfo;
+		renderPassBeginInfo.setFramebuffer	(frameBuffers[index])
+			.setRenderArea					(vk::Rect2D(vk::Offset2D (0, 0), vk::Extent2D (width,height)))
+			.setClearValueCount				(2)
+			.setPClearValues				(clearValues);
+
+		vk::Viewport viewport {0, 0, (float)width, (float)height};
+		viewport.setMaxDepth (1.0f)
+				.setMinDepth (0.0f);
+		vk::Rect2D scissor{ { 0,0 },{ width, height } };
+
+		vk::CommandBufferBeginInfo cmdBufInfo;
+		VK_CHECK_RESULT(cmdBuffer.begin (cmdBufInfo));
+		gpuProfiler.beginFrame(cmdBuffer, index);
+
+		for (uint32_t phase = 0; phase < 2; phase++)
+		{
+			// Culling, pass and pyramid build of the phase
+			vks::GpuProfiler::Scope scope(gpuProfiler, cmdBuffer, (phase == 0) ? "early phase" : "late phase");
+			hiZCulling.buildCullCommandBuffer(cmdBuffer, index, phase);
+
+			renderPassBeginInfo.setRenderPass ((phase == 0) ? hiZCulling.earlyRenderPass : hiZCulling.lateRenderPass);
+			cmdBuffer.beginRenderPass (renderPassBeginInfo, vk::SubpassContents::eInline);
+			cmdBuffer.setViewport (0, { viewport });
+			cmdBuffer.setScissor (0, { scissor });
+			cmdBuffer.bindDescriptorSets (vk::PipelineBindPoint::eGraphics, pipelineLayout, 0, descriptorSet, {});
+			cmdBuffer.bindPipeline (vk::PipelineBindPoint::eGraphics, instancingPipeline);
+			cmdBuffer.bindVertexBuffers (1, vk::Buffer(instanceBuffer.buffer.buffer), { instanceBuffer.regionOffset(index) });
+			meshArena.bind(cmdBuffer, 0);
+			hiZCulling.draws(phase).draw(cmdBuffer, index);
+			if (phase == 1)
+			{
+				drawTextOverlay(cmdBuffer, index, hiZCulling.lateRenderPass);
+			}
+			cmdBuffer.endRenderPass ();
+
+			// Phase 1 tests against the early pass depth, the next frame's phase 0 against the final depth
+			hiZCulling.buildPyramidCommandBuffer(cmdBuffer, phase == 0);
+		}
+
+		VK_CHECK_RESULT(cmdBuffer.end());
+	}
+
+	// Record the draw of the triangle mesh (descriptor set 0 must be bound)
+	void drawTriangle(vk::CommandBuffer cmdBuffer)
+	{
+		// Bind the rendering pipeline
+		// The pipeline (state object) contains all states of the rendering pipeline, binding it will set all the states specified at pipeline creation time
+		cmdBuffer.bindPipeline (vk::PipelineBindPoint::eGraphics, pipeline);
+
+		cmdBuffer.bindVertexBuffers (0, vertices.buffer, {0});	// Bind triangle vertex buffer (contains position and colors)
+		cmdBuffer.bindIndexBuffer (indices.buffer, 0, vk::IndexType::eUint32); // Bind triangle index buffer
+		cmdBuffer.drawIndexed (indices.count, 1, 0, 0, 0);					   // Draw indexed triangle
+	}
+
+	// Record the scene draw(s) for the selected draw mode
+	void drawScene(vk::CommandBuffer cmdBuffer, uint32_t frameIndex)
+	{
+		if (options.drawMode == DrawMode::Single)
+		{
+			drawTriangle(cmdBuffer);
+			return;
+		}
+
+		if (options.drawMode == DrawMode::HostParticles)
+		{
+			// Vertices of this frame's region, written by the host simulator
+			cmdBuffer.bindPipeline (vk::PipelineBindPoint::eGraphics, hostParticlePipeline);
+			cmdBuffer.bindVertexBuffers (0, vk::Buffer(particleVertices.buffer.buffer), particleVertices.regionOffset(frameIndex));
+			cmdBuffer.draw (particleSimulator.count, 1, 0, 0);
+			return;
+		}
+
+		cmdBuffer.bindPipeline (vk::PipelineBindPoint::eGraphics, (options.drawMode == DrawMode::HostTransforms) ? mvpPipeline : instancingPipeline);
+
+		// Binding 0 : Mesh vertices, binding 1 : Instance data of this frame's region
+		cmdBuffer.bindVertexBuffers (0, { vertices.buffer, vk::Buffer(instanceBuffer.buffer.buffer) }, { 0, instanceBuffer.regionOffset(frameIndex) });
+		cmdBuffer.bindIndexBuffer (indices.buffer, 0, vk::IndexType::eUint32);
+
+		if (options.drawMode == DrawMode::Indirect)
+		{
+			// Binding 0 : Shared vertices of all meshes
+			meshArena.bind(cmdBuffer, 0);
+			// The whole scene in one indirect draw, records are read from this frame's region
+			indirectDraws.draw(cmdBuffer, frameIndex);
+		}
+		else if (options.drawMode == DrawMode::HostTransforms)
+		{
+			// Instance count is the number of visible objects written by the host this frame
+			transformDraw.draw(cmdBuffer, frameIndex);
+		}
+		else if (options.drawMode == DrawMode::Instanced)
+		{
+			// All instances in one draw
+			cmdBuffer.drawIndexed (indices.count, instanceBuffer.count, 0, 0, 0);
+		}
+		else
+		{
+			// One draw per object, firstInstance selects the instance attributes
+			for (uint32_t instance = 0; instance < instanceBuffer.count; instance++)
+			{
+				cmdBuffer.drawIndexed (indices.count, 1, 0, 0, instance);
+			}
+		}
+	}
+
+	// Renders the instanced scene with one draw per object, with a single instanced draw and with indirect draw records
+	// and reports draw calls and instances per second for all paths
+	void benchmarkInstancing()
+	{
+		std::vector<DrawMode> modes = { DrawMode::PerObject, DrawMode::Instanced };
+		if (vulkanDevice->enabledFeatures.drawIndirectFirstInstance)
+		{
+			modes.push_back(DrawMode::Indirect);
+		}
+		const char* modeNames[] = { "Single draw", "Per-object draws", "Instanced draw", "Indirect draws", "Host transforms" };
+		for (DrawMode mode : modes)
+		{
+			options.drawMode = mode;
+			vkDeviceWaitIdle(device);
+
+			auto tRecordStart = std::chrono::high_resolution_clock::now();
+			buildCommandBuffers();
+			auto tRecordEnd = std::chrono::high_resolution_clock::now();
+			double recordMs = std::chrono::duration<double, std::milli>(tRecordEnd - tRecordStart).count() / drawCmdBuffers.size();
+
+			// Warm up
+			for (uint32_t i = 0; i < 10; i++)
+			{
+				draw();
+			}
+			vkDeviceWaitIdle(device);
+
+			auto tStart = std::chrono::high_resolution_clock::now();
+			for (uint32_t i = 0; i < options.benchmarkFrames; i++)
+			{
+				draw();
+			}
+			vkDeviceWaitIdle(device);
+			auto tEnd = std::chrono::high_resolution_clock::now();
+			double seconds = std::chrono::duration<double>(tEnd - tStart).count();
+
+			// Indirect draws count every draw record, even though they are submitted with a single command
+			const uint32_t drawsPerFrame = ((mode == DrawMode::PerObject) || (mode == DrawMode::Indirect)) ? instanceBuffer.count : 1;
+			std::cout << modeNames[static_cast<uint32_t>(mode)] << " (" << instanceBuffer.count << " instances)" << std::endl;
+			std::cout << " Frames/sec    : " << options.benchmarkFrames / seconds << std::endl;
+			std::cout << " Draws/sec     : " << (double)drawsPerFrame * options.benchmarkFrames / seconds << std::endl;
+			std::cout << " Instances/sec : " << (double)instanceBuffer.count * options.benchmarkFrames / seconds << std::endl;
+			std::cout << " Recording     : " << recordMs << " ms per command buffer" << std::endl;
+		}
+	}
+
+	// Draws the compute particles with each render mode while the simulation keeps running on the compute queue
+	// All modes read position and velocity (28 bytes) per particle straight from the simulation buffer, they differ in the
+	// vertex shader invocations per particle and the rasterized area (points cover one pixel, quads particleQuads.size)
+	void benchmarkParticleRender()
+	{
+		const vks::ParticleRenderMode defaultMode = options.particleRender;
+		const uint32_t count = particleSystem.particleCount;
+		for (vks::ParticleRenderMode mode : { vks::ParticleRenderMode::Points, vks::ParticleRenderMode::Instanced, vks::ParticleRenderMode::VertexPulling })
+		{
+			options.particleRender = mode;
+			vkDeviceWaitIdle(device);
+
+			// Warm up
+			for (uint32_t i = 0; i < 10; i++)
+			{
+				draw();
+			}
+			vkDeviceWaitIdle(device);
+
+			auto tStart = std::chrono::high_resolution_clock::now();
+			for (uint32_t i = 0; i < options.benchmarkFrames; i++)
+			{
+				draw();
+			}
+			vkDeviceWaitIdle(device);
+			auto tEnd = std::chrono::high_resolution_clock::now();
+			double seconds = std::chrono::duration<double>(tEnd - tStart).count();
+
+			const uint32_t vertices = vks::ParticleQuads::verticesPerParticle(mode);
+			std::cout << "Particles as " << vks::particleRenderModeName(mode) << " (" << count << " particles, " << vertices << " vertices each)" << std::endl;
+			std::cout << " Frames/sec    : " << options.benchmarkFrames / seconds << std::endl;
+			std::cout << " Frame time    : " << seconds * 1000.0 / options.benchmarkFrames << " ms (simulation " << particleSystem.averageStepTimeMs << " ms/step)" << std::endl;
+			std::cout << " Particles/sec : " << (double)count * options.benchmarkFrames / seconds << std::endl;
+			std::cout << " Vertices/sec  : " << (double)count * vertices * options.benchmarkFrames / seconds << std::endl;
+		}
+		options.particleRender = defaultMode;
+	}
+
+	// Draws a fixed particle state over the triangle at full resolution (ratio 1) and through the low resolution pass (ratios 2 and 4)
+	// into an offscreen target and reports the GPU time of each pass and the error of the composited image against ratio 1
+	// The particle pass shades 1 / (ratio * ratio) of the fragments, the composite adds a constant full screen pass
+	void benchmarkLowResParticles()
+	{
+		const uint32_t count = options.particleCount;
+		const uint32_t frames = std::max(options.benchmarkFrames, 1u);
+		const uint32_t validBits = vulkanDevice->queueFamilyProperties[vulkanDevice->queueFamilyIndices.graphics].timestampValidBits;
+		const bool timestamps = (validBits > 0) && (vulkanDevice->properties.limits.timestampPeriod > 0.0f);
+		const uint64_t timestampMask = (validBits >= 64) ? ~0ull : ((1ull << validBits) - 1);
+		vk::QueryPool queryPool;
+		if (timestamps)
+		{
+			queryPool = CHECK(vulkanDevice->D().createQueryPool (vk::QueryPoolCreateInfo().setQueryType (vk::QueryType::eTimestamp).setQueryCount (4)));
+		}
+
+		// Two seconds of the fountain, stepped with the host reference
+		const vks::ParticleParams params;
+		std::vector<vks::Particle> particles(count);
+		jobSystem->parallelFor(0, count, 4096, [&](uint32_t first, uint32_t last)
+		{
+			for (uint32_t i = first; i < last; i++)
+			{
+				vks::Particle particle = vks::particles::initial(i, params);
+				for (uint32_t step = 0; step < 120; step++)
+				{
+					particle = vks::particles::step(i, particle, params);
+				}
+				particles[i] = particle;
+			}
+		});
+		vks::Buffer particleBuffer;
+		VK_CHECK_RESULT(vulkanDevice->createDeviceLocalBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &particleBuffer, particles.size() * sizeof(vks::Particle), particles.data(), queue));
+		vks::ParticleQuads quads;
+		quads.prepare(vulkanDevice, queue, uniformBufferVS.descriptor, { vk::Buffer(particleBuffer.buffer) });
+
+		// Offscreen color target (copied to the host) and depth attachment of the frame size
+		struct
+		{
+			VkImage image;
+			VkDeviceMemory memory;
+			VkImageView view;
+		} targets[2];
+		const VkFormat formats[2] = { swapChain.colorFormat, depthFormat };
+		const VkImageUsageFlags usages[2] = { VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT };
+		const VkImageAspectFlags aspects[2] = { VK_IMAGE_ASPECT_COLOR_BIT, vks::ParticleOffscreen::depthAttachmentAspects(depthFormat) };
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			VkImageCreateInfo imageInfo = vks::initializers::imageCreateInfo();
+			imageInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageInfo.format = formats[i];
+			imageInfo.extent = { width, height, 1 };
+			imageInfo.mipLevels = 1;
+			imageInfo.arrayLayers = 1;
+			imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageInfo.usage = usages[i];
+			VK_CHECK_RESULT(vulkanDevice->createImage(&imageInfo, &targets[i].image, (i == 0) ? "benchmark color" : "benchmark depth"));
+			VkMemoryRequirements memReqs;
+			vkGetImageMemoryRequirements(device, targets[i].image, &memReqs);
+			VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+			memAlloc.allocationSize = memReqs.size;
+			memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal);
+			VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &targets[i].memory));
+			VK_CHECK_RESULT(vkBindImageMemory(device, targets[i].image, targets[i].memory, 0));
+			VkImageViewCreateInfo viewInfo = vks::initializers::imageViewCreateInfo();
+			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewInfo.format = formats[i];
+			viewInfo.subresourceRange = { aspects[i], 0, 1, 0, 1 };
+			viewInfo.image = targets[i].image;
+			VK_CHECK_RESULT(vkCreateImageView(device, &viewInfo, nullptr, &targets[i].view));
+		}
+
+		// The swap chain formats are 8 bit per channel with four channels
+		const uint32_t pixelCount = width * height;
+		vks::Buffer readback;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+			&readback, (VkDeviceSize)pixelCount * 4));
+		VK_CHECK_RESULT(readback.map());
+		std::vector<uint8_t> reference;
+
+		std::cout << "Particle resolution (" << count << " particles, " << width << "x" << height << ", " << frames << " frames, "
+			<< (timestamps ? "GPU timestamps" : "wall time") << ")" << std::endl;
+		double fullResolutionMs = 0.0;
+		for (uint32_t ratio : { 1u, 2u, 4u })
+		{
+			vks::ParticleOffscreen offscreen;
+			offscreen.prepare(vulkanDevice, pipelineCache, quads, swapChain.colorFormat, vk::ImageLayout::eTransferSrcOptimal,
+				depthFormat, targets[1].image, targets[1].view, { targets[0].view }, width, height, ratio);
+
+			vk::CommandBuffer cmdBuffer = vulkanDevice->createCommandBuffer(vk::CommandBufferLevel::ePrimary, true);
+			if (timestamps)
+			{
+				cmdBuffer.resetQueryPool (queryPool, 0, 4);
+				cmdBuffer.writeTimestamp (vk::PipelineStageFlagBits::eTopOfPipe, queryPool, 0);
+			}
+			offscreen.beginScenePass(cmdBuffer, 0);
+			cmdBuffer.bindDescriptorSets (vk::PipelineBindPoint::eGraphics, pipelineLayout, 0, descriptorSet, {});
+			drawTriangle(cmdBuffer);
+			cmdBuffer.endRenderPass ();
+			if (timestamps)
+			{
+				cmdBuffer.writeTimestamp (vk::PipelineStageFlagBits::eBottomOfPipe, queryPool, 1);
+			}
+			offscreen.buildParticlePass(cmdBuffer, 0, count);
+			if (timestamps)
+			{
+				cmdBuffer.writeTimestamp (vk::PipelineStageFlagBits::eBottomOfPipe, queryPool, 2);
+			}
+			offscreen.buildCompositePass(cmdBuffer, 0);
+			if (timestamps)
+			{
+				cmdBuffer.writeTimestamp (vk::PipelineStageFlagBits::eBottomOfPipe, queryPool, 3);
+			}
+			vk::BufferImageCopy copyRegion;
+			copyRegion.setImageSubresource (vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1))
+				.setImageExtent (vk::Extent3D(width, height, 1));
+			cmdBuffer.copyImageToBuffer (vk::Image(targets[0].image), vk::ImageLayout::eTransferSrcOptimal, vk::Buffer(readback.buffer), copyRegion);
+			// The first submission is the warm up
+			vulkanDevice->flushCommandBuffer(cmdBuffer, queue, false);
+
+			double passMs[3] = { 0.0, 0.0, 0.0 };
+			auto tStart = std::chrono::high_resolution_clock::now();
+			for (uint32_t i = 0; i < frames; i++)
+			{
+				VK_CHECK_RESULT(queue.submit (vk::SubmitInfo().setCommandBufferCount (1).setPCommandBuffers (&cmdBuffer), vk::Fence()));
+				VK_CHECK_RESULT(queue.waitIdle ());
+				if (timestamps)
+				{
+					uint64_t ticks[4];
+					VK_CHECK_RESULT(vkGetQueryPoolResults(device, queryPool, 0, 4, sizeof(ticks), ticks, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT));
+					for (uint32_t pass = 0; pass < 3; pass++)
+					{
+						passMs[pass] += (double)((ticks[pass + 1] - ticks[pass]) & timestampMask) * vulkanDevice->properties.limits.timestampPeriod / 1000000.0;
+					}
+				}
+			}
+			const double wallMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+			for (uint32_t pass = 0; pass < 3; pass++)
+			{
+				passMs[pass] /= frames;
+			}
+			// Without timestamps only the whole frame can be measured
+			const double particleMs = timestamps ? passMs[1] + passMs[2] : wallMs / frames;
+			if (ratio == 1)
+			{
+				fullResolutionMs = particleMs;
+			}
+
+			std::cout << " Ratio " << ratio << " (" << offscreen.lowWidth << "x" << offscreen.lowHeight << ", "
+				<< 100.0 * offscreen.particlePixels() / pixelCount << "% of the fragments)" << std::endl;
+			if (timestamps)
+			{
+				std::cout << "  Scene          : " << passMs[0] << " ms" << std::endl;
+				std::cout << "  Particle pass  : " << passMs[1] << " ms (depth downsample + particles)" << std::endl;
+				std::cout << "  Composite      : " << passMs[2] << " ms" << std::endl;
+			}
+			std::cout << "  Particle cost  : " << particleMs << " ms, " << fullResolutionMs / particleMs << "x faster than full resolution" << std::endl;
+
+			// Per channel error of the composited image against full resolution
+			const uint8_t *pixels = static_cast<const uint8_t*>(readback.mapped);
+			if (ratio == 1)
+			{
+				reference.assign(pixels, pixels + (size_t)pixelCount * 4);
+			}
+			else
+			{
+				double sumSquared = 0.0;
+				int maxError = 0;
+				uint32_t differing = 0;
+				for (uint32_t i = 0; i < pixelCount; i++)
+				{
+					int pixelError = 0;
+					for (uint32_t c = 0; c < 3; c++)
+					{
+						const int error = std::abs((int)pixels[i * 4 + c] - (int)reference[i * 4 + c]);
+						sumSquared += (double)error * error;
+						pixelError = std::max(pixelError, error);
+					}
+					maxError = std::max(maxError, pixelError);
+					// More than ~3% of the range in any channel
+					differing += (pixelError > 8) ? 1 : 0;
+				}
+				std::cout << "  Error          : RMSE " << std::sqrt(sumSquared / (3.0 * pixelCount)) << ", max. " << maxError << " (of 255), "
+					<< 100.0 * differing / pixelCount << "% of the pixels differ visibly" << std::endl;
+			}
+
+			vulkanDevice->D().freeCommandBuffers (vk::CommandPool(vulkanDevice->commandPool), cmdBuffer);
+			offscreen.destroy();
+		}
+
+		readback.destroy();
+		for (uint32_t i = 0; i < 2; i++)
+		{
+			vkDestroyImageView(device, targets[i].view, nullptr);
+			vkDestroyImage(device, targets[i].image, nullptr);
+			vkFreeMemory(device, targets[i].memory, nullptr);
+		}
+		quads.destroy();
+		particleBuffer.destroy();
+		if (queryPool)
+		{
+			vulkanDevice->D().destroyQueryPool (queryPool);
+		}
+	}
+
+	// Runs the host transform and culling update with every available kernel and reports objects per second (single thread)
+	void benchmarkTransforms()
+	{
+		std::vector<vks::InstanceData> output(sceneTransforms.count);
+		const glm::mat4 viewProjection = uboVS.projectionMatrix * uboVS.viewMatrix * uboVS.modelMatrix;
+		vks::Frustum frustum;
+		frustum.update(viewProjection);
+
+		const vks::simd::InstructionSet defaultSet = sceneTransforms.instructionSet;
+		for (vks::simd::InstructionSet instructionSet : { vks::simd::InstructionSet::Scalar, vks::simd::InstructionSet::SSE, vks::simd::InstructionSet::AVX2 })
+		{
+			if (!vks::SceneTransforms::kernelAvailable(instructionSet))
+			{
+				continue;
+			}
+			sceneTransforms.instructionSet = instructionSet;
+
+			uint32_t visibleCount = 0;
+			for (uint32_t i = 0; i < 10; i++)
+			{
+				visibleCount = sceneTransforms.update(viewProjection, frustum.planes, 0.0f, output.data());
+			}
+
+			auto tStart = std::chrono::high_resolution_clock::now();
+			for (uint32_t i = 0; i < options.benchmarkFrames; i++)
+			{
+				visibleCount = sceneTransforms.update(viewProjection, frustum.planes, (float)i * 0.01f, output.data());
+			}
+			auto tEnd = std::chrono::high_resolution_clock::now();
+			double seconds = std::chrono::duration<double>(tEnd - tStart).count();
+
+			std::cout << "Host transforms " << vks::simd::name(instructionSet) << " (" << sceneTransforms.count << " objects, " << visibleCount << " visible)" << std::endl;
+			std::cout << " Objects/sec   : " << (double)sceneTransforms.count * options.benchmarkFrames / seconds << std::endl;
+			std::cout << " Update        : " << seconds * 1000.0 / options.benchmarkFrames << " ms" << std::endl;
+		}
+		sceneTransforms.instructionSet = defaultSet;
+	}
+
+	// Steps all host particle kernels from the same initial state (single threaded and on all job system threads)
+	// Results have to be bit identical
+	void benchmarkParticles()
+	{
+		std::vector<vks::Particle> referenceParticles;
+
+		for (vks::simd::InstructionSet instructionSet : { vks::simd::InstructionSet::Scalar, vks::simd::InstructionSet::AVX2, vks::simd::InstructionSet::NEON })
+		{
+			if (!vks::ParticleSimulator::kernelAvailable(instructionSet))
+			{
+				continue;
+			}
+			for (vks::JobSystem *jobs : { (vks::JobSystem*)nullptr, jobSystem.get() })
+			{
+				vks::ParticleSimulator simulator;
+				simulator.instructionSet = instructionSet;
+				simulator.reset(options.particleCount, vks::ParticleParams());
+				// Stream into device memory like the render loop does
+				vks::ParticleVertex *output = particleVertices.buffer.buffer ? particleVertices.region(0) : nullptr;
+				std::vector<vks::ParticleVertex> hostOutput;
+				if (!output)
+				{
+					hostOutput.resize(simulator.paddedCount());
+					output = hostOutput.data();
+				}
+
+				auto tStart = std::chrono::high_resolution_clock::now();
+				for (uint32_t i = 0; i < options.benchmarkFrames; i++)
+				{
+					simulator.step(output, jobs);
+				}
+				auto tEnd = std::chrono::high_resolution_clock::now();
+				double seconds = std::chrono::duration<double>(tEnd - tStart).count();
+
+				if (referenceParticles.empty())
+				{
+					referenceParticles.resize(simulator.count);
+					for (uint32_t i = 0; i < simulator.count; i++)
+					{
+						referenceParticles[i] = simulator.get(i);
+					}
+				}
+				const uint32_t mismatches = simulator.compare(referenceParticles);
+
+				std::cout << "Host particles " << vks::simd::name(instructionSet) << ", " << (jobs ? jobs->threadCount() : 1) << " thread(s) (" << simulator.count << " particles)" << std::endl;
+				std::cout << " Particles/sec : " << (double)simulator.count * options.benchmarkFrames / seconds << std::endl;
+				std::cout << " Bandwidth     : " << (double)simulator.count * vks::ParticleSimulator::bytesPerStep() * options.benchmarkFrames / seconds / 1.0e9 << " GB/s" << std::endl;
+				std::cout << " Step          : " << seconds * 1000.0 / options.benchmarkFrames << " ms" << std::endl;
+				std::cout << " Mismatches    : " << mismatches << " (vs. scalar)" << std::endl;
+			}
+		}
+	}
+
+	// Reads back the step submitted with readback enabled and replays the simulation from the start on the host
+	// Sorts the same random keys (with their indices as values) on the device and with std::sort on the host
+	// Device times are measured with timestamps around the sort only, the result is compared with a stable host sort
+	void benchmarkSort()
+	{
+		const uint32_t count = options.sortCount;
+		const uint32_t iterations = 20;
+		vks::RadixSort sort;
+		sort.prepare(vulkanDevice, pipelineCache, count);
+
+		std::vector<uint32_t> keys(count);
+		std::vector<uint32_t> values(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			keys[i] = vks::particles::hash(i);
+			values[i] = i;
+		}
+
+		// Unsorted input, copied to the sort buffers before each iteration
+		vks::Buffer sourceKeys, sourceValues, readback;
+		const VkDeviceSize size = count * sizeof(uint32_t);
+		VK_CHECK_RESULT(vulkanDevice->createDeviceLocalBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, &sourceKeys, size, keys.data(), queue));
+		VK_CHECK_RESULT(vulkanDevice->createDeviceLocalBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, &sourceValues, size, values.data(), queue));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, &readback, 2 * size));
+
+		const uint32_t validBits = vulkanDevice->queueFamilyProperties[vulkanDevice->queueFamilyIndices.graphics].timestampValidBits;
+		const bool timestamps = (validBits > 0) && (vulkanDevice->properties.limits.timestampPeriod > 0.0f);
+		const uint64_t timestampMask = (validBits >= 64) ? ~0ull : ((1ull << validBits) - 1);
+		vk::QueryPool queryPool;
+		if (timestamps)
+		{
+			queryPool = CHECK(vulkanDevice->D().createQueryPool (vk::QueryPoolCreateInfo().setQueryType (vk::QueryType::eTimestamp).setQueryCount (2)));
+		}
+
+		vk::CommandBuffer cmdBuffer = vulkanDevice->createCommandBuffer(vk::CommandBufferLevel::ePrimary, true);
+		cmdBuffer.copyBuffer (vk::Buffer(sourceKeys.buffer), vk::Buffer(sort.keys[0].buffer), vk::BufferCopy(0, 0, size));
+		cmdBuffer.copyBuffer (vk::Buffer(sourceValues.buffer), vk::Buffer(sort.values[0].buffer), vk::BufferCopy(0, 0, size));
+		if (timestamps)
+		{
+			cmdBuffer.resetQueryPool (queryPool, 0, 2);
+			cmdBuffer.writeTimestamp (vk::PipelineStageFlagBits::eTopOfPipe, queryPool, 0);
+		}
+		sort.buildCommandBuffer(cmdBuffer, count);
+		if (timestamps)
+		{
+			cmdBuffer.writeTimestamp (vk::PipelineStageFlagBits::eBottomOfPipe, queryPool, 1);
+		}
+		vk::MemoryBarrier copyBarrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eTransferRead);
+		cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags(), copyBarrier, nullptr, nullptr);
+		cmdBuffer.copyBuffer (vk::Buffer(sort.keys[0].buffer), vk::Buffer(readback.buffer), vk::BufferCopy(0, 0, size));
+		cmdBuffer.copyBuffer (vk::Buffer(sort.values[0].buffer), vk::Buffer(readback.buffer), vk::BufferCopy(0, size, size));
+		vk::MemoryBarrier hostBarrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eHostRead);
+		cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost, vk::DependencyFlags(), hostBarrier, nullptr, nullptr);
+		// The first run is the warm up
+		vulkanDevice->flushCommandBuffer(cmdBuffer, queue, false);
+
+		double gpuMs = 0.0;
+		auto tStart = std::chrono::high_resolution_clock::now();
+		for (uint32_t i = 0; i < iterations; i++)
+		{
+			VK_CHECK_RESULT(queue.submit (vk::SubmitInfo().setCommandBufferCount (1).setPCommandBuffers (&cmdBuffer), vk::Fence()));
+			VK_CHECK_RESULT(queue.waitIdle ());
+			if (timestamps)
+			{
+				uint64_t ticks[2];
+				VK_CHECK_RESULT(vkGetQueryPoolResults(device, queryPool, 0, 2, sizeof(ticks), ticks, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT));
+				gpuMs += (double)((ticks[1] - ticks[0]) & timestampMask) * vulkanDevice->properties.limits.timestampPeriod / 1000000.0;
+			}
+		}
+		// Without timestamps the wall time also contains the input copies and readback
+		double wallMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+		const double deviceMs = (timestamps ? gpuMs : wallMs) / iterations;
+
+		// Host reference, pairs sorted by key (stable, as the radix sort)
+		std::vector<std::pair<uint32_t, uint32_t>> pairs(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			pairs[i] = std::make_pair(keys[i], values[i]);
+		}
+		std::vector<std::pair<uint32_t, uint32_t>> sorted = pairs;
+		auto tHostStart = std::chrono::high_resolution_clock::now();
+		std::sort(sorted.begin(), sorted.end(), [](const std::pair<uint32_t, uint32_t> &a, const std::pair<uint32_t, uint32_t> &b) { return a.first < b.first; });
+		const double hostMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tHostStart).count();
+		std::stable_sort(pairs.begin(), pairs.end(), [](const std::pair<uint32_t, uint32_t> &a, const std::pair<uint32_t, uint32_t> &b) { return a.first < b.first; });
+
+		VK_CHECK_RESULT(readback.map());
+		const uint32_t *deviceKeys = static_cast<const uint32_t*>(readback.mapped);
+		const uint32_t *deviceValues = deviceKeys + count;
+		uint32_t mismatches = 0;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			if ((deviceKeys[i] != pairs[i].first) || (deviceValues[i] != pairs[i].second))
+			{
+				mismatches++;
+			}
+		}
+		readback.unmap();
+
+		std::cout << "Radix sort (" << count << " keys, " << (timestamps ? "GPU timestamps" : "wall time") << ")" << std::endl;
+		std::cout << " Keys/sec      : " << (double)count / (deviceMs / 1000.0) << std::endl;
+		std::cout << " Sort          : " << deviceMs << " ms" << std::endl;
+		std::cout << " Mismatches    : " << mismatches << " (compared with std::stable_sort)" << std::endl;
+		std::cout << "std::sort (" << count << " key/value pairs, single thread)" << std::endl;
+		std::cout << " Keys/sec      : " << (double)count / (hostMs / 1000.0) << std::endl;
+		std::cout << " Sort          : " << hostMs << " ms" << std::endl;
+
+		vulkanDevice->D().freeCommandBuffers (vk::CommandPool(vulkanDevice->commandPool), cmdBuffer);
+		if (queryPool)
+		{
+			vulkanDevice->D().destroyQueryPool (queryPool);
+		}
+		sourceKeys.destroy();
+		sourceValues.destroy();
+		readback.destroy();
+		sort.destroy();
+	}
+
+	// Dam break scene with the same particle count and substeps for each workgroup size, each size starts from the initial state
+	void benchmarkFluid()
+	{
+		const uint32_t frames = std::max(options.benchmarkFrames, 1u);
+		const uint32_t validBits = vulkanDevice->queueFamilyProperties[vulkanDevice->queueFamilyIndices.graphics].timestampValidBits;
+		const bool timestamps = (validBits > 0) && (vulkanDevice->properties.limits.timestampPeriod > 0.0f);
+		const uint64_t timestampMask = (validBits >= 64) ? ~0ull : ((1ull << validBits) - 1);
+		vk::QueryPool queryPool;
+		if (timestamps)
+		{
+			queryPool = CHECK(vulkanDevice->D().createQueryPool (vk::QueryPoolCreateInfo().setQueryType (vk::QueryType::eTimestamp).setQueryCount (2)));
+		}
+
+		std::cout << "SPH fluid (" << options.fluidCount << " particles, " << frames << " frames, " << (timestamps ? "GPU timestamps" : "wall time") << ")" << std::endl;
+		for (uint32_t workgroupSize : { 64u, 128u, 256u, 512u })
+		{
+			if (workgroupSize > std::min(vulkanDevice->properties.limits.maxComputeWorkGroupSize[0], vulkanDevice->properties.limits.maxComputeWorkGroupInvocations))
+			{
+				continue;
+			}
+			vks::ParticleFluid fluid;
+			fluid.prepare(vulkanDevice, queue, pipelineCache, options.fluidCount, vks::FluidParams(), options.fluidSubsteps, workgroupSize);
+
+			vk::CommandBuffer cmdBuffer = vulkanDevice->createCommandBuffer(vk::CommandBufferLevel::ePrimary, true);
+			if (timestamps)
+			{
+				cmdBuffer.resetQueryPool (queryPool, 0, 2);
+				cmdBuffer.writeTimestamp (vk::PipelineStageFlagBits::eTopOfPipe, queryPool, 0);
+			}
+			fluid.buildCommandBuffer(cmdBuffer);
+			if (timestamps)
+			{
+				cmdBuffer.writeTimestamp (vk::PipelineStageFlagBits::eBottomOfPipe, queryPool, 1);
+			}
+			// The first frame is the warm up
+			vulkanDevice->flushCommandBuffer(cmdBuffer, queue, false);
+
+			double gpuMs = 0.0;
+			auto tStart = std::chrono::high_resolution_clock::now();
+			for (uint32_t i = 0; i < frames; i++)
+			{
+				VK_CHECK_RESULT(queue.submit (vk::SubmitInfo().setCommandBufferCount (1).setPCommandBuffers (&cmdBuffer), vk::Fence()));
+				VK_CHECK_RESULT(queue.waitIdle ());
+				if (timestamps)
+				{
+					uint64_t ticks[2];
+					VK_CHECK_RESULT(vkGetQueryPoolResults(device, queryPool, 0, 2, sizeof(ticks), ticks, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT));
+					gpuMs += (double)((ticks[1] - ticks[0]) & timestampMask) * vulkanDevice->properties.limits.timestampPeriod / 1000000.0;
+				}
+			}
+			const double wallMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+			const double frameMs = (timestamps ? gpuMs : wallMs) / frames;
+
+			std::cout << " Workgroup size " << fluid.workgroupSize << " : " << frameMs << " ms/frame (" << fluid.substeps << " substeps), "
+				<< (double)fluid.particleCount * fluid.substeps / (frameMs / 1000.0) << " particles x steps/sec" << std::endl;
+
+			vulkanDevice->D().freeCommandBuffers (vk::CommandPool(vulkanDevice->commandPool), cmdBuffer);
+			fluid.destroy();
+		}
+		if (queryPool)
+		{
+			vulkanDevice->D().destroyQueryPool (queryPool);
+		}
+	}
+
+	// Direct (tiled) and hierarchical steps from the same disc, the first step of each is compared with the tiled host reference
+	// Interactions are body pairs, the hierarchical rate is the all pairs equivalent (N^2 / step time)
+	void benchmarkNBody()
+	{
+		const uint32_t count = options.nbodyCount;
+		const uint32_t frames = std::max(options.benchmarkFrames, 1u);
+		const uint32_t validBits = vulkanDevice->queueFamilyProperties[vulkanDevice->queueFamilyIndices.graphics].timestampValidBits;
+		const bool timestamps = (validBits > 0) && (vulkanDevice->properties.limits.timestampPeriod > 0.0f);
+		const uint64_t timestampMask = (validBits >= 64) ? ~0ull : ((1ull << validBits) - 1);
+		vk::QueryPool queryPool;
+		if (timestamps)
+		{
+			queryPool = CHECK(vulkanDevice->D().createQueryPool (vk::QueryPoolCreateInfo().setQueryType (vk::QueryType::eTimestamp).setQueryCount (2)));
+		}
+
+		std::vector<vks::Particle> bodies(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			bodies[i] = vks::nbody::disc(i, count);
+		}
+		const vks::NBodyParams params;
+		const double pairs = (double)count * count;
+
+		// Host reference with the device's default tile size
+		std::vector<vks::Particle> reference(count);
+		auto tStart = std::chrono::high_resolution_clock::now();
+		jobSystem->parallelFor(0, count, 256, [&](uint32_t first, uint32_t last)
+		{
+			vks::nbody::step(bodies, reference, params, vks::ParticleNBody::defaultTileSize, first, last);
+		});
+		const double hostMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+		std::cout << "N-body (" << count << " bodies, " << frames << " steps, " << (timestamps ? "GPU timestamps" : "wall time") << ")" << std::endl;
+		std::cout << " Host tiled reference (" << jobSystem->threadCount() << " threads) : " << hostMs << " ms/step, " << pairs / (hostMs / 1000.0) << " interactions/sec" << std::endl;
+
+		vks::Buffer readback;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+			&readback, (VkDeviceSize)count * sizeof(vks::Particle)));
+		VK_CHECK_RESULT(readback.map());
+
+		for (bool hierarchical : { false, true })
+		{
+			vks::ParticleNBody simulation;
+			simulation.prepare(vulkanDevice, queue, pipelineCache, bodies, params, hierarchical);
+
+			// First step from the initial state, read back for the comparison
+			vk::CommandBuffer cmdBuffer = vulkanDevice->createCommandBuffer(vk::CommandBufferLevel::ePrimary, true);
+			simulation.buildStep(cmdBuffer);
+			vk::BufferMemoryBarrier transferBarrier = vks::initializers::bufferBarrier(simulation.buffers[simulation.current].buffer, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eTransferRead);
+			cmdBuffer.pipelineBarrier (vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags(), nullptr, transferBarrier, nullptr);
+			cmdBuffer.copyBuffer (vk::Buffer(simulation.buffers[simulation.current].buffer), vk::Buffer(readback.buffer), vk::BufferCopy(0, 0, readback.size));
+			vulkanDevice->flushCommandBuffer(cmdBuffer, queue);
+
+			// Velocity change relative to the reference's
+			const vks::Particle *deviceBodies = static_cast<const vks::Particle*>(readback.mapped);
+			double maxError = 0.0;
+			double sumError = 0.0;
+			for (uint32_t i = 0; i < count; i++)
+			{
+				const glm::vec3 referenceDelta = reference[i].velocity - bodies[i].velocity;
+				const glm::vec3 deviceDelta = deviceBodies[i].velocity - bodies[i].velocity;
+				const double error = glm::length(deviceDelta - referenceDelta) / std::max(glm::length(referenceDelta), 1e-12f);
+				maxError = std::max(maxError, error);
+				sumError += error;
+			}
+
+			// Two steps per submission, so every submission reads and writes the same buffers
+			cmdBuffer = vulkanDevice->createCommandBuffer(vk::CommandBufferLevel::ePrimary, true);
+			if (timestamps)
+			{
+				cmdBuffer.resetQueryPool (queryPool, 0, 2);
+				cmdBuffer.writeTimestamp (vk::PipelineStageFlagBits::eTopOfPipe, queryPool, 0);
+			}
+			simulation.buildStep(cmdBuffer);
+			simulation.buildStep(cmdBuffer);
+			if (timestamps)
+			{
+				cmdBuffer.writeTimestamp (vk::PipelineStageFlagBits::eBottomOfPipe, queryPool, 1);
+			}
+			// The first submission is the warm up
+			vulkanDevice->flushCommandBuffer(cmdBuffer, queue, false);
+
+			const uint32_t submissions = std::max(frames / 2, 1u);
+			double gpuMs = 0.0;
+			tStart = std::chrono::high_resolution_clock::now();
+			for (uint32_t i = 0; i < submissions; i++)
+			{
+				VK_CHECK_RESULT(queue.submit (vk::SubmitInfo().setCommandBufferCount (1).setPCommandBuffers (&cmdBuffer), vk::Fence()));
+				VK_CHECK_RESULT(queue.waitIdle ());
+				if (timestamps)
+				{
+					uint64_t ticks[2];
+					VK_CHECK_RESULT(vkGetQueryPoolResults(device, queryPool, 0, 2, sizeof(ticks), ticks, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT));
+					gpuMs += (double)((ticks[1] - ticks[0]) & timestampMask) * vulkanDevice->properties.limits.timestampPeriod / 1000000.0;
+				}
+			}
+			const double wallMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+			const double stepMs = (timestamps ? gpuMs : wallMs) / (2.0 * submissions);
+
+			if (hierarchical)
+			{
+				std::cout << " Hierarchical (" << simulation.params.levels << " octree levels) : ";
+			}
+			else
+			{
+				std::cout << " Direct (tile size " << simulation.tileSize << ") : ";
+			}
+			std::cout << stepMs << " ms/step, " << pairs / (stepMs / 1000.0) << (hierarchical ? " equivalent" : "") << " interactions/sec, "
+				<< "velocity change error vs. host max. " << maxError << " mean " << sumError / count << std::endl;
+
+			vulkanDevice->D().freeCommandBuffers (vk::CommandPool(vulkanDevice->commandPool), cmdBuffer);
+			simulation.destroy();
+		}
+		readback.destroy();
+		if (queryPool)
+		{
+			vulkanDevice->D().destroyQueryPool (queryPool);
+		}
+	}
+
+	// Replays the validated step on the host from the device's source state, so the cost doesn't grow with the run length
+	void validateParticles()
+	{
+		std::vector<vks::Particle> sourceParticles;
+		std::vector<vks::Particle> deviceParticles = particleSystem.readbackStep(&sourceParticles);
+		if (particleSystem.collisions)
+		{
+			validateParticleCollisions(sourceParticles, deviceParticles);
+			return;
+		}
+		vks::ParticleSimulator reference;
+		reference.reset(particleSystem.particleCount, particleSystem.params);
+		for (uint32_t i = 0; i < std::min(reference.count, static_cast<uint32_t>(sourceParticles.size())); i++)
+		{
+			reference.set(i, sourceParticles[i]);
+		}
+		reference.step(nullptr, jobSystem.get());
+		float maxError = 0.0f;
+		const uint32_t mismatches = reference.compare(deviceParticles, &maxError);
+		std::cout << "Particle validation of step " << particleSystem.stepCount << ": " << mismatches << " of " << particleSystem.particleCount
+			<< " particles differ from the host simulation (max. position error " << maxError << ")" << std::endl;
+	}
+
+	// The collision reference is the scalar integration and the grid reference applied to the step's source state
+	// Contact distances are square roots that may round differently on the device, so results are compared with a tolerance
+	void validateParticleCollisions(const std::vector<vks::Particle> &sourceParticles, const std::vector<vks::Particle> &deviceParticles)
+	{
+		const uint32_t count = std::min(particleSystem.particleCount, static_cast<uint32_t>(sourceParticles.size()));
+		std::vector<vks::Particle> reference(count);
+		jobSystem->parallelFor(0, count, 4096, [&](uint32_t first, uint32_t last)
+		{
+			for (uint32_t i = first; i < last; i++)
+			{
+				reference[i] = vks::particles::step(i, sourceParticles[i], particleSystem.params);
+			}
+		});
+		vks::grid::collide(reference, particleSystem.grid.params);
+		const float tolerance = 1e-3f;
+		uint32_t mismatches = 0;
+		float maxError = 0.0f;
+		for (uint32_t i = 0; i < std::min(count, static_cast<uint32_t>(deviceParticles.size())); i++)
+		{
+			const float error = std::max(glm::length(glm::vec3(deviceParticles[i].position) - glm::vec3(reference[i].position)),
+				glm::length(deviceParticles[i].velocity - reference[i].velocity));
+			maxError = std::max(maxError, error);
+			if ((error > tolerance) || (deviceParticles[i].generation != reference[i].generation))
+			{
+				mismatches++;
+			}
+		}
+		mismatches += count - std::min(count, static_cast<uint32_t>(deviceParticles.size()));
+		std::cout << "Particle collision validation of step " << particleSystem.stepCount << ": " << mismatches << " of " << count
+			<< " particles differ from the host reference by more than " << tolerance << " (max. position/velocity error " << maxError << ")" << std::endl;
 	}
 
 	void prepare ()
@@ -499,39 +2460,403 @@ public:
 		VulkanExampleBase::prepare();
 		prepareSynchronizationPrimitives();
 		prepareVertices();
+		prepareInstances();
+		prepareIndirectScene();
+		if (options.drawMode == DrawMode::Particles)
+		{
+			vks::GridParams gridParams;
+			particleSystem.prepare(vulkanDevice, queue, pipelineCache, options.particleCount, vks::ParticleParams(), options.collisions ? &gridParams : nullptr, options.asyncCompute);
+			std::cout << "Particles: " << particleSystem.particleCount << (particleSystem.dedicatedComputeQueue ? " (dedicated compute queue" : " (shared graphics and compute queue")
+				<< (particleSystem.asyncCompute ? ", async)" : ")") << (particleSystem.collisions ? ", grid collisions" : "") << std::endl;
+			particleValidationRequested = options.validateParticles;
+			// Both queues are still idle, the overlap of steps and frames needs the timestamps of both on a common clock
+			particleSystem.calibrateTimeline(gpuProfiler, queue);
+		}
+		if ((options.drawMode == DrawMode::HostParticles) || (options.benchmarkParticles))
+		{
+			particleSimulator.reset(options.particleCount, vks::ParticleParams());
+			particleVertices.create(vulkanDevice, particleSimulator.paddedCount(), static_cast<uint32_t>(drawCmdBuffers.size()));
+			std::cout << "Host particles: " << particleSimulator.count << " (" << vks::simd::name(particleSimulator.instructionSet) << ")" << std::endl;
+		}
 		prepareUniformBuffers();
+		if (options.drawMode == DrawMode::Particles)
+		{
+			particleQuads.prepare(vulkanDevice, queue, uniformBufferVS.descriptor, particleSystem.bufferHandles());
+		}
+		if ((options.drawMode == DrawMode::Particles) && (options.lowResRatio > 0))
+		{
+			// Blended with the over operator in arbitrary order (soft, mostly transparent sprites), the depth sort is not used
+			options.sortParticles = false;
+			lowResParticles.prepare(vulkanDevice, pipelineCache, particleQuads, swapChain.colorFormat, presentLayout(),
+				depthFormat, depthStencil.image, depthStencil.view, swapChainViews(), width, height, options.lowResRatio);
+			std::cout << "Low resolution particles: " << lowResParticles.lowWidth << "x" << lowResParticles.lowHeight << " (1/" << lowResParticles.ratio
+				<< "), " << 100.0 * lowResParticles.particlePixels() / ((double)width * height) << "% of the full resolution fragments" << std::endl;
+		}
+		if (options.sortParticles)
+		{
+			particleSort.prepare(vulkanDevice, pipelineCache, particleSystem.particleCount);
+			particleSystem.prepareDepthSort(&particleSort, pipelineCache, uniformBufferVS.descriptor);
+		}
+		if (options.drawMode == DrawMode::EmittedParticles)
+		{
+			prepareEmitters();
+		}
+		if (options.drawMode == DrawMode::Fluid)
+		{
+			particleFluid.prepare(vulkanDevice, queue, pipelineCache, options.fluidCount, vks::FluidParams(), options.fluidSubsteps);
+			std::cout << "Fluid particles: " << particleFluid.particleCount << ", kernel radius " << particleFluid.kernelRadius << ", "
+				<< particleFluid.substeps << " substeps per frame" << std::endl;
+		}
+		if (options.drawMode == DrawMode::NBody)
+		{
+			std::vector<vks::Particle> bodies(options.nbodyCount);
+			for (uint32_t i = 0; i < options.nbodyCount; i++)
+			{
+				bodies[i] = vks::nbody::disc(i, options.nbodyCount);
+			}
+			nbody.prepare(vulkanDevice, queue, pipelineCache, bodies, vks::NBodyParams(), options.nbodyHierarchical);
+			std::cout << "Bodies: " << nbody.bodyCount;
+			if (nbody.hierarchical)
+			{
+				std::cout << " (hierarchical, " << nbody.params.levels << " octree levels)" << std::endl;
+			}
+			else
+			{
+				std::cout << " (direct, tile size " << nbody.tileSize << ")" << std::endl;
+			}
+		}
 		setupDescriptorSetLayout();
 		preparePipelines();
 		setupDescriptorPool();
 		setupDescriptorSet();
 		buildCommandBuffers();
+		if ((options.validateCulling) && (options.gpuCulling))
+		{
+			frustumCulling.validate(queue, 0);
+		}
+		prepareFrameGraph();
 		prepared = true;
 	}
 
 	void draw()
 	{
+		VKS_TRACE_SCOPE("draw");
 		VulkanExampleBase::prepareFrame (); //sets currentBuffer
 		// Use a fence to wait until the command buffer has finished execution before using it again
 		VK_CHECK_RESULT(vkWaitForFences(device, 1, &waitFences[currentBuffer], VK_TRUE, UINT64_MAX));
 		VK_CHECK_RESULT(vkResetFences(device, 1, &waitFences[currentBuffer]));
+		// The previous submission of this command buffer has completed, its scopes can be read without waiting
+		gpuProfiler.resolve(currentBuffer);
+		// The regions of this frame are no longer in use by the device
+		jobSystem->run(frameGraph);
+		jobSystem->wait(frameGraph);
+
+		if (options.occlusionCulling)
+		{
+			// Matrices are written per frame, phase 0 also needs the ones the previous frame's pyramid was rendered with
+			hiZCulling.updateFrame(currentBuffer, uboVS.projectionMatrix * uboVS.viewMatrix * uboVS.modelMatrix);
+		}
+		if (options.drawMode == DrawMode::EmittedParticles)
+		{
+			// Spawn counts and the alive list parity change every frame
+			updateEmitters(currentBuffer);
+			buildEmitterCommandBuffer(currentBuffer);
+		}
+		if (options.drawMode == DrawMode::NBody)
+		{
+			buildNBodyCommandBuffer(currentBuffer);
+		}
+		if (options.drawMode == DrawMode::Particles)
+		{
+			drawParticles();
+			return;
+		}
 
 		// Pipeline stage at which the queue submission will wait (via pWaitSemaphores)
 		vk::PipelineStageFlags waitStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+		const std::vector<vk::CommandBuffer> cmdBuffers = frameCommandBuffers();
 		// The submit info structure specifices a command buffer queue submission batch
 		//SEMAPHORES ALREADY SET
 		submitInfo.setPWaitDstStageMask (&waitStageMask)			
-			.setPCommandBuffers (&drawCmdBuffers[currentBuffer])	// Pointer to the list of pipeline stages that the semaphore waits will occur at
-			.setCommandBufferCount (1);								// Command buffers(s) to execute in this batch (submission)
+			.setPCommandBuffers (cmdBuffers.data())	// Pointer to the list of pipeline stages that the semaphore waits will occur at
+			.setCommandBufferCount (static_cast<uint32_t>(cmdBuffers.size()));	// Command buffers(s) to execute in this batch (submission)
 
 		VK_CHECK_RESULT(queue.submit (submitInfo, waitFences[currentBuffer]));	// Submit to the graphics queue passing a wait fence
+		endLateUpdate();
+		gpuProfiler.markSubmitted(currentBuffer);
 		VulkanExampleBase::submitFrame();
 	}
 
+	// Step the simulation on the compute queue and draw its result on the graphics queue
+	// The graphics submission waits for the step (vertex input) and signals the compute queue that the buffer may be reused
+	// With async compute it waits for the previous step instead and draws its source, so the step just submitted runs concurrently
+	void drawParticles()
+	{
+		const bool validate = particleValidationRequested;
+		particleValidationRequested = false;
+		particleSystem.submitStep(validate);
+		buildParticleCommandBuffer(currentBuffer);
+
+		std::vector<vk::Semaphore> waitSemaphores = { semaphores.presentComplete };
+		std::vector<vk::PipelineStageFlags> waitStageMasks = { vk::PipelineStageFlagBits::eColorAttachmentOutput };
+		if (particleSystem.graphicsWaitSemaphore())
+		{
+			waitSemaphores.push_back(particleSystem.graphicsWaitSemaphore());
+			waitStageMasks.push_back(vks::ParticleSystem::graphicsReadStages());
+		}
+		std::array<vk::Semaphore, 2> signalSemaphores = { semaphores.renderComplete, particleSystem.graphicsSignalSemaphore() };
+		const std::vector<vk::CommandBuffer> cmdBuffers = frameCommandBuffers();
+		vk::SubmitInfo particleSubmitInfo;
+		particleSubmitInfo.setWaitSemaphoreCount (static_cast<uint32_t>(waitSemaphores.size()))
+			.setPWaitSemaphores (waitSemaphores.data())
+			.setPWaitDstStageMask (waitStageMasks.data())
+			.setCommandBufferCount (static_cast<uint32_t>(cmdBuffers.size()))
+			.setPCommandBuffers (cmdBuffers.data())
+			.setSignalSemaphoreCount (static_cast<uint32_t>(signalSemaphores.size()))
+			.setPSignalSemaphores (signalSemaphores.data());
+
+		VK_CHECK_RESULT(queue.submit (particleSubmitInfo, waitFences[currentBuffer]));
+		endLateUpdate();
+		gpuProfiler.markSubmitted(currentBuffer);
+		VulkanExampleBase::submitFrame();
+
+		if (validate)
+		{
+			validateParticles();
+		}
+	}
+
 	virtual void render() override
 	{
 		if (!prepared)
 			return;
 		draw();
+		if ((gpuProfiler.enabled) && (frameCounter == 0))
+		{
+			std::cout << "GPU:";
+			for (auto& timings : gpuProfiler.timings())
+			{
+				std::cout << " " << timings.name << " " << timings.averageMs << " ms";
+			}
+			std::cout << std::endl;
+			for (auto& timings : gpuProfiler.timings())
+			{
+				if (timings.hasStatistics)
+				{
+					// Fragment shader invocations per pixel show overdraw (and quad overshading of small primitives)
+					const vks::GpuProfiler::PipelineStatistics &statistics = timings.lastStatistics;
+					std::cout << " " << timings.name << ": " << statistics.vertexInvocations << " vertex invocations, " << statistics.clippingPrimitives
+						<< " primitives after clipping, " << statistics.fragmentInvocations << " fragment invocations ("
+						<< (double)statistics.fragmentInvocations / ((double)width * height) << " per pixel)" << std::endl;
+				}
+			}
+		}
+		// Once per second
+		if ((options.drawMode == DrawMode::Particles) && (frameCounter == 0))
+		{
+			std::cout << "Particles: " << particleSystem.particleCount << " as " << vks::particleRenderModeName(options.particleRender)
+				<< ", simulation " << particleSystem.averageStepTimeMs << " ms/step" << std::endl;
+			if (particleSystem.overlapMeasured())
+			{
+				// Part of the step hidden behind the graphics work
+				std::cout << "Timeline: graphics " << particleSystem.timeline.graphicsMs << " ms/frame, " << particleSystem.timeline.overlapMs
+					<< " ms of the step overlapped (" << 100.0 * particleSystem.overlapFraction() << "%)" << std::endl;
+			}
+			else if (particleSystem.timeline.supported)
+			{
+				std::cout << "Timeline: graphics " << particleSystem.timeline.graphicsMs << " ms/frame (overlap needs the GPU profiler, see -profile)" << std::endl;
+			}
+		}
+		if ((options.drawMode == DrawMode::HostParticles) && (frameCounter == 0))
+		{
+			std::cout << "Host particles: " << particleSimulator.count << ", simulation " << hostParticleStepMs << " ms/step" << std::endl;
+		}
+		if ((options.drawMode == DrawMode::Fluid) && (frameCounter == 0))
+		{
+			std::cout << "Fluid particles: " << particleFluid.particleCount << ", " << (double)particleFluid.particleCount * particleFluid.substeps * lastFPS
+				<< " particles x steps/sec (" << lastFPS << " fps)" << std::endl;
+		}
+		if ((options.drawMode == DrawMode::NBody) && (frameCounter == 0))
+		{
+			// The hierarchical mode evaluates fewer pairs, its rate is the all pairs equivalent
+			std::cout << "Bodies: " << nbody.bodyCount << ", " << (double)nbody.interactionsPerStep() * lastFPS
+				<< (nbody.hierarchical ? " equivalent" : "") << " interactions/sec (" << lastFPS << " fps)" << std::endl;
+		}
+		if ((options.drawMode == DrawMode::EmittedParticles) && (frameCounter == 0))
+		{
+			// Counters of the last completed frame (no readback stall)
+			const vks::ParticleEmitters::Counters &stats = particleEmitters.statistics;
+			std::cout << "Emitted particles: " << stats.draw.vertexCount << " alive, " << stats.deadCount << " free, "
+				<< stats.emitted << " emitted and " << stats.died << " died in the frame (" << lastFPS << " fps)" << std::endl;
+		}
+	}
+
+	virtual void getEnabledFeatures() override
+	{
+		vk::PhysicalDeviceFeatures deviceFeatures = physicalDevice.getFeatures();
+		// Submit all draw records of the indirect scene with a single call
+		enabledFeatures.multiDrawIndirect = deviceFeatures.multiDrawIndirect;
+		// Indirect draw records select the per-object instance data via firstInstance
+		enabledFeatures.drawIndirectFirstInstance = deviceFeatures.drawIndirectFirstInstance;
+		// Shader invocation and primitive counters of the profiler scopes
+		if (settings.pipelineStatistics)
+		{
+			enabledFeatures.pipelineStatisticsQuery = deviceFeatures.pipelineStatisticsQuery;
+			if (!deviceFeatures.pipelineStatisticsQuery)
+			{
+				std::cerr << "pipelineStatisticsQuery not supported, profiling timestamps only" << std::endl;
+				settings.pipelineStatistics = false;
+			}
+		}
+		if ((options.drawMode == DrawMode::Indirect) && (!deviceFeatures.drawIndirectFirstInstance))
+		{
+			std::cerr << "drawIndirectFirstInstance not supported, falling back to instanced draws" << std::endl;
+			options.drawMode = DrawMode::Instanced;
+			options.gpuCulling = false;
+			options.occlusionCulling = false;
+		}
+
+		// Source the number of draws from a buffer if the device supports it
+		std::vector<vk::ExtensionProperties> extensions = CHECK(physicalDevice.enumerateDeviceExtensionProperties());
+		auto extensionPresent = [&extensions](const char* name)
+		{
+			return std::find_if(extensions.begin(), extensions.end(), [name](const vk::ExtensionProperties& ext) { return std::string(ext.extensionName) == name; }) != extensions.end();
+		};
+		if (extensionPresent(vks::drawIndirectCountExtensionKHR))
+		{
+			enabledExtensions.push_back(vks::drawIndirectCountExtensionKHR);
+		}
+		else if (extensionPresent(vks::drawIndirectCountExtensionAMD))
+		{
+			enabledExtensions.push_back(vks::drawIndirectCountExtensionAMD);
+		}
+	}
+
+	virtual void getBenchmarkMetadata(vks::BenchmarkReport &report) override
+	{
+		const char* drawModes[] = { "single", "per object", "instanced", "indirect", "host transforms", "particles", "host particles", "emitted particles", "fluid", "nbody" };
+		report.addMetadata("drawMode", drawModes[static_cast<uint32_t>(options.drawMode)]);
+		report.addMetadataNumber("instanceCount", options.instanceCount);
+		report.addMetadataFlag("gpuCulling", options.gpuCulling);
+		report.addMetadataFlag("occlusionCulling", options.occlusionCulling);
+		report.addMetadataNumber("particleCount", options.particleCount);
+		report.addMetadata("particleRender", vks::particleRenderModeName(options.particleRender));
+		report.addMetadataFlag("sortParticles", options.sortParticles);
+		report.addMetadataNumber("lowResRatio", options.lowResRatio);
+		report.addMetadataFlag("collisions", options.collisions);
+		report.addMetadataFlag("asyncCompute", options.asyncCompute);
+		report.addMetadataNumber("fluidCount", options.fluidCount);
+		report.addMetadataNumber("nbodyCount", options.nbodyCount);
+		report.addMetadataFlag("nbodyHierarchical", options.nbodyHierarchical);
+	}
+
+	virtual void getOverlayText(vks::TextOverlay *textOverlay, float x, float &y) override
+	{
+		const uint32_t color = vks::TextOverlay::color(0.7f, 0.7f, 0.7f);
+		const uint32_t background = vks::TextOverlay::color(0.0f, 0.0f, 0.0f, 0.6f);
+		const double megabyte = 1024.0 * 1024.0;
+		char text[256];
+		text[0] = '\0';
+		if (options.drawMode == DrawMode::Particles)
+		{
+			VkDeviceSize size = 0;
+			for (uint32_t i = 0; i < particleSystem.bufferCount; i++)
+			{
+				size += particleSystem.buffers[i].size;
+			}
+			snprintf(text, sizeof(text), "Particles %u as %s, %.1f MB state buffers", particleSystem.particleCount,
+				vks::particleRenderModeName(options.particleRender), size / megabyte);
+		}
+		if (options.drawMode == DrawMode::HostParticles)
+		{
+			snprintf(text, sizeof(text), "Host particles %u, simulation %.2f ms/step", particleSimulator.count, hostParticleStepMs);
+		}
+		if (options.drawMode == DrawMode::EmittedParticles)
+		{
+			// Counters of the last completed frame
+			const vks::ParticleEmitters::Counters &stats = particleEmitters.statistics;
+			const VkDeviceSize size = particleEmitters.particleBuffer.size + particleEmitters.aliveBuffer.size + particleEmitters.deadBuffer.size;
+			snprintf(text, sizeof(text), "Emitted particles %u alive, %d free, %.1f MB pool", stats.draw.vertexCount, stats.deadCount, size / megabyte);
+		}
+		if (options.drawMode == DrawMode::Fluid)
+		{
+			const VkDeviceSize size = particleFluid.particleBuffer.size + particleFluid.densityBuffer.size;
+			snprintf(text, sizeof(text), "Fluid particles %u, %.1f MB state buffers", particleFluid.particleCount, size / megabyte);
+		}
+		if (options.drawMode == DrawMode::NBody)
+		{
+			const VkDeviceSize size = nbody.buffers[0].size + nbody.buffers[1].size;
+			snprintf(text, sizeof(text), "Bodies %u, %.1f MB state buffers", nbody.bodyCount, size / megabyte);
+		}
+		if (text[0] != '\0')
+		{
+			textOverlay->addText(text, x, y, vks::TextOverlay::Align::Left, color, background);
+			y += textOverlay->lineHeight();
+		}
+	}
+
+	virtual void keyPressed(uint32_t key) override
+	{
+		switch (key)
+		{
+		case KEY_F2:
+			if (options.gpuCulling)
+			{
+				frustumCulling.validate(queue, 0);
+			}
+			break;
+		case KEY_F3:
+			if (options.occlusionCulling)
+			{
+				const vks::HiZCulling::Statistics &stats = hiZCulling.statistics;
+				std::cout << "Occlusion culling: " << stats.visibleEarly << " early + " << stats.visibleLate << " late visible, "
+					<< stats.occluded << " occluded, " << stats.frustumCulled << " outside of the frustum" << std::endl;
+			}
+			break;
+		case KEY_F4:
+			if (options.drawMode == DrawMode::Particles)
+			{
+				particleValidationRequested = true;
+			}
+			break;
+		case KEY_F5:
+			if ((options.drawMode == DrawMode::Indirect) && (!options.gpuCulling) && (!options.occlusionCulling))
+			{
+				meshReassignRequested = true;
+			}
+			break;
+		}
+	}
+
+	// Color views of the swap chain images
+	std::vector<VkImageView> swapChainViews()
+	{
+		std::vector<VkImageView> views;
+		for (auto& buffer : swapChain.buffers)
+		{
+			views.push_back(buffer.view);
+		}
+		return views;
+	}
+
+	virtual void setupFrameBuffer() override
+	{
+		VulkanExampleBase::setupFrameBuffer();
+		// The low resolution targets and the pass frame buffers depend on the swap chain images and the depth attachment
+		if (lowResParticles.prepared)
+		{
+			lowResParticles.resize(depthStencil.image, depthStencil.view, swapChainViews(), width, height);
+		}
+	}
+
+	virtual void setupDepthStencil() override
+	{
+		VulkanExampleBase::setupDepthStencil();
+		// The depth pyramid depends on the size of the depth attachment
+		if (hiZCulling.prepared)
+		{
+			hiZCulling.resize(depthStencil.image, width, height);
+		}
 	}
 
 	virtual void viewChanged() override
@@ -553,12 +2878,52 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 }
 int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR pCmdLine, int nCmdShow)
 {
+	for (int32_t i = 0; i < __argc; i++) { VulkanExample::args.push_back(__argv[i]); };
 	vulkanExample = new VulkanExample();
 	vulkanExample->initVulkan();
-	vulkanExample->setupWindow(hInstance, WndProc);
-	vulkanExample->initSwapchain();
+	// Headless runs render into offscreen images, there is no window or surface
+	if (!vulkanExample->settings.headless)
+	{
+		vulkanExample->setupWindow(hInstance, WndProc);
+		vulkanExample->initSwapchain();
+	}
 	vulkanExample->prepare();
-	vulkanExample->renderLoop();
+	if (vulkanExample->options.benchmarkInstancing)
+	{
+		vulkanExample->benchmarkInstancing();
+	}
+	else if (vulkanExample->options.benchmarkParticleRender)
+	{
+		vulkanExample->benchmarkParticleRender();
+	}
+	else if (vulkanExample->options.benchmarkLowRes)
+	{
+		vulkanExample->benchmarkLowResParticles();
+	}
+	else if (vulkanExample->options.benchmarkTransforms)
+	{
+		vulkanExample->benchmarkTransforms();
+	}
+	else if (vulkanExample->options.benchmarkParticles)
+	{
+		vulkanExample->benchmarkParticles();
+	}
+	else if (vulkanExample->options.benchmarkSort)
+	{
+		vulkanExample->benchmarkSort();
+	}
+	else if (vulkanExample->options.benchmarkFluid)
+	{
+		vulkanExample->benchmarkFluid();
+	}
+	else if (vulkanExample->options.benchmarkNBody)
+	{
+		vulkanExample->benchmarkNBody();
+	}
+	else
+	{
+		vulkanExample->renderLoop();
+	}
 	delete(vulkanExample);
 	return 0;
 }
@@ -0,0 +1,10 @@
+@echo off
+rem Compiles all GLSL shaders in this folder to SPIR-V (glslangValidator ships with the Vulkan SDK)
+rem Usage: compile.bat [path to glslangValidator.exe]
+
+set GLSLANG=%1
+if "%GLSLANG%"=="" set GLSLANG=%VULKAN_SDK%\Bin\glslangValidator.exe
+
+for %%f in (*.vert *.frag *.comp) do (
+	"%GLSLANG%" -V %%f -o %%f.spv
+)
@@ -0,0 +1,31 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// Writes the farthest full resolution depth of the ratio x ratio footprint of each low resolution texel,
+// so a particle is kept wherever any of the covered pixels can see it (the composite rejects it at the occluded ones)
+
+layout (binding = 0) uniform sampler2D fullDepth;
+
+layout (push_constant) uniform PushConstants
+{
+	uint ratio;
+	float depthTolerance;
+} pushConstants;
+
+void main() 
+{
+	ivec2 size = textureSize(fullDepth, 0);
+	ivec2 origin = ivec2(gl_FragCoord.xy) * int(pushConstants.ratio);
+	float depth = 0.0;
+	for (int y = 0; y < int(pushConstants.ratio); y++)
+	{
+		for (int x = 0; x < int(pushConstants.ratio); x++)
+		{
+			ivec2 texel = min(origin + ivec2(x, y), size - 1);
+			depth = max(depth, texelFetch(fullDepth, texel, 0).r);
+		}
+	}
+	gl_FragDepth = depth;
+}
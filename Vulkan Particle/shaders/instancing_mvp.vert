@@ -0,0 +1,27 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// Per-vertex attributes (binding 0)
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inColor;
+
+// Per-instance attributes (binding 1)
+// The model-view-projection matrix is computed on the host (see SceneTransforms.hpp)
+layout (location = 2) in mat4 instanceMVP;
+layout (location = 6) in vec4 instanceColor;
+
+layout (location = 0) out vec3 outColor;
+
+out gl_PerVertex 
+{
+    vec4 gl_Position;   
+};
+
+
+void main() 
+{
+	outColor = inColor * instanceColor.rgb;
+	gl_Position = instanceMVP * vec4(inPos.xyz, 1.0);
+}
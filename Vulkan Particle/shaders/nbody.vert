@@ -0,0 +1,33 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// Draws the N-body bodies as points, the body buffer is bound as vertex buffer (position.w = mass)
+
+layout (location = 0) in vec4 inPos;		// xyz = position, w = mass
+layout (location = 1) in vec3 inVelocity;
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projectionMatrix;
+	mat4 modelMatrix;
+	mat4 viewMatrix;
+} ubo;
+
+layout (location = 0) out vec3 outColor;
+
+out gl_PerVertex 
+{
+	vec4 gl_Position;
+	float gl_PointSize;
+};
+
+void main() 
+{
+	// Slow (outer) bodies are red, fast (inner) ones white
+	float speed = clamp(length(inVelocity) * 0.8, 0.0, 1.0);
+	outColor = mix(vec3(0.8, 0.2, 0.1), mix(vec3(1.0, 0.8, 0.4), vec3(1.0), speed), speed);
+	gl_PointSize = 1.0;
+	gl_Position = ubo.projectionMatrix * ubo.viewMatrix * ubo.modelMatrix * vec4(inPos.xyz, 1.0);
+}
@@ -0,0 +1,34 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// Draws the simulated particles as points, the particle buffer is bound as vertex buffer
+
+layout (location = 0) in vec4 inPos;		// xyz = position, w = remaining lifetime
+layout (location = 1) in vec3 inVelocity;
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projectionMatrix;
+	mat4 modelMatrix;
+	mat4 viewMatrix;
+} ubo;
+
+layout (location = 0) out vec3 outColor;
+
+out gl_PerVertex 
+{
+	vec4 gl_Position;
+	float gl_PointSize;
+};
+
+void main() 
+{
+	// Fast particles are bright, dying ones fade to red
+	float speed = clamp(length(inVelocity) * 0.25, 0.0, 1.0);
+	float life = clamp(inPos.w * 0.5, 0.0, 1.0);
+	outColor = mix(vec3(1.0, 0.2, 0.05), mix(vec3(0.2, 0.5, 1.0), vec3(1.0), speed), life);
+	gl_PointSize = 1.0;
+	gl_Position = ubo.projectionMatrix * ubo.viewMatrix * ubo.modelMatrix * vec4(inPos.xyz, 1.0);
+}
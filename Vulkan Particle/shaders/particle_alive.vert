@@ -0,0 +1,53 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// Draws the live particles as points, the vertex index selects an entry of the alive list written by this frame's update
+
+struct Particle
+{
+	vec4 position;		// xyz = position, w = remaining lifetime
+	vec3 velocity;
+	uint color;			// RGBA8
+};
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projectionMatrix;
+	mat4 modelMatrix;
+	mat4 viewMatrix;
+} ubo;
+
+layout (std430, binding = 1) readonly buffer Particles
+{
+	Particle particles[];
+};
+
+layout (std430, binding = 2) readonly buffer Alive
+{
+	uint alive[];
+};
+
+layout (push_constant) uniform PushConstants
+{
+	uint list;
+	uint maxParticles;
+} pushConstants;
+
+layout (location = 0) out vec3 outColor;
+
+out gl_PerVertex 
+{
+	vec4 gl_Position;
+	float gl_PointSize;
+};
+
+void main() 
+{
+	Particle particle = particles[alive[pushConstants.list * pushConstants.maxParticles + gl_VertexIndex]];
+	// Fade out during the last half second
+	outColor = unpackUnorm4x8(particle.color).rgb * clamp(particle.position.w * 2.0, 0.0, 1.0);
+	gl_PointSize = 1.0;
+	gl_Position = ubo.projectionMatrix * ubo.viewMatrix * ubo.modelMatrix * vec4(particle.position.xyz, 1.0);
+}
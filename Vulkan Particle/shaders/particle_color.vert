@@ -0,0 +1,31 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// Draws host simulated particles as points, color is computed by the host simulator
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec4 inColor;
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projectionMatrix;
+	mat4 modelMatrix;
+	mat4 viewMatrix;
+} ubo;
+
+layout (location = 0) out vec3 outColor;
+
+out gl_PerVertex 
+{
+	vec4 gl_Position;
+	float gl_PointSize;
+};
+
+void main() 
+{
+	outColor = inColor.rgb;
+	gl_PointSize = 1.0;
+	gl_Position = ubo.projectionMatrix * ubo.viewMatrix * ubo.modelMatrix * vec4(inPos, 1.0);
+}
@@ -0,0 +1,58 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// Draws each particle as a camera facing quad without vertex input: six vertices (two triangles) per particle,
+// each one reads its particle from the simulation's storage buffer (gl_VertexIndex / 6) and derives its corner
+
+layout (constant_id = 0) const float QUAD_SIZE = 0.01;
+
+struct Particle
+{
+	vec4 position;		// xyz = position, w = remaining lifetime
+	vec3 velocity;
+	uint generation;
+};
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projectionMatrix;
+	mat4 modelMatrix;
+	mat4 viewMatrix;
+} ubo;
+
+layout (std430, binding = 1) readonly buffer Particles
+{
+	Particle particles[];
+};
+
+layout (location = 0) out vec3 outColor;
+layout (location = 1) out vec2 outCorner;
+
+out gl_PerVertex 
+{
+	vec4 gl_Position;
+};
+
+// Triangles (0, 1, 2) and (2, 1, 3) of the strip corners in particle_quad.vert
+const vec2 corners[6] = vec2[6](vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(-1.0, 1.0), vec2(-1.0, 1.0), vec2(1.0, -1.0), vec2(1.0, 1.0));
+
+void main() 
+{
+	uint index = uint(gl_VertexIndex) / 6u;
+	vec2 corner = corners[uint(gl_VertexIndex) % 6u];
+	// Only position and velocity are fetched (28 of the 32 bytes)
+	vec4 position = particles[index].position;
+	vec3 velocity = particles[index].velocity;
+
+	// Same colors as particle.vert
+	float speed = clamp(length(velocity) * 0.25, 0.0, 1.0);
+	float life = clamp(position.w * 0.5, 0.0, 1.0);
+	outColor = mix(vec3(1.0, 0.2, 0.05), mix(vec3(0.2, 0.5, 1.0), vec3(1.0), speed), life);
+	outCorner = corner;
+	// Expanded in view space, so the quad always faces the camera
+	vec4 viewPos = ubo.viewMatrix * ubo.modelMatrix * vec4(position.xyz, 1.0);
+	viewPos.xy += corner * (0.5 * QUAD_SIZE);
+	gl_Position = ubo.projectionMatrix * viewPos;
+}
@@ -0,0 +1,21 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// Round particle sprite on a quad, corners outside the unit circle are discarded
+
+layout (location = 0) in vec3 inColor;
+layout (location = 1) in vec2 inCorner;
+
+layout (location = 0) out vec4 outFragColor;
+
+void main() 
+{
+	float radiusSquared = dot(inCorner, inCorner);
+	if (radiusSquared > 1.0)
+	{
+		discard;
+	}
+	outFragColor = vec4(inColor * (1.0 - 0.5 * radiusSquared), 1.0);
+}
@@ -0,0 +1,41 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// Draws each particle as a camera facing quad: one instance of a four corner triangle strip per particle,
+// the particle buffer is bound as per-instance vertex buffer
+
+layout (constant_id = 0) const float QUAD_SIZE = 0.01;
+
+layout (location = 0) in vec2 inCorner;		// -1..1
+layout (location = 1) in vec4 inPos;		// xyz = position, w = remaining lifetime
+layout (location = 2) in vec3 inVelocity;
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projectionMatrix;
+	mat4 modelMatrix;
+	mat4 viewMatrix;
+} ubo;
+
+layout (location = 0) out vec3 outColor;
+layout (location = 1) out vec2 outCorner;
+
+out gl_PerVertex 
+{
+	vec4 gl_Position;
+};
+
+void main() 
+{
+	// Same colors as particle.vert
+	float speed = clamp(length(inVelocity) * 0.25, 0.0, 1.0);
+	float life = clamp(inPos.w * 0.5, 0.0, 1.0);
+	outColor = mix(vec3(1.0, 0.2, 0.05), mix(vec3(0.2, 0.5, 1.0), vec3(1.0), speed), life);
+	outCorner = inCorner;
+	// Expanded in view space, so the quad always faces the camera
+	vec4 viewPos = ubo.viewMatrix * ubo.modelMatrix * vec4(inPos.xyz, 1.0);
+	viewPos.xy += inCorner * (0.5 * QUAD_SIZE);
+	gl_Position = ubo.projectionMatrix * viewPos;
+}
@@ -0,0 +1,22 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// Soft round particle sprite with premultiplied alpha, accumulated with the over operator into the low resolution target
+
+layout (location = 0) in vec3 inColor;
+layout (location = 1) in vec2 inCorner;
+
+layout (location = 0) out vec4 outFragColor;
+
+void main() 
+{
+	float radiusSquared = dot(inCorner, inCorner);
+	if (radiusSquared > 1.0)
+	{
+		discard;
+	}
+	float alpha = 0.6 * (1.0 - radiusSquared);
+	outFragColor = vec4(inColor * alpha, alpha);
+}
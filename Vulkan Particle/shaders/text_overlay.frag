@@ -0,0 +1,18 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// Text overlay glyph, the atlas holds the glyph coverage
+
+layout (binding = 0) uniform sampler2D samplerFont;
+
+layout (location = 0) in vec2 inUV;
+layout (location = 1) in vec4 inColor;
+
+layout (location = 0) out vec4 outFragColor;
+
+void main() 
+{
+	outFragColor = vec4(inColor.rgb, inColor.a * texture(samplerFont, inUV).r);
+}
@@ -0,0 +1,36 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// Text overlay glyph: one instance of a four corner triangle strip per glyph (or filled rectangle),
+// the corner is derived from the vertex index
+
+layout (location = 0) in vec4 inRect;		// xy = top left, zw = size, in pixels
+layout (location = 1) in uint inCell;		// Font atlas cell
+layout (location = 2) in vec4 inColor;
+
+layout (push_constant) uniform PushConstants
+{
+	vec2 invFrameSize;
+} pushConstants;
+
+layout (location = 0) out vec2 outUV;
+layout (location = 1) out vec4 outColor;
+
+out gl_PerVertex 
+{
+	vec4 gl_Position;
+};
+
+// Cells of the 16 x 6 atlas
+const vec2 cellSize = vec2(1.0 / 16.0, 1.0 / 6.0);
+
+void main() 
+{
+	vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1);
+	outUV = (vec2(inCell % 16, inCell / 16) + corner) * cellSize;
+	outColor = inColor;
+	vec2 pos = inRect.xy + corner * inRect.zw;
+	gl_Position = vec4(pos * pushConstants.invFrameSize * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,47 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// Depth aware upsample of the low resolution particles: the four nearest low resolution texels are weighted bilinearly
+// and by the similarity of their depth to the pixel's full resolution depth, texels across a depth edge get (almost) no weight.
+// Output is premultiplied, blended over the scene with (One, OneMinusSrcAlpha)
+
+layout (binding = 0) uniform sampler2D lowColor;
+layout (binding = 1) uniform sampler2D lowDepth;
+layout (binding = 2) uniform sampler2D fullDepth;
+
+layout (push_constant) uniform PushConstants
+{
+	uint ratio;
+	float depthTolerance;
+} pushConstants;
+
+layout (location = 0) out vec4 outFragColor;
+
+void main() 
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	float depth = texelFetch(fullDepth, pixel, 0).r;
+	ivec2 lowSize = textureSize(lowColor, 0);
+
+	// Position in low resolution texel space, the four taps around it and their bilinear weights
+	vec2 lowPos = gl_FragCoord.xy / float(pushConstants.ratio) - 0.5;
+	ivec2 base = ivec2(floor(lowPos));
+	vec2 f = lowPos - vec2(base);
+
+	vec4 color = vec4(0.0);
+	float weightSum = 0.0;
+	for (int i = 0; i < 4; i++)
+	{
+		ivec2 offset = ivec2(i & 1, i >> 1);
+		ivec2 texel = clamp(base + offset, ivec2(0), lowSize - 1);
+		float bilinear = (offset.x == 1 ? f.x : 1.0 - f.x) * (offset.y == 1 ? f.y : 1.0 - f.y);
+		// The low resolution depth is the farthest of its footprint, particles in front of the pixel's occluder pass this test
+		float difference = max(texelFetch(lowDepth, texel, 0).r - depth, 0.0);
+		float weight = bilinear / (1.0 + difference / pushConstants.depthTolerance) + 1e-5 * bilinear;
+		color += texelFetch(lowColor, texel, 0) * weight;
+		weightSum += weight;
+	}
+	outFragColor = color / weightSum;
+}
@@ -0,0 +1,190 @@
+#pragma once
+
+/*
+* Benchmark report
+*
+* Collects per-frame series (e.g. CPU time, GPU time, present interval) of a benchmark run, reduces them to
+* min / avg / median / p95 / p99 / max and writes them together with device and settings metadata as JSON.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace vks
+{
+	/** @brief Reduction of a sample series, percentiles use the nearest rank */
+	struct SampleStatistics
+	{
+		double min = 0.0;
+		double avg = 0.0;
+		double median = 0.0;
+		double p95 = 0.0;
+		double p99 = 0.0;
+		double max = 0.0;
+
+		static SampleStatistics compute(std::vector<double> samples)
+		{
+			SampleStatistics statistics;
+			if (samples.empty())
+			{
+				return statistics;
+			}
+			std::sort(samples.begin(), samples.end());
+			auto percentile = [&samples](double p)
+			{
+				size_t rank = static_cast<size_t>(std::ceil(p * samples.size()));
+				return samples[std::min(std::max(rank, (size_t)1), samples.size()) - 1];
+			};
+			double sum = 0.0;
+			for (double sample : samples)
+			{
+				sum += sample;
+			}
+			statistics.min = samples.front();
+			statistics.avg = sum / samples.size();
+			statistics.median = percentile(0.5);
+			statistics.p95 = percentile(0.95);
+			statistics.p99 = percentile(0.99);
+			statistics.max = samples.back();
+			return statistics;
+		}
+	};
+
+	class BenchmarkReport
+	{
+	public:
+		/** @brief Add a metadata entry written as JSON string */
+		void addMetadata(const std::string &name, const std::string &value)
+		{
+			metadata.push_back({ name, quote(value) });
+		}
+
+		/** @brief Add a metadata entry written as JSON number */
+		void addMetadataNumber(const std::string &name, double value)
+		{
+			metadata.push_back({ name, number(value) });
+		}
+
+		/** @brief Add a metadata entry written as JSON boolean */
+		void addMetadataFlag(const std::string &name, bool value)
+		{
+			metadata.push_back({ name, value ? "true" : "false" });
+		}
+
+		/** @brief Add a per-frame series (milliseconds), written with its statistics and the raw samples */
+		void addSeries(const std::string &name, const std::vector<double> &samples)
+		{
+			series.push_back({ name, samples });
+		}
+
+		/** @brief Statistics of a series added before, zero if there is none with that name */
+		SampleStatistics statistics(const std::string &name) const
+		{
+			for (auto& entry : series)
+			{
+				if (entry.first == name)
+				{
+					return SampleStatistics::compute(entry.second);
+				}
+			}
+			return SampleStatistics();
+		}
+
+		std::string json() const
+		{
+			std::ostringstream out;
+			out << "{\n\t\"metadata\": {";
+			for (size_t i = 0; i < metadata.size(); i++)
+			{
+				out << (i > 0 ? "," : "") << "\n\t\t" << quote(metadata[i].first) << ": " << metadata[i].second;
+			}
+			out << "\n\t},\n\t\"series\": {";
+			for (size_t i = 0; i < series.size(); i++)
+			{
+				const SampleStatistics s = SampleStatistics::compute(series[i].second);
+				out << (i > 0 ? "," : "") << "\n\t\t" << quote(series[i].first) << ": {"
+					<< "\"count\": " << series[i].second.size()
+					<< ", \"min\": " << number(s.min)
+					<< ", \"avg\": " << number(s.avg)
+					<< ", \"median\": " << number(s.median)
+					<< ", \"p95\": " << number(s.p95)
+					<< ", \"p99\": " << number(s.p99)
+					<< ", \"max\": " << number(s.max)
+					<< ", \"samples\": [";
+				for (size_t j = 0; j < series[i].second.size(); j++)
+				{
+					out << (j > 0 ? ", " : "") << number(series[i].second[j]);
+				}
+				out << "]}";
+			}
+			out << "\n\t}\n}\n";
+			return out.str();
+		}
+
+		/** @brief Write the report to a file, returns false if it can't be opened */
+		bool write(const std::string &fileName) const
+		{
+			std::ofstream file(fileName, std::ios::out | std::ios::trunc);
+			if (!file.is_open())
+			{
+				return false;
+			}
+			file << json();
+			return file.good();
+		}
+
+	private:
+		std::vector<std::pair<std::string, std::string>> metadata;
+		std::vector<std::pair<std::string, std::vector<double>>> series;
+
+		static std::string quote(const std::string &value)
+		{
+			std::string quoted = "\"";
+			for (char c : value)
+			{
+				switch (c)
+				{
+				case '"': quoted += "\\\""; break;
+				case '\\': quoted += "\\\\"; break;
+				case '\n': quoted += "\\n"; break;
+				case '\t': quoted += "\\t"; break;
+				default:
+					if (static_cast<unsigned char>(c) < 0x20)
+					{
+						char escaped[8];
+						snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+						quoted += escaped;
+					}
+					else
+					{
+						quoted += c;
+					}
+				}
+			}
+			return quoted + "\"";
+		}
+
+		// JSON has no inf / nan
+		static std::string number(double value)
+		{
+			if (!std::isfinite(value))
+			{
+				return "null";
+			}
+			std::ostringstream out;
+			out << std::setprecision(9) << value;
+			return out.str();
+		}
+	};
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+/*
+* Frame pacer
+*
+* Limits the render loop to a target frame rate. Frame starts are scheduled so that the presents (the end of a frame's
+* CPU work) land on a fixed grid: the next present is predicted one period after the last one, and the frame starts
+* that much earlier as its CPU work usually takes. The wait sleeps coarsely and spins for the last part, the spin margin
+* follows the observed sleep overshoot, so the deadline is met without sleeping past it or spinning for a whole period.
+*
+* The achieved pacing is measured as jitter, the deviation of each present interval from the target period.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace vks
+{
+	class FramePacer
+	{
+	public:
+		/** @brief Target time from present to present in nanoseconds (0 = not pacing) */
+		int64_t periodNs = 0;
+		/** @brief Lower bound of the spin margin, the wait never sleeps closer to the deadline than this */
+		int64_t minSpinNs = 100000;
+		/** @brief Keep the jitter of every frame (for benchmark reports) */
+		bool collectSamples = false;
+		/** @brief Frames that are not sampled (e.g. benchmark warm up) */
+		uint32_t skipFrames = 0;
+
+		/** @brief Last present interval's deviation from the period */
+		double lastJitterMs = 0.0;
+		/** @brief Moving average of lastJitterMs */
+		double averageJitterMs = 0.0;
+		/** @brief Largest lastJitterMs since the last resetMaxJitter() */
+		double maxJitterMs = 0.0;
+		/** @brief Moving average of the time spent waiting per frame */
+		double averageWaitMs = 0.0;
+		/** @brief lastJitterMs of every frame while collecting */
+		std::vector<double> jitterSamples;
+
+		/** @brief Pace to a frame rate, 0 disables pacing */
+		void setTargetFps(double fps)
+		{
+			periodNs = (fps > 0.0) ? static_cast<int64_t>(1000000000.0 / fps) : 0;
+		}
+
+		bool enabled() const
+		{
+			return periodNs > 0;
+		}
+
+		double targetFps() const
+		{
+			return enabled() ? 1000000000.0 / periodNs : 0.0;
+		}
+
+		/** @brief Steady clock nanoseconds, the pacer's time base */
+		static int64_t now()
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		/**
+		* Wait until the frame should start (call at the top of the render loop)
+		*
+		* @note Returns right away if pacing is disabled, for the first frame and if the loop runs behind
+		*/
+		void waitForFrameStart()
+		{
+			if ((!enabled()) || (lastPresentNs == 0))
+			{
+				frameStartNs = now();
+				return;
+			}
+			const int64_t predictedPresentNs = lastPresentNs + periodNs;
+			const int64_t deadlineNs = predictedPresentNs - static_cast<int64_t>(workNs);
+			const int64_t waitStartNs = now();
+
+			// Sleep until the spin margin is left, the margin covers the largest recent overshoot
+			const int64_t spinNs = std::max(minSpinNs, static_cast<int64_t>(sleepOvershootNs));
+			int64_t currentNs = waitStartNs;
+			while (deadlineNs - currentNs > spinNs)
+			{
+				const int64_t requestNs = deadlineNs - currentNs - spinNs;
+				std::this_thread::sleep_for(std::chrono::nanoseconds(requestNs));
+				const int64_t sleptNs = now() - currentNs;
+				// Decays slowly, so a single late wake up keeps the margin up for a while
+				sleepOvershootNs = std::max(sleepOvershootNs * 0.99, (double)std::max(sleptNs - requestNs, (int64_t)0));
+				currentNs += sleptNs;
+			}
+			while (currentNs < deadlineNs)
+			{
+				std::this_thread::yield();
+				currentNs = now();
+			}
+
+			frameStartNs = currentNs;
+			const double waitMs = (currentNs - waitStartNs) / 1000000.0;
+			averageWaitMs = (averageWaitMs == 0.0) ? waitMs : averageWaitMs * 0.95 + waitMs * 0.05;
+		}
+
+		/** @brief The frame has been presented (call after the present / final submit returned) */
+		void framePresented()
+		{
+			const int64_t presentNs = now();
+			// CPU work of the frame, the next frame starts that much ahead of its predicted present
+			const double frameWorkNs = (double)(presentNs - frameStartNs);
+			workNs = (workNs == 0.0) ? frameWorkNs : workNs * 0.9 + frameWorkNs * 0.1;
+
+			if ((enabled()) && (measuredPresentNs != 0))
+			{
+				lastJitterMs = std::abs((presentNs - measuredPresentNs) - periodNs) / 1000000.0;
+				averageJitterMs = (averageJitterMs == 0.0) ? lastJitterMs : averageJitterMs * 0.95 + lastJitterMs * 0.05;
+				maxJitterMs = std::max(maxJitterMs, lastJitterMs);
+				frames++;
+				if ((collectSamples) && (frames > skipFrames))
+				{
+					jitterSamples.push_back(lastJitterMs);
+				}
+			}
+			measuredPresentNs = presentNs;
+			// Presents close to their slot keep the grid, one that missed it by half a period or more starts a new grid instead of rushing to catch up
+			const int64_t slotNs = lastPresentNs + periodNs;
+			lastPresentNs = ((enabled()) && (lastPresentNs != 0) && (std::abs(presentNs - slotNs) < periodNs / 2)) ? slotNs : presentNs;
+		}
+
+		void resetMaxJitter()
+		{
+			maxJitterMs = 0.0;
+		}
+
+	private:
+		int64_t frameStartNs = 0;
+		// Slot of the last present on the grid, the next frame is scheduled from it
+		int64_t lastPresentNs = 0;
+		int64_t measuredPresentNs = 0;
+		double workNs = 0.0;
+		double sleepOvershootNs = 1000000.0;
+		uint64_t frames = 0;
+	};
+}
@@ -0,0 +1,378 @@
+#pragma once
+
+/*
+* Work stealing job system
+*
+* A fixed set of worker threads, each with its own job deque. Workers push and pop at the back of their own deque
+* (LIFO, cache friendly for nested jobs) and steal from the front of other deques when they run out of work.
+* Threads waiting for jobs to complete execute pending jobs instead of blocking, so jobs can spawn and wait for jobs.
+*
+* Supports fire and forget jobs tracked by counters, task graphs with dependencies and parallel for loops.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cassert>
+#include <string>
+
+#include "vksTrace.h"
+
+namespace vks
+{
+	class JobSystem
+	{
+	public:
+		/** @brief Counts unfinished jobs, wait() returns once it reaches zero */
+		struct Counter
+		{
+			std::atomic<uint32_t> pending { 0 };
+			bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+		};
+
+		/**
+		* @brief Set of tasks with dependencies, can be run any number of times (e.g. once per frame)
+		*
+		* @note Dependencies must not form cycles and the graph must not be changed while it is running
+		*/
+		class TaskGraph
+		{
+		public:
+			typedef uint32_t Task;
+
+			/** @brief Add a task, returns its handle for dependencies */
+			Task add(std::function<void()> function)
+			{
+				nodes.emplace_back(new Node());
+				nodes.back()->function = std::move(function);
+				return static_cast<Task>(nodes.size() - 1);
+			}
+
+			/** @brief Task "after" starts once task "before" has finished */
+			void precede(Task before, Task after)
+			{
+				assert(before < nodes.size() && after < nodes.size() && before != after);
+				nodes[before]->successors.push_back(after);
+				nodes[after]->dependencyCount++;
+			}
+
+			size_t size() const { return nodes.size(); }
+
+			void clear()
+			{
+				assert(counter.done());
+				nodes.clear();
+			}
+
+		private:
+			friend class JobSystem;
+			struct Node
+			{
+				std::function<void()> function;
+				std::vector<Task> successors;
+				uint32_t dependencyCount = 0;
+				// Dependencies not finished in the current run
+				std::atomic<uint32_t> remaining { 0 };
+			};
+			// Nodes hold atomics, so they are not moved when the graph grows
+			std::vector<std::unique_ptr<Node>> nodes;
+			Counter counter;
+		};
+
+		/**
+		* Start the worker threads
+		*
+		* @param workerCount Number of worker threads, the thread calling wait() helps out as well (0 = one less than the hardware threads)
+		*/
+		explicit JobSystem(uint32_t workerCount = 0)
+		{
+			if (workerCount == 0)
+			{
+				workerCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+			}
+			// Queue 0 is shared by all threads that are not workers (e.g. the main thread)
+			queues.resize(workerCount + 1);
+			for (auto& queue : queues)
+			{
+				queue.reset(new Queue());
+			}
+			workers.reserve(workerCount);
+			for (uint32_t i = 0; i < workerCount; i++)
+			{
+				workers.emplace_back(&JobSystem::workerLoop, this, i + 1);
+			}
+		}
+
+		~JobSystem()
+		{
+			{
+				std::lock_guard<std::mutex> lock(sleepMutex);
+				running = false;
+			}
+			sleepCondition.notify_all();
+			for (auto& worker : workers)
+			{
+				worker.join();
+			}
+		}
+
+		/** @brief Number of threads executing jobs (workers + the waiting thread) */
+		uint32_t threadCount() const { return static_cast<uint32_t>(queues.size()); }
+
+		/**
+		* @brief Index of the calling thread, 0 for non-worker threads, 1..workers for worker threads
+		*
+		* @note Secondary command buffers can be recorded by jobs with one command pool per thread and frame in flight
+		* (threadCount() pools per frame), allocating from pools[frame][threadIndex()]. A pool is then only used by one thread,
+		* which Vulkan requires, even if a waiting job runs other jobs in between. Resetting the pools of a frame once its fence
+		* has signaled recycles all of its command buffers. Index 0 is shared by all non-worker threads, so only one of them may record.
+		*/
+		static uint32_t threadIndex() { return currentThreadIndex(); }
+
+		/**
+		* Queue a job
+		*
+		* @param job Function to execute
+		* @param counter Optional counter incremented now and decremented once the job has finished
+		*/
+		void submit(std::function<void()> job, Counter *counter = nullptr)
+		{
+			if (counter)
+			{
+				counter->pending.fetch_add(1, std::memory_order_relaxed);
+			}
+			push(Job{ std::move(job), counter, nullptr, 0 });
+		}
+
+		/** @brief Execute pending jobs on the calling thread until the counter reaches zero */
+		void wait(const Counter &counter)
+		{
+			const uint32_t index = currentThreadIndex();
+			while (!counter.done())
+			{
+				Job job;
+				if (pop(index, job))
+				{
+					execute(job);
+				}
+				else
+				{
+					std::this_thread::yield();
+				}
+			}
+		}
+
+		/** @brief Start all tasks of a graph without dependencies, the others start once their dependencies are done */
+		void run(TaskGraph &graph)
+		{
+			assert(graph.counter.done());
+			if (graph.nodes.empty())
+			{
+				return;
+			}
+			graph.counter.pending.store(static_cast<uint32_t>(graph.nodes.size()), std::memory_order_relaxed);
+			for (auto& node : graph.nodes)
+			{
+				node->remaining.store(node->dependencyCount, std::memory_order_relaxed);
+			}
+			for (uint32_t i = 0; i < graph.nodes.size(); i++)
+			{
+				if (graph.nodes[i]->dependencyCount == 0)
+				{
+					push(Job{ nullptr, &graph.counter, &graph, i });
+				}
+			}
+		}
+
+		/** @brief Execute pending jobs on the calling thread until all tasks of the graph have finished */
+		void wait(const TaskGraph &graph)
+		{
+			wait(graph.counter);
+		}
+
+		/**
+		* Split [begin, end) into chunks and process them in parallel, returns once all chunks are done
+		*
+		* @param begin First index
+		* @param end One past the last index
+		* @param grainSize Min. number of indices per chunk
+		* @param function Called as function(first, last) for each chunk [first, last)
+		*/
+		template <typename Function>
+		void parallelFor(uint32_t begin, uint32_t end, uint32_t grainSize, const Function &function)
+		{
+			if (end <= begin)
+			{
+				return;
+			}
+			const uint32_t count = end - begin;
+			// A few chunks per thread so threads that finish early can steal the rest
+			const uint32_t chunkSize = std::max(grainSize, (count + threadCount() * 4 - 1) / (threadCount() * 4));
+			if (chunkSize >= count)
+			{
+				function(begin, end);
+				return;
+			}
+			Counter counter;
+			for (uint32_t first = begin + chunkSize; first < end; first += chunkSize)
+			{
+				const uint32_t last = std::min(first + chunkSize, end);
+				submit([&function, first, last]() { function(first, last); }, &counter);
+			}
+			// The calling thread takes the first chunk itself
+			function(begin, begin + chunkSize);
+			wait(counter);
+		}
+
+	private:
+		struct Job
+		{
+			std::function<void()> function;
+			Counter *counter;
+			// Task graph jobs run graph->nodes[task]
+			TaskGraph *graph;
+			uint32_t task;
+		};
+
+		struct Queue
+		{
+			std::mutex mutex;
+			std::deque<Job> jobs;
+		};
+
+		std::vector<std::unique_ptr<Queue>> queues;
+		std::vector<std::thread> workers;
+		std::atomic<uint32_t> queuedJobs { 0 };
+		bool running = true;
+		std::mutex sleepMutex;
+		std::condition_variable sleepCondition;
+
+		static uint32_t& currentThreadIndex()
+		{
+			static thread_local uint32_t index = 0;
+			return index;
+		}
+
+		void push(Job &&job)
+		{
+			uint32_t index = currentThreadIndex();
+			// Threads of another job system (or none) use the shared queue
+			if (index >= queues.size())
+			{
+				index = 0;
+			}
+			// Counted before it is visible, so the count never drops below the number of queued jobs
+			queuedJobs.fetch_add(1, std::memory_order_relaxed);
+			{
+				std::lock_guard<std::mutex> lock(queues[index]->mutex);
+				queues[index]->jobs.push_back(std::move(job));
+			}
+			// Taking the lock orders the notification after a worker's check of queuedJobs
+			{
+				std::lock_guard<std::mutex> lock(sleepMutex);
+			}
+			sleepCondition.notify_one();
+		}
+
+		// Own queue first (newest job), then steal the oldest job of another queue
+		bool pop(uint32_t index, Job &job)
+		{
+			if (queuedJobs.load(std::memory_order_acquire) == 0)
+			{
+				return false;
+			}
+			const uint32_t queueCount = static_cast<uint32_t>(queues.size());
+			index = (index < queueCount) ? index : 0;
+			{
+				Queue &queue = *queues[index];
+				std::lock_guard<std::mutex> lock(queue.mutex);
+				if (!queue.jobs.empty())
+				{
+					job = std::move(queue.jobs.back());
+					queue.jobs.pop_back();
+					queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+					return true;
+				}
+			}
+			for (uint32_t i = 1; i < queueCount; i++)
+			{
+				Queue &victim = *queues[(index + i) % queueCount];
+				std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+				if (lock.owns_lock() && !victim.jobs.empty())
+				{
+					job = std::move(victim.jobs.front());
+					victim.jobs.pop_front();
+					queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+					return true;
+				}
+			}
+			return false;
+		}
+
+		void execute(Job &job)
+		{
+			VKS_TRACE_SCOPE("job");
+			if (job.graph)
+			{
+				TaskGraph::Node &node = *job.graph->nodes[job.task];
+				node.function();
+				// Start successors whose last dependency this was
+				for (TaskGraph::Task successor : node.successors)
+				{
+					if (job.graph->nodes[successor]->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+					{
+						push(Job{ nullptr, job.counter, job.graph, successor });
+					}
+				}
+			}
+			else
+			{
+				job.function();
+			}
+			if (job.counter)
+			{
+				job.counter->pending.fetch_sub(1, std::memory_order_release);
+			}
+		}
+
+		void workerLoop(uint32_t index)
+		{
+			currentThreadIndex() = index;
+			vks::trace::setThreadName("worker " + std::to_string(index));
+			uint32_t idleSpins = 0;
+			while (true)
+			{
+				Job job;
+				if (pop(index, job))
+				{
+					execute(job);
+					idleSpins = 0;
+					continue;
+				}
+				// Spin a little before sleeping, jobs often come in bursts (e.g. once per frame)
+				if (++idleSpins < 64)
+				{
+					std::this_thread::yield();
+					continue;
+				}
+				std::unique_lock<std::mutex> lock(sleepMutex);
+				sleepCondition.wait(lock, [this]() { return !running || (queuedJobs.load(std::memory_order_acquire) > 0); });
+				if (!running)
+				{
+					return;
+				}
+				idleSpins = 0;
+			}
+		}
+	};
+}
@@ -0,0 +1,224 @@
+#pragma once
+
+/*
+* SIMD helpers for host side batch processing
+*
+* Runtime instruction set detection, 32 byte aligned storage for SoA arrays
+* and per-function instruction set targets (so AVX2 kernels can live next to the SSE and scalar ones)
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define VKS_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define VKS_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+// MSVC accepts intrinsics of any instruction set without compiler flags, GCC and Clang need a per-function target
+#if defined(VKS_SIMD_X86) && !defined(_MSC_VER)
+#define VKS_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define VKS_TARGET_AVX2
+#endif
+
+// AVX2 without FMA, for kernels that have to match scalar (or shader) results bit for bit
+// GCC and Clang would otherwise contract separate multiplies and adds into fused ones
+#if defined(VKS_SIMD_X86) && !defined(_MSC_VER)
+#define VKS_TARGET_AVX2_NOFMA __attribute__((target("avx2")))
+#else
+#define VKS_TARGET_AVX2_NOFMA
+#endif
+
+// Code between VKS_FP_CONTRACT_OFF_BEGIN and VKS_FP_CONTRACT_OFF_END keeps multiplies and adds separately rounded
+// GCC contracts across statements on targets with FMA (e.g. AArch64) by default, Clang within expressions
+// MSVC only contracts with /fp:contract or /fp:fast, which the project doesn't use
+#if defined(__clang__)
+#define VKS_FP_CONTRACT_OFF_BEGIN _Pragma("STDC FP_CONTRACT OFF")
+#define VKS_FP_CONTRACT_OFF_END _Pragma("STDC FP_CONTRACT DEFAULT")
+#elif defined(__GNUC__)
+#define VKS_FP_CONTRACT_OFF_BEGIN _Pragma("GCC push_options") _Pragma("GCC optimize (\"fp-contract=off\")")
+#define VKS_FP_CONTRACT_OFF_END _Pragma("GCC pop_options")
+#else
+#define VKS_FP_CONTRACT_OFF_BEGIN
+#define VKS_FP_CONTRACT_OFF_END
+#endif
+
+namespace vks
+{
+	namespace simd
+	{
+		enum class InstructionSet
+		{
+			Scalar,
+			SSE,	// SSE2 (baseline on x64)
+			AVX2,	// AVX2 + FMA
+			NEON
+		};
+
+		/** @brief Returns true if the CPU and the OS support AVX2 and FMA */
+		inline bool hasAVX2()
+		{
+#if defined(VKS_SIMD_X86)
+#if defined(_MSC_VER)
+			int info[4];
+			__cpuid(info, 0);
+			if (info[0] < 7)
+			{
+				return false;
+			}
+			__cpuid(info, 1);
+			const bool fma = (info[2] & (1 << 12)) != 0;
+			const bool osxsave = (info[2] & (1 << 27)) != 0;
+			const bool avx = (info[2] & (1 << 28)) != 0;
+			// The OS must save the YMM registers on context switches
+			if (!(fma && osxsave && avx) || ((_xgetbv(0) & 0x6) != 0x6))
+			{
+				return false;
+			}
+			__cpuidex(info, 7, 0);
+			return (info[1] & (1 << 5)) != 0;
+#else
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+#else
+			return false;
+#endif
+		}
+
+		/** @brief Returns true if the instruction set can be used on this machine */
+		inline bool supported(InstructionSet instructionSet)
+		{
+			switch (instructionSet)
+			{
+			case InstructionSet::Scalar:
+				return true;
+#if defined(VKS_SIMD_X86)
+			case InstructionSet::SSE:
+				return true;
+			case InstructionSet::AVX2:
+				return hasAVX2();
+#endif
+#if defined(VKS_SIMD_NEON)
+			case InstructionSet::NEON:
+				return true;
+#endif
+			default:
+				return false;
+			}
+		}
+
+		/** @brief Widest instruction set supported by this machine */
+		inline InstructionSet best()
+		{
+			if (supported(InstructionSet::AVX2))
+			{
+				return InstructionSet::AVX2;
+			}
+			if (supported(InstructionSet::NEON))
+			{
+				return InstructionSet::NEON;
+			}
+			if (supported(InstructionSet::SSE))
+			{
+				return InstructionSet::SSE;
+			}
+			return InstructionSet::Scalar;
+		}
+
+		inline const char* name(InstructionSet instructionSet)
+		{
+			switch (instructionSet)
+			{
+			case InstructionSet::SSE: return "SSE";
+			case InstructionSet::AVX2: return "AVX2";
+			case InstructionSet::NEON: return "NEON";
+			default: return "Scalar";
+			}
+		}
+
+		/** @brief Allocator for SoA arrays, aligned for 256 bit loads and stores */
+		template <typename T, size_t Alignment = 32>
+		struct AlignedAllocator
+		{
+			typedef T value_type;
+
+			template <typename U>
+			struct rebind { typedef AlignedAllocator<U, Alignment> other; };
+
+			AlignedAllocator() {}
+			template <typename U>
+			AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+			T* allocate(size_t count)
+			{
+				void *data = nullptr;
+#if defined(_WIN32)
+				data = _aligned_malloc(count * sizeof(T), Alignment);
+#else
+				if (posix_memalign(&data, Alignment, count * sizeof(T)) != 0)
+				{
+					data = nullptr;
+				}
+#endif
+				if (!data)
+				{
+					throw std::bad_alloc();
+				}
+				return static_cast<T*>(data);
+			}
+
+			void deallocate(T *data, size_t)
+			{
+#if defined(_WIN32)
+				_aligned_free(data);
+#else
+				free(data);
+#endif
+			}
+
+			template <typename U>
+			bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+			template <typename U>
+			bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+		};
+
+		template <typename T>
+		using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+		/** @brief Index of the lowest set bit (mask must not be zero) */
+		inline uint32_t lowestBit(uint32_t mask)
+		{
+#if defined(_MSC_VER)
+			unsigned long index;
+			_BitScanForward(&index, mask);
+			return static_cast<uint32_t>(index);
+#else
+			return static_cast<uint32_t>(__builtin_ctz(mask));
+#endif
+		}
+
+		/** @brief Round a count up to a multiple of the lane count */
+		inline uint32_t padded(uint32_t count, uint32_t laneCount)
+		{
+			return (count + laneCount - 1) / laneCount * laneCount;
+		}
+	}
+}
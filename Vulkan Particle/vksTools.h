@@ -12,6 +12,8 @@
 
 #include <vulkan/vulkan.hpp>
 
+#include "VulkanDebugMarker.hpp"
+
 // Custom define for better code readability
 #define VK_FLAGS_NONE 0
 // Default fence timeout in nanoseconds
@@ -230,6 +232,37 @@ namespace vks {
 			}
 		}
 
+		/**
+		* Create a compute pipeline from a SPIR-V file
+		*
+		* @param device Logical device
+		* @param pipelineCache Pipeline cache to use
+		* @param layout Pipeline layout
+		* @param filename SPIR-V compute shader file
+		* @param specializationInfo (Optional) Specialization constants of the compute stage
+		*
+		* @note The shader module is destroyed once the pipeline has been created
+		* @note The pipeline is named after the shader file for debugging tools
+		*/
+		static inline vk::Pipeline createComputePipeline(vk::Device device, vk::PipelineCache pipelineCache, vk::PipelineLayout layout,
+			std::string filename, const vk::SpecializationInfo *specializationInfo = nullptr)
+		{
+			vk::PipelineShaderStageCreateInfo shaderStage;
+			shaderStage.setStage (vk::ShaderStageFlagBits::eCompute)
+				.setModule (loadSPIRVShader(filename, device))
+				.setPName ("main")
+				.setPSpecializationInfo (specializationInfo);
+
+			vk::ComputePipelineCreateInfo pipelineCreateInfo;
+			pipelineCreateInfo.setStage (shaderStage)
+				.setLayout (layout);
+			vk::Pipeline pipeline = CHECK(device.createComputePipeline (pipelineCache, pipelineCreateInfo));
+			vks::debugmarker::setObjectName(static_cast<VkDevice>(device), (uint64_t)static_cast<VkPipeline>(pipeline), VK_DEBUG_REPORT_OBJECT_TYPE_PIPELINE_EXT, filename.c_str());
+
+			device.destroyShaderModule (shaderStage.module);
+			return pipeline;
+		}
+
 		static inline void exitFatal(std::string message, std::string caption)
 		{
 			MessageBox(NULL, message.c_str(), caption.c_str(), MB_OK | MB_ICONERROR);
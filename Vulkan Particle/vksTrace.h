@@ -0,0 +1,292 @@
+#pragma once
+
+/*
+* CPU / GPU trace recorder
+*
+* CPU scopes (VKS_TRACE_SCOPE) are recorded into a fixed size ring buffer per thread, so recording takes no lock and
+* only the oldest events are lost on long runs. GPU scopes are added by the GPU profiler with their timestamps converted
+* to the CPU time base. write() emits both as Chrome trace event JSON (chrome://tracing, ui.perfetto.dev).
+*
+* The scope macro is compiled out without VKS_TRACING, with it a scope costs a relaxed load while recording is off.
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(VKS_TRACING)
+#define VKS_TRACE_CONCAT_(a, b) a##b
+#define VKS_TRACE_CONCAT(a, b) VKS_TRACE_CONCAT_(a, b)
+/** @brief Records the enclosing block as CPU event, the name must be a string literal */
+#define VKS_TRACE_SCOPE(name) vks::trace::Scope VKS_TRACE_CONCAT(traceScope, __LINE__)(name)
+#else
+#define VKS_TRACE_SCOPE(name)
+#endif
+
+namespace vks
+{
+	namespace trace
+	{
+		/** @brief A completed scope, times in nanoseconds of now() */
+		struct Event
+		{
+			const char* name;
+			int64_t beginNs;
+			int64_t endNs;
+		};
+
+		/** @brief Events kept per thread (and for the GPU), older events are overwritten */
+		const uint32_t ringCapacity = 1 << 16;
+
+		/** @brief Trace time base, steady clock nanoseconds */
+		inline int64_t now()
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		class Ring
+		{
+		public:
+			std::string name;
+			uint32_t id = 0;
+
+			Ring() : events(ringCapacity) {}
+
+			void push(const char* name, int64_t beginNs, int64_t endNs)
+			{
+				const uint64_t index = count.load(std::memory_order_relaxed);
+				events[index % ringCapacity] = { name, beginNs, endNs };
+				count.store(index + 1, std::memory_order_release);
+			}
+
+			/** @brief Events in recording order, only consistent while the ring's thread doesn't record */
+			std::vector<Event> snapshot() const
+			{
+				const uint64_t end = count.load(std::memory_order_acquire);
+				const uint64_t begin = (end > ringCapacity) ? end - ringCapacity : 0;
+				std::vector<Event> result;
+				result.reserve(static_cast<size_t>(end - begin));
+				for (uint64_t i = begin; i < end; i++)
+				{
+					result.push_back(events[i % ringCapacity]);
+				}
+				return result;
+			}
+
+		private:
+			std::vector<Event> events;
+			std::atomic<uint64_t> count { 0 };
+		};
+
+		struct State
+		{
+			std::atomic<bool> enabled { false };
+			// Taken when a thread records its first event, when the GPU ring is written and when the trace is written
+			std::mutex mutex;
+			std::vector<std::shared_ptr<Ring>> threads;
+			Ring gpu;
+			std::string gpuName = "GPU";
+		};
+
+		inline State& state()
+		{
+			static State instance;
+			return instance;
+		}
+
+		inline std::string& threadName()
+		{
+			static thread_local std::string name;
+			return name;
+		}
+
+		// Registered on first use, the registry keeps the ring alive after its thread has exited
+		inline std::shared_ptr<Ring>& threadRingPointer()
+		{
+			static thread_local std::shared_ptr<Ring> ring;
+			return ring;
+		}
+
+		inline Ring& threadRing()
+		{
+			std::shared_ptr<Ring> &ring = threadRingPointer();
+			if (!ring)
+			{
+				ring = std::make_shared<Ring>();
+				State &s = state();
+				std::lock_guard<std::mutex> lock(s.mutex);
+				ring->id = static_cast<uint32_t>(s.threads.size());
+				ring->name = threadName().empty() ? "thread " + std::to_string(ring->id) : threadName();
+				s.threads.push_back(ring);
+			}
+			return *ring;
+		}
+
+		/** @brief Start or stop recording */
+		inline void setEnabled(bool enabled)
+		{
+			state().enabled.store(enabled, std::memory_order_relaxed);
+		}
+
+		inline bool enabled()
+		{
+			return state().enabled.load(std::memory_order_relaxed);
+		}
+
+		/** @brief Name of the calling thread's track, doesn't allocate the thread's ring */
+		inline void setThreadName(const std::string &name)
+		{
+			threadName() = name;
+			std::shared_ptr<Ring> &ring = threadRingPointer();
+			if (ring)
+			{
+				std::lock_guard<std::mutex> lock(state().mutex);
+				ring->name = name;
+			}
+		}
+
+		/** @brief Name of the GPU track (e.g. the device name) */
+		inline void setGpuName(const std::string &name)
+		{
+			std::lock_guard<std::mutex> lock(state().mutex);
+			state().gpuName = name;
+		}
+
+		/** @brief Add a GPU event, times already converted to now() nanoseconds */
+		inline void addGpuEvent(const char* name, int64_t beginNs, int64_t endNs)
+		{
+			State &s = state();
+			if (!s.enabled.load(std::memory_order_relaxed))
+			{
+				return;
+			}
+			std::lock_guard<std::mutex> lock(s.mutex);
+			s.gpu.push(name, beginNs, endNs);
+		}
+
+		/** @brief Records its lifetime as event of the calling thread */
+		class Scope
+		{
+		public:
+			explicit Scope(const char* name) : name(name)
+			{
+				beginNs = enabled() ? now() : -1;
+			}
+			~Scope()
+			{
+				if (beginNs >= 0)
+				{
+					threadRing().push(name, beginNs, now());
+				}
+			}
+		private:
+			const char* name;
+			int64_t beginNs;
+		};
+
+		namespace detail
+		{
+			inline std::string quote(const char* value)
+			{
+				std::string quoted = "\"";
+				for (const char* c = value; *c; c++)
+				{
+					if ((*c == '"') || (*c == '\\'))
+					{
+						quoted += '\\';
+					}
+					quoted += (static_cast<unsigned char>(*c) < 0x20) ? ' ' : *c;
+				}
+				return quoted + "\"";
+			}
+
+			inline void writeEvents(std::ostringstream &out, bool &first, uint32_t pid, uint32_t tid, const std::vector<Event> &events, int64_t originNs)
+			{
+				char buffer[64];
+				for (auto& event : events)
+				{
+					// Microseconds with nanosecond resolution
+					out << (first ? "" : ",") << "\n\t\t{\"name\": " << quote(event.name) << ", \"ph\": \"X\", \"pid\": " << pid << ", \"tid\": " << tid;
+					snprintf(buffer, sizeof(buffer), "%.3f", (event.beginNs - originNs) / 1000.0);
+					out << ", \"ts\": " << buffer;
+					snprintf(buffer, sizeof(buffer), "%.3f", (event.endNs - event.beginNs) / 1000.0);
+					out << ", \"dur\": " << buffer << "}";
+					first = false;
+				}
+			}
+
+			inline void writeName(std::ostringstream &out, bool &first, const char* kind, uint32_t pid, uint32_t tid, const std::string &name)
+			{
+				out << (first ? "" : ",") << "\n\t\t{\"name\": \"" << kind << "\", \"ph\": \"M\", \"pid\": " << pid << ", \"tid\": " << tid
+					<< ", \"args\": {\"name\": " << quote(name.c_str()) << "}}";
+				first = false;
+			}
+		}
+
+		/**
+		* Write all recorded events as Chrome trace JSON, CPU threads as process 0, the GPU as process 1
+		*
+		* @note Call while no thread records (e.g. after the render loop), returns false if the file can't be written
+		*/
+		inline bool write(const std::string &fileName)
+		{
+			State &s = state();
+			std::lock_guard<std::mutex> lock(s.mutex);
+
+			std::vector<std::vector<Event>> threadEvents;
+			int64_t originNs = INT64_MAX;
+			for (auto& ring : s.threads)
+			{
+				// Events are in order of their end, an enclosing scope begins before the first one
+				threadEvents.push_back(ring->snapshot());
+				for (auto& event : threadEvents.back())
+				{
+					originNs = std::min(originNs, event.beginNs);
+				}
+			}
+			const std::vector<Event> gpuEvents = s.gpu.snapshot();
+			for (auto& event : gpuEvents)
+			{
+				originNs = std::min(originNs, event.beginNs);
+			}
+			if (originNs == INT64_MAX)
+			{
+				originNs = 0;
+			}
+
+			std::ostringstream out;
+			bool first = true;
+			out << "{\n\t\"displayTimeUnit\": \"ms\",\n\t\"traceEvents\": [";
+			detail::writeName(out, first, "process_name", 0, 0, "CPU");
+			detail::writeName(out, first, "process_name", 1, 0, "GPU");
+			detail::writeName(out, first, "thread_name", 1, 0, s.gpuName);
+			for (size_t i = 0; i < s.threads.size(); i++)
+			{
+				detail::writeName(out, first, "thread_name", 0, s.threads[i]->id, s.threads[i]->name);
+				detail::writeEvents(out, first, 0, s.threads[i]->id, threadEvents[i], originNs);
+			}
+			detail::writeEvents(out, first, 1, 0, gpuEvents, originNs);
+			out << "\n\t]\n}\n";
+
+			std::ofstream file(fileName, std::ios::out | std::ios::trunc);
+			if (!file.is_open())
+			{
+				return false;
+			}
+			file << out.str();
+			return file.good();
+		}
+	}
+}